@@ -0,0 +1,52 @@
+//
+//  AliasTable.h
+//  RayTracing
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+#ifndef ALIAS_TABLE_H
+#define ALIAS_TABLE_H
+
+#ifndef __METAL_VERSION__
+#include <stdint.h>
+#include "Config.h"
+
+/// Alias table over `count` weights by Vose's method, see `EnvironmentMap.makeAliasTable()`.
+/// Weights must sum up to a positive number, and are overwritten with their scaled values.
+/// `stack` has room for `count` indices: texels below the average grow from the start, above it from the end.
+static inline void build_alias_table(double *weights, uint32_t count, struct EnvironmentAliasEntry *entries, uint32_t *stack) {
+    double sum = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        sum += weights[i];
+    }
+    uint32_t small = 0;
+    uint32_t large = count;
+    for (uint32_t i = 0; i < count; i++) {
+        entries[i].probability = 1;
+        entries[i].alias = i;
+        entries[i].pdf = (float)(weights[i] / sum);
+        weights[i] = weights[i] / sum * count;
+        if (weights[i] < 1) {
+            stack[small++] = i;
+        } else {
+            stack[--large] = i;
+        }
+    }
+    while (small > 0 && large < count) {
+        uint32_t s = stack[--small];
+        uint32_t l = stack[large++];
+        entries[s].probability = (float)weights[s];
+        entries[s].alias = l;
+        weights[l] -= 1 - weights[s];
+        if (weights[l] < 1) {
+            stack[small++] = l;
+        } else {
+            stack[--large] = l;
+        }
+    }
+    // Leftovers are 1 up to rounding errors, and keep probability 1
+}
+
+#endif
+
+#endif // ALIAS_TABLE_H
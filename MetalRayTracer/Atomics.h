@@ -0,0 +1,28 @@
+//
+//  Atomics.h
+//  RayTracing
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+#ifndef ATOMICS_H
+#define ATOMICS_H
+
+#ifndef __METAL_VERSION__
+#include <stdint.h>
+
+/// Atomic accesses to plain integers for lock-free structures in Swift, see `Tracer.ThreadBuffer`.
+/// Swift has no atomics of its own before macOS 15.
+static inline uint64_t atomic_load_acquire_u64(uint64_t const *pointer) {
+    return __atomic_load_n(pointer, __ATOMIC_ACQUIRE);
+}
+
+static inline void atomic_store_release_u64(uint64_t *pointer, uint64_t value) {
+    __atomic_store_n(pointer, value, __ATOMIC_RELEASE);
+}
+
+static inline void atomic_increment_relaxed_u64(uint64_t *pointer) {
+    __atomic_fetch_add(pointer, 1, __ATOMIC_RELAXED);
+}
+#endif
+
+#endif // ATOMICS_H
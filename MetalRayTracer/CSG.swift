@@ -12,6 +12,15 @@ struct __SubtractImpl<LHS: RenderableImpl, RHS: RenderableImpl>: RenderableImpl
     static var intersectionFunctionName: String {
         getIntersectionFunctionName(operation: "subtract", operands: (LHS.self, RHS.self))
     }
+
+    static var materialHandleOffsets: [Int] {
+        LHS.materialHandleOffsets.map { $0 + MemoryLayout<Self>.offset(of: \.lhs)! }
+            + RHS.materialHandleOffsets.map { $0 + MemoryLayout<Self>.offset(of: \.rhs)! }
+    }
+
+    static var hasMotion: Bool {
+        getHasMotion(operands: (LHS.self, RHS.self))
+    }
 }
 
 struct Subtract<LHS: Renderable, RHS: Renderable>: Renderable {
@@ -22,6 +31,10 @@ struct Subtract<LHS: Renderable, RHS: Renderable>: Renderable {
         lhs.boundingBox
     }
 
+    func boundingBox(during interval: ClosedRange<Float>) -> MTLAxisAlignedBoundingBox {
+        lhs.boundingBox(during: interval)
+    }
+
     func visitMaterials(_ reserver: inout MaterialReserver) {
         lhs.visitMaterials(&reserver)
         rhs.visitMaterials(&reserver)
@@ -48,6 +61,14 @@ struct __UnionImpl<each T: RenderableImpl>: RenderableImpl {
     static var intersectionFunctionName: String {
         getIntersectionFunctionName(operation: "union\(Self.count)", operands: (repeat (each T).self))
     }
+
+    static var materialHandleOffsets: [Int] {
+        getMaterialHandleOffsets(at: MemoryLayout<Self>.offset(of: \.items)!, operands: (repeat (each T).self))
+    }
+
+    static var hasMotion: Bool {
+        getHasMotion(operands: (repeat (each T).self))
+    }
 }
 
 struct Union<each T: Renderable>: Renderable {
@@ -65,6 +86,14 @@ struct Union<each T: Renderable>: Renderable {
         return result
     }
 
+    func boundingBox(during interval: ClosedRange<Float>) -> MTLAxisAlignedBoundingBox {
+        var result: MTLAxisAlignedBoundingBox = .empty
+        for item in repeat (each items) {
+            result.unite(with: item.boundingBox(during: interval))
+        }
+        return result
+    }
+
     func visitMaterials(_ reserver: inout MaterialReserver) {
         for item in repeat (each items) {
             item.visitMaterials(&reserver)
@@ -90,6 +119,14 @@ struct __IntersectionImpl<each T: RenderableImpl>: RenderableImpl {
     static var intersectionFunctionName: String {
         getIntersectionFunctionName(operation: "intersection\(Self.count)", operands: (repeat (each T).self))
     }
+
+    static var materialHandleOffsets: [Int] {
+        getMaterialHandleOffsets(at: MemoryLayout<Self>.offset(of: \.items)!, operands: (repeat (each T).self))
+    }
+
+    static var hasMotion: Bool {
+        getHasMotion(operands: (repeat (each T).self))
+    }
 }
 
 struct Intersection<each T: Renderable>: Renderable {
@@ -107,6 +144,14 @@ struct Intersection<each T: Renderable>: Renderable {
         return result
     }
 
+    func boundingBox(during interval: ClosedRange<Float>) -> MTLAxisAlignedBoundingBox {
+        var result: MTLAxisAlignedBoundingBox = .unlimited
+        for item in repeat (each items) {
+            result.intersect(with: item.boundingBox(during: interval))
+        }
+        return result
+    }
+
     func visitMaterials(_ reserver: inout MaterialReserver) {
         for item in repeat (each items) {
             item.visitMaterials(&reserver)
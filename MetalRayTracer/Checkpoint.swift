@@ -0,0 +1,202 @@
+//
+//  Checkpoint.swift
+//  MetalRayTracer
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+//  Accumulated moments of a progressive render, saved so that a long render can be resumed after a crash,
+//  and independent renders of the same scene and camera can be merged into a result with more samples.
+//  Interactive renderer seeds every pass randomly, so separate runs give independent samples.
+//
+//  File layout: "RTCK", UInt32 version, UInt64 length of the JSON header, the header, padding to 16 bytes,
+//  and `PixelMoments` per pixel, rows from top to bottom.
+//
+//  MetalRayTracer [--checkpoint <path>] [--checkpoint-interval <seconds>] [--samples <count>]
+//  MetalRayTracer --merge-checkpoints <output> <input>...
+//
+//  --checkpoint resumes from the file if it matches the scene, camera and view size, and rewrites it periodically.
+//  --merge-checkpoints writes the merged checkpoint, and its color as PFM next to it.
+//
+
+import Foundation
+import Metal
+
+struct Checkpoint {
+    static let magic: UInt32 = 0x4B43_5452 // "RTCK"
+    static let version: UInt32 = 2
+
+    struct Header: Codable {
+        var scene: String
+        var width: Int
+        var height: Int
+        var passes: Int
+        /// Samples per pixel, passes can have different numbers of them.
+        var samples: Int
+        /// Bytes of `__CameraConfig`.
+        var camera: Data
+
+        init(scene: String, width: Int, height: Int, passes: Int, samples: Int, camera: CameraConfig) {
+            self.scene = scene
+            self.width = width
+            self.height = height
+            self.passes = passes
+            self.samples = samples
+            self.camera = withUnsafeBytes(of: camera.impl) { Data($0) }
+        }
+
+        var cameraConfig: CameraConfig? {
+            guard camera.count == MemoryLayout<__CameraConfig>.size else { return nil }
+            var config = CameraConfig()
+            config.impl = camera.withUnsafeBytes { $0.loadUnaligned(as: __CameraConfig.self) }
+            return config
+        }
+
+        /// Same image, so that moments can be continued or merged.
+        func isCompatible(with other: Header) -> Bool {
+            scene == other.scene && width == other.width && height == other.height && cameraConfig != nil && cameraConfig == other.cameraConfig
+        }
+    }
+
+    var header: Header
+    var pixels: [PixelMoments]
+
+    init(header: Header, pixels: [PixelMoments]) {
+        precondition(pixels.count == header.width * header.height)
+        self.header = header
+        self.pixels = pixels
+    }
+
+    init?(url: URL) {
+        guard let data = try? Data(contentsOf: url, options: .mappedIfSafe), data.count >= 16 else { return nil }
+        let (magic, version, headerLength) = data.withUnsafeBytes {
+            ($0.loadUnaligned(as: UInt32.self), $0.loadUnaligned(fromByteOffset: 4, as: UInt32.self), $0.loadUnaligned(fromByteOffset: 8, as: UInt64.self))
+        }
+        // Sizes come from the file, so they are checked without trapping on overflow
+        guard magic == Self.magic, version == Self.version, headerLength <= UInt64(data.count - 16) else { return nil }
+        let jsonLength = Int(headerLength)
+        guard let header = try? JSONDecoder().decode(Header.self, from: data[16..<16 + jsonLength]),
+              header.width > 0, header.height > 0
+        else { return nil }
+        let offset = Self.pixelsOffset(headerLength: jsonLength)
+        let (count, countOverflow) = header.width.multipliedReportingOverflow(by: header.height)
+        guard !countOverflow, offset <= data.count else { return nil }
+        let (size, sizeOverflow) = count.multipliedReportingOverflow(by: MemoryLayout<PixelMoments>.stride)
+        guard !sizeOverflow, data.count - offset == size else { return nil }
+        let pixels = data[offset...].withUnsafeBytes { buffer in
+            (0..<count).map { buffer.loadUnaligned(fromByteOffset: $0 * MemoryLayout<PixelMoments>.stride, as: PixelMoments.self) }
+        }
+        self.init(header: header, pixels: pixels)
+    }
+
+    func write(to url: URL) throws {
+        try pixels.withUnsafeBytes { try Self.write(header: header, pixels: $0, to: url) }
+    }
+
+    /// Writes into a temporary file and renames it, so that a crash never leaves a partial checkpoint.
+    static func write(header: Header, pixels: UnsafeRawBufferPointer, to url: URL) throws {
+        let json = try JSONEncoder().encode(header)
+        var data = Data()
+        withUnsafeBytes(of: magic.littleEndian) { data.append(contentsOf: $0) }
+        withUnsafeBytes(of: version.littleEndian) { data.append(contentsOf: $0) }
+        withUnsafeBytes(of: UInt64(json.count).littleEndian) { data.append(contentsOf: $0) }
+        data.append(json)
+        data.count = pixelsOffset(headerLength: json.count)
+        data.append(contentsOf: pixels)
+        try data.write(to: url, options: .atomic)
+    }
+
+    private static func pixelsOffset(headerLength: Int) -> Int {
+        (16 + headerLength + 15) / 16 * 16
+    }
+
+    /// Color as output by the kernel, i.e. square root of the linear color clamped to 1.
+    var image: FloatImage {
+        FloatImage(width: header.width, height: header.height, pixels: pixels.map { simd_clamp(simd_make_float3($0.mean), .zero, .one).squareRoot() })
+    }
+
+    /// Combines moments of independent renders, returns nil if they are not compatible.
+    static func merged(_ checkpoints: [Checkpoint]) -> Checkpoint? {
+        guard var result = checkpoints.first else { return nil }
+        for other in checkpoints.dropFirst() {
+            guard result.header.isCompatible(with: other.header) else { return nil }
+            result.header.passes += other.header.passes
+            result.header.samples += other.header.samples
+            for i in result.pixels.indices {
+                result.pixels[i] = PixelMoments(merging: result.pixels[i], other.pixels[i])
+            }
+        }
+        return result
+    }
+}
+
+extension PixelMoments {
+    /// Parallel variant of Welford's algorithm (Chan et al.).
+    init(merging a: PixelMoments, _ b: PixelMoments) {
+        let count = a.mean.w + b.mean.w
+        guard count > 0 else {
+            self.init()
+            return
+        }
+        let delta = simd_make_float3(b.mean - a.mean)
+        let mean = simd_make_float3(a.mean) + delta * (b.mean.w / count)
+        let m2 = simd_make_float3(a.m2 + b.m2) + delta * delta * (a.mean.w * b.mean.w / count)
+        self.init(mean: SIMD4(mean, count), m2: SIMD4(m2, 0))
+    }
+
+    /// Variance of the linear color of a single sample.
+    var variance: SIMD3<Float> {
+        mean.w > 1 ? simd_make_float3(m2) / (mean.w - 1) : .zero
+    }
+}
+
+/// Command line options for checkpointing of the interactive renderer.
+struct CheckpointOptions {
+    var url: URL
+    var interval: Double = 60
+    /// Samples per pixel after which rendering stops.
+    var samples = 200
+
+    static let shared: CheckpointOptions? = CheckpointOptions(arguments: CommandLine.arguments)
+
+    /// Returns nil if the app was launched without `--checkpoint`.
+    init?(arguments: [String]) {
+        guard let i = arguments.firstIndex(of: "--checkpoint"), i + 1 < arguments.endIndex else { return nil }
+        url = SceneBenchmark.Options.url(for: arguments[i + 1])
+        if let j = arguments.firstIndex(of: "--checkpoint-interval"), j + 1 < arguments.endIndex, let value = Double(arguments[j + 1]) {
+            interval = value
+        }
+        if let j = arguments.firstIndex(of: "--samples"), j + 1 < arguments.endIndex, let value = Int(arguments[j + 1]) {
+            samples = value
+        }
+    }
+
+    /// Merges checkpoints given by `--merge-checkpoints <output> <input>...`, returns false if there is no such option.
+    static func runMerge(arguments: [String]) -> Bool {
+        guard let i = arguments.firstIndex(of: "--merge-checkpoints") else { return false }
+        let paths = arguments[(i + 1)...].prefix { !$0.hasPrefix("-") }.map(SceneBenchmark.Options.url(for:))
+        guard let output = paths.first, paths.count > 1 else {
+            FileHandle.standardError.write(Data("Usage: --merge-checkpoints <output> <input>...\n".utf8))
+            return true
+        }
+        var checkpoints: [Checkpoint] = []
+        for url in paths.dropFirst() {
+            guard let checkpoint = Checkpoint(url: url) else {
+                FileHandle.standardError.write(Data("Invalid checkpoint \(url.path)\n".utf8))
+                return true
+            }
+            checkpoints.append(checkpoint)
+        }
+        guard let merged = Checkpoint.merged(checkpoints) else {
+            FileHandle.standardError.write(Data("Checkpoints have different scenes, cameras or sizes\n".utf8))
+            return true
+        }
+        do {
+            try merged.write(to: output)
+            merged.image.writePFM(to: output.deletingPathExtension().appendingPathExtension("pfm"))
+            FileHandle.standardError.write(Data("Wrote \(output.path), \(merged.header.passes) passes, \(merged.header.samples) samples per pixel\n".utf8))
+        } catch {
+            FileHandle.standardError.write(Data("Failed to write \(output.path): \(error)\n".utf8))
+        }
+        return true
+    }
+}
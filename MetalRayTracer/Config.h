@@ -13,6 +13,8 @@
 enum BackgroundLighting {
     background_lighting_none,
     background_lighting_sky,
+    /// Equirectangular HDR map, importance sampled at diffuse bounces.
+    background_lighting_environment,
 } __attribute__((enum_extensibility(closed)));
 
 struct CameraConfig {
@@ -25,21 +27,207 @@ struct CameraConfig {
     enum BackgroundLighting background;
 } __attribute__((swift_private));
 
+/// What the kernel writes into the output texture.
+/// Heatmap modes show average cost per sample, divided by `RenderConfig.heatmap_max`.
+enum OutputMode {
+    output_mode_color,
+    /// Calls of intersection functions, i.e. bounding boxes hit by the ray
+    output_mode_intersection_tests,
+    /// Hits examined by HitEnumerators inside intersection functions
+    output_mode_enumerator_steps,
+    output_mode_bounces,
+} __attribute__((enum_extensibility(closed)));
+
 struct RenderConfig {
     unsigned int samples_per_pixel;
     unsigned int max_depth;
     unsigned int pass_counter;
     uint64_t rng_seed;
+    enum OutputMode output_mode;
+    float heatmap_max;
+    /// If non-zero, the pass with counter 1 starts from history reprojected from the previous camera,
+    /// counting as at most this many samples per pixel.
+    unsigned int max_history_samples;
+    /// If non-zero, diffuse bounces sample the environment map directly and weight it against BSDF sampling.
+    unsigned int sample_environment;
+    /// Samples per pixel averaged into features and cost before this pass, 0 starts them over.
+    /// Counted by `RenderEngine`, separately from moments, which can be resumed from a checkpoint without features.
+    unsigned int feature_samples;
 } __attribute__((swift_private));
 
+/// Entry of the alias table over texels of the environment map, rows from top to bottom.
+/// Texels are picked with probability proportional to luminance times solid angle.
+struct EnvironmentAliasEntry {
+    /// Probability of keeping the texel if it is picked uniformly, otherwise `alias` is taken.
+    float probability;
+    uint32_t alias;
+    /// Probability of picking this texel in total.
+    float pdf;
+};
+
+/// Running statistics of the linear color of a pixel, accumulated over passes.
+/// Each pass merges the mean and the squared deviations of its samples, so the variance is per sample for any samples per pass.
+struct PixelMoments {
+    /// Mean in RGB, number of samples in W.
+    vector_float4 mean;
+    /// Sum of squared differences from the mean in RGB, W is unused.
+    vector_float4 m2;
+};
+
+/// First-hit auxiliary outputs (AOVs) of a pixel, averaged over passes, used by the denoiser.
+struct PixelFeatures {
+    /// Albedo in RGB, 1 for emitters and misses. Distance to the first hit along the camera ray in W, 0 if the ray missed.
+    vector_float4 albedo_depth;
+    /// Shading normal in XYZ, zero if the ray missed. `MaterialKind` of the last sample in W, 0 if it missed.
+    vector_float4 normal_kind;
+    /// World position of the first hit in XYZ, averaged over samples that hit. Fraction of such samples in W.
+    vector_float4 position;
+};
+
+/// Emissive quad that emits caustic photons, see `PhotonMapConfig`.
+struct PhotonEmitter {
+    vector_float3 origin;
+    vector_float3 u;
+    vector_float3 v;
+    vector_float3 radiance;
+    /// Cumulative probability of picking this emitter or the ones before it.
+    float cdf;
+};
+
+/// Light-tracing pass for caustics: photons leave emitters, pass through at least one dielectric,
+/// and are stored at the first Lambertian surface they hit. Camera paths gather them at their first Lambertian hit
+/// reached through dielectrics only, and skip the same light paths when tracing, so that they are not counted twice.
+struct PhotonMapConfig {
+    /// Photons emitted per pass, 0 disables the photon map.
+    unsigned int photon_count;
+    /// Capacity of the photon buffers, extra stored photons are dropped.
+    unsigned int max_stored_photons;
+    unsigned int emitter_count;
+    /// If non-zero, the background emits photons, picked after all emitters.
+    /// Background photons are parallel rays aimed at the bounding sphere of dielectric objects.
+    unsigned int background_emits;
+    vector_float3 caster_center;
+    float caster_radius;
+    /// Distance from `caster_center` where background photons start, outside of the whole scene.
+    float background_distance;
+    /// Upper bound of gather radii, and half of the size of hash grid cells.
+    float max_radius;
+    /// Initial gather radius relative to the width of the camera ray cone at the gather point.
+    float initial_radius_scale;
+    /// Fraction of newly found photons kept by progressive density estimation, shrinking the radius.
+    float alpha;
+    /// Number of hash grid cells, a power of two.
+    unsigned int cell_count;
+};
+
+/// Caustic photon stored at a Lambertian surface.
+struct Photon {
+    vector_float3 position;
+    /// Direction of travel.
+    vector_float3 direction;
+    /// Flux carried by the photon. Photons of one pass sum up to the flux of the emitters.
+    vector_float3 power;
+    unsigned int cell;
+};
+
+/// Gather radius of a pixel, shrinking as photons are found, reset at pass 1.
+/// Every sample adds the caustic radiance it gathers to its color, so caustics are averaged in `PixelMoments` over all passes.
+struct PixelPhotonStats {
+    /// Gather radius, 0 until the pixel has seen a Lambertian surface.
+    float radius;
+    /// Photons the current radius represents, see `shrink_gather_radius()`.
+    float count;
+};
+
+/// Path guiding field (SD-tree): a binary tree over the scene bounds, splitting boxes in half along X, Y and Z in turn,
+/// with a directional quadtree in each leaf. Diffuse bounces sample directions from the quadtree of their leaf
+/// with probability `1 - bsdf_fraction`, and from the material otherwise, see `GuidingField` in GuidingImpl.h.
+struct GuidingConfig {
+    vector_float3 bounds_min;
+    vector_float3 bounds_max;
+    /// 0 disables guiding.
+    unsigned int spatial_node_count;
+    float bsdf_fraction;
+    /// If non-zero, paths record incident radiance at guided bounces into training buffers.
+    unsigned int training;
+    /// Slot of `GuidingPassStatistics` written by the current pass.
+    unsigned int statistics_slot;
+};
+
+/// Node of the spatial tree of `GuidingConfig`.
+struct GuidingSpatialNode {
+    /// Axis splitting an inner node, 3 for leaves.
+    unsigned int axis;
+    /// First of two children of an inner node, or the root `GuidingDirectionalNode` of a leaf.
+    unsigned int child;
+};
+
+/// Node of a directional quadtree over the square of cylindrical coordinates (cos θ, φ / 2π),
+/// which maps areas of the square to solid angles uniformly.
+struct GuidingDirectionalNode {
+    /// First of four children, ordered by X then Y, 0 for leaves.
+    unsigned int child;
+    /// Incident radiance integrated over the node, learned by training.
+    float energy;
+};
+
+/// Estimate of pixel variance for a pass of a guided render: sum over pixels of squared differences
+/// between the luminance of the pass and the luminance accumulated before it, scaled to the variance of one sample.
+/// Both are floats, so that they are summed by the same atomics.
+struct GuidingPassStatistics {
+    float squared_error;
+    float pixels;
+};
+
 enum kernel_buffers {
     kernel_buffer_output_texture,
-    kernel_buffer_accumulator_texture,
+    kernel_buffer_moments,
     kernel_buffer_camera_config,
     kernel_buffer_render_config,
     kernel_buffer_acceleration_structure,
     kernel_buffer_function_table,
-    kernel_buffer_materials
+    kernel_buffer_materials,
+    kernel_buffer_ray_counter,
+    kernel_buffer_statistics,
+    kernel_buffer_cost_texture,
+    kernel_buffer_features,
+    kernel_buffer_history_moments,
+    kernel_buffer_history_features,
+    kernel_buffer_history_camera_config,
+    kernel_buffer_environment_texture,
+    kernel_buffer_environment_alias_table,
+    kernel_buffer_photon_config,
+    kernel_buffer_photon_emitters,
+    kernel_buffer_photons,
+    kernel_buffer_sorted_photons,
+    kernel_buffer_photon_counter,
+    kernel_buffer_photon_cell_counts,
+    kernel_buffer_photon_cell_starts,
+    kernel_buffer_photon_stats,
+    kernel_buffer_guiding_config,
+    kernel_buffer_guiding_spatial_nodes,
+    kernel_buffer_guiding_directional_nodes,
+    /// Energy per `GuidingDirectionalNode`, accumulated by paths of the training iteration.
+    kernel_buffer_guiding_training_energy,
+    /// Recorded bounces per `GuidingSpatialNode`, used to decide which leaves to split.
+    kernel_buffer_guiding_training_counts,
+    kernel_buffer_guiding_statistics,
+} __attribute__((enum_extensibility(closed)));
+
+/// Function constants specializing the kernel for features used by the scene.
+/// Code of unused features is removed when the pipeline is compiled.
+enum kernel_function_constants {
+    /// Bit per `MaterialKind` present in the scene, all bits if not set.
+    kernel_function_constant_material_kinds,
+    /// Whether the scene has an environment map, true if not set.
+    kernel_function_constant_environment,
+    /// Whether the kernel gathers caustic photons, true if not set.
+    kernel_function_constant_photons,
+    /// Whether diffuse bounces are guided, see `GuidingConfig`, true if not set.
+    kernel_function_constant_guiding,
+    /// Whether the kernel measures `PathCost` into the cost texture for heatmap output modes, true if not set.
+    /// Also set for intersection functions, which count tests and enumerator steps.
+    kernel_function_constant_cost,
 } __attribute__((enum_extensibility(closed)));
 
 #endif // CONFIG_H
@@ -76,15 +76,56 @@ struct RenderConfig {
         samplesPerPixel: Int = 10,
         maxDepth: Int = 10,
         passCounter: Int,
-        rngSeed: UInt64
+        rngSeed: UInt64,
+        outputMode: OutputMode = .output_mode_color,
+        heatmapMax: Float? = nil,
+        maxHistorySamples: Int = 0,
+        sampleEnvironment: Bool = true
     ) {
         impl = .init(
             samples_per_pixel: UInt32(samplesPerPixel),
             max_depth: UInt32(maxDepth),
             pass_counter: UInt32(passCounter),
-            rng_seed: rngSeed
+            rng_seed: rngSeed,
+            output_mode: outputMode,
+            heatmap_max: heatmapMax ?? outputMode.defaultHeatmapMax(maxDepth: maxDepth),
+            max_history_samples: UInt32(maxHistorySamples),
+            sample_environment: sampleEnvironment ? 1 : 0,
+            feature_samples: 0
         )
     }
+
+    /// Deterministic per-pass seed, so that runs are comparable with each other.
+    /// Different streams give independent sequences of seeds.
+    static func seed(pass: Int, stream: UInt64) -> UInt64 {
+        var rng = SplitMix64(seed: UInt64(pass) &+ stream << 32)
+        return rng.next()
+    }
+}
+
+extension OutputMode: CaseIterable {
+    static var allCases: [OutputMode] {
+        [.output_mode_color, .output_mode_intersection_tests, .output_mode_enumerator_steps, .output_mode_bounces]
+    }
+
+    var name: String {
+        switch self {
+        case .output_mode_color: "Color"
+        case .output_mode_intersection_tests: "Intersection Tests"
+        case .output_mode_enumerator_steps: "Enumerator Steps"
+        case .output_mode_bounces: "Bounces"
+        }
+    }
+
+    /// Cost per sample shown as the hottest color.
+    func defaultHeatmapMax(maxDepth: Int) -> Float {
+        switch self {
+        case .output_mode_color: 1
+        case .output_mode_intersection_tests: 32
+        case .output_mode_enumerator_steps: 64
+        case .output_mode_bounces: Float(maxDepth)
+        }
+    }
 }
 
 extension __CameraConfig: Hashable {
@@ -12,6 +12,12 @@ struct __ConstantDensityVolumeImpl<Base: RenderableImpl>: RenderableImpl {
     static var intersectionFunctionName: String {
         getIntersectionFunctionName(operation: "cdv", operands: (Base.self))
     }
+
+    static var materialHandleOffsets: [Int] {
+        Base.materialHandleOffsets.map { $0 + MemoryLayout<Self>.offset(of: \.base)! }
+    }
+
+    static var hasMotion: Bool { Base.hasMotion }
 }
 
 struct ConstantDensityVolume<Base: Renderable>: Renderable {
@@ -22,6 +28,10 @@ struct ConstantDensityVolume<Base: Renderable>: Renderable {
         base.boundingBox
     }
 
+    func boundingBox(during interval: ClosedRange<Float>) -> MTLAxisAlignedBoundingBox {
+        base.boundingBox(during: interval)
+    }
+
     func visitMaterials(_ reserver: inout MaterialReserver) {
         base.visitMaterials(&reserver)
     }
@@ -18,6 +18,8 @@ struct ContentView: View {
     @State var cameraDistance: Float
     @State var focusDistance: Float
     @State var defocusAngle: Float
+    @State var outputMode: OutputMode = .output_mode_color
+    @State var denoise = false
 
     var initialScene: Scene
 
@@ -46,8 +48,15 @@ struct ContentView: View {
 
     var body: some View {
         HStack {
-            SceneView(scene: currentScene)
+            SceneView(scene: currentScene, outputMode: outputMode, denoise: denoise)
             VStack {
+                Picker("Output", selection: $outputMode) {
+                    ForEach(OutputMode.allCases, id: \.self) { mode in
+                        Text(mode.name).tag(mode)
+                    }
+                }
+                Toggle("Denoised preview", isOn: $denoise)
+                Divider()
                 Text("FOV: \(fov)")
                 Slider(value: $fov, in: 1...180)
                 Divider()
@@ -75,6 +84,8 @@ struct ContentView: View {
 
 struct SceneView: NSViewRepresentable {
     var scene: Scene
+    var outputMode: OutputMode
+    var denoise: Bool
 
     func makeCoordinator() -> Renderer {
         Renderer(scene)
@@ -96,6 +107,8 @@ struct SceneView: NSViewRepresentable {
     
     func updateNSView(_ nsView: MTKView, context: Context) {
         context.coordinator.scene = scene
+        context.coordinator.outputMode = outputMode
+        context.coordinator.denoise = denoise
         nsView.setNeedsDisplay(nsView.bounds)
     }
 }
@@ -107,66 +120,94 @@ class Renderer: NSObject, MTKViewDelegate {
     var scene: Scene {
         didSet {
             if oldValue.camera != scene.camera {
+                // Several changes can happen between passes, accumulation belongs to the first camera
+                let historyCamera = self.historyCamera ?? (passCounter > 0 ? oldValue.camera : nil)
+                setNeedsRedraw()
+                self.historyCamera = historyCamera
+            }
+        }
+    }
+    var outputMode: OutputMode = .output_mode_color {
+        didSet {
+            if oldValue != outputMode {
+                setNeedsRedraw()
+            }
+        }
+    }
+    /// Stops after `denoisedPreviewSamples`, and shows the image filtered by `Denoiser`.
+    var denoise = false {
+        didSet {
+            if oldValue != denoise {
                 setNeedsRedraw()
             }
         }
     }
+    static let denoisedPreviewSamples = 16
+    /// Reprojected history counts as at most this many samples, so that it is soon outweighed by new ones.
+    static let maxHistorySamples = 32
+    /// Camera of the accumulation to reproject into the next pass, set when only the camera has changed.
+    private var historyCamera: CameraConfig?
+    /// Denoised image to show instead of rendering the next pass.
+    private var denoisedTexture: MTLTexture?
+    /// Set while decoded textures wait for passes in flight to complete, no passes are encoded meanwhile.
+    private var isInstallingTextures = false
     var device: MTLDevice!
     var commandQueue: MTLCommandQueue!
-    var sceneBuffers: SceneBuffers
-    var pipeline: MTLComputePipelineState
-    var intersectionFunctionsTable: any MTLIntersectionFunctionTable
+    var engine: RenderEngine
     var passCounter: Int = 0
-    var accumulator: MTLTexture?
+    /// Samples per pixel accumulated since the last change.
+    var sampleCounter: Int = 0
+    var frameBudget = FrameBudgetController()
+    let checkpointOptions = CheckpointOptions.shared
+    /// Checkpoint to continue from, only considered for the first pass after launch.
+    private var resumeCheckpoint: Checkpoint?
+    private var lastCheckpoint = Date.now
+    private var isWritingCheckpoint = false
+    private var checkpointedPasses = 0
 
     init(_ scene: Scene) {
 
         self.scene = scene
+        self.resumeCheckpoint = CheckpointOptions.shared.flatMap { Checkpoint(url: $0.url) }
         if let device = MTLCreateSystemDefaultDevice() {
             self.device = device
         }
         self.commandQueue = device.makeCommandQueue()
 
-        sceneBuffers = SceneBuffers(scene: scene, device: device, commandQueue: commandQueue)
+        // Installing streamed textures restarts accumulation, so a resumed checkpoint waits for real textures
+        engine = RenderEngine(scene: scene, device: device, commandQueue: commandQueue, streamTextures: resumeCheckpoint == nil)
 
-        let lib = device.makeDefaultLibrary()!
-        let kernel = lib.makeFunction(name: "ray_tracing_kernel")!
+        super.init()
+        decodeTextures()
+    }
 
-        // Load functions from Metal library
-        let functions = sceneBuffers.intersectionFunctions.mapValues { name in
-            lib.makeFunction(name: name)!
+    /// First passes render with placeholder textures, accumulation restarts once the real ones are installed.
+    private func decodeTextures() {
+        let textureLoader = engine.sceneBuffers.textureLoader
+        let pending = engine.sceneBuffers.pendingTextures
+        guard !pending.isEmpty else { return }
+        DispatchQueue.global(qos: .userInitiated).async {
+            let decoded = textureLoader.decode(pending)
+            Task { @MainActor [weak self] in
+                self?.installTextures(decoded)
+            }
         }
-        let functionsTableSize = functions.keys.max().map { $0 + 1 } ?? 0
-
-        // Attach functions to ray tracing compute pipeline descriptor
-        let linkedFunctions = MTLLinkedFunctions()
-        linkedFunctions.functions = Array(functions.values)
-
-        let pipelineDescriptor = MTLComputePipelineDescriptor()
-        pipelineDescriptor.computeFunction = kernel
-        pipelineDescriptor.linkedFunctions = linkedFunctions
-
-        self.pipeline = try! device.makeComputePipelineState(descriptor: pipelineDescriptor, options: [], reflection: nil)
+    }
 
-        do {
-            // Allocate intersection function table
-            let descriptor = MTLIntersectionFunctionTableDescriptor()
-            descriptor.functionCount = functionsTableSize
-
-            let functionTable = pipeline.makeIntersectionFunctionTable(descriptor: descriptor)!
-            for i in 0..<functionsTableSize {
-                guard let f = functions[i] else { continue }
-                // Get a handle to the linked intersection function in the pipeline state
-                let functionHandle = pipeline.functionHandle(function: f)
-
-                // Insert the function handle into the table
-                functionTable.setFunction(functionHandle, index: i)
+    /// Passes in flight must not see resource IDs of textures they have not made resident.
+    /// The queue completes command buffers in order, so textures are installed once an empty one after them completes.
+    private func installTextures(_ decoded: [ImageTexture: MTLTexture]) {
+        isInstallingTextures = true
+        let fence = commandQueue.makeCommandBuffer()!
+        fence.addCompletedHandler { _ in
+            Task { @MainActor [weak self] in
+                guard let self else { return }
+                self.engine.sceneBuffers.installTextures(decoded)
+                self.isInstallingTextures = false
+                self.setNeedsRedraw()
             }
-
-            self.intersectionFunctionsTable = functionTable
         }
-
-        super.init()
+        fence.commit()
     }
 
     func mtkView(_ view: MTKView, drawableSizeWillChange size: CGSize) {
@@ -176,61 +217,168 @@ class Renderer: NSObject, MTKViewDelegate {
     @MainActor
     private func setNeedsRedraw() {
         passCounter = 0
+        sampleCounter = 0
+        frameBudget.viewDidChange()
+        historyCamera = nil
+        denoisedTexture = nil
         view?.isPaused = false
     }
 
     func draw(in view: MTKView) {
-        guard let drawable = view.currentDrawable else {
+        guard !isInstallingTextures, let drawable = view.currentDrawable else {
+            return
+        }
+
+        if let denoisedTexture {
+            self.denoisedTexture = nil
+            let commandBuffer = commandQueue.makeCommandBuffer()!
+            let blitEncoder = commandBuffer.makeBlitCommandEncoder()!
+            blitEncoder.copy(from: denoisedTexture, to: drawable.texture)
+            blitEncoder.endEncoding()
+            commandBuffer.present(drawable)
+            commandBuffer.commit()
             return
         }
 
         passCounter += 1
-        if passCounter >= 200 {
+        if passCounter == 1 {
+            resume(width: drawable.texture.width, height: drawable.texture.height)
+        }
+        let denoising = denoise && outputMode == .output_mode_color
+        let targetSamples = denoising ? Self.denoisedPreviewSamples : checkpointOptions?.samples ?? 200
+        let samplesPerPixel = min(frameBudget.nextSamplesPerPixel(), max(targetSamples - sampleCounter, 1))
+        sampleCounter += samplesPerPixel
+        if sampleCounter >= targetSamples {
             view.isPaused = true
         }
 
         let commandBuffer = commandQueue.makeCommandBuffer()!
 
-        let renderEncoder = commandBuffer.makeComputeCommandEncoder()!
-        renderEncoder.setComputePipelineState(pipeline)
-        let outputTexture = drawable.texture
-        renderEncoder.setTexture(outputTexture, index: Int(kernel_buffers.output_texture.rawValue))
-        renderEncoder.setTexture(getAccumulatorTexture(width: outputTexture.width, height: outputTexture.height), index: Int(kernel_buffers.accumulator_texture.rawValue))
-        var camera = scene.camera
-        renderEncoder.setBytes(&camera, length: MemoryLayout<CameraConfig>.stride, index: Int(kernel_buffers.camera_config.rawValue))
         var rng = SystemRandomNumberGenerator()
-        var renderConfig = RenderConfig(samplesPerPixel: 1, maxDepth: 10, passCounter: passCounter, rngSeed: rng.next())
-        renderEncoder.setBytes(&renderConfig, length: MemoryLayout<RenderConfig>.stride, index: Int(kernel_buffers.render_config.rawValue))
-        renderEncoder.setAccelerationStructure(sceneBuffers.accelerationStructure, bufferIndex: Int(kernel_buffers.acceleration_structure.rawValue))
-        renderEncoder.setIntersectionFunctionTable(intersectionFunctionsTable, bufferIndex: Int(kernel_buffers.function_table.rawValue))
-        renderEncoder.setBuffer(sceneBuffers.materialsBuffer, offset: 0, index: Int(kernel_buffers.materials.rawValue))
+        // Reprojected samples are biased, so they are not mixed into checkpoints and the denoiser's variance estimate
+        let maxHistorySamples = checkpointOptions == nil && !denoising ? Self.maxHistorySamples : 0
+        let renderConfig = RenderConfig(samplesPerPixel: samplesPerPixel, maxDepth: 10, passCounter: passCounter, rngSeed: rng.next(), outputMode: outputMode, maxHistorySamples: maxHistorySamples)
+        engine.encodePass(commandBuffer: commandBuffer, outputTexture: drawable.texture, camera: scene.camera, renderConfig: renderConfig, historyCamera: historyCamera)
+        historyCamera = nil
+        commandBuffer.addCompletedHandler { commandBuffer in
+            let gpuSeconds = commandBuffer.gpuEndTime - commandBuffer.gpuStartTime
+            Task { @MainActor [weak self] in
+                self?.frameBudget.record(samplesPerPixel: samplesPerPixel, gpuSeconds: gpuSeconds)
+            }
+        }
 
-        for texture in sceneBuffers.textureLoader.textures.values {
-            renderEncoder.useResource(texture, usage: .read)
+        if let checkpointOptions, !isWritingCheckpoint, view.isPaused || Date.now.timeIntervalSince(lastCheckpoint) >= checkpointOptions.interval {
+            encodeCheckpoint(commandBuffer: commandBuffer, url: checkpointOptions.url, width: drawable.texture.width, height: drawable.texture.height)
         }
 
-        let threadGroupWidth = pipeline.threadExecutionWidth
-        let threadGroupHeight = pipeline.maxTotalThreadsPerThreadgroup / threadGroupWidth
-        let threadGroupSize = MTLSize(width: threadGroupWidth, height: threadGroupHeight, depth: 1)
+        if denoising && view.isPaused {
+            encodeDenoising(commandBuffer: commandBuffer, drawable: drawable.texture)
+        }
 
-        let gridSize = MTLSize(width: Int(view.drawableSize.width), height: Int(view.drawableSize.height), depth: 1)
+        commandBuffer.present(drawable)
+        commandBuffer.commit()
+    }
+
+    /// Filters on a background queue, and shows the result, unless rendering has restarted meanwhile.
+    private func encodeDenoising(commandBuffer: MTLCommandBuffer, drawable: MTLTexture) {
+        guard let moments = engine.encodeMomentsSnapshot(commandBuffer: commandBuffer),
+              let features = engine.encodeFeaturesSnapshot(commandBuffer: commandBuffer)
+        else { return }
+        let descriptor = MTLTextureDescriptor.texture2DDescriptor(pixelFormat: drawable.pixelFormat, width: drawable.width, height: drawable.height, mipmapped: false)
+        let pending = PendingDenoising(moments: moments, features: features, output: device.makeTexture(descriptor: descriptor)!)
+        let passes = passCounter
+        commandBuffer.addCompletedHandler { _ in
+            DispatchQueue.global(qos: .userInitiated).async {
+                pending.run()
+                Task { @MainActor [weak self] in
+                    guard let self, self.passCounter == passes, self.denoise else { return }
+                    self.denoisedTexture = pending.output
+                    self.view?.draw()
+                }
+            }
+        }
+    }
 
-        renderEncoder.dispatchThreads(gridSize, threadsPerThreadgroup: threadGroupSize)
+    private func resume(width: Int, height: Int) {
+        guard let checkpoint = resumeCheckpoint else { return }
+        resumeCheckpoint = nil
+        let current = Checkpoint.Header(scene: scene.name, width: width, height: height, passes: 0, samples: 0, camera: scene.camera)
+        guard checkpoint.header.isCompatible(with: current) else { return }
+        engine.loadMoments(checkpoint.pixels, width: width, height: height)
+        passCounter = checkpoint.header.passes + 1
+        sampleCounter = checkpoint.header.samples
+    }
 
-        renderEncoder.endEncoding()
+    /// Checkpoint is copied on the GPU after the pass, and written on a background queue, so rendering does not wait for it.
+    private func encodeCheckpoint(commandBuffer: MTLCommandBuffer, url: URL, width: Int, height: Int) {
+        guard let snapshot = engine.encodeMomentsSnapshot(commandBuffer: commandBuffer) else { return }
+        let header = Checkpoint.Header(scene: scene.name, width: width, height: height, passes: passCounter, samples: sampleCounter, camera: scene.camera)
+        let pending = PendingCheckpoint(header: header, snapshot: snapshot)
+        isWritingCheckpoint = true
+        lastCheckpoint = .now
+        checkpointedPasses = passCounter
+        commandBuffer.addCompletedHandler { _ in
+            DispatchQueue.global(qos: .utility).async {
+                pending.write(to: url)
+                Task { @MainActor [weak self] in
+                    self?.didWriteCheckpoint(url: url, width: width, height: height)
+                }
+            }
+        }
+    }
 
-        commandBuffer.present(drawable)
+    /// Makes sure that the last pass is saved, when rendering stopped while the previous checkpoint was being written.
+    private func didWriteCheckpoint(url: URL, width: Int, height: Int) {
+        isWritingCheckpoint = false
+        guard view?.isPaused == true, checkpointedPasses != passCounter else { return }
+        let commandBuffer = commandQueue.makeCommandBuffer()!
+        encodeCheckpoint(commandBuffer: commandBuffer, url: url, width: width, height: height)
         commandBuffer.commit()
     }
+}
+
+/// Buffers copied by the GPU, not accessed until the command buffer completes.
+private final class PendingDenoising: @unchecked Sendable {
+    let moments: MTLBuffer
+    let features: MTLBuffer
+    let output: MTLTexture
+
+    init(moments: MTLBuffer, features: MTLBuffer, output: MTLTexture) {
+        self.moments = moments
+        self.features = features
+        self.output = output
+    }
+
+    /// Writes the denoised image into `output`, which has a BGRA8 format of the drawable.
+    func run() {
+        let width = output.width
+        let height = output.height
+        let image = Denoiser().denoise(moments: RenderEngine.read(moments), features: RenderEngine.read(features), width: width, height: height)
+        let bgra = image.pixels.map { p in
+            let c = SIMD3<UInt32>(simd_clamp(p, .zero, .one) * 255 + 0.5)
+            return c.z | c.y << 8 | c.x << 16 | 0xff << 24
+        }
+        bgra.withUnsafeBytes { bytes in
+            output.replace(region: MTLRegionMake2D(0, 0, width, height), mipmapLevel: 0, withBytes: bytes.baseAddress!, bytesPerRow: width * 4)
+        }
+    }
+}
+
+/// Moments copied by the GPU, not accessed until the command buffer completes.
+private final class PendingCheckpoint: @unchecked Sendable {
+    let header: Checkpoint.Header
+    let snapshot: MTLBuffer
 
-    func getAccumulatorTexture(width: Int, height: Int) -> MTLTexture {
-        if let accumulator, accumulator.width == width, accumulator.height == height {
-            return accumulator
+    init(header: Checkpoint.Header, snapshot: MTLBuffer) {
+        self.header = header
+        self.snapshot = snapshot
+    }
+
+    func write(to url: URL) {
+        do {
+            try Checkpoint.write(header: header, pixels: UnsafeRawBufferPointer(start: snapshot.contents(), count: snapshot.length), to: url)
+        } catch {
+            FileHandle.standardError.write(Data("Failed to write checkpoint \(url.path): \(error)\n".utf8))
         }
-        let descriptor = MTLTextureDescriptor.texture2DDescriptor(pixelFormat: .rgb10a2Uint, width: width, height: height, mipmapped: false)
-        descriptor.usage = [.shaderRead, .shaderWrite]
-        let texture = device.makeTexture(descriptor: descriptor)!
-        self.accumulator = texture
-        return texture
     }
 }
@@ -0,0 +1,134 @@
+//
+//  Denoiser.swift
+//  MetalRayTracer
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+
+import Foundation
+import simd
+
+/// Edge-avoiding à-trous wavelet filter (Dammertz et al. 2010), guided by first-hit features.
+///
+/// Filters illumination, i.e. color divided by first-hit albedo, so that texture detail is not blurred,
+/// and multiplies the result by albedo again. Neighbours are weighted down when their normal or depth differ,
+/// and when their color differs by more than the noise expected from per-pixel variance.
+/// Every iteration doubles the step of the 5x5 B3-spline kernel, and halves the color tolerance.
+///
+/// Runs on the CPU, processing tiles in parallel. Pixel data is kept in `SIMD4<Float>` planes.
+struct Denoiser {
+    var iterations = 5
+    /// Color tolerance in standard deviations of the mean.
+    var colorSigma: Float = 4
+    /// Exponent applied to the cosine between normals.
+    var normalPower: Float = 32
+    /// Tolerance for the relative difference of depth.
+    var depthSigma: Float = 0.05
+    var tileSize = 64
+
+    /// Planes shared between worker threads, every tile writes only its own pixels.
+    private struct Planes: @unchecked Sendable {
+        var illumination: UnsafeMutableBufferPointer<SIMD4<Float>>
+        var filtered: UnsafeMutableBufferPointer<SIMD4<Float>>
+        /// Normal in XYZ, depth in W.
+        var geometry: UnsafeBufferPointer<SIMD4<Float>>
+    }
+
+    private static let kernel: [Float] = [1.0 / 16, 1.0 / 4, 3.0 / 8, 1.0 / 4, 1.0 / 16]
+
+    /// Returns the image as output by the kernel, i.e. square root of linear color.
+    func denoise(moments: [PixelMoments], features: [PixelFeatures], width: Int, height: Int) -> FloatImage {
+        let count = width * height
+        precondition(moments.count == count && features.count == count)
+
+        // Illumination in RGB, variance of its mean in W
+        var illumination = [SIMD4<Float>](repeating: .zero, count: count)
+        var geometry = [SIMD4<Float>](repeating: .zero, count: count)
+        var albedo = [SIMD3<Float>](repeating: .zero, count: count)
+        for i in 0..<count {
+            let a = simd_max(simd_make_float3(features[i].albedo_depth), SIMD3(repeating: 0.01))
+            let m = moments[i]
+            let variance = m.mean.w > 1 ? simd_reduce_add(m.variance / (a * a)) / (3 * m.mean.w) : 1
+            albedo[i] = a
+            illumination[i] = SIMD4(simd_make_float3(m.mean) / a, variance)
+            geometry[i] = SIMD4(simd_make_float3(features[i].normal_kind), features[i].albedo_depth.w)
+        }
+
+        var filtered = [SIMD4<Float>](repeating: .zero, count: count)
+        illumination.withUnsafeMutableBufferPointer { illumination in
+            filtered.withUnsafeMutableBufferPointer { filtered in
+                geometry.withUnsafeBufferPointer { geometry in
+                    var planes = Planes(illumination: illumination, filtered: filtered, geometry: geometry)
+                    for iteration in 0..<iterations {
+                        filter(planes, width: width, height: height, step: 1 << iteration, colorSigma: colorSigma / Float(1 << iteration))
+                        swap(&planes.illumination, &planes.filtered)
+                    }
+                }
+            }
+        }
+        // Planes are swapped after every iteration
+        let result = iterations % 2 == 0 ? illumination : filtered
+
+        var pixels = [SIMD3<Float>](repeating: .zero, count: count)
+        for i in 0..<count {
+            pixels[i] = simd_clamp(simd_make_float3(result[i]) * albedo[i], .zero, .one).squareRoot()
+        }
+        return FloatImage(width: width, height: height, pixels: pixels)
+    }
+
+    private func filter(_ planes: Planes, width: Int, height: Int, step: Int, colorSigma: Float) {
+        let tilesX = (width + tileSize - 1) / tileSize
+        let tilesY = (height + tileSize - 1) / tileSize
+        DispatchQueue.concurrentPerform(iterations: tilesX * tilesY) { tile in
+            let x0 = (tile % tilesX) * tileSize
+            let y0 = (tile / tilesX) * tileSize
+            for y in y0..<min(y0 + tileSize, height) {
+                for x in x0..<min(x0 + tileSize, width) {
+                    filterPixel(planes, x: x, y: y, width: width, height: height, step: step, colorSigma: colorSigma)
+                }
+            }
+        }
+    }
+
+    @inline(__always)
+    private func filterPixel(_ planes: Planes, x: Int, y: Int, width: Int, height: Int, step: Int, colorSigma: Float) {
+        let p = y * width + x
+        let center = planes.illumination[p]
+        let centerGeometry = planes.geometry[p]
+        let centerNormal = simd_make_float3(centerGeometry)
+        let centerIsBackground = centerGeometry.w == 0
+        let colorScale = 1 / (colorSigma * colorSigma * max(center.w, 1e-6))
+        let depthScale = 1 / (depthSigma * Float(step) * max(centerGeometry.w, 1e-3))
+
+        var sum = SIMD4<Float>.zero
+        var weightSum: Float = 0
+        for j in -2...2 {
+            let qy = y + j * step
+            guard qy >= 0 && qy < height else { continue }
+            for i in -2...2 {
+                let qx = x + i * step
+                guard qx >= 0 && qx < width else { continue }
+                let q = qy * width + qx
+                let sample = planes.illumination[q]
+                let geometry = planes.geometry[q]
+
+                var weight = Self.kernel[i + 2] * Self.kernel[j + 2]
+                if centerIsBackground || geometry.w == 0 {
+                    // Background matches only background
+                    if centerIsBackground != (geometry.w == 0) { continue }
+                } else {
+                    let cosine = max(simd_dot(centerNormal, simd_make_float3(geometry)), 0)
+                    weight *= pow(cosine, normalPower)
+                    weight *= exp(-abs(geometry.w - centerGeometry.w) * depthScale)
+                }
+                let d = simd_make_float3(sample - center)
+                weight *= exp(-simd_length_squared(d) * colorScale)
+
+                sum += weight * SIMD4(simd_make_float3(sample), weight * sample.w)
+                weightSum += weight
+            }
+        }
+        // Variance of a weighted mean is scaled by the square of weights
+        planes.filtered[p] = weightSum > 0 ? SIMD4(simd_make_float3(sum) / weightSum, sum.w / (weightSum * weightSum)) : center
+    }
+}
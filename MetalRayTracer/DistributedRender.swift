@@ -0,0 +1,426 @@
+//
+//  DistributedRender.swift
+//  MetalRayTracer
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+//  Final-frame rendering split between worker processes on the same machine.
+//  The coordinator splits the requested passes into work items of a fixed size, and hands them to workers over loopback TCP.
+//  Every worker sums linear color of its passes in float, and the coordinator merges the sums in the order of items.
+//  Seed of a pass depends only on its global index, so the result does not depend on which worker rendered what.
+//
+//  Items of workers that disconnect are requeued. When the queue is empty, idle workers also get duplicates
+//  of items that run much longer than usual, and the first result wins.
+//
+//  MetalRayTracer --coordinator --scene <name> [--resolution <width>x<height>] [--passes <count>] [--item-passes <count>]
+//                               [--port <port>] [--spawn-workers <count>] [--output <path>] [--report <path>]
+//  MetalRayTracer --worker --port <port>
+//
+//  --output writes the merged image as PFM, --report writes per-worker throughput as JSON lines.
+//
+
+import Foundation
+import Metal
+
+enum DistributedRender {
+    struct Options {
+        enum Role {
+            case coordinator
+            case worker
+        }
+
+        var role: Role
+        var scene = "quads"
+        var resolution = SceneBenchmark.Resolution(width: 1280, height: 720)
+        var passes = 1024
+        var itemPasses = 16
+        var port: UInt16 = 0
+        var spawnWorkers = 0
+        var output: URL?
+        var report: URL?
+
+        /// Returns nil if the app was launched neither with `--coordinator`, nor with `--worker`.
+        init?(arguments: [String]) {
+            if arguments.contains("--coordinator") {
+                role = .coordinator
+            } else if arguments.contains("--worker") {
+                role = .worker
+            } else {
+                return nil
+            }
+            var i = arguments.startIndex + 1
+            func value() -> String? {
+                guard i + 1 < arguments.endIndex else { return nil }
+                i += 1
+                return arguments[i]
+            }
+            while i < arguments.endIndex {
+                switch arguments[i] {
+                case "--scene":
+                    scene = value() ?? scene
+                case "--resolution":
+                    if let parts = value()?.split(separator: "x").compactMap({ Int($0) }), parts.count == 2 {
+                        resolution = SceneBenchmark.Resolution(width: parts[0], height: parts[1])
+                    }
+                case "--passes":
+                    passes = value().flatMap { Int($0) } ?? passes
+                case "--item-passes":
+                    itemPasses = max(value().flatMap { Int($0) } ?? itemPasses, 1)
+                case "--port":
+                    port = value().flatMap { UInt16($0) } ?? port
+                case "--spawn-workers":
+                    spawnWorkers = value().flatMap { Int($0) } ?? spawnWorkers
+                case "--output":
+                    output = value().map(SceneBenchmark.Options.url(for:))
+                case "--report":
+                    report = value().map(SceneBenchmark.Options.url(for:))
+                default:
+                    break
+                }
+                i += 1
+            }
+        }
+    }
+
+    struct Job: Codable {
+        var scene: String
+        var width: Int
+        var height: Int
+        var maxDepth: Int
+    }
+
+    struct WorkItem: Codable {
+        var index: Int
+        var firstPass: Int
+        var passCount: Int
+    }
+
+    struct ItemResult: Codable {
+        var index: Int
+        var seconds: Double
+        var rays: UInt64
+    }
+
+    /// `.result` is followed by a message with the sum of linear colors, one `SIMD3<Float>` per pixel.
+    enum Message: Codable {
+        case hello(pid: Int32)
+        case job(Job)
+        case item(WorkItem)
+        case result(ItemResult)
+        case done
+    }
+
+    /// Independent from the streams used by `SceneBenchmark`.
+    static let seedStream: UInt64 = 2
+
+    static func run(options: Options) {
+        switch options.role {
+        case .coordinator:
+            Coordinator(options: options).run()
+        case .worker:
+            do {
+                try runWorker(port: options.port)
+            } catch {
+                FileHandle.standardError.write(Data("Worker failed: \(error)\n".utf8))
+            }
+        }
+    }
+
+    static func send(_ message: Message, to socket: MessageSocket) throws {
+        try socket.send(JSONEncoder().encode(message))
+    }
+
+    static func receive(from socket: MessageSocket) throws -> Message {
+        try JSONDecoder().decode(Message.self, from: socket.receive())
+    }
+
+    static func runWorker(port: UInt16) throws {
+        let socket = try MessageSocket(connectingTo: port)
+        try send(.hello(pid: getpid()), to: socket)
+        guard case .job(let job) = try receive(from: socket),
+              let scene = Scene.presets.first(where: { $0.name == job.scene })?.scene
+        else { return }
+
+        let device = MTLCreateSystemDefaultDevice()!
+        // Every pass starts from scratch, so progressive caustic photons would not converge.
+        // Guiding would make passes depend on the items the worker rendered before, and images on the scheduling
+        let engine = RenderEngine(scene: scene, device: device, commandQueue: device.makeCommandQueue()!, photonsPerPass: 0, guidingIterations: 0)
+        let outputTexture = engine.makeOutputTexture(width: job.width, height: job.height)
+        while case .item(let item) = try receive(from: socket) {
+            let start = Date.now
+            engine.resetRayCounter()
+            var sum = [SIMD3<Float>](repeating: .zero, count: job.width * job.height)
+            for pass in item.firstPass..<item.firstPass + item.passCount {
+                let commandBuffer = engine.commandQueue.makeCommandBuffer()!
+                let renderConfig = RenderConfig(samplesPerPixel: 1, maxDepth: job.maxDepth, passCounter: 1, rngSeed: RenderConfig.seed(pass: pass, stream: seedStream))
+                engine.encodePass(commandBuffer: commandBuffer, outputTexture: outputTexture, camera: scene.camera, renderConfig: renderConfig)
+                commandBuffer.commit()
+                // Kernel outputs square root of the linear color
+                let image = engine.readPixels(outputTexture)
+                for i in sum.indices {
+                    let c = image.pixels[i]
+                    sum[i] += c * c
+                }
+            }
+            let result = ItemResult(index: item.index, seconds: Date.now.timeIntervalSince(start), rays: UInt64(engine.rayCount))
+            try send(.result(result), to: socket)
+            try socket.send(sum.withUnsafeBytes { Data($0) })
+        }
+    }
+}
+
+extension DistributedRender {
+    struct WorkerReport: Encodable {
+        var worker: Int
+        var pid: Int32
+        var items: Int
+        var passes: Int
+        /// Items that were finished by another worker first.
+        var wastedItems: Int = 0
+        var rays: UInt64 = 0
+        var busySeconds: Double = 0
+        var samplesPerSecond: Double = 0
+        var raysPerSecond: Double = 0
+        var failed = false
+    }
+
+    struct Summary: Encodable {
+        var scene: String
+        var width: Int
+        var height: Int
+        var passes: Int
+        var items: Int
+        var workers: Int
+        var wallSeconds: Double
+        var samplesPerSecond: Double
+    }
+
+    final class Coordinator: @unchecked Sendable {
+        /// Duplicate an item once it runs this many times longer than the median item.
+        static let stragglerFactor = 3.0
+
+        let options: Options
+        let job: Job
+        let items: [WorkItem]
+
+        private let condition = NSCondition()
+        private var pending: [Int]
+        private var inFlight: [Int: [(worker: Int, start: Date)]] = [:]
+        private var finished: [Bool]
+        private var finishedCount = 0
+        /// Items before this one are summed into `total`, in order, so that the result is the same for any assignment of items to workers.
+        private var foldedCount = 0
+        /// Sums of finished items that cannot be folded yet, because an earlier item is still missing.
+        private var unfolded: [Int: [SIMD3<Float>]] = [:]
+        private var total: [SIMD3<Double>]
+        private var itemSeconds: [Double] = []
+        private var reports: [WorkerReport] = []
+
+        init(options: Options) {
+            self.options = options
+            self.job = Job(scene: options.scene, width: options.resolution.width, height: options.resolution.height, maxDepth: 10)
+            let items = stride(from: 0, to: options.passes, by: options.itemPasses).enumerated().map { index, firstPass in
+                // Passes are 1-based, as in `SceneBenchmark`
+                WorkItem(index: index, firstPass: firstPass + 1, passCount: min(options.itemPasses, options.passes - firstPass))
+            }
+            self.items = items
+            self.pending = Array(items.indices)
+            self.finished = Array(repeating: false, count: items.count)
+            self.total = Array(repeating: .zero, count: options.resolution.width * options.resolution.height)
+        }
+
+        func run() {
+            guard Scene.presets.contains(where: { $0.name == job.scene }) else {
+                FileHandle.standardError.write(Data("Unknown scene \(job.scene)\n".utf8))
+                return
+            }
+            let listener: MessageListener
+            do {
+                listener = try MessageListener(port: options.port)
+            } catch {
+                FileHandle.standardError.write(Data("Coordinator failed: \(error)\n".utf8))
+                return
+            }
+            FileHandle.standardError.write(Data("Coordinator listening on port \(listener.port)\n".utf8))
+            let workers = (0..<options.spawnWorkers).compactMap { _ in spawnWorker(port: listener.port) }
+
+            let start = Date.now
+            Thread.detachNewThread { [self] in
+                while !isFinished {
+                    guard let socket = listener.accept(timeout: .milliseconds(100)) else { continue }
+                    let worker = condition.withLock {
+                        reports.append(WorkerReport(worker: reports.count, pid: 0, items: 0, passes: 0))
+                        return reports.count - 1
+                    }
+                    Thread.detachNewThread { [self] in
+                        serve(socket, worker: worker)
+                    }
+                }
+            }
+
+            condition.withLock {
+                while finishedCount < items.count {
+                    condition.wait()
+                }
+            }
+            let wallSeconds = Date.now.timeIntervalSince(start)
+            let image = merge()
+            // Workers still busy with duplicates of finished items are not needed anymore
+            for worker in workers {
+                worker.terminate()
+                worker.waitUntilExit()
+            }
+
+            if let output = options.output {
+                image.writePFM(to: output)
+            }
+            var report = JSONLinesWriter(url: options.report)
+            condition.withLock {
+                for var r in reports {
+                    let samples = Double(r.passes * job.width * job.height)
+                    r.samplesPerSecond = r.busySeconds > 0 ? samples / r.busySeconds : 0
+                    r.raysPerSecond = r.busySeconds > 0 ? Double(r.rays) / r.busySeconds : 0
+                    report.write(r)
+                }
+            }
+            report.write(Summary(
+                scene: job.scene,
+                width: job.width,
+                height: job.height,
+                passes: options.passes,
+                items: items.count,
+                workers: reports.count,
+                wallSeconds: wallSeconds,
+                samplesPerSecond: Double(options.passes * job.width * job.height) / wallSeconds
+            ))
+        }
+
+        private var isFinished: Bool {
+            condition.withLock { finishedCount == items.count }
+        }
+
+        private func spawnWorker(port: UInt16) -> Process? {
+            let process = Process()
+            process.executableURL = Bundle.main.executableURL
+            process.arguments = ["--worker", "--port", "\(port)"]
+            do {
+                try process.run()
+                return process
+            } catch {
+                FileHandle.standardError.write(Data("Failed to spawn worker: \(error)\n".utf8))
+                return nil
+            }
+        }
+
+        private func serve(_ socket: MessageSocket, worker: Int) {
+            var current: Int?
+            do {
+                guard case .hello(let pid) = try receive(from: socket) else { return }
+                condition.withLock { reports[worker].pid = pid }
+                try send(.job(job), to: socket)
+                while let index = nextItem(worker: worker) {
+                    current = index
+                    try send(.item(items[index]), to: socket)
+                    guard case .result(let result) = try receive(from: socket) else { break }
+                    let payload = try socket.receive()
+                    let sum = payload.withUnsafeBytes { Array($0.bindMemory(to: SIMD3<Float>.self)) }
+                    guard result.index == index, sum.count == job.width * job.height else { break }
+                    complete(index, sum: sum, result: result, worker: worker)
+                    current = nil
+                }
+                try send(.done, to: socket)
+            } catch {
+                FileHandle.standardError.write(Data("Worker \(worker) failed: \(error)\n".utf8))
+            }
+            if let current {
+                fail(current, worker: worker)
+            }
+        }
+
+        /// Blocks until there is an item for the worker, returns nil when all items are done.
+        private func nextItem(worker: Int) -> Int? {
+            condition.withLock {
+                while finishedCount < items.count {
+                    if !pending.isEmpty {
+                        let index = pending.removeFirst()
+                        inFlight[index, default: []].append((worker, .now))
+                        return index
+                    }
+                    if let index = straggler(excluding: worker) {
+                        inFlight[index, default: []].append((worker, .now))
+                        return index
+                    }
+                    _ = condition.wait(until: .now.addingTimeInterval(0.1))
+                }
+                return nil
+            }
+        }
+
+        /// Oldest item in flight that takes much longer than usual, and is not already being rendered by `worker`.
+        private func straggler(excluding worker: Int) -> Int? {
+            guard !itemSeconds.isEmpty else { return nil }
+            let median = itemSeconds.sorted()[itemSeconds.count / 2]
+            let now = Date.now
+            return inFlight
+                .filter { _, attempts in
+                    !attempts.contains { $0.worker == worker }
+                        && attempts.allSatisfy { now.timeIntervalSince($0.start) > median * Self.stragglerFactor }
+                }
+                .min { $0.value[0].start < $1.value[0].start }?
+                .key
+        }
+
+        private func complete(_ index: Int, sum: [SIMD3<Float>], result: ItemResult, worker: Int) {
+            condition.withLock {
+                reports[worker].busySeconds += result.seconds
+                guard !finished[index] else {
+                    reports[worker].wastedItems += 1
+                    return
+                }
+                reports[worker].items += 1
+                reports[worker].passes += items[index].passCount
+                reports[worker].rays += result.rays
+                finished[index] = true
+                finishedCount += 1
+                unfolded[index] = sum
+                fold()
+                inFlight[index] = nil
+                itemSeconds.append(result.seconds)
+                condition.broadcast()
+            }
+        }
+
+        private func fail(_ index: Int, worker: Int) {
+            condition.withLock {
+                reports[worker].failed = true
+                inFlight[index]?.removeAll { $0.worker == worker }
+                if !finished[index], inFlight[index]?.isEmpty != false {
+                    inFlight[index] = nil
+                    // Keep items ordered, so that the image fills in the same order
+                    pending.insert(index, at: pending.firstIndex { $0 > index } ?? pending.endIndex)
+                }
+                condition.broadcast()
+            }
+        }
+
+        /// Adds the finished prefix of items to `total`, and drops their sums.
+        /// Only items finished out of order are kept, instead of full frames of all items.
+        private func fold() {
+            while let sum = unfolded.removeValue(forKey: foldedCount) {
+                for i in total.indices {
+                    total[i] += SIMD3<Double>(sum[i])
+                }
+                foldedCount += 1
+            }
+        }
+
+        private func merge() -> FloatImage {
+            let total = condition.withLock {
+                assert(foldedCount == items.count)
+                return self.total
+            }
+            let n = Double(options.passes)
+            return FloatImage(width: job.width, height: job.height, pixels: total.map { SIMD3<Float>(($0 / n).squareRoot()) })
+        }
+    }
+}
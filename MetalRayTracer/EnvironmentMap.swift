@@ -0,0 +1,117 @@
+//
+//  EnvironmentMap.swift
+//  RayTracing
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+
+import Metal
+
+/// Equirectangular HDR map of radiance arriving from infinity, used with `background_lighting_environment`.
+/// Row 0 looks straight up, see `Environment` in EnvironmentImpl.h for the mapping.
+struct EnvironmentMap {
+    var image: FloatImage
+
+    init(image: FloatImage) {
+        self.image = image
+    }
+
+    /// Reads linear RGB from a PFM file.
+    init?(pfm url: URL) {
+        guard let image = FloatImage(pfm: url) else { return nil }
+        self.init(image: image)
+    }
+
+    /// Same as `Environment::uv_to_direction()`.
+    static func direction(u: Float, v: Float) -> vector_float3 {
+        let φ = 2 * Float.pi * u
+        let θ = Float.pi * v
+        return vector_float3(sin(θ) * cos(φ), cos(θ), sin(θ) * sin(φ))
+    }
+
+    /// Clear sky with a small bright sun, and a dim ground below the horizon.
+    /// Most of the light comes from a few texels of the sun, which is hard to hit by bouncing rays.
+    static func sunAndSky(
+        width: Int = 1024,
+        height: Int = 512,
+        sunDirection: vector_float3 = normalize(vector_float3(-0.4, 0.6, 0.5)),
+        sunRadiance: vector_float3 = vector_float3(1000, 950, 850),
+        sunAngularRadius: Float = 1.5
+    ) -> EnvironmentMap {
+        let cosSun = cos(sunAngularRadius * .pi / 180)
+        var pixels: [SIMD3<Float>] = []
+        pixels.reserveCapacity(width * height)
+        for y in 0..<height {
+            for x in 0..<width {
+                let d = direction(u: (Float(x) + 0.5) / Float(width), v: (Float(y) + 0.5) / Float(height))
+                if dot(d, sunDirection) >= cosSun {
+                    pixels.append(sunRadiance)
+                } else if d.y >= 0 {
+                    // Same gradient as `background_lighting_sky`
+                    let a = 0.5 * d.y + 1
+                    pixels.append((1 - a) * SIMD3(1, 1, 1) + a * SIMD3(0.5, 0.7, 1.0))
+                } else {
+                    pixels.append(SIMD3(0.2, 0.2, 0.2))
+                }
+            }
+        }
+        return EnvironmentMap(image: FloatImage(width: width, height: height, pixels: pixels))
+    }
+
+    /// Luminance of texels times their solid angle, up to a common factor.
+    private func luminanceWeights() -> [Double] {
+        var weights = [Double](repeating: 0, count: image.pixels.count)
+        for y in 0..<image.height {
+            // Solid angle of a texel is proportional to sinθ
+            let sinθ = sin(Double.pi * (Double(y) + 0.5) / Double(image.height))
+            for x in 0..<image.width {
+                let i = y * image.width + x
+                let luminance = dot(simd_max(image.pixels[i], .zero), SIMD3(0.2126, 0.7152, 0.0722))
+                weights[i] = Double(luminance) * sinθ
+            }
+        }
+        return weights
+    }
+
+    /// Luminance averaged over the sphere of directions.
+    var averageLuminance: Float {
+        // Integral of sinθ over rows is 2/π of their number
+        let n = Double(image.pixels.count)
+        return Float(luminanceWeights().reduce(0, +) / (n * 2 / .pi))
+    }
+
+    /// Alias table over texels weighted by luminance times solid angle, see `build_alias_table()`.
+    /// Maps without light are sampled uniformly.
+    func makeAliasTable() -> [EnvironmentAliasEntry] {
+        let n = image.pixels.count
+        var weights = luminanceWeights()
+        if weights.reduce(0, +) <= 0 {
+            weights = Array(repeating: 1, count: n)
+        }
+        var entries = [EnvironmentAliasEntry](repeating: EnvironmentAliasEntry(), count: n)
+        var stack = [UInt32](repeating: 0, count: n)
+        build_alias_table(&weights, UInt32(n), &entries, &stack)
+        return entries
+    }
+
+    func makeTexture(device: MTLDevice) -> MTLTexture {
+        let descriptor = MTLTextureDescriptor.texture2DDescriptor(pixelFormat: .rgba32Float, width: image.width, height: image.height, mipmapped: false)
+        descriptor.usage = .shaderRead
+        let texture = device.makeTexture(descriptor: descriptor)!
+        let rgba = image.pixels.map { SIMD4<Float>($0, 1) }
+        rgba.withUnsafeBytes { buffer in
+            texture.replace(
+                region: MTLRegionMake2D(0, 0, image.width, image.height),
+                mipmapLevel: 0,
+                withBytes: buffer.baseAddress!,
+                bytesPerRow: image.width * MemoryLayout<SIMD4<Float>>.stride
+            )
+        }
+        return texture
+    }
+
+    /// Black 1×1 map, bound when the scene has no environment.
+    static var empty: EnvironmentMap {
+        EnvironmentMap(image: FloatImage(width: 1, height: 1, pixels: [.zero]))
+    }
+}
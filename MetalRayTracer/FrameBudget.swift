@@ -0,0 +1,48 @@
+//
+//  FrameBudget.swift
+//  MetalRayTracer
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+
+import Foundation
+
+/// Chooses samples per pixel of the next pass from GPU time of previous passes.
+///
+/// While the view changes, passes are sized to fit into the frame time.
+/// Once it has been static for a while, passes grow to `throughputPassSeconds`,
+/// which amortizes per-pass overhead and maximizes samples per second, while the UI stays responsive.
+struct FrameBudgetController {
+    var targetFrameSeconds = 1.0 / 60
+    /// Part of the frame left for presentation and the UI.
+    var headroom = 0.2
+    var throughputPassSeconds = 0.1
+    /// View is considered static after this many seconds without changes.
+    var staticDelay = 0.5
+    var maxSamplesPerPixel = 256
+
+    /// Exponential moving average.
+    private(set) var secondsPerSample: Double?
+    private var lastChange = Date.now
+
+    var isStatic: Bool {
+        Date.now.timeIntervalSince(lastChange) >= staticDelay
+    }
+
+    /// Cost per sample usually stays similar when the camera moves, so the estimate is kept.
+    mutating func viewDidChange() {
+        lastChange = .now
+    }
+
+    mutating func record(samplesPerPixel: Int, gpuSeconds: Double) {
+        guard gpuSeconds > 0 else { return }
+        let perSample = gpuSeconds / Double(samplesPerPixel)
+        secondsPerSample = secondsPerSample.map { $0 * 0.7 + perSample * 0.3 } ?? perSample
+    }
+
+    func nextSamplesPerPixel() -> Int {
+        guard let secondsPerSample else { return 1 }
+        let budget = isStatic ? throughputPassSeconds : targetFrameSeconds * (1 - headroom)
+        return min(max(Int(budget / secondsPerSample), 1), maxSamplesPerPixel)
+    }
+}
@@ -0,0 +1,120 @@
+//
+//  HeterogeneousVolume.swift
+//  RayTracing
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+
+import Metal
+
+struct __HeterogeneousVolumeImpl<Base: RenderableImpl>: RenderableImpl {
+    var base: Base
+    var grid: DensityGrid
+
+    static var intersectionFunctionName: String {
+        getIntersectionFunctionName(operation: "hdv", operands: (Base.self))
+    }
+
+    static var materialHandleOffsets: [Int] {
+        Base.materialHandleOffsets.map { $0 + MemoryLayout<Self>.offset(of: \.base)! }
+    }
+
+    static var hasMotion: Bool { Base.hasMotion }
+}
+
+/// Volume with density varying inside `base`, e.g. smoke or fog.
+/// Density is given by a voxel grid over the bounding box of `base`, and is zero outside of `base`.
+struct HeterogeneousVolume<Base: Renderable>: Renderable {
+    var base: Base
+    var grid: DensityGrid
+
+    /// `density` gets voxel centers in world space, and returns values in [0, 1], scaled by `maxDensity`.
+    init(base: Base, maxDensity: Float, density: ([vector_float3]) -> [Float]) {
+        self.base = base
+        self.grid = DensityGrid(bounds: base.boundingBox, maxDensity: maxDensity, density: density)
+    }
+
+    var boundingBox: MTLAxisAlignedBoundingBox {
+        base.boundingBox
+    }
+
+    func boundingBox(during interval: ClosedRange<Float>) -> MTLAxisAlignedBoundingBox {
+        base.boundingBox(during: interval)
+    }
+
+    func visitMaterials(_ reserver: inout MaterialReserver) {
+        base.visitMaterials(&reserver)
+    }
+
+    func asImpl(_ encoder: inout MaterialEncoder) -> __HeterogeneousVolumeImpl<Base.Impl> {
+        let baseImpl = base.asImpl(&encoder)
+        return __HeterogeneousVolumeImpl(base: baseImpl, grid: grid)
+    }
+}
+
+extension DensityGrid {
+    static let resolution = Int(DENSITY_GRID_RESOLUTION)
+    static let majorantResolution = Int(DENSITY_GRID_MAJORANT_RESOLUTION)
+
+    init(bounds: MTLAxisAlignedBoundingBox, maxDensity: Float, density: ([vector_float3]) -> [Float]) {
+        self.init()
+        let n = Self.resolution
+        bounds_min = bounds.min.asUnpacked
+        bounds_max = bounds.max.asUnpacked
+        density_scale = maxDensity
+
+        var points: [vector_float3] = []
+        points.reserveCapacity(n * n * n)
+        for z in 0..<n {
+            for y in 0..<n {
+                for x in 0..<n {
+                    let p = (vector_float3(Float(x), Float(y), Float(z)) + 0.5) / Float(n)
+                    points.append(bounds_min + p * (bounds_max - bounds_min))
+                }
+            }
+        }
+        let values = density(points)
+        precondition(values.count == points.count)
+        withUnsafeMutableBytes(of: &voxels) { voxels in
+            for (i, value) in values.enumerated() {
+                voxels[i] = UInt8((simd_clamp(value, 0, 1) * 255).rounded())
+            }
+        }
+        updateMajorants()
+    }
+
+    /// Maximum of every block of voxels, extended by one voxel, because interpolation inside the block also reads neighbours.
+    /// Blocks without density get zero, so that delta tracking skips them.
+    mutating func updateMajorants() {
+        let n = Self.resolution
+        let m = Self.majorantResolution
+        let b = n / m
+        let scale = density_scale / 255
+        let voxels = withUnsafeBytes(of: voxels) { Array($0) }
+        withUnsafeMutableBytes(of: &majorants) { buffer in
+            let majorants = buffer.bindMemory(to: Float.self)
+            for z in 0..<m {
+                for y in 0..<m {
+                    for x in 0..<m {
+                        var value: UInt8 = 0
+                        for k in max(z * b - 1, 0)...min(z * b + b, n - 1) {
+                            for j in max(y * b - 1, 0)...min(y * b + b, n - 1) {
+                                for i in max(x * b - 1, 0)...min(x * b + b, n - 1) {
+                                    value = max(value, voxels[(k * n + j) * n + i])
+                                }
+                            }
+                        }
+                        majorants[(z * m + y) * m + x] = Float(value) * scale
+                    }
+                }
+            }
+        }
+    }
+}
+
+extension DensityGrid {
+    /// Smoke-like density from turbulence of `noise`, with empty space around the denser parts.
+    static func smoke(_ noise: PerlinNoiseTexture) -> ([vector_float3]) -> [Float] {
+        { points in noise.turbulence(at: points).map { ($0 - 0.5) * 2 } }
+    }
+}
@@ -23,6 +23,7 @@
 
 typedef vector_float3 float3;
 typedef vector_float2 float2;
+typedef unsigned char uchar;
 
 using namespace simd;
 
@@ -0,0 +1,77 @@
+//
+//  EnvironmentImpl.h
+//  RayTracing
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+
+#ifndef ENVIRONMENT_IMPL_H
+#define ENVIRONMENT_IMPL_H
+
+#include "../Config.h"
+#include "RNG.h"
+#include "Defines.h"
+
+/// Equirectangular environment map: U goes around the Y axis starting from +X towards +Z, V goes from +Y down to -Y.
+struct Environment {
+    texture2d<float> texture;
+    device EnvironmentAliasEntry const *alias_table;
+
+    static float2 direction_to_uv(float3 direction) {
+        float u = atan2(direction.z, direction.x) / (2 * M_PI_F);
+        return float2(u < 0 ? u + 1 : u, acos(clamp(direction.y, -1.0f, 1.0f)) / M_PI_F);
+    }
+
+    static float3 uv_to_direction(float2 uv) {
+        float φ = 2 * M_PI_F * uv.x;
+        float θ = M_PI_F * uv.y;
+        float sinθ = sin(θ);
+        return float3(sinθ * cos(φ), cos(θ), sinθ * sin(φ));
+    }
+
+    uint2 texel(float2 uv) const {
+        uint2 size = uint2(texture.get_width(), texture.get_height());
+        return min(uint2(uv * float2(size)), size - 1);
+    }
+
+    float3 radiance(float3 direction) const {
+        return texture.read(texel(direction_to_uv(direction))).rgb;
+    }
+
+    /// Probability density per solid angle of `sample()` returning `direction`.
+    /// Texels are sampled uniformly in UV, which covers 2π² sinθ steradians per unit of area.
+    float pdf(float3 direction) const {
+        float2 uv = direction_to_uv(direction);
+        uint2 t = texel(uv);
+        float sinθ = sqrt(max(1 - direction.y * direction.y, 0.0f));
+        if (sinθ == 0) {
+            return 0;
+        }
+        uint texels = texture.get_width() * texture.get_height();
+        return alias_table[t.y * texture.get_width() + t.x].pdf * texels / (2 * M_PI_F * M_PI_F * sinθ);
+    }
+
+    /// Picks a texel in O(1) using the alias table, and a uniform point inside it.
+    float3 sample(thread RNG *rng, thread float & pdf) const {
+        uint width = texture.get_width();
+        uint texels = width * texture.get_height();
+        uint i = min(uint(rng->random_f() * texels), texels - 1);
+        EnvironmentAliasEntry entry = alias_table[i];
+        if (rng->random_f() >= entry.probability) {
+            i = entry.alias;
+        }
+        float2 uv = (float2(i % width, i / width) + float2(rng->random_f(), rng->random_f())) / float2(width, texture.get_height());
+        float3 direction = uv_to_direction(uv);
+        pdf = this->pdf(direction);
+        return direction;
+    }
+};
+
+/// Power heuristic for two strategies taking one sample each.
+inline float mis_weight(float pdf, float other_pdf) {
+    float a = pdf * pdf;
+    float b = other_pdf * other_pdf;
+    return a + b > 0 ? a / (a + b) : 0;
+}
+
+#endif // ENVIRONMENT_IMPL_H
@@ -0,0 +1,165 @@
+//
+//  GuidingImpl.h
+//  RayTracing
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+
+#ifndef GUIDING_IMPL_H
+#define GUIDING_IMPL_H
+
+#include "../Config.h"
+#include "RNG.h"
+#include "Defines.h"
+
+inline float luminance(float3 color) {
+    return dot(color, float3(0.2126, 0.7152, 0.0722));
+}
+
+/// Guided bounces remembered by a path for training, deeper ones are not recorded.
+constant uint const guiding_max_vertices = 6;
+
+/// Bounce that sampled `direction` with density `pdf`, radiance arriving along it is known when the path ends.
+struct GuidedVertex {
+    uint leaf;
+    float3 direction;
+    float pdf;
+    /// Path throughput including the bounce, and color collected by the path before continuing from it.
+    float3 throughput;
+    float3 color;
+};
+
+struct GuidedPath {
+    GuidedVertex vertices[guiding_max_vertices];
+    uint count;
+};
+
+/// Spatial and directional trees of the guiding field, see `GuidingConfig`.
+struct GuidingField {
+    constant GuidingConfig const *config;
+    device GuidingSpatialNode const *spatial_nodes;
+    device GuidingDirectionalNode const *directional_nodes;
+
+    bool enabled() const {
+        return config->spatial_node_count > 0;
+    }
+
+    /// Leaf of the spatial tree containing `point`, points outside of the bounds belong to the nearest leaf.
+    uint leaf_at(float3 point) const {
+        float3 lo = config->bounds_min;
+        float3 hi = config->bounds_max;
+        float3 p = clamp(point, lo, hi);
+        uint node = 0;
+        while (true) {
+            GuidingSpatialNode n = spatial_nodes[node];
+            if (n.axis > 2) {
+                return node;
+            }
+            float middle = (lo[n.axis] + hi[n.axis]) / 2;
+            if (p[n.axis] < middle) {
+                hi[n.axis] = middle;
+                node = n.child;
+            } else {
+                lo[n.axis] = middle;
+                node = n.child + 1;
+            }
+        }
+    }
+
+    uint directional_root(uint leaf) const {
+        return spatial_nodes[leaf].child;
+    }
+
+    /// Whether the directional tree has learned anything, otherwise only the material samples directions.
+    bool can_sample(uint root) const {
+        return directional_nodes[root].energy > 0;
+    }
+
+    static float2 direction_to_square(float3 direction) {
+        float φ = atan2(direction.z, direction.x) / (2 * M_PI_F);
+        float2 p = float2((clamp(direction.y, -1.0f, 1.0f) + 1) / 2, φ < 0 ? φ + 1 : φ);
+        return min(p, float2(0.99999994f));
+    }
+
+    static float3 square_to_direction(float2 p) {
+        float cosθ = 2 * p.x - 1;
+        float sinθ = sqrt(max(1 - cosθ * cosθ, 0.0f));
+        float φ = 2 * M_PI_F * p.y;
+        return float3(sinθ * cos(φ), cosθ, sinθ * sin(φ));
+    }
+
+    /// Leaf of the directional tree under `root` containing `p`, which is made relative to the leaf.
+    uint directional_leaf(uint root, thread float2 & p, thread float & density) const {
+        uint node = root;
+        density = 1;
+        while (true) {
+            GuidingDirectionalNode n = directional_nodes[node];
+            if (n.child == 0) {
+                return node;
+            }
+            uint2 quadrant = uint2(p >= 0.5);
+            p = p * 2 - float2(quadrant);
+            uint child = n.child + quadrant.x + 2 * quadrant.y;
+            density *= n.energy > 0 ? 4 * directional_nodes[child].energy / n.energy : 0;
+            node = child;
+        }
+    }
+
+    /// Probability density per solid angle of `sample()` returning `direction`.
+    /// The cylindrical mapping covers the sphere of 4π steradians by the unit square, with constant Jacobian.
+    float pdf(uint root, float3 direction) const {
+        float2 p = direction_to_square(direction);
+        float density;
+        directional_leaf(root, p, density);
+        return density / (4 * M_PI_F);
+    }
+
+    /// Descends into children proportionally to their energy, and picks a uniform point in the leaf.
+    float3 sample(uint root, thread RNG *rng, thread float & pdf) const {
+        uint node = root;
+        float2 origin = 0;
+        float size = 1;
+        float density = 1;
+        while (true) {
+            GuidingDirectionalNode n = directional_nodes[node];
+            if (n.child == 0) {
+                break;
+            }
+            float u = rng->random_f() * n.energy;
+            uint i = 0;
+            float energy = directional_nodes[n.child].energy;
+            while (i < 3 && u >= energy) {
+                u -= energy;
+                i++;
+                energy = directional_nodes[n.child + i].energy;
+            }
+            density *= 4 * energy / n.energy;
+            size /= 2;
+            origin += float2(i & 1, i >> 1) * size;
+            node = n.child + i;
+        }
+        pdf = density / (4 * M_PI_F);
+        return square_to_direction(origin + float2(rng->random_f(), rng->random_f()) * size);
+    }
+
+    /// Splats radiance arriving at every vertex of `path`, given the final color of the path, into the training buffers.
+    /// Estimates of incident radiance divided by the density of their direction sum up to radiance integrated over nodes.
+    /// Atomic adds from all threads need no locks, the tree is rebuilt on the CPU between training iterations.
+    void record(GuidedPath path, float3 color, device atomic_float *training_energy, device atomic_uint *training_counts) const {
+        for (uint i = 0; i < path.count; i++) {
+            GuidedVertex v = path.vertices[i];
+            // Light collected after the vertex was scaled by its throughput, so dividing gives the radiance along `direction`
+            float3 radiance = select(float3(0), (color - v.color) / v.throughput, v.throughput > 0);
+            float value = v.pdf > 0 ? luminance(max(radiance, 0.0f)) / v.pdf : 0;
+            float2 p = direction_to_square(v.direction);
+            float density;
+            uint leaf = directional_leaf(directional_root(v.leaf), p, density);
+            if (value > 0 && isfinite(value)) {
+                atomic_fetch_add_explicit(training_energy + leaf, value, memory_order_relaxed);
+            }
+            atomic_fetch_add_explicit(training_counts + v.leaf, 1, memory_order_relaxed);
+        }
+    }
+};
+
+#endif // GUIDING_IMPL_H
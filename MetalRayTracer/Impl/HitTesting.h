@@ -8,6 +8,7 @@
 #define HIT_TESTING_H
 
 #include "Defines.h"
+#include "../Materials.h"
 
 enum class face {
     front,
@@ -18,10 +19,12 @@ struct HitInfo {
     float3 point;
     float3 normal;
     face face;
-    size_t material_offset;
+    MaterialHandle material;
     float2 texture_coordinates;
+    /// Change of texture coordinates per unit of distance along the surface, for texture level of detail.
+    float texture_scale;
 
-    void set_normal(float3 front_normal, float3 ray_direction) ray_data {
+    void set_normal(float3 front_normal, float3 ray_direction) {
         if (dot(front_normal, ray_direction) > 0) {
             normal = -front_normal;
             face = face::back;
@@ -36,12 +39,28 @@ class Ray3D {
 public:
     float3 origin;
     float3 direction;
+    /// Fraction of the shutter interval, from 0 (open) to 1 (closed).
+    float time;
 
-    Ray3D(float3 _origin, float3 _direction): origin(_origin), direction(_direction) {}
+    Ray3D(float3 _origin, float3 _direction): origin(_origin), direction(_direction), time(0) {}
+    Ray3D(float3 _origin, float3 _direction, float _time): origin(_origin), direction(_direction), time(_time) {}
 
     float3 at(float t) const {
         return origin + t * direction;
     }
 };
 
+/// Cone around the rays of a path, approximating the footprint of a pixel on the surfaces it hits,
+/// as in "Texture Level of Detail Strategies for Real-Time Ray Tracing" (Ray Tracing Gems, chapter 20).
+struct RayCone {
+    /// Width at the origin of the current ray.
+    float width;
+    /// Angle of the cone, i.e. growth of the width per unit of distance.
+    float spread;
+
+    float width_at(float distance) const {
+        return width + spread * distance;
+    }
+};
+
 #endif // HIT_TESTING_H
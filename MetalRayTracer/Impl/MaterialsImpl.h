@@ -46,15 +46,28 @@ float3 refract_or_reflect(float3 v, float3 normal, float ηRatio, float reflecta
     return reflect(v, normal);
 }
 
-vector_float3 get_color(SolidColor color, vector_float2 coords, vector_float3 point) {
+// `footprint` is the width of the ray cone at the hit, details smaller than it are filtered out.
+
+/// Grazing hits stretch the footprint on the surface by 1 / cos, up to this factor.
+constant float const max_footprint_stretch = 16;
+
+vector_float3 get_color(SolidColor color, Ray3D ray, HitInfo hit, float footprint) {
     return color;
 }
 
-float3 get_color(ImageTexture texture, vector_float2 coords, vector_float3 point) {
+float3 get_color(ImageTexture texture, Ray3D ray, HitInfo hit, float footprint) {
+#ifdef __METAL__
     static_assert(sizeof(texture.texture) == sizeof(MTLResourceID), "Bad texture size");
     static_assert(__alignof(texture.texture) == __alignof(MTLResourceID), "Bad texture alignment");
-    constexpr sampler s(coord::normalized, filter::nearest);
-    return texture.texture.sample(s, coords).rgb;
+    constexpr sampler s(coord::normalized, mag_filter::nearest, min_filter::linear, mip_filter::linear);
+    // Footprint in texels of the finest level, along the longer axis of its projection on the surface
+    float cosine = max(abs(dot(ray.direction, hit.normal)), 1 / max_footprint_stretch);
+    float texels = footprint / cosine * hit.texture_scale * max(texture.texture.get_width(), texture.texture.get_height());
+    return texture.texture.sample(s, hit.texture_coordinates, level(max(log2(texels), 0.0f))).rgb;
+#else
+    // Image textures live on the GPU, on the CPU use the same magenta as TextureLoader's placeholder.
+    return (float3){1, 0, 1};
+#endif
 }
 
 uchar perlin_hash(constant PerlinNoiseTexture const & tex, uchar x, uchar y, uchar z) {
@@ -99,14 +112,14 @@ float perlin_noise(constant PerlinNoiseTexture const & tex, float3 p) {
     float y0 = ty, y1 = ty - 1;
     float z0 = tz, z1 = tz - 1;
 
-    float3 p000 = float3(x0, y0, z0);
-    float3 p100 = float3(x1, y0, z0);
-    float3 p010 = float3(x0, y1, z0);
-    float3 p110 = float3(x1, y1, z0);
-    float3 p001 = float3(x0, y0, z1);
-    float3 p101 = float3(x1, y0, z1);
-    float3 p011 = float3(x0, y1, z1);
-    float3 p111 = float3(x1, y1, z1);
+    float3 p000 = (float3){x0, y0, z0};
+    float3 p100 = (float3){x1, y0, z0};
+    float3 p010 = (float3){x0, y1, z0};
+    float3 p110 = (float3){x1, y1, z0};
+    float3 p001 = (float3){x0, y0, z1};
+    float3 p101 = (float3){x1, y0, z1};
+    float3 p011 = (float3){x0, y1, z1};
+    float3 p111 = (float3){x1, y1, z1};
 
     // linear interpolation
     float a = mix(dot(c000, p000), dot(c100, p100), u);
@@ -120,16 +133,26 @@ float perlin_noise(constant PerlinNoiseTexture const & tex, float3 p) {
     return mix(e, f, w);
 }
 
-float3 get_color(constant PerlinNoiseTexture const & texture, vector_float2 coords, vector_float3 point) {
-    auto t = 0.0;
+/// Noise has features of size 1 / frequency, which average out to 0 when they are smaller than the footprint.
+/// Octaves fade out as their features shrink from half the footprint to the footprint, and are skipped after that.
+float octave_fade(float frequency, float footprint) {
+    return clamp(2 - 2 * footprint * frequency, 0.0f, 1.0f);
+}
+
+float3 perlin_color(constant PerlinNoiseTexture const & texture, float3 point, float footprint) {
+    float t = 0;
     if (texture.turbulence == 0) {
-        t = 1.0 + perlin_noise(texture, point * texture.frequency);
+        t = 1 + perlin_noise(texture, point * texture.frequency) * octave_fade(texture.frequency, footprint);
     } else {
-        auto f = texture.frequency;
-        auto weight = 1.0;
+        float f = texture.frequency;
+        float weight = 1;
         for (unsigned i = 0; i < texture.turbulence; i++) {
+            float fade = octave_fade(f, footprint);
+            if (fade <= 0) {
+                break;
+            }
             float ti = perlin_noise(texture, point * f);
-            t += ti * weight;
+            t += ti * weight * fade;
             weight *= 0.5;
             f *= 2;
         }
@@ -138,14 +161,22 @@ float3 get_color(constant PerlinNoiseTexture const & texture, vector_float2 coor
     return mix(texture.colors[0], texture.colors[1], t);
 }
 
+float3 get_color(constant PerlinNoiseTexture const & texture, Ray3D ray, HitInfo hit, float footprint) {
+    return perlin_color(texture, hit.point, footprint);
+}
+
 struct material_result {
     float3 emitted;
     float3 attenuation;
     Ray3D scattered;
 };
 
+/// Spread of the cone after a diffuse bounce. Scattered rays cover the whole hemisphere,
+/// so this only keeps lookups at the next hit from going finer than the blur of the bounce.
+constant float const diffuse_cone_spread = 0.5;
+
 template<class LambertianMaterial>
-bool lambertian_scatter(constant LambertianMaterial const * material, Ray3D ray, HitInfo hit, thread RNG* rng, thread material_result & result) {
+bool lambertian_scatter(constant LambertianMaterial const * material, Ray3D ray, HitInfo hit, thread RayCone & cone, thread RNG* rng, thread material_result & result) {
     result.emitted = 0;
     while (true) {
         float3 d = hit.normal + rng->random_unit_vector_3d();
@@ -156,21 +187,25 @@ bool lambertian_scatter(constant LambertianMaterial const * material, Ray3D ray,
             break;
         }
     }
-    result.attenuation = get_color(material->albedo, hit.texture_coordinates, hit.point);
+    result.attenuation = get_color(material->albedo, ray, hit, cone.width);
+    cone.spread = max(cone.spread, diffuse_cone_spread);
     return true;
 }
 
 template<class MetalMaterial>
-bool metal_scatter(constant MetalMaterial const * material, Ray3D ray, HitInfo hit, thread RNG* rng, thread material_result & result) {
+bool metal_scatter(constant MetalMaterial const * material, Ray3D ray, HitInfo hit, thread RayCone & cone, thread RNG* rng, thread material_result & result) {
     result.emitted = 0;
     float3 reflected = reflect(ray.direction, hit.normal) + material->fuzz * rng->random_unit_vector_3d();
     if (dot(reflected, hit.normal) < 0) { return false; }
-    result.attenuation = get_color(material->albedo, hit.texture_coordinates, hit.point);
+    result.attenuation = get_color(material->albedo, ray, hit, cone.width);
     result.scattered = Ray3D(hit.point, normalize(reflected));
+    // Fuzz perturbs the mirror direction by up to `fuzz` radians
+    cone.spread += material->fuzz;
     return true;
 }
 
-bool dielectric_scatter(constant DielectricMaterial const * material, Ray3D ray, HitInfo hit, thread RNG* rng, thread material_result & result) {
+/// Refraction keeps the spread, ignoring curvature of the surface.
+bool dielectric_scatter(constant DielectricMaterial const * material, Ray3D ray, HitInfo hit, thread RayCone & cone, thread RNG* rng, thread material_result & result) {
     result.emitted = 0;
     float ηRatio = hit.face == face::front ? 1.0 / material->refraction_index : material->refraction_index;
     float3 refracted = refract_or_reflect(ray.direction, hit.normal, ηRatio, rng->random_f());
@@ -179,38 +214,81 @@ bool dielectric_scatter(constant DielectricMaterial const * material, Ray3D ray,
     return true;
 }
 
-bool emissive_scatter(constant ColoredEmissiveMaterial const * material, Ray3D ray, HitInfo hit, thread RNG* rng, thread material_result & result) {
+bool emissive_scatter(constant ColoredEmissiveMaterial const * material, Ray3D ray, HitInfo hit, thread RayCone & cone, thread RNG* rng, thread material_result & result) {
     result.emitted = material->albedo;
     return false;
 }
 
-bool isotropic_scatter(constant ColoredIsotropicMaterial const * material, Ray3D ray, HitInfo hit, thread RNG* rng, thread material_result & result) {
+bool isotropic_scatter(constant ColoredIsotropicMaterial const * material, Ray3D ray, HitInfo hit, thread RayCone & cone, thread RNG* rng, thread material_result & result) {
     result.scattered = Ray3D(hit.point, rng->random_unit_vector_3d());
-    result.attenuation = get_color(material->albedo, hit.texture_coordinates, hit.point);
+    result.attenuation = get_color(material->albedo, ray, hit, cone.width);
+    cone.spread = max(cone.spread, diffuse_cone_spread);
     return true;
 }
 
-bool scatter(constant void const * material, Ray3D ray, HitInfo hit, thread RNG* rng, thread material_result & result) {
-    MaterialKind kind = *reinterpret_cast<constant MaterialKind const*>(material);
-    switch (kind) {
+/// Material referenced by `handle` in the table of its kind, see `MaterialTables`.
+template<class Material>
+constant Material const * material_at(constant uchar const * materials, MaterialHandle handle) {
+    constant MaterialTables const * tables = reinterpret_cast<constant MaterialTables const *>(materials);
+    constant Material const * table = reinterpret_cast<constant Material const *>(materials + tables->offsets[material_handle_kind(handle)]);
+    return table + material_handle_index(handle);
+}
+
+/// False for kinds that are compiled out of the kernel, see `enabled_material_kinds` in Shaders.metal.
+inline bool material_kind_enabled(MaterialKind kind) {
+#ifdef ENABLED_MATERIAL_KINDS
+    return (ENABLED_MATERIAL_KINDS & (1u << kind)) != 0;
+#else
+    return true;
+#endif
+}
+
+/// `cone` is the ray cone at the hit, and is updated for the scattered ray.
+/// With constant kinds for `material_kind_enabled()`, only enabled materials are compiled in.
+bool scatter(constant uchar const * materials, MaterialHandle material, Ray3D ray, HitInfo hit, thread RayCone & cone, thread RNG* rng, thread material_result & result) {
+    switch (material_handle_kind(material)) {
         case material_kind_lambertian_colored:
-            return lambertian_scatter(reinterpret_cast<constant ColoredLambertianMaterial const *>(material), ray, hit, rng, result);
+            return material_kind_enabled(material_kind_lambertian_colored) && lambertian_scatter(material_at<ColoredLambertianMaterial>(materials, material), ray, hit, cone, rng, result);
         case material_kind_lambertian_textured:
-            return lambertian_scatter(reinterpret_cast<constant TexturedLambertianMaterial const *>(material), ray, hit, rng, result);
+            return material_kind_enabled(material_kind_lambertian_textured) && lambertian_scatter(material_at<TexturedLambertianMaterial>(materials, material), ray, hit, cone, rng, result);
         case material_kind_lambertian_perlin_noise:
-            return lambertian_scatter(reinterpret_cast<constant PerlinNoiseLambertianMaterial const *>(material), ray, hit, rng, result);
+            return material_kind_enabled(material_kind_lambertian_perlin_noise) && lambertian_scatter(material_at<PerlinNoiseLambertianMaterial>(materials, material), ray, hit, cone, rng, result);
         case material_kind_metal_colored:
-            return metal_scatter(reinterpret_cast<constant ColoredMetalMaterial const *>(material), ray, hit, rng, result);
+            return material_kind_enabled(material_kind_metal_colored) && metal_scatter(material_at<ColoredMetalMaterial>(materials, material), ray, hit, cone, rng, result);
         case material_kind_metal_textured:
-            return metal_scatter(reinterpret_cast<constant TexturedMetalMaterial const *>(material), ray, hit, rng, result);
+            return material_kind_enabled(material_kind_metal_textured) && metal_scatter(material_at<TexturedMetalMaterial>(materials, material), ray, hit, cone, rng, result);
         case material_kind_metal_perlin_noise:
-            return metal_scatter(reinterpret_cast<constant PerlinNoiseMetalMaterial const *>(material), ray, hit, rng, result);
+            return material_kind_enabled(material_kind_metal_perlin_noise) && metal_scatter(material_at<PerlinNoiseMetalMaterial>(materials, material), ray, hit, cone, rng, result);
         case material_kind_dielectric:
-            return dielectric_scatter(reinterpret_cast<constant DielectricMaterial const *>(material), ray, hit, rng, result);
+            return material_kind_enabled(material_kind_dielectric) && dielectric_scatter(material_at<DielectricMaterial>(materials, material), ray, hit, cone, rng, result);
         case material_kind_emissive_colored:
-            return emissive_scatter(reinterpret_cast<constant ColoredEmissiveMaterial const *>(material), ray, hit, rng, result);
+            return material_kind_enabled(material_kind_emissive_colored) && emissive_scatter(material_at<ColoredEmissiveMaterial>(materials, material), ray, hit, cone, rng, result);
+        case material_kind_isotropic_colored:
+            return material_kind_enabled(material_kind_isotropic_colored) && isotropic_scatter(material_at<ColoredIsotropicMaterial>(materials, material), ray, hit, cone, rng, result);
+    }
+}
+
+/// Surfaces that store and gather caustic photons, see `PhotonMapConfig`.
+inline bool is_lambertian(MaterialKind kind) {
+    return kind == material_kind_lambertian_colored || kind == material_kind_lambertian_textured || kind == material_kind_lambertian_perlin_noise;
+}
+
+/// Density of `scatter()` choosing `direction`, for materials scattering diffusely.
+/// Their attenuation is the albedo, so BSDF times cosine equals attenuation times this density.
+/// Returns false for other materials, which are not sampled towards lights.
+bool diffuse_pdf(MaterialKind kind, HitInfo hit, float3 direction, thread float & pdf) {
+    switch (kind) {
+        case material_kind_lambertian_colored:
+        case material_kind_lambertian_textured:
+        case material_kind_lambertian_perlin_noise:
+            // Cosine-weighted, see `lambertian_scatter()`
+            pdf = max(dot(hit.normal, direction), 0.0f) / M_PI_F;
+            return true;
         case material_kind_isotropic_colored:
-            return isotropic_scatter(reinterpret_cast<constant ColoredIsotropicMaterial const *>(material), ray, hit, rng, result);
+            pdf = 1 / (4 * M_PI_F);
+            return true;
+        default:
+            return false;
     }
 }
 
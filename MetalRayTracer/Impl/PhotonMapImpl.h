@@ -0,0 +1,95 @@
+//
+//  PhotonMapImpl.h
+//  RayTracing
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+
+#ifndef PHOTON_MAP_IMPL_H
+#define PHOTON_MAP_IMPL_H
+
+#include "../Config.h"
+#include "RNG.h"
+#include "Defines.h"
+
+/// Photons sorted by cell of a hash grid, see `photon_sort_kernel`.
+/// Cells are `2 * max_radius` wide, so a gather sphere overlaps at most 2×2×2 of them.
+struct PhotonMap {
+    constant PhotonMapConfig const *config;
+    device Photon const *photons;
+    /// First photon of each cell, see `photon_prefix_sum_kernel`.
+    device uint const *cell_starts;
+    device uint const *cell_counts;
+
+    float cell_size() const {
+        return 2 * config->max_radius;
+    }
+
+    static uint hash_cell(int3 cell, uint cell_count) {
+        uint h = uint(cell.x) * 73856093u ^ uint(cell.y) * 19349663u ^ uint(cell.z) * 83492791u;
+        return h & (cell_count - 1);
+    }
+
+    static uint cell_of(float3 point, constant PhotonMapConfig const & config) {
+        return hash_cell(int3(floor(point / (2 * config.max_radius))), config.cell_count);
+    }
+
+    /// Sum of power of photons within `radius` of `point`, arriving at the side of `normal`.
+    /// Distinct grid cells can share a hash, so hashes already visited are skipped.
+    float3 gather(float3 point, float3 normal, float radius, thread uint & count) const {
+        float3 power = 0;
+        count = 0;
+        int3 first = int3(floor((point - radius) / cell_size()));
+        uint visited[8];
+        uint visited_count = 0;
+        for (int i = 0; i < 8; i++) {
+            uint h = hash_cell(first + int3(i & 1, (i >> 1) & 1, i >> 2), config->cell_count);
+            bool seen = false;
+            for (uint j = 0; j < visited_count; j++) {
+                seen = seen || visited[j] == h;
+            }
+            if (seen) {
+                continue;
+            }
+            visited[visited_count++] = h;
+            uint end = cell_starts[h] + cell_counts[h];
+            for (uint k = cell_starts[h]; k < end; k++) {
+                Photon p = photons[k];
+                if (distance_squared(p.position, point) <= radius * radius && dot(p.direction, normal) < 0) {
+                    power += p.power;
+                    count++;
+                }
+            }
+        }
+        return power;
+    }
+};
+
+/// Progressive photon mapping radius reduction (Hachisuka and Jensen, "Stochastic Progressive Photon Mapping"):
+/// only `alpha` of the new photons are kept, and the radius shrinks so that the density of photons is preserved.
+/// Each pass estimates radiance at its own radius, and passes are averaged, as in Knaus and Zwicker,
+/// "Progressive Photon Mapping: A Probabilistic Approach".
+inline void shrink_gather_radius(thread PixelPhotonStats & stats, float count, float alpha) {
+    if (count > 0) {
+        float kept = stats.count + alpha * count;
+        stats.radius *= sqrt(kept / (stats.count + count));
+        stats.count = kept;
+    }
+}
+
+/// Uniform point in the unit disk.
+inline float2 random_in_unit_disk(thread RNG *rng) {
+    float r = sqrt(rng->random_f());
+    float φ = 2 * M_PI_F * rng->random_f();
+    return r * float2(cos(φ), sin(φ));
+}
+
+/// Cosine-weighted direction around `normal`.
+inline float3 random_cosine_direction(float3 normal, thread RNG *rng) {
+    float2 d = random_in_unit_disk(rng);
+    float3 t = normalize(abs(normal.x) > 0.9 ? cross(normal, float3(0, 1, 0)) : cross(normal, float3(1, 0, 0)));
+    float3 b = cross(normal, t);
+    return d.x * t + d.y * b + sqrt(max(1 - length_squared(d), 0.0f)) * normal;
+}
+
+#endif // PHOTON_MAP_IMPL_H
@@ -15,11 +15,11 @@
 
 inline Ray3D inverse_transform(Ray3D r, Transform t) {
     matrix_float3x3 rInv = transpose(t.rotation);
-    return Ray3D(rInv * (r.origin - t.translation), rInv * r.direction);
+    return Ray3D(rInv * (r.origin - t.translation), rInv * r.direction, r.time);
 }
 
 inline Ray3D transform(Ray3D r, Transform t) {
-    return Ray3D(t.rotation * r.origin + t.translation, t.rotation * r.direction);
+    return Ray3D(t.rotation * r.origin + t.translation, t.rotation * r.direction, r.time);
 }
 
 inline float3 inverse_transform_point(float3 p, Transform t) {
@@ -27,6 +27,29 @@ inline float3 inverse_transform_point(float3 p, Transform t) {
     return rInv * (p - t.translation);
 }
 
+/// Rotation matrix of a quaternion of any non-zero length.
+/// Scaling by the squared norm makes normalization unnecessary.
+inline matrix_float3x3 quaternion_matrix(float x, float y, float z, float w) {
+    float s = 2 / (x * x + y * y + z * z + w * w);
+    matrix_float3x3 m;
+    m.columns[0] = (float3){1 - s * (y * y + z * z), s * (x * y + w * z), s * (x * z - w * y)};
+    m.columns[1] = (float3){s * (x * y - w * z), 1 - s * (x * x + z * z), s * (y * z + w * x)};
+    m.columns[2] = (float3){s * (x * z + w * y), s * (y * z - w * x), 1 - s * (x * x + y * y)};
+    return m;
+}
+
+/// Rotation matrix of a quaternion in signed normalized components.
+inline matrix_float3x3 unpack_rotation(vector_short4 packed) {
+    return quaternion_matrix(packed.x, packed.y, packed.z, packed.w);
+}
+
+inline Transform unpack_transform(vector_short4 rotation, float3 translation) {
+    Transform t;
+    t.rotation = unpack_rotation(rotation);
+    t.translation = translation;
+    return t;
+}
+
 class Sphere::HitEnumerator {
     Sphere _sphere;
     Ray3D _ray;
@@ -39,7 +62,7 @@ public:
         // (ray.direction * t + (ray.origin - C)) • (ray.direction * t + (ray.origin - C)) = radius²
         // (ray.direction * t + (ray.origin - C)) • (ray.direction * t + (ray.origin - C)) = radius²
         // t² * ray.direction • ray.direction + t * (2 * ray.direction • (ray.origin - C)) + (ray.origin - C) • (ray.origin - C) - radius² = 0
-        float3 oc = _ray.origin - _sphere.transform.translation;
+        float3 oc = _ray.origin - _sphere.center;
         float a = dot(ray.direction, ray.direction);
         float b_2 = dot(ray.direction, oc);
         float c = dot(oc, oc) - _sphere.radius * _sphere.radius;
@@ -57,6 +80,7 @@ public:
 
     bool hasNext() const { return _index < 2; }
     void move() { _index++; }
+    uint steps() const { return 0; }
 
     bool isExit() const { return _index == 1; }
 
@@ -70,36 +94,42 @@ public:
     }
 
     float3 normal() const {
-        return (point() - _sphere.transform.translation) / _sphere.radius;
+        return (point() - _sphere.center) / _sphere.radius;
     }
 
-    size_t material_offset() const {
-        return _sphere.material_offset;
+    MaterialHandle material() const {
+        return _sphere.material;
     }
 
     float2 texture_coordinates() const {
-        float3 n = transpose(_sphere.transform.rotation) * normal();
+        // Rotation is needed only here, so it is not unpacked for every candidate hit
+        float3 n = transpose(unpack_rotation(_sphere.rotation)) * normal();
         float2 result;
         result.x = (atan2(n.z, -n.x) + M_PI_F) / (2 * M_PI_F);
         result.y = acos(-n.y) / M_PI_F;
         return result;
     }
+
+    float texture_scale() const {
+        // Along meridians, parallels are shorter and have a finer scale
+        return 1 / (M_PI_F * _sphere.radius);
+    }
 };
 
 class Cylinder::HitEnumerator {
     struct Hit {
         float t;
         float3 normal;
-        size_t material_offset;
+        MaterialHandle material;
         float2 texture_coordinates;
+        float texture_scale;
     };
 
-    Cylinder _cylinder;
     Ray3D _ray;
     Hit _hit[2];
     int _index;
 
-    static void hit_plane(Cylinder cylinder, Ray3D local_ray, thread Hit & planeIn, thread Hit & planeOut) {
+    static void hit_plane(Cylinder cylinder, matrix_float3x3 rotation, Ray3D local_ray, thread Hit & planeIn, thread Hit & planeOut) {
         float denom = local_ray.direction.y; // dot((0,1,0),_local_ray.direction);
         float tb, tt;
         bool has_solutions;
@@ -111,14 +141,16 @@ class Cylinder::HitEnumerator {
         }
         if (has_solutions) {
             planeIn.t = tb;
-            planeIn.normal = -cylinder.transform.rotation.columns[1];
-            planeIn.material_offset = cylinder.bottom_material_offset;
+            planeIn.normal = -rotation.columns[1];
+            planeIn.material = cylinder.bottom_material;
             planeIn.texture_coordinates = plane_texture_coordinates(local_ray.at(tb), cylinder.radius, -1);
+            planeIn.texture_scale = 1 / (2 * cylinder.radius);
 
             planeOut.t = tt;
-            planeOut.normal = +cylinder.transform.rotation.columns[1];
-            planeOut.material_offset = cylinder.top_material_offset;
+            planeOut.normal = +rotation.columns[1];
+            planeOut.material = cylinder.top_material;
             planeOut.texture_coordinates = plane_texture_coordinates(local_ray.at(tt), cylinder.radius, +1);
+            planeOut.texture_scale = 1 / (2 * cylinder.radius);
 
             if (planeIn.t > planeOut.t) {
                 Hit tmp = planeIn;
@@ -145,7 +177,7 @@ class Cylinder::HitEnumerator {
         return result;
     }
 
-    static void hit_tube(Cylinder cylinder, Ray3D local_ray, thread Hit & tubeIn, thread Hit & tubeOut) {
+    static void hit_tube(Cylinder cylinder, matrix_float3x3 rotation, Ray3D local_ray, thread Hit & tubeIn, thread Hit & tubeOut) {
         // let ob = ray.origin - .zero
         // let ot = ray.origin - (0, height, 0)
         // let d = ray.direction
@@ -179,14 +211,16 @@ class Cylinder::HitEnumerator {
             float3 lp2 = local_ray.at(t2);
 
             tubeIn.t = t1;
-            tubeIn.normal = cylinder.transform.rotation * ((float3){lp1.x, 0, lp1.z} / cylinder.radius);
-            tubeIn.material_offset = cylinder.side_material_offset;
+            tubeIn.normal = rotation * ((float3){lp1.x, 0, lp1.z} / cylinder.radius);
+            tubeIn.material = cylinder.side_material;
             tubeIn.texture_coordinates = tube_texture_coordinates(lp1, cylinder.height);
+            tubeIn.texture_scale = tube_texture_scale(cylinder);
 
             tubeOut.t = t2;
-            tubeOut.normal = cylinder.transform.rotation * ((float3){lp2.x, 0, lp2.z} / cylinder.radius);
-            tubeOut.material_offset = cylinder.side_material_offset;
+            tubeOut.normal = rotation * ((float3){lp2.x, 0, lp2.z} / cylinder.radius);
+            tubeOut.material = cylinder.side_material;
             tubeOut.texture_coordinates = tube_texture_coordinates(lp2, cylinder.height);
+            tubeOut.texture_scale = tube_texture_scale(cylinder);
         } else {
             if (length_squared(local_ray.origin.xz) > cylinder.radius * cylinder.radius) {
                 // Ray is outside of the side tube
@@ -206,18 +240,23 @@ class Cylinder::HitEnumerator {
         result.y = local_point.y / height;
         return result;
     }
+
+    static float tube_texture_scale(Cylinder cylinder) {
+        return max(1 / (2 * M_PI_F * cylinder.radius), 1 / cylinder.height);
+    }
 public:
     HitEnumerator(Cylinder cylinder, Ray3D ray)
-        : _cylinder(cylinder), _ray(ray)
+        : _ray(ray)
     {
-        Ray3D local_ray = inverse_transform(ray, cylinder.transform);
+        Transform transform = unpack_transform(cylinder.rotation, cylinder.translation);
+        Ray3D local_ray = inverse_transform(ray, transform);
 
         Hit planeIn, planeOut;
-        hit_plane(cylinder, local_ray, planeIn, planeOut);
+        hit_plane(cylinder, transform.rotation, local_ray, planeIn, planeOut);
 
         // Hit testing side tube
         Hit tubeIn, tubeOut;
-        hit_tube(cylinder, local_ray, tubeIn, tubeOut);
+        hit_tube(cylinder, transform.rotation, local_ray, tubeIn, tubeOut);
 
         _hit[0] = planeIn.t > tubeIn.t ? planeIn : tubeIn;
         _hit[1] = planeOut.t < tubeOut.t ? planeOut : tubeOut;
@@ -226,6 +265,7 @@ public:
 
     bool hasNext() const { return _index < 2; }
     void move() { _index++; }
+    uint steps() const { return 0; }
 
     bool isExit() const { return _index == 1; }
 
@@ -243,15 +283,20 @@ public:
         return _hit[_index].normal;
     }
 
-    size_t material_offset() const {
+    MaterialHandle material() const {
         assert(hasNext());
-        return _hit[_index].material_offset;
+        return _hit[_index].material;
     }
 
     float2 texture_coordinates() const {
         assert(hasNext());
         return _hit[_index].texture_coordinates;
     }
+
+    float texture_scale() const {
+        assert(hasNext());
+        return _hit[_index].texture_scale;
+    }
 };
 
 class Cuboid::HitEnumerator {
@@ -317,16 +362,17 @@ public:
     HitEnumerator(Cuboid cuboid, Ray3D ray)
         : _cuboid(cuboid), _ray(ray)
     {
-        Ray3D local_ray = inverse_transform(ray, cuboid.transform);
+        Transform transform = unpack_transform(cuboid.rotation, cuboid.translation);
+        Ray3D local_ray = inverse_transform(ray, transform);
 
         Hit xIn, xOut;
-        hit_plane(cuboid.size.x, local_ray.origin.x, local_ray.direction.x, cuboid.transform.rotation.columns[0], 0, xIn, xOut);
+        hit_plane(cuboid.size.x, local_ray.origin.x, local_ray.direction.x, transform.rotation.columns[0], 0, xIn, xOut);
 
         Hit yIn, yOut;
-        hit_plane(cuboid.size.y, local_ray.origin.y, local_ray.direction.y, cuboid.transform.rotation.columns[1], 1, yIn, yOut);
+        hit_plane(cuboid.size.y, local_ray.origin.y, local_ray.direction.y, transform.rotation.columns[1], 1, yIn, yOut);
 
         Hit zIn, zOut;
-        hit_plane(cuboid.size.z, local_ray.origin.z, local_ray.direction.z, cuboid.transform.rotation.columns[2], 2, zIn, zOut);
+        hit_plane(cuboid.size.z, local_ray.origin.z, local_ray.direction.z, transform.rotation.columns[2], 2, zIn, zOut);
 
         _hit[0] = xIn.t > yIn.t ? (xIn.t > zIn.t ? xIn : zIn) : (yIn.t > zIn.t ? yIn : zIn);
         _hit[1] = xOut.t < yOut.t ? (xOut.t < zOut.t ? xOut : zOut) : (yOut.t < zOut.t ? yOut : zOut);
@@ -335,6 +381,7 @@ public:
 
     bool hasNext() const { return _index < 2; }
     void move() { _index++; }
+    uint steps() const { return 0; }
 
     bool isExit() const { return _index == 1; }
 
@@ -352,14 +399,14 @@ public:
         return _hit[_index].normal;
     }
 
-    size_t material_offset() const {
+    MaterialHandle material() const {
         assert(hasNext());
-        return _cuboid.material_offset[_hit[_index].face];
+        return _cuboid.material[_hit[_index].face];
     }
 
     float2 texture_coordinates() const {
         float3 p = point();
-        float3 local_p = inverse_transform_point(p, _cuboid.transform) / _cuboid.size;
+        float3 local_p = inverse_transform_point(p, unpack_transform(_cuboid.rotation, _cuboid.translation)) / _cuboid.size;
         Face face = _hit[_index].face;
         float2 result;
         switch (face) {
@@ -390,6 +437,27 @@ public:
         }
         return result;
     }
+
+    float texture_scale() const {
+        // Faces are mapped to the unit square, use the shorter side
+        float3 size = _cuboid.size;
+        float side;
+        switch (_hit[_index].face) {
+        case left:
+        case right:
+            side = min(size.y, size.z);
+            break;
+        case front:
+        case back:
+            side = min(size.x, size.y);
+            break;
+        case top:
+        case bottom:
+            side = min(size.x, size.z);
+            break;
+        }
+        return 1 / side;
+    }
 };
 
 class Quad::HitEnumerator {
@@ -398,16 +466,17 @@ class Quad::HitEnumerator {
     float3 _point;
     float3 _normal;
     float2 _texture_coordinates;
-    size_t _material_offset;
+    float _texture_scale;
+    MaterialHandle _material;
 public:
     HitEnumerator(Quad object, Ray3D ray)
     {
-        float denom = dot(ray.direction, object.normal);
+        float denom = dot(ray.direction, object.w);
         float t;
         bool has_solutions;
         {
 #pragma METAL fp math_mode(safe)
-            t = (object.d - dot(ray.origin, object.normal)) / denom;
+            t = (object.d - dot(ray.origin, object.w)) / denom;
             has_solutions = isfinite(t);
         }
         if (has_solutions) {
@@ -416,14 +485,17 @@ public:
             _hit[1] = denom < 0 ? +INFINITY : t;
 
             _point = ray.at(t);
-            _normal = object.normal;
+            // |w| is inverse of the area, scale is inverse of the side of a square with the same area
+            float w_length = length(object.w);
+            _normal = object.w / w_length;
+            _texture_scale = sqrt(w_length);
             float3 p = _point - object.origin;
             // p = α * u + β * v
             // w • (p ⨯ v) = w • (α * (u ⨯ v) + β * (v ⨯ v)) = α * (n / |n|²) • n = α
             // w • (u ⨯ p) = w • (α * (u ⨯ u) + β * (u ⨯ v)) = β * (n / |n|²) • n = β
             _texture_coordinates.x = dot(object.w, cross(p, object.v));
             _texture_coordinates.y = dot(object.w, cross(object.u, p));
-            _material_offset = object.material_offset;
+            _material = object.material;
 
             if (_texture_coordinates.x < 0 || _texture_coordinates.x > 1 || _texture_coordinates.y < 0 || _texture_coordinates.y > 1) {
                 _index = 2;
@@ -437,6 +509,7 @@ public:
 
     bool hasNext() const { return _index < 2; }
     void move() { _index++; }
+    uint steps() const { return 0; }
 
     bool isExit() const { return _index == 1; }
 
@@ -455,15 +528,20 @@ public:
         return _normal;
     }
 
-    size_t material_offset() const {
+    MaterialHandle material() const {
         assert(isfinite(t()));
-        return _material_offset;
+        return _material;
     }
 
     float2 texture_coordinates() const {
         assert(isfinite(t()));
         return _texture_coordinates;
     }
+
+    float texture_scale() const {
+        assert(isfinite(t()));
+        return _texture_scale;
+    }
 };
 
 template<class... T> struct tuple;
@@ -557,6 +635,15 @@ bool anyHasNext(thread tuple<H, T...> const & children) {
     return anyHasNext(children.get_tail());
 }
 
+uint sumSteps(thread tuple<> const & children) {
+    return 0;
+}
+
+template<class H, class... T>
+uint sumSteps(thread tuple<H, T...> const & children) {
+    return children.head.steps() + sumSteps(children.get_tail());
+}
+
 template<class F, class H, class... T>
 typename F::result withSelectedChild(F f, size_t selected_index, size_t current_index, thread tuple<H, T...> & children) {
     if (selected_index == current_index) {
@@ -625,11 +712,11 @@ struct GetNormal {
 };
 
 struct GetMaterial {
-    typedef size_t result;
+    typedef uint32_t result;
 
     template<class E>
     result operator()(thread E const & e) const {
-        return e.material_offset();
+        return e.material();
     }
 };
 
@@ -642,6 +729,15 @@ struct GetTextureCoordinates {
     }
 };
 
+struct GetTextureScale {
+    typedef float result;
+
+    template<class E>
+    result operator()(thread E const & e) const {
+        return e.texture_scale();
+    }
+};
+
 struct GetHitEnumerator {
     Ray3D _ray;
 
@@ -659,6 +755,7 @@ template<int min_count, bool subtract, class... T>
 class Composition<min_count, subtract, T...>::HitEnumerator {
     tuple<typename T::HitEnumerator...> _children;
     int _depth;
+    uint _steps;
     composition_impl::NearestChild _currentChild;
 
     void chooseChild() {
@@ -686,6 +783,7 @@ class Composition<min_count, subtract, T...>::HitEnumerator {
             }
             bool isInside = (_depth >= min_count);
             if (isInside != wasInside) break;
+            _steps++;
             withSelectedChild(composition_impl::Move());
         }
     }
@@ -697,6 +795,7 @@ public:
     HitEnumerator(Composition<min_count, subtract, T...> object, Ray3D ray) : _children(composition_impl::GetHitEnumerator(ray), object._items)
     {
         _depth = 0;
+        _steps = 0;
         scanDepth();
     }
 
@@ -705,13 +804,15 @@ public:
         withSelectedChild(composition_impl::Move());
         scanDepth();
     }
+    uint steps() const { return _steps + composition_impl::sumSteps(_children); }
 
     bool isExit() const { return withSelectedChild(composition_impl::IsExit()) != shouldSwap(); }
     float t() const { return withSelectedChild(composition_impl::GetT()); }
     float3 point() const { return withSelectedChild(composition_impl::GetPoint()); }
     float3 normal() const { return withSelectedChild(composition_impl::GetNormal()) * (shouldSwap() ? -1 : +1); }
-    size_t material_offset() const { return withSelectedChild(composition_impl::GetMaterial()); }
+    MaterialHandle material() const { return withSelectedChild(composition_impl::GetMaterial()); }
     float2 texture_coordinates() const { return withSelectedChild(composition_impl::GetTextureCoordinates()); }
+    float texture_scale() const { return withSelectedChild(composition_impl::GetTextureScale()); }
 };
 
 template<class Impl>
@@ -730,6 +831,7 @@ class ConstantDensityVolume<Impl>::HitEnumerator {
     Ray3D _ray;
     thread RNG *_rng;
     float _neg_inv_density;
+    uint _steps = 0;
     bool _exit;
     float _t;
     HitInfo _hit;
@@ -742,10 +844,12 @@ class ConstantDensityVolume<Impl>::HitEnumerator {
             }
             assert(!_impl.isExit());
             float t1 = max(0.0f, _impl.t());
-            size_t material = _impl.material_offset();
+            MaterialHandle material = _impl.material();
             float2 tex = _impl.texture_coordinates();
+            float tex_scale = _impl.texture_scale();
 
             _impl.move();
+            _steps++;
             float t2;
             if (_impl.hasNext()) {
                 assert(_impl.isExit());
@@ -762,13 +866,15 @@ class ConstantDensityVolume<Impl>::HitEnumerator {
                     _hit.point = _ray.at(t);
                     _hit.normal = -_ray.direction;
                     _hit.face = face::front;
-                    _hit.material_offset = material;
+                    _hit.material = material;
                     _hit.texture_coordinates = tex;
+                    _hit.texture_scale = tex_scale;
                     break;
                 }
             }
             if (_impl.hasNext()) {
                 _impl.move();
+                _steps++;
             } else {
                 _exit = true;
                 break;
@@ -790,6 +896,198 @@ public:
             _exit = true;
         }
     }
+    uint steps() const { return _steps + _impl.steps(); }
+
+    bool isExit() const { return _exit; }
+    float t() const {
+        return _exit ? _impl.t() : _t;
+    }
+    float3 point() const { return _exit ? _impl.point() : _hit.point; }
+    float3 normal() const { return _exit ? _impl.normal() : _hit.normal; }
+    MaterialHandle material() const { return _exit ? _impl.material() : _hit.material; }
+    float2 texture_coordinates() const { return _exit ? _impl.texture_coordinates() : _hit.texture_coordinates; }
+    float texture_scale() const { return _exit ? _impl.texture_scale() : _hit.texture_scale; }
+};
+
+/// Trilinear interpolation between voxel centers, clamped at the boundary of the grid.
+inline float density_at(device DensityGrid const & grid, float3 point) {
+    enum { N = DensityGrid::DENSITY_GRID_RESOLUTION };
+    float3 g = (point - grid.bounds_min) / (grid.bounds_max - grid.bounds_min) * float(N) - 0.5f;
+    int i0[3];
+    float f[3];
+    for (int a = 0; a < 3; a++) {
+        float x = min(max(g[a], 0.0f), float(N - 1));
+        i0[a] = min(int(x), N - 2);
+        f[a] = x - float(i0[a]);
+    }
+    float c[2][2];
+    for (int dz = 0; dz < 2; dz++) {
+        for (int dy = 0; dy < 2; dy++) {
+            device uint8_t const *row = grid.voxels[i0[2] + dz][i0[1] + dy];
+            c[dz][dy] = row[i0[0]] + (row[i0[0] + 1] - row[i0[0]]) * f[0];
+        }
+    }
+    float c0 = c[0][0] + (c[0][1] - c[0][0]) * f[1];
+    float c1 = c[1][0] + (c[1][1] - c[1][0]) * f[1];
+    return (c0 + (c1 - c0) * f[2]) * (grid.density_scale / 255);
+}
+
+template<class Impl>
+class HeterogeneousVolume {
+    Impl _impl;
+    DensityGrid _grid;
+public:
+    HeterogeneousVolume(Impl impl, DensityGrid grid): _impl(impl), _grid(grid) {}
+
+    class HitEnumerator;
+};
+
+/// Same as `ConstantDensityVolume<Impl>::HitEnumerator`, but samples collisions by delta tracking:
+/// tentative collisions are sampled with the majorant of the current block of the grid,
+/// and accepted with probability of density divided by the majorant.
+/// Blocks are walked by a 3D DDA, so empty ones are skipped without sampling.
+template<class Impl>
+class HeterogeneousVolume<Impl>::HitEnumerator {
+    typename Impl::HitEnumerator _impl;
+    // Grid is too large to be copied into thread memory
+    device DensityGrid const *_grid;
+    Ray3D _ray;
+    thread RNG *_rng;
+    uint _steps = 0;
+    bool _exit;
+    float _t;
+    HitInfo _hit;
+
+    /// Samples collision within [t1, t2], returns false if the ray passes through.
+    bool track(float t1, float t2, thread float & collision) {
+        enum { M = DensityGrid::DENSITY_GRID_MAJORANT_RESOLUTION };
+        device DensityGrid const & grid = *_grid;
+        // Ray in coordinates of majorant blocks, t is the same
+        float3 size = grid.bounds_max - grid.bounds_min;
+        float3 o = (_ray.origin - grid.bounds_min) / size * float(M);
+        float3 d = _ray.direction / size * float(M);
+
+        for (int a = 0; a < 3; a++) {
+            if (d[a] != 0) {
+                float ta = -o[a] / d[a];
+                float tb = (M - o[a]) / d[a];
+                t1 = max(t1, min(ta, tb));
+                t2 = min(t2, max(ta, tb));
+            } else if (o[a] < 0 || o[a] > M) {
+                return false;
+            }
+        }
+        if (!(t1 < t2)) {
+            return false;
+        }
+
+        int cell[3], step[3];
+        float t_next[3], t_delta[3];
+        for (int a = 0; a < 3; a++) {
+            float p = o[a] + d[a] * t1;
+            cell[a] = min(max(int(floor(p)), 0), M - 1);
+            if (d[a] > 0) {
+                step[a] = 1;
+                t_next[a] = (cell[a] + 1 - o[a]) / d[a];
+                t_delta[a] = 1 / d[a];
+            } else if (d[a] < 0) {
+                step[a] = -1;
+                t_next[a] = (cell[a] - o[a]) / d[a];
+                t_delta[a] = -1 / d[a];
+            } else {
+                step[a] = 0;
+                t_next[a] = INFINITY;
+                t_delta[a] = INFINITY;
+            }
+        }
+
+        float t = t1;
+        while (t < t2) {
+            int axis = t_next[0] < t_next[1] ? (t_next[0] < t_next[2] ? 0 : 2) : (t_next[1] < t_next[2] ? 1 : 2);
+            float t_end = min(t_next[axis], t2);
+            float majorant = grid.majorants[cell[2]][cell[1]][cell[0]];
+            if (majorant > 0) {
+                while (true) {
+                    t -= log(1 - _rng->random_f()) / majorant;
+                    if (t >= t_end) {
+                        break;
+                    }
+                    if (_rng->random_f() * majorant < density_at(grid, _ray.at(t))) {
+                        collision = t;
+                        return true;
+                    }
+                }
+            }
+            // Free flight is memoryless, so sampling restarts at the boundary of the next block
+            t = t_end;
+            cell[axis] += step[axis];
+            if (cell[axis] < 0 || cell[axis] >= M) {
+                break;
+            }
+            t_next[axis] += t_delta[axis];
+        }
+        return false;
+    }
+
+    void scan() {
+        while (true) {
+            if (!_impl.hasNext()) {
+                _exit = true;
+                break;
+            }
+            assert(!_impl.isExit());
+            float t1 = max(0.0f, _impl.t());
+            MaterialHandle material = _impl.material();
+            float2 tex = _impl.texture_coordinates();
+            float tex_scale = _impl.texture_scale();
+
+            _impl.move();
+            _steps++;
+            float t2;
+            if (_impl.hasNext()) {
+                assert(_impl.isExit());
+                t2 = _impl.t();
+            } else {
+                t2 = +INFINITY;
+            }
+
+            float t;
+            if (t1 < t2 && track(t1, t2, t)) {
+                _exit = false;
+                _t = t;
+                _hit.point = _ray.at(t);
+                _hit.normal = -_ray.direction;
+                _hit.face = face::front;
+                _hit.material = material;
+                _hit.texture_coordinates = tex;
+                _hit.texture_scale = tex_scale;
+                break;
+            }
+            if (_impl.hasNext()) {
+                _impl.move();
+                _steps++;
+            } else {
+                _exit = true;
+                break;
+            }
+        }
+    }
+public:
+    HitEnumerator(device HeterogeneousVolume<Impl> const & object, Ray3D ray, thread RNG* rng) : _impl(object._impl, ray), _grid(&object._grid), _ray(ray), _rng(rng)
+    {
+        scan();
+    }
+
+    bool hasNext() const { return !_exit || _impl.hasNext(); }
+    void move() {
+        if (_exit) {
+            _impl.move();
+            scan();
+        } else {
+            _exit = true;
+        }
+    }
+    uint steps() const { return _steps + _impl.steps(); }
 
     bool isExit() const { return _exit; }
     float t() const {
@@ -797,9 +1095,102 @@ public:
     }
     float3 point() const { return _exit ? _impl.point() : _hit.point; }
     float3 normal() const { return _exit ? _impl.normal() : _hit.normal; }
-    size_t material_offset() const { return _exit ? _impl.material_offset() : _hit.material_offset; }
+    MaterialHandle material() const { return _exit ? _impl.material() : _hit.material; }
     float2 texture_coordinates() const { return _exit ? _impl.texture_coordinates() : _hit.texture_coordinates; }
+    float texture_scale() const { return _exit ? _impl.texture_scale() : _hit.texture_scale; }
+};
+
+/// Transform of a moving object at `time`, interpolated between the two nearest keyframes.
+/// Quaternions are interpolated linearly, and normalized by `quaternion_matrix()`.
+inline Transform motion_transform(Motion motion, float time) {
+    float x = clamp(time, 0.0f, 1.0f) * (motion.keyframe_count - 1);
+    uint i = min(uint(x), motion.keyframe_count - 2);
+    float f = x - i;
+    vector_short4 a = motion.rotation[i];
+    vector_short4 b = motion.rotation[i + 1];
+    // q and -q are the same rotation, take the shorter arc
+    float sign = float(a.x) * b.x + float(a.y) * b.y + float(a.z) * b.z + float(a.w) * b.w < 0 ? -1 : 1;
+    Transform result;
+    result.rotation = quaternion_matrix(mix(float(a.x), sign * b.x, f), mix(float(a.y), sign * b.y, f),
+                                        mix(float(a.z), sign * b.z, f), mix(float(a.w), sign * b.w, f));
+    result.translation = mix(motion.translation[i], motion.translation[i + 1], f);
+    return result;
+}
+
+/// Rigid motion of `Impl` over the shutter interval.
+/// `Impl` is given in its own coordinates, and is moved into the world by the transform at the time of the ray.
+template<class Impl>
+class Moving {
+    Impl _impl;
+    Motion _motion;
+public:
+    Moving(Impl impl, Motion motion): _impl(impl), _motion(motion) {}
+
+    class HitEnumerator;
+};
+
+template<class Impl>
+class Moving<Impl>::HitEnumerator {
+    Transform _transform;
+    Ray3D _ray;
+    typename Impl::HitEnumerator _impl;
+public:
+    // Transform is rigid, so t is the same for the local ray
+    HitEnumerator(Moving<Impl> object, Ray3D ray)
+        : _transform(motion_transform(object._motion, ray.time)), _ray(ray), _impl(object._impl, inverse_transform(ray, _transform))
+    {}
+
+    bool hasNext() const { return _impl.hasNext(); }
+    void move() { _impl.move(); }
+    uint steps() const { return _impl.steps(); }
+
+    bool isExit() const { return _impl.isExit(); }
+    float t() const { return _impl.t(); }
+    float3 point() const { return _ray.at(t()); }
+    float3 normal() const { return _transform.rotation * _impl.normal(); }
+    MaterialHandle material() const { return _impl.material(); }
+    float2 texture_coordinates() const { return _impl.texture_coordinates(); }
+    float texture_scale() const { return _impl.texture_scale(); }
 };
 
+template<class T>
+auto get_hit_enumerator(device T const & object, Ray3D ray, thread RNG * rng) -> decltype(typename T::HitEnumerator(object, ray)) {
+    return typename T::HitEnumerator(object, ray);
+}
+
+template<class T>
+auto get_hit_enumerator(device T const & object, Ray3D ray, thread RNG * rng) -> decltype(typename T::HitEnumerator(object, ray, rng)) {
+    return typename T::HitEnumerator(object, ray, rng);
+}
+
+/// Advances `e` to the first hit within [min_distance, max_distance] and describes it in `hit`.
+/// Shared by the intersection functions and the CPU benchmarks, so both measure the same code.
+/// Adds number of examined hits to `steps`, including hits of CSG children and volume boundaries skipped by `e`.
+template<class E>
+bool find_first_hit(thread E & e, float3 direction, float min_distance, float max_distance, thread HitInfo & hit, thread float & distance, thread uint & steps) {
+    bool found = false;
+    for (; e.hasNext(); e.move()) {
+        steps++;
+        // TODO: Should it be multiplied by vector length?
+        float t = e.t();
+        bool matches_distance;
+        {
+#pragma METAL fp math_mode(safe)
+            matches_distance = t >= min_distance && t <= max_distance;
+        }
+        if (matches_distance) {
+            hit.point = e.point();
+            hit.set_normal(e.normal(), direction);
+            hit.material = e.material();
+            hit.texture_coordinates = e.texture_coordinates();
+            hit.texture_scale = e.texture_scale();
+            distance = t;
+            found = true;
+            break;
+        }
+    }
+    steps += e.steps();
+    return found;
+}
 
 #endif // RENDERABLE_IMPL_H
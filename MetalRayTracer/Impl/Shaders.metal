@@ -8,9 +8,27 @@
 #include <metal_stdlib>
 #include <metal_raytracing>
 #include "../Types.h"
+
+// Specialization for the scene, see `kernel_function_constants`. Pipelines created without constants support everything.
+constant uint material_kinds_constant [[function_constant(kernel_function_constant_material_kinds)]];
+constant uint enabled_material_kinds = is_function_constant_defined(material_kinds_constant) ? material_kinds_constant : ~0u;
+constant bool environment_constant [[function_constant(kernel_function_constant_environment)]];
+constant bool has_environment = is_function_constant_defined(environment_constant) ? environment_constant : true;
+constant bool photons_constant [[function_constant(kernel_function_constant_photons)]];
+constant bool has_photons = is_function_constant_defined(photons_constant) ? photons_constant : true;
+constant bool guiding_constant [[function_constant(kernel_function_constant_guiding)]];
+constant bool has_guiding = is_function_constant_defined(guiding_constant) ? guiding_constant : true;
+constant bool cost_constant [[function_constant(kernel_function_constant_cost)]];
+constant bool measure_cost = is_function_constant_defined(cost_constant) ? cost_constant : true;
+#define ENABLED_MATERIAL_KINDS enabled_material_kinds
+
 #include "RNG.h"
 #include "MaterialsImpl.h"
 #include "RenderableImpl.h"
+#include "StatisticsImpl.h"
+#include "EnvironmentImpl.h"
+#include "PhotonMapImpl.h"
+#include "GuidingImpl.h"
 
 struct BoundingBoxResult {
     bool accept [[accept_intersection]];
@@ -23,6 +41,8 @@ class Camera {
     float3 viewport_u;
     float3 viewport_v;
     float3 viewport_center;
+    float3 forward;
+    float focus_distance;
 
     float3 defocus_u;
     float3 defocus_v;
@@ -41,16 +61,24 @@ public:
         viewport_u = viewport_width * u;
         viewport_v = -viewport_height * v;
         viewport_center = config.look_from - config.focus_distance * w;
+        forward = -w;
+        focus_distance = config.focus_distance;
 
         float defocus_radius = config.focus_distance * tan(config.defocus_angle * M_PI_F / 360);
         defocus_u = u * defocus_radius;
         defocus_v = v * defocus_radius;
     }
 
+    /// Time is uniform over the shutter interval, and is shared by the whole path.
     Ray3D get_ray(uint2 grid_index, thread RNG* rng) const {
         float3 origin = get_ray_origin(rng);
         float3 pixel_sample = get_pixel_sample(grid_index, rng);
-        return Ray3D(origin, normalize(pixel_sample - origin));
+        return Ray3D(origin, normalize(pixel_sample - origin), rng->random_f());
+    }
+
+    /// Cone of a pixel at the center of the image, the lens is treated as a pinhole.
+    RayCone get_ray_cone() const {
+        return { 0, length(viewport_v) / (image_size.y * focus_distance) };
     }
 
     float3 get_pixel_sample(uint2 grid_index, thread RNG* rng) const {
@@ -65,16 +93,35 @@ public:
         float2 p = rng->random_unit_vector_2d();
         return camera_center + p.x * defocus_u + p.y * defocus_v;
     }
+
+    /// Continuous pixel coordinates of a point, i.e. pixel centers are at half-integers.
+    /// Returns false if the point is behind the camera.
+    bool project(float3 point, thread float2 & pixel) const {
+        float3 d = point - camera_center;
+        float z = dot(d, forward);
+        if (z <= 0) {
+            return false;
+        }
+        float3 q = camera_center + d * (focus_distance / z) - viewport_center;
+        float2 s = float2(dot(q, viewport_u) / length_squared(viewport_u), dot(q, viewport_v) / length_squared(viewport_v));
+        pixel = (s + 0.5) * image_size;
+        return true;
+    }
 };
 
+// Acceleration structures built without motion are traversed by the same intersector, ignoring time
 struct world {
-    primitive_acceleration_structure acceleration_structure;
-    intersection_function_table<triangle_data> function_table;
+    acceleration_structure<primitive_motion> acceleration_structure;
+    intersection_function_table<triangle_data, primitive_motion> function_table;
     BackgroundLighting background_lighting;
+    Environment environment;
+    bool sample_environment;
+    PhotonMap photon_map;
+    GuidingField guiding;
 };
 
-float3 background_color(BackgroundLighting mode, float3 direction) {
-    switch (mode) {
+float3 background_color(world w, float3 direction) {
+    switch (w.background_lighting) {
         case background_lighting_none: {
             return float3(0, 0, 0);
         }
@@ -82,37 +129,213 @@ float3 background_color(BackgroundLighting mode, float3 direction) {
             auto a = 0.5 * direction.y + 1.0;
             return (1.0-a) * float3(1.0, 1.0, 1.0) + a * float3(0.5, 0.7, 1.0);
         }
+        case background_lighting_environment: {
+            return has_environment ? w.environment.radiance(direction) : 0;
+        }
     }
 }
 
+/// Work done for a pixel, shown by heatmap output modes.
+/// Rays are always counted, intersection tests and enumerator steps only if `measure_cost` is set.
+struct PathCost {
+    uint rays;
+    uint intersection_tests;
+    uint enumerator_steps;
+};
+
 struct Payload {
     RNG rng;
     HitInfo hit;
+    uint intersection_tests;
+    uint enumerator_steps;
+    STATISTICS(IntersectionStatistics statistics;)
+};
+
+// Black - blue - cyan - green - yellow - red - white
+constant float3 heatmap_stops[] = {
+    float3(0, 0, 0),
+    float3(0, 0, 1),
+    float3(0, 1, 1),
+    float3(0, 1, 0),
+    float3(1, 1, 0),
+    float3(1, 0, 0),
+    float3(1, 1, 1),
+};
+
+float3 heatmap_color(float value) {
+    float x = saturate(value) * 6;
+    uint i = min(uint(x), 5u);
+    return mix(heatmap_stops[i], heatmap_stops[i + 1], x - i);
+}
+
+/// Caustic photons found by the camera path of a sample, see `PhotonMapConfig`.
+struct PhotonGather {
+    /// Gather radius of the pixel, set at the first gather if it is 0.
+    float radius;
+    /// Flux reflected towards the camera, times throughput of the camera path.
+    float3 flux;
+    uint count;
 };
 
-float3 get_ray_color(ray r, world w, constant uchar const * meterials, thread RNG *rng, uint max_depth) {
+/// Environment light reaching `hit` from a direction sampled from the environment map, through a shadow ray,
+/// weighted against the material of `kind` sampling the same direction, mixed with the guiding field
+/// if `guiding_root` is the directional tree the bounce samples from, see `GuidingField`.
+float3 sample_environment(world w, HitInfo hit, MaterialKind kind, float time, int guiding_root, thread RNG *rng, thread PathCost & cost
+                          STATISTICS(, thread RenderStatistics & statistics)) {
+    float light_pdf;
+    float3 direction = w.environment.sample(rng, light_pdf);
+    float bsdf_pdf;
+    if (light_pdf <= 0 || !diffuse_pdf(kind, hit, direction, bsdf_pdf) || bsdf_pdf <= 0) {
+        return 0;
+    }
+    float sampling_pdf = bsdf_pdf;
+    if (has_guiding && guiding_root >= 0) {
+        float fraction = w.guiding.config->bsdf_fraction;
+        sampling_pdf = fraction * bsdf_pdf + (1 - fraction) * w.guiding.pdf(guiding_root, direction);
+    }
+    intersector<triangle_data, primitive_motion> intersector;
+    intersector.accept_any_intersection(true);
+    Payload payload = { *rng };
+    cost.rays++;
+    STATISTICS(statistics.rays[statistics_ray_shadow]++;)
+    STATISTICS(payload.statistics = statistics.intersections;)
+    intersection_result<triangle_data> intersection = intersector.intersect(ray(hit.point, direction, 0.0001), w.acceleration_structure, time, w.function_table, payload);
+    *rng = payload.rng;
+    if (measure_cost) {
+        cost.intersection_tests += payload.intersection_tests;
+        cost.enumerator_steps += payload.enumerator_steps;
+    }
+    STATISTICS(statistics.intersections = payload.statistics;)
+    if (intersection.type != intersection_type::none) {
+        return 0;
+    }
+    return w.environment.radiance(direction) * (bsdf_pdf / light_pdf * mis_weight(light_pdf, sampling_pdf));
+}
+
+float3 get_ray_color(ray r, float time, RayCone cone, world w, constant uchar const * meterials, thread RNG *rng, uint max_depth, thread PathCost & cost,
+                     thread PixelFeatures & features, thread PhotonGather & gather, thread GuidedPath & path
+                     STATISTICS(, thread RenderStatistics & statistics)) {
+    STATISTICS(uint const initial_depth = max_depth;)
     float3 attenuation = 1;
     float3 color = 0;
+    bool first_hit = true;
+    bool environment_sampling = has_environment && w.sample_environment && w.background_lighting == background_lighting_environment;
+    // Density of sampling the current ray by the material, mixed with guiding if it was guided.
+    // 0 if the environment was not sampled at its origin
+    float bsdf_pdf = 0;
+    bool guiding = has_guiding && w.guiding.enabled();
+    bool training = guiding && w.guiding.config->training != 0;
+    path.count = 0;
+    constant PhotonMapConfig const & photon_config = *w.photon_map.config;
+    // The path can gather photons while it has only passed through dielectrics
+    bool can_gather = has_photons && photon_config.photon_count > 0;
+    // Dielectric bounces since photons were gathered, -1 if there was another bounce or no gather.
+    // Light reached after one or more of them was delivered by photons.
+    int caustic_bounces = -1;
     while (max_depth > 0) {
-        intersector<triangle_data> intersector;
+        intersector<triangle_data, primitive_motion> intersector;
         Payload payload = { *rng };
-        intersection_result<triangle_data> intersection = intersector.intersect(r, w.acceleration_structure, w.function_table, payload);
+        cost.rays++;
+        STATISTICS(statistics.rays[max_depth == initial_depth ? statistics_ray_camera : statistics_ray_bounce]++;)
+        STATISTICS(payload.statistics = statistics.intersections;)
+        intersection_result<triangle_data> intersection = intersector.intersect(r, w.acceleration_structure, time, w.function_table, payload);
         *rng = payload.rng;
+        if (measure_cost) {
+            cost.intersection_tests += payload.intersection_tests;
+            cost.enumerator_steps += payload.enumerator_steps;
+        }
+        STATISTICS(statistics.intersections = payload.statistics;)
 
         switch (intersection.type) {
             case intersection_type::none: {
-                return color + attenuation * background_color(w.background_lighting, r.direction);
+                STATISTICS(record_path_length(statistics, initial_depth - max_depth);)
+                float3 background = background_color(w, r.direction);
+                if (first_hit) {
+                    // Background is not a surface, its radiance is illumination and must not be divided out
+                    features = { float4(1, 1, 1, 0), float4(0), float4(0) };
+                }
+                if (caustic_bounces > 0 && photon_config.background_emits) {
+                    return color;
+                }
+                float weight = bsdf_pdf > 0 ? mis_weight(bsdf_pdf, w.environment.pdf(r.direction)) : 1;
+                return color + attenuation * background * weight;
             }
             case intersection_type::bounding_box: {
-                constant uchar const * material = meterials + payload.hit.material_offset;
+                MaterialKind kind = material_handle_kind(payload.hit.material);
+                STATISTICS(record_shading(statistics, kind);)
                 Ray3D old_ray(r.origin, r.direction);
                 material_result result = { 0, 0, Ray3D(0, 0) };
-                bool did_scatter = scatter(material, old_ray, payload.hit, rng, result);
-                color += attenuation * result.emitted;
+                cone.width = cone.width_at(intersection.distance);
+                bool did_scatter = scatter(meterials, payload.hit.material, old_ray, payload.hit, cone, rng, result);
+                if (first_hit) {
+                    // Emitters have no reflectance, neutral albedo keeps their radiance in the filtered illumination
+                    float3 albedo = did_scatter ? result.attenuation : float3(1);
+                    float3 position = r.origin + r.direction * intersection.distance;
+                    features = { float4(albedo, intersection.distance), float4(payload.hit.normal, float(kind)), float4(position, 1) };
+                    first_hit = false;
+                }
+                if (caustic_bounces <= 0 || photon_config.emitter_count == 0) {
+                    color += attenuation * result.emitted;
+                }
                 if (!did_scatter) {
+                    STATISTICS(record_path_length(statistics, initial_depth - max_depth);)
                     return color;
                 }
-                attenuation *= result.attenuation;
+                if (kind == material_kind_dielectric) {
+                    caustic_bounces += caustic_bounces >= 0 ? 1 : 0;
+                } else if (can_gather && is_lambertian(kind)) {
+                    if (gather.radius == 0) {
+                        gather.radius = min(photon_config.max_radius, photon_config.initial_radius_scale * cone.width);
+                    }
+                    uint count;
+                    float3 power = w.photon_map.gather(payload.hit.point, payload.hit.normal, gather.radius, count);
+                    // Lambertian BRDF is albedo / π
+                    gather.flux += attenuation * result.attenuation / M_PI_F * power;
+                    gather.count += count;
+                    caustic_bounces = 0;
+                    can_gather = false;
+                } else {
+                    can_gather = false;
+                    caustic_bounces = -1;
+                }
+                bsdf_pdf = 0;
+                float sampling_pdf;
+                bool diffuse = diffuse_pdf(kind, payload.hit, result.scattered.direction, sampling_pdf);
+                float3 weight = result.attenuation;
+                int guiding_root = -1;
+                uint guiding_leaf = 0;
+                if (guiding && diffuse) {
+                    // One-sample mixture of the material and the guiding field, weighted by the density of the mixture
+                    guiding_leaf = w.guiding.leaf_at(payload.hit.point);
+                    uint root = w.guiding.directional_root(guiding_leaf);
+                    if (w.guiding.can_sample(root)) {
+                        guiding_root = root;
+                        float fraction = w.guiding.config->bsdf_fraction;
+                        float guide_pdf;
+                        if (rng->random_f() >= fraction) {
+                            result.scattered.direction = w.guiding.sample(root, rng, guide_pdf);
+                            diffuse_pdf(kind, payload.hit, result.scattered.direction, sampling_pdf);
+                        } else {
+                            guide_pdf = w.guiding.pdf(root, result.scattered.direction);
+                        }
+                        float material_pdf = sampling_pdf;
+                        sampling_pdf = fraction * material_pdf + (1 - fraction) * guide_pdf;
+                        weight = sampling_pdf > 0 ? result.attenuation * (material_pdf / sampling_pdf) : float3(0);
+                    }
+                }
+                if (environment_sampling && diffuse) {
+                    bsdf_pdf = sampling_pdf;
+                    color += attenuation * result.attenuation * sample_environment(w, payload.hit, kind, time, guiding_root, rng, cost STATISTICS(, statistics));
+                }
+                attenuation *= weight;
+                if (all(attenuation == 0)) {
+                    // Nothing more can be collected, e.g. after a guided direction below the surface
+                    STATISTICS(record_path_length(statistics, initial_depth - max_depth);)
+                    return color;
+                }
+                if (training && diffuse && path.count < guiding_max_vertices) {
+                    path.vertices[path.count++] = { guiding_leaf, result.scattered.direction, sampling_pdf, attenuation, color };
+                }
                 r = ray(result.scattered.origin, result.scattered.direction, 0.0001);
                 max_depth--;
                 continue;
@@ -125,47 +348,413 @@ float3 get_ray_color(ray r, world w, constant uchar const * meterials, thread RN
         }
     }
     // If we've exceeded the ray bounce limit, no more light is gathered.
+    STATISTICS(statistics.paths_killed_by_max_depth++;)
+    STATISTICS(record_path_length(statistics, initial_depth);)
     return float3(0, 0, 0);
 }
 
+/// Previous accumulation of the pixel seeing the same surface as `features` from the current camera,
+/// counting as at most `max_samples`. Bilinear taps that see a different surface, judged by position and normal, are rejected.
+/// Returns empty moments if the point is disoccluded.
+PixelMoments reproject_history(PixelFeatures features, Camera history_camera, uint2 size,
+                               device PixelMoments const *history_moments, device PixelFeatures const *history_features,
+                               uint max_samples) {
+    float2 pixel;
+    // Normals of opposite samples can cancel out, and normalizing zero gives NaN, which passes no comparison
+    if (features.position.w < 0.5 || length_squared(features.normal_kind.xyz) == 0 || !history_camera.project(features.position.xyz, pixel)) {
+        return {};
+    }
+    float2 p = pixel - 0.5;
+    int2 origin = int2(floor(p));
+    float2 f = p - float2(origin);
+    float3 normal = normalize(features.normal_kind.xyz);
+    float tolerance = 0.02 * features.albedo_depth.w;
+
+    float weight_sum = 0;
+    float3 mean = 0;
+    float3 variance = 0;
+    float count = 0;
+    for (int i = 0; i < 4; i++) {
+        int2 tap = origin + int2(i & 1, i >> 1);
+        if (any(tap < 0) || any(tap >= int2(size))) {
+            continue;
+        }
+        uint index = tap.y * size.x + tap.x;
+        PixelFeatures h = history_features[index];
+        // History pixels that missed have zero normals
+        if (h.position.w < 0.5 || length_squared(h.normal_kind.xyz) == 0 || distance(h.position.xyz, features.position.xyz) > tolerance
+            || dot(normalize(h.normal_kind.xyz), normal) < 0.9) {
+            continue;
+        }
+        PixelMoments m = history_moments[index];
+        if (m.mean.w == 0) {
+            continue;
+        }
+        float weight = (i & 1 ? f.x : 1 - f.x) * (i >> 1 ? f.y : 1 - f.y);
+        weight_sum += weight;
+        mean += weight * m.mean.rgb;
+        variance += weight * m.m2.rgb / m.mean.w;
+        count += weight * m.mean.w;
+    }
+    if (weight_sum < 0.01) {
+        return {};
+    }
+    // Partially rejected footprint is trusted less
+    count = min(count, float(max_samples) * weight_sum);
+    mean /= weight_sum;
+    variance /= weight_sum;
+    return { float4(mean, count), float4(variance * count, 0) };
+}
+
+/// Parallel variant of Welford's algorithm (Chan et al.), same as `PixelMoments(merging:)`.
+/// `color` is the mean of `weight` samples, and `m2` is the sum of their squared deviations from it.
+void add_samples(thread PixelMoments &m, float3 color, float3 m2, float weight) {
+    float count = m.mean.w + weight;
+    float3 delta = color - m.mean.rgb;
+    m.m2.rgb += m2 + delta * delta * (m.mean.w * weight / count);
+    m.mean = float4(m.mean.rgb + delta * (weight / count), count);
+}
+
 kernel void ray_tracing_kernel(texture2d<float, access::write> color_buffer [[texture(kernel_buffer_output_texture)]],
-                               texture2d<ushort, access::read_write> acc_buffer [[texture(kernel_buffer_accumulator_texture)]],
+                               device PixelMoments *moments [[buffer(kernel_buffer_moments)]],
+                               device PixelFeatures *features [[buffer(kernel_buffer_features)]],
+                               device PixelMoments const *history_moments [[buffer(kernel_buffer_history_moments)]],
+                               device PixelFeatures const *history_features [[buffer(kernel_buffer_history_features)]],
+                               constant CameraConfig const &history_camera_config [[buffer(kernel_buffer_history_camera_config)]],
+                               texture2d<float, access::read_write> cost_buffer [[texture(kernel_buffer_cost_texture), function_constant(measure_cost)]],
                                uint2 grid_index [[thread_position_in_grid]],
                                constant CameraConfig const &camera_config [[buffer(kernel_buffer_camera_config)]],
                                constant RenderConfig const &render_config [[buffer(kernel_buffer_render_config)]],
-                               primitive_acceleration_structure accelerationStructure [[buffer(kernel_buffer_acceleration_structure)]],
-                               intersection_function_table<triangle_data> functionTable [[buffer(kernel_buffer_function_table)]],
-                               constant uchar const *materials [[buffer(kernel_buffer_materials)]])
+                               acceleration_structure<primitive_motion> accelerationStructure [[buffer(kernel_buffer_acceleration_structure)]],
+                               intersection_function_table<triangle_data, primitive_motion> functionTable [[buffer(kernel_buffer_function_table)]],
+                               constant uchar const *materials [[buffer(kernel_buffer_materials)]],
+                               device atomic_uint *ray_counter [[buffer(kernel_buffer_ray_counter)]],
+                               texture2d<float> environment_texture [[texture(kernel_buffer_environment_texture)]],
+                               device EnvironmentAliasEntry const *environment_alias_table [[buffer(kernel_buffer_environment_alias_table)]],
+                               constant PhotonMapConfig const &photon_config [[buffer(kernel_buffer_photon_config)]],
+                               device Photon const *sorted_photons [[buffer(kernel_buffer_sorted_photons)]],
+                               device uint const *photon_cell_starts [[buffer(kernel_buffer_photon_cell_starts)]],
+                               device uint const *photon_cell_counts [[buffer(kernel_buffer_photon_cell_counts)]],
+                               device PixelPhotonStats *photon_stats [[buffer(kernel_buffer_photon_stats)]],
+                               constant GuidingConfig const &guiding_config [[buffer(kernel_buffer_guiding_config)]],
+                               device GuidingSpatialNode const *guiding_spatial_nodes [[buffer(kernel_buffer_guiding_spatial_nodes)]],
+                               device GuidingDirectionalNode const *guiding_directional_nodes [[buffer(kernel_buffer_guiding_directional_nodes)]],
+                               device atomic_float *guiding_training_energy [[buffer(kernel_buffer_guiding_training_energy)]],
+                               device atomic_uint *guiding_training_counts [[buffer(kernel_buffer_guiding_training_counts)]],
+                               device atomic_float *guiding_statistics [[buffer(kernel_buffer_guiding_statistics)]]
+#if ENABLE_STATISTICS
+                               , device RenderStatistics *statistics_slots [[buffer(kernel_buffer_statistics)]],
+                               uint2 threadgroup_position [[threadgroup_position_in_grid]],
+                               uint2 threadgroups [[threadgroups_per_grid]],
+                               uint simdgroup_index [[simdgroup_index_in_threadgroup]],
+                               uint simdgroups [[dispatch_simdgroups_per_threadgroup]]
+#endif
+                               )
 {
     Camera camera(color_buffer.get_width(), color_buffer.get_height(), camera_config);
     uint32_t rng_seed_hi = (uint32_t)(render_config.rng_seed >> 32);
     uint32_t rng_seed_lo = (uint32_t)render_config.rng_seed;
     RNG rng(grid_index[0] * 5569 + rng_seed_lo, grid_index[1] * 2707 + rng_seed_hi);
-    world w = { accelerationStructure, functionTable, camera_config.background };
+    world w = { accelerationStructure, functionTable, camera_config.background, { environment_texture, environment_alias_table },
+                render_config.sample_environment != 0, { &photon_config, sorted_photons, photon_cell_starts, photon_cell_counts },
+                { &guiding_config, guiding_spatial_nodes, guiding_directional_nodes } };
+    bool guiding = has_guiding && w.guiding.enabled();
+    uint pixel = grid_index.y * color_buffer.get_width() + grid_index.x;
+    bool photons = has_photons && photon_config.photon_count > 0;
+    PixelPhotonStats pixel_photons = {};
+    if (photons && render_config.pass_counter > 1) {
+        pixel_photons = photon_stats[pixel];
+    }
 
     float3 color = 0;
+    // Caustic radiance of photons gathered by the samples, not clamped with path traced light
+    float3 caustics = 0;
+    // Spread of samples within the pass, by Welford's algorithm. Moments are not clamped, only the displayed color is
+    float3 pass_mean = 0;
+    float3 pass_m2 = 0;
+    PathCost cost = {};
+    PixelFeatures sample_features = {};
+    PhotonGather gather = { pixel_photons.radius, 0, 0 };
+    GuidedPath path;
+    STATISTICS(RenderStatistics statistics = {};)
     for (uint i = 0; i < render_config.samples_per_pixel; i++) {
         auto r = camera.get_ray(grid_index, &rng);
-        color += get_ray_color(ray(r.origin, r.direction), w, materials, &rng, render_config.max_depth);
-    }
-    color /= render_config.samples_per_pixel;
-    color = min(color, 1);
-    float3 old_color = (float3(acc_buffer.read(grid_index).rgb) + nextafter(0.5, 0)) / 1024.f;
-    float t = 1.f / render_config.pass_counter;
-    float3 total_color = old_color * (1 - t) + color * t;
-    ushort3 uint_color = min(ushort3(total_color * 1024), 1023);
-    acc_buffer.write(ushort4(uint_color, 0), grid_index);
-    color_buffer.write(float4(sqrt(total_color), 1.0), grid_index);
+        PixelFeatures f = {};
+        float3 gathered = gather.flux;
+        float3 sample_color = get_ray_color(ray(r.origin, r.direction), r.time, camera.get_ray_cone(), w, materials, &rng, render_config.max_depth, cost, f, gather, path STATISTICS(, statistics));
+        // Light the path skipped after dielectrics is delivered by photons, and goes into moments, but guiding learns only paths it sampled
+        float3 sample_caustics = photons && gather.radius > 0 ? (gather.flux - gathered) / (M_PI_F * gather.radius * gather.radius) : 0;
+        if (guiding && guiding_config.training != 0) {
+            w.guiding.record(path, sample_color, guiding_training_energy, guiding_training_counts);
+        }
+        color += sample_color;
+        caustics += sample_caustics;
+        float3 value = sample_color + sample_caustics;
+        float3 delta = value - pass_mean;
+        pass_mean += delta / (i + 1);
+        pass_m2 += delta * (value - pass_mean);
+        sample_features.albedo_depth += f.albedo_depth;
+        sample_features.normal_kind = float4(sample_features.normal_kind.xyz + f.normal_kind.xyz, f.normal_kind.w);
+        sample_features.position += f.position;
+    }
+#if ENABLE_STATISTICS
+    uint slot = (threadgroup_position.y * threadgroups.x + threadgroup_position.x) * simdgroups + simdgroup_index;
+    store_simdgroup_statistics(statistics, statistics_slots + slot);
+#endif
+    // One atomic per SIMD-group instead of one per thread
+    uint simd_ray_count = simd_sum(cost.rays);
+    if (simd_is_first()) {
+        atomic_fetch_add_explicit(ray_counter, simd_ray_count, memory_order_relaxed);
+    }
+    color = (color + caustics) / render_config.samples_per_pixel;
+    // Features and cost are averaged over samples since they started over, which can be later than the moments, see `feature_samples`
+    float t = float(render_config.samples_per_pixel) / (render_config.feature_samples + render_config.samples_per_pixel);
+
+    sample_features.albedo_depth /= render_config.samples_per_pixel;
+    sample_features.normal_kind.xyz /= render_config.samples_per_pixel;
+    sample_features.position = float4(sample_features.position.xyz / max(sample_features.position.w, 1.f),
+                                      sample_features.position.w / render_config.samples_per_pixel);
+    if (render_config.feature_samples > 0) {
+        PixelFeatures old_features = features[pixel];
+        sample_features.albedo_depth = mix(old_features.albedo_depth, sample_features.albedo_depth, t);
+        sample_features.normal_kind.xyz = mix(old_features.normal_kind.xyz, sample_features.normal_kind.xyz, t);
+        sample_features.position = mix(old_features.position, sample_features.position, t);
+    }
+    features[pixel] = sample_features;
+
+    PixelMoments m;
+    if (render_config.pass_counter > 1) {
+        m = moments[pixel];
+    } else if (render_config.max_history_samples > 0) {
+        Camera history_camera(color_buffer.get_width(), color_buffer.get_height(), history_camera_config);
+        uint2 size = uint2(color_buffer.get_width(), color_buffer.get_height());
+        m = reproject_history(sample_features, history_camera, size, history_moments, history_features, render_config.max_history_samples);
+    } else {
+        m = {};
+    }
+    if (guiding) {
+        // Spread of this pass around the accumulation before it, summed over pixels, tracks variance as guiding learns.
+        // Noise of the accumulation of N samples adds 1/N of the sample variance, which is taken out,
+        // and the pass of S samples has 1/S of it, which is scaled back, so that passes of any S compare
+        float difference = luminance(color) - luminance(m.mean.rgb);
+        bool measured = render_config.pass_counter > 1 && m.mean.w > 0;
+        float samples = render_config.samples_per_pixel;
+        float error = difference * difference * m.mean.w * samples / (m.mean.w + samples);
+        float simd_error = simd_sum(measured ? error : 0.0f);
+        float simd_pixels = simd_sum(measured ? 1.0f : 0.0f);
+        if (simd_is_first() && simd_pixels > 0) {
+            device atomic_float *slot = guiding_statistics + 2 * guiding_config.statistics_slot;
+            atomic_fetch_add_explicit(slot, simd_error, memory_order_relaxed);
+            atomic_fetch_add_explicit(slot + 1, simd_pixels, memory_order_relaxed);
+        }
+    }
+    add_samples(m, color, pass_m2, render_config.samples_per_pixel);
+    moments[pixel] = m;
+    float3 total_color = m.mean.rgb;
+
+    if (photons) {
+        pixel_photons.radius = gather.radius;
+        shrink_gather_radius(pixel_photons, float(gather.count) / render_config.samples_per_pixel, photon_config.alpha);
+        photon_stats[pixel] = pixel_photons;
+    }
+
+    float3 total_cost = 0;
+    if (measure_cost) {
+        // Camera ray is not a bounce
+        float3 sample_cost = float3(cost.intersection_tests, cost.enumerator_steps, cost.rays - render_config.samples_per_pixel) / render_config.samples_per_pixel;
+        total_cost = render_config.feature_samples > 0 ? mix(cost_buffer.read(grid_index).rgb, sample_cost, t) : sample_cost;
+        cost_buffer.write(float4(total_cost, 0), grid_index);
+    }
+
+    if (render_config.output_mode == output_mode_color || !measure_cost) {
+        color_buffer.write(float4(sqrt(min(total_color, 1)), 1.0), grid_index);
+    } else {
+        float value = total_cost[render_config.output_mode - output_mode_intersection_tests];
+        color_buffer.write(float4(heatmap_color(value / render_config.heatmap_max), 1.0), grid_index);
+    }
 }
 
-template<class T>
-auto get_hit_enumerator(device T const & object, Ray3D ray, thread RNG * rng) -> decltype(typename T::HitEnumerator(object, ray)) {
-    return typename T::HitEnumerator(object, ray);
+// MARK: - Photon map
+
+/// Resets counters of the photon map before `photon_tracing_kernel`, one thread per hash grid cell.
+kernel void photon_clear_kernel(uint index [[thread_position_in_grid]],
+                                constant PhotonMapConfig const &config [[buffer(kernel_buffer_photon_config)]],
+                                device uint *photon_counter [[buffer(kernel_buffer_photon_counter)]],
+                                device uint *cell_counts [[buffer(kernel_buffer_photon_cell_counts)]])
+{
+    if (index == 0) {
+        *photon_counter = 0;
+    }
+    if (index < config.cell_count) {
+        cell_counts[index] = 0;
+    }
 }
 
-template<class T>
-auto get_hit_enumerator(device T const & object, Ray3D ray, thread RNG * rng) -> decltype(typename T::HitEnumerator(object, ray, rng)) {
-    return typename T::HitEnumerator(object, ray, rng);
+/// Traces one photon from an emitter or the background, and stores it at the first Lambertian surface
+/// it reaches after passing through dielectrics. Photons that hit anything else first are dropped.
+kernel void photon_tracing_kernel(uint index [[thread_position_in_grid]],
+                                  constant PhotonMapConfig const &config [[buffer(kernel_buffer_photon_config)]],
+                                  constant PhotonEmitter const *emitters [[buffer(kernel_buffer_photon_emitters)]],
+                                  device Photon *photons [[buffer(kernel_buffer_photons)]],
+                                  device atomic_uint *photon_counter [[buffer(kernel_buffer_photon_counter)]],
+                                  device atomic_uint *cell_counts [[buffer(kernel_buffer_photon_cell_counts)]],
+                                  constant CameraConfig const &camera_config [[buffer(kernel_buffer_camera_config)]],
+                                  constant RenderConfig const &render_config [[buffer(kernel_buffer_render_config)]],
+                                  acceleration_structure<primitive_motion> accelerationStructure [[buffer(kernel_buffer_acceleration_structure)]],
+                                  intersection_function_table<triangle_data, primitive_motion> functionTable [[buffer(kernel_buffer_function_table)]],
+                                  constant uchar const *materials [[buffer(kernel_buffer_materials)]],
+                                  texture2d<float> environment_texture [[texture(kernel_buffer_environment_texture)]],
+                                  device EnvironmentAliasEntry const *environment_alias_table [[buffer(kernel_buffer_environment_alias_table)]])
+{
+    if (index >= config.photon_count) {
+        return;
+    }
+    // Different stream than camera paths of the same pass
+    uint32_t rng_seed_hi = (uint32_t)(render_config.rng_seed >> 32);
+    uint32_t rng_seed_lo = (uint32_t)render_config.rng_seed;
+    RNG rng(index * 7919 + rng_seed_hi, rng_seed_lo ^ 0x9e3779b9);
+    Environment environment = { environment_texture, environment_alias_table };
+    world w = { accelerationStructure, functionTable, camera_config.background, environment, false };
+
+    // Emitters are picked by their share of the total flux, the background takes the rest
+    float u = rng.random_f();
+    uint e = 0;
+    while (e < config.emitter_count && u >= emitters[e].cdf) {
+        e++;
+    }
+    float previous_cdf = e > 0 ? emitters[e - 1].cdf : 0;
+    float3 origin;
+    float3 direction;
+    float3 power;
+    if (e < config.emitter_count) {
+        PhotonEmitter emitter = emitters[e];
+        origin = emitter.origin + rng.random_f() * emitter.u + rng.random_f() * emitter.v;
+        float3 normal = normalize(cross(emitter.u, emitter.v));
+        // Both faces emit, see `emissive_scatter()`
+        if (rng.random_f() < 0.5) {
+            normal = -normal;
+        }
+        direction = random_cosine_direction(normal, &rng);
+        // Lambertian emitter sends π·L·A per face
+        power = emitter.radiance * (2 * M_PI_F * length(cross(emitter.u, emitter.v))) / (emitter.cdf - previous_cdf);
+    } else {
+        if (!config.background_emits) {
+            return;
+        }
+        float pdf;
+        float3 towards_light;
+        if (has_environment && w.background_lighting == background_lighting_environment) {
+            towards_light = w.environment.sample(&rng, pdf);
+        } else {
+            float z = 1 - 2 * rng.random_f();
+            float φ = 2 * M_PI_F * rng.random_f();
+            float r = sqrt(max(1 - z * z, 0.0f));
+            towards_light = float3(r * cos(φ), z, r * sin(φ));
+            pdf = 1 / (4 * M_PI_F);
+        }
+        if (pdf <= 0) {
+            return;
+        }
+        // Parallel rays through a disk covering the dielectrics, from outside of the scene
+        float3 t = normalize(abs(towards_light.x) > 0.9 ? cross(towards_light, float3(0, 1, 0)) : cross(towards_light, float3(1, 0, 0)));
+        float3 b = cross(towards_light, t);
+        float2 d = random_in_unit_disk(&rng) * config.caster_radius;
+        origin = config.caster_center + d.x * t + d.y * b + config.background_distance * towards_light;
+        direction = -towards_light;
+        float area = M_PI_F * config.caster_radius * config.caster_radius;
+        power = background_color(w, towards_light) * area / (pdf * (1 - previous_cdf));
+    }
+    power /= config.photon_count;
+
+    float time = rng.random_f();
+    // Photons are not filtered, textures are read at the finest level
+    RayCone cone = { 0, 0 };
+    bool through_dielectric = false;
+    for (uint depth = 0; depth < render_config.max_depth; depth++) {
+        intersector<triangle_data, primitive_motion> intersector;
+        Payload payload = { rng };
+        intersection_result<triangle_data> intersection = intersector.intersect(ray(origin, direction, 0.0001), w.acceleration_structure, time, w.function_table, payload);
+        rng = payload.rng;
+        if (intersection.type != intersection_type::bounding_box) {
+            return;
+        }
+        MaterialKind kind = material_handle_kind(payload.hit.material);
+        if (kind != material_kind_dielectric) {
+            if (!through_dielectric || !is_lambertian(kind)) {
+                return;
+            }
+            uint slot = atomic_fetch_add_explicit(photon_counter, 1, memory_order_relaxed);
+            if (slot < config.max_stored_photons) {
+                uint cell = PhotonMap::cell_of(payload.hit.point, config);
+                Photon photon = { payload.hit.point, direction, power, cell };
+                photons[slot] = photon;
+                atomic_fetch_add_explicit(cell_counts + cell, 1, memory_order_relaxed);
+            }
+            return;
+        }
+        material_result result = { 0, 0, Ray3D(0, 0) };
+        if (!scatter(materials, payload.hit.material, Ray3D(origin, direction), payload.hit, cone, &rng, result)) {
+            return;
+        }
+        through_dielectric = true;
+        power *= result.attenuation;
+        origin = result.scattered.origin;
+        direction = result.scattered.direction;
+    }
+}
+
+/// Turns photon counts per cell into offsets past the end of each cell, in a single threadgroup.
+/// Every thread sums a contiguous range of cells, and ranges are combined by SIMD-group prefix sums.
+kernel void photon_prefix_sum_kernel(constant PhotonMapConfig const &config [[buffer(kernel_buffer_photon_config)]],
+                                     device uint const *cell_counts [[buffer(kernel_buffer_photon_cell_counts)]],
+                                     device uint *cell_starts [[buffer(kernel_buffer_photon_cell_starts)]],
+                                     uint thread_index [[thread_position_in_threadgroup]],
+                                     uint threads [[threads_per_threadgroup]],
+                                     uint simd_lane [[thread_index_in_simdgroup]],
+                                     uint simd_index [[simdgroup_index_in_threadgroup]],
+                                     uint simd_size [[threads_per_simdgroup]])
+{
+    threadgroup uint simd_offsets[32];
+    uint per_thread = (config.cell_count + threads - 1) / threads;
+    uint begin = min(thread_index * per_thread, config.cell_count);
+    uint end = min(begin + per_thread, config.cell_count);
+    uint sum = 0;
+    for (uint i = begin; i < end; i++) {
+        sum += cell_counts[i];
+    }
+    uint offset = simd_prefix_exclusive_sum(sum);
+    if (simd_lane == simd_size - 1) {
+        simd_offsets[simd_index] = offset + sum;
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    if (simd_index == 0) {
+        uint simd_groups = (threads + simd_size - 1) / simd_size;
+        uint total = simd_lane < simd_groups ? simd_offsets[simd_lane] : 0;
+        simd_offsets[simd_lane] = simd_prefix_exclusive_sum(total);
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    offset += simd_offsets[simd_index];
+    for (uint i = begin; i < end; i++) {
+        offset += cell_counts[i];
+        cell_starts[i] = offset;
+    }
+}
+
+/// Moves stored photons into the order of their cells. Every photon takes the last free slot of its cell,
+/// so that `cell_starts` ends up pointing at the first photon of each cell.
+kernel void photon_sort_kernel(uint index [[thread_position_in_grid]],
+                               constant PhotonMapConfig const &config [[buffer(kernel_buffer_photon_config)]],
+                               device Photon const *photons [[buffer(kernel_buffer_photons)]],
+                               device Photon *sorted_photons [[buffer(kernel_buffer_sorted_photons)]],
+                               device uint const *photon_counter [[buffer(kernel_buffer_photon_counter)]],
+                               device atomic_uint *cell_starts [[buffer(kernel_buffer_photon_cell_starts)]])
+{
+    if (index >= min(*photon_counter, config.max_stored_photons)) {
+        return;
+    }
+    Photon photon = photons[index];
+    uint slot = atomic_fetch_sub_explicit(cell_starts + photon.cell, 1, memory_order_relaxed) - 1;
+    sorted_photons[slot] = photon;
 }
 
 template<typename T>
@@ -174,37 +763,37 @@ BoundingBoxResult intersection(float3 origin,
                                float minDistance,
                                float maxDistance,
                                device T const &object,
-                               ray_data Payload & payload)
+                               ray_data Payload & payload,
+                               StatisticsIntersectionFunction function,
+                               float time = 0)
 {
-    Ray3D ray(origin, direction);
+    if (measure_cost) {
+        payload.intersection_tests++;
+    }
+    STATISTICS(payload.statistics.calls[function]++;)
+    Ray3D ray(origin, direction, time);
     RNG rng = payload.rng;
     auto e = get_hit_enumerator(object, ray, &rng);
-    for (; e.hasNext(); e.move()) {
-        // TODO: Should it be multiplied by vector length?
-        float distance = e.t();
-        bool matches_distance;
-        {
-#pragma METAL fp math_mode(safe)
-            matches_distance = distance >= minDistance && distance <= maxDistance;
-        }
-        if (matches_distance) {
-            payload.hit.point = e.point();
-            payload.hit.set_normal(e.normal(), direction);
-            payload.hit.material_offset = e.material_offset();
-            payload.hit.texture_coordinates = e.texture_coordinates();
-
-            payload.rng = rng;
-            return { true, distance };
-        }
-    }
-
+    HitInfo hit;
+    float distance;
+    uint steps = 0;
+    bool accept = find_first_hit(e, direction, minDistance, maxDistance, hit, distance, steps);
     payload.rng = rng;
+    if (measure_cost) {
+        payload.enumerator_steps += steps;
+    }
+    if (accept) {
+        STATISTICS(payload.statistics.accepted_hits++;)
+        payload.hit = hit;
+        return { true, distance };
+    }
+    STATISTICS(payload.statistics.rejected_hits++;)
     return { false, 0.0f };
 }
 
 // MARK: - Primitives
 
-[[intersection(bounding_box)]]
+[[intersection(bounding_box, triangle_data, primitive_motion)]]
 BoundingBoxResult sphereIntersectionFunction(float3 origin [[origin]],
                                              float3 direction [[direction]],
                                              float minDistance [[min_distance]],
@@ -212,10 +801,10 @@ BoundingBoxResult sphereIntersectionFunction(float3 origin [[origin]],
                                              device Sphere const *object [[primitive_data]],
                                              ray_data Payload & payload [[payload]])
 {
-    return intersection(origin, direction, minDistance, maxDistance, *object, payload);
+    return intersection(origin, direction, minDistance, maxDistance, *object, payload, statistics_function_sphere);
 }
 
-[[intersection(bounding_box)]]
+[[intersection(bounding_box, triangle_data, primitive_motion)]]
 BoundingBoxResult cylinderIntersectionFunction(float3 origin [[origin]],
                                                float3 direction [[direction]],
                                                float minDistance [[min_distance]],
@@ -224,10 +813,10 @@ BoundingBoxResult cylinderIntersectionFunction(float3 origin [[origin]],
                                                device Cylinder const *object [[primitive_data]],
                                                ray_data Payload & payload [[payload]])
 {
-    return intersection(origin, direction, minDistance, maxDistance, *object, payload);
+    return intersection(origin, direction, minDistance, maxDistance, *object, payload, statistics_function_cylinder);
 }
 
-[[intersection(bounding_box)]]
+[[intersection(bounding_box, triangle_data, primitive_motion)]]
 BoundingBoxResult cuboidIntersectionFunction(float3 origin [[origin]],
                                              float3 direction [[direction]],
                                              float minDistance [[min_distance]],
@@ -236,10 +825,10 @@ BoundingBoxResult cuboidIntersectionFunction(float3 origin [[origin]],
                                              device Cuboid const *object [[primitive_data]],
                                              ray_data Payload & payload [[payload]])
 {
-    return intersection(origin, direction, minDistance, maxDistance, *object, payload);
+    return intersection(origin, direction, minDistance, maxDistance, *object, payload, statistics_function_cuboid);
 }
 
-[[intersection(bounding_box)]]
+[[intersection(bounding_box, triangle_data, primitive_motion)]]
 BoundingBoxResult quadIntersectionFunction(float3 origin [[origin]],
                                              float3 direction [[direction]],
                                              float minDistance [[min_distance]],
@@ -248,12 +837,12 @@ BoundingBoxResult quadIntersectionFunction(float3 origin [[origin]],
                                              device Quad const *object [[primitive_data]],
                                              ray_data Payload & payload [[payload]])
 {
-    return intersection(origin, direction, minDistance, maxDistance, *object, payload);
+    return intersection(origin, direction, minDistance, maxDistance, *object, payload, statistics_function_quad);
 }
 
 // MARK: - CSG Operations
 
-[[intersection(bounding_box)]]
+[[intersection(bounding_box, triangle_data, primitive_motion)]]
 BoundingBoxResult subtract_cylinder_cylinder_IntersectionFunction(float3 origin [[origin]],
                                                                   float3 direction [[direction]],
                                                                   float minDistance [[min_distance]],
@@ -262,10 +851,10 @@ BoundingBoxResult subtract_cylinder_cylinder_IntersectionFunction(float3 origin
                                                                   device Subtract<Cylinder, Cylinder> const *object [[primitive_data]],
                                                                   ray_data Payload & payload [[payload]])
 {
-    return intersection(origin, direction, minDistance, maxDistance, *object, payload);
+    return intersection(origin, direction, minDistance, maxDistance, *object, payload, statistics_function_subtract_cylinder_cylinder);
 }
 
-[[intersection(bounding_box)]]
+[[intersection(bounding_box, triangle_data, primitive_motion)]]
 BoundingBoxResult subtract_cuboid_cylinder_IntersectionFunction(float3 origin [[origin]],
                                                                 float3 direction [[direction]],
                                                                 float minDistance [[min_distance]],
@@ -274,10 +863,10 @@ BoundingBoxResult subtract_cuboid_cylinder_IntersectionFunction(float3 origin [[
                                                                 device Subtract<Cuboid, Cylinder> const *object [[primitive_data]],
                                                                 ray_data Payload & payload [[payload]])
 {
-    return intersection(origin, direction, minDistance, maxDistance, *object, payload);
+    return intersection(origin, direction, minDistance, maxDistance, *object, payload, statistics_function_subtract_cuboid_cylinder);
 }
 
-[[intersection(bounding_box)]]
+[[intersection(bounding_box, triangle_data, primitive_motion)]]
 BoundingBoxResult intersection2_cuboid_sphere_IntersectionFunction(float3 origin [[origin]],
                                                                    float3 direction [[direction]],
                                                                    float minDistance [[min_distance]],
@@ -286,10 +875,10 @@ BoundingBoxResult intersection2_cuboid_sphere_IntersectionFunction(float3 origin
                                                                    device Intersection<Cuboid, Sphere> const *object [[primitive_data]],
                                                                    ray_data Payload & payload [[payload]])
 {
-    return intersection(origin, direction, minDistance, maxDistance, *object, payload);
+    return intersection(origin, direction, minDistance, maxDistance, *object, payload, statistics_function_intersection2_cuboid_sphere);
 }
 
-[[intersection(bounding_box)]]
+[[intersection(bounding_box, triangle_data, primitive_motion)]]
 BoundingBoxResult union3_cylinder_cylinder_cylinder_IntersectionFunction(float3 origin [[origin]],
                                                                   float3 direction [[direction]],
                                                                   float minDistance [[min_distance]],
@@ -298,10 +887,10 @@ BoundingBoxResult union3_cylinder_cylinder_cylinder_IntersectionFunction(float3
                                                                   device Union<Cylinder, Cylinder, Cylinder> const *object [[primitive_data]],
                                                                   ray_data Payload & payload [[payload]])
 {
-    return intersection(origin, direction, minDistance, maxDistance, *object, payload);
+    return intersection(origin, direction, minDistance, maxDistance, *object, payload, statistics_function_union3_cylinder_cylinder_cylinder);
 }
 
-[[intersection(bounding_box)]]
+[[intersection(bounding_box, triangle_data, primitive_motion)]]
 BoundingBoxResult subtract_cuboid_union3_cylinder_cylinder_cylinder__IntersectionFunction(
     float3 origin [[origin]],
     float3 direction [[direction]],
@@ -311,10 +900,10 @@ BoundingBoxResult subtract_cuboid_union3_cylinder_cylinder_cylinder__Intersectio
     device Subtract<Cuboid, Union<Cylinder, Cylinder, Cylinder>> const *object [[primitive_data]],
     ray_data Payload & payload [[payload]])
 {
-    return intersection(origin, direction, minDistance, maxDistance, *object, payload);
+    return intersection(origin, direction, minDistance, maxDistance, *object, payload, statistics_function_subtract_cuboid_union3_cylinder_cylinder_cylinder);
 }
 
-[[intersection(bounding_box)]]
+[[intersection(bounding_box, triangle_data, primitive_motion)]]
 BoundingBoxResult subtract_intersection2_cuboid_sphere__cylinder_IntersectionFunction(
     float3 origin [[origin]],
     float3 direction [[direction]],
@@ -324,10 +913,10 @@ BoundingBoxResult subtract_intersection2_cuboid_sphere__cylinder_IntersectionFun
     device Subtract<Intersection<Cuboid, Sphere>, Cylinder> const *object [[primitive_data]],
     ray_data Payload & payload [[payload]])
 {
-    return intersection(origin, direction, minDistance, maxDistance, *object, payload);
+    return intersection(origin, direction, minDistance, maxDistance, *object, payload, statistics_function_subtract_intersection2_cuboid_sphere__cylinder);
 }
 
-[[intersection(bounding_box)]]
+[[intersection(bounding_box, triangle_data, primitive_motion)]]
 BoundingBoxResult subtract_intersection2_cuboid_sphere__union3_cylinder_cylinder_cylinder__IntersectionFunction(
     float3 origin [[origin]],
     float3 direction [[direction]],
@@ -337,12 +926,12 @@ BoundingBoxResult subtract_intersection2_cuboid_sphere__union3_cylinder_cylinder
     device Subtract<Intersection<Cuboid, Sphere>, Union<Cylinder, Cylinder, Cylinder>> const *object [[primitive_data]],
     ray_data Payload & payload [[payload]])
 {
-    return intersection(origin, direction, minDistance, maxDistance, *object, payload);
+    return intersection(origin, direction, minDistance, maxDistance, *object, payload, statistics_function_subtract_intersection2_cuboid_sphere__union3_cylinder_cylinder_cylinder);
 }
 
 // MARK: - Constant Density Volumes
 
-[[intersection(bounding_box)]]
+[[intersection(bounding_box, triangle_data, primitive_motion)]]
 BoundingBoxResult cdv_cuboid_IntersectionFunction(
     float3 origin [[origin]],
     float3 direction [[direction]],
@@ -352,5 +941,50 @@ BoundingBoxResult cdv_cuboid_IntersectionFunction(
     device ConstantDensityVolume<Cuboid> const *object [[primitive_data]],
     ray_data Payload & payload [[payload]])
 {
-    return intersection(origin, direction, minDistance, maxDistance, *object, payload);
+    return intersection(origin, direction, minDistance, maxDistance, *object, payload, statistics_function_cdv_cuboid);
+}
+
+// MARK: - Heterogeneous Volumes
+
+[[intersection(bounding_box, triangle_data, primitive_motion)]]
+BoundingBoxResult hdv_cuboid_IntersectionFunction(
+    float3 origin [[origin]],
+    float3 direction [[direction]],
+    float minDistance [[min_distance]],
+    float maxDistance [[max_distance]],
+    uint primitiveIndex [[primitive_id]],
+    device HeterogeneousVolume<Cuboid> const *object [[primitive_data]],
+    ray_data Payload & payload [[payload]])
+{
+    return intersection(origin, direction, minDistance, maxDistance, *object, payload, statistics_function_hdv_cuboid);
+}
+
+// MARK: - Motion
+
+[[intersection(bounding_box, triangle_data, primitive_motion)]]
+BoundingBoxResult moving_sphere_IntersectionFunction(
+    float3 origin [[origin]],
+    float3 direction [[direction]],
+    float minDistance [[min_distance]],
+    float maxDistance [[max_distance]],
+    float time [[time]],
+    uint primitiveIndex [[primitive_id]],
+    device Moving<Sphere> const *object [[primitive_data]],
+    ray_data Payload & payload [[payload]])
+{
+    return intersection(origin, direction, minDistance, maxDistance, *object, payload, statistics_function_moving_sphere, time);
+}
+
+[[intersection(bounding_box, triangle_data, primitive_motion)]]
+BoundingBoxResult moving_cuboid_IntersectionFunction(
+    float3 origin [[origin]],
+    float3 direction [[direction]],
+    float minDistance [[min_distance]],
+    float maxDistance [[max_distance]],
+    float time [[time]],
+    uint primitiveIndex [[primitive_id]],
+    device Moving<Cuboid> const *object [[primitive_data]],
+    ray_data Payload & payload [[payload]])
+{
+    return intersection(origin, direction, minDistance, maxDistance, *object, payload, statistics_function_moving_cuboid, time);
 }
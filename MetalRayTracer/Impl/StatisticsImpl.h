@@ -0,0 +1,46 @@
+//
+//  StatisticsImpl.h
+//  RayTracing
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+#ifndef STATISTICS_IMPL_H
+#define STATISTICS_IMPL_H
+
+#include "Defines.h"
+#include "../Materials.h"
+#include "../Statistics.h"
+
+#if ENABLE_STATISTICS
+#define STATISTICS(...) __VA_ARGS__
+#else
+#define STATISTICS(...)
+#endif
+
+#ifdef __METAL__
+
+inline void record_path_length(thread RenderStatistics & statistics, uint length) {
+    statistics.path_length[min(length, uint(statistics_path_length_buckets - 1))]++;
+}
+
+inline void record_shading(thread RenderStatistics & statistics, MaterialKind kind) {
+    statistics.material_shading[min(uint(kind), uint(statistics_material_kinds - 1))]++;
+}
+
+/// Sums counters of all threads in the SIMD-group and stores them into the slot of this SIMD-group.
+/// Every slot is written by a single thread, so no atomics are needed. Slots are summed on the CPU after the pass.
+inline void store_simdgroup_statistics(thread RenderStatistics const & statistics, device RenderStatistics * slot) {
+    thread uint const * src = reinterpret_cast<thread uint const *>(&statistics);
+    device uint * dst = reinterpret_cast<device uint *>(slot);
+    bool first = simd_is_first();
+    for (uint i = 0; i < sizeof(RenderStatistics) / sizeof(uint); i++) {
+        uint sum = simd_sum(src[i]);
+        if (first) {
+            dst[i] = sum;
+        }
+    }
+}
+
+#endif
+
+#endif // STATISTICS_IMPL_H
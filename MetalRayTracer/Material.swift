@@ -7,61 +7,183 @@
 
 public protocol Material {
     associatedtype Impl
+    /// Selects the table of the material in the materials buffer.
+    static var kind: MaterialKind { get }
     func asImpl(_ encoder: inout MaterialEncoder) -> Impl
 }
 
 extension Material {
     var size: Int { MemoryLayout<Impl>.stride }
-    func encode(to encoder: inout MaterialEncoder) {
-        let impl = asImpl(&encoder)
-        encoder.write(impl)
-    }
 }
 
+/// Counts materials of each kind, to lay out their tables before encoding.
 struct MaterialReserver {
+    private(set) var counts = [Int](repeating: 0, count: Int(MATERIAL_TABLE_COUNT))
+    private(set) var strides = [Int](repeating: 0, count: Int(MATERIAL_TABLE_COUNT))
+
+    public init() {}
+
+    mutating func accept<M: Material>(_ material: M) {
+        let kind = Int(M.kind.rawValue)
+        counts[kind] += 1
+        strides[kind] = material.size
+    }
+
+    var layout: MaterialLayout {
+        MaterialLayout(counts: counts, strides: strides)
+    }
+}
+
+/// Offsets of material tables in the materials buffer, as stored in `MaterialTables` at its start.
+struct MaterialLayout {
+    private(set) var offsets: [Int]
     private(set) var totalSize: Int
 
-    public init() {
-        totalSize = 0
+    /// See `material_tables_layout()`.
+    init(counts: [Int], strides: [Int]) {
+        var tables = MaterialTables()
+        totalSize = Int(material_tables_layout(counts.map { UInt32($0) }, strides.map { UInt32($0) }, &tables))
+        offsets = withUnsafeBytes(of: tables.offsets) { Array($0.bindMemory(to: UInt32.self)).map(Int.init) }
+    }
+
+    /// Reads the layout of an encoded buffer.
+    init(buffer: UnsafeRawPointer, length: Int) {
+        let tables = buffer.load(as: MaterialTables.self)
+        offsets = withUnsafeBytes(of: tables.offsets) { Array($0.bindMemory(to: UInt32.self)).map(Int.init) }
+        totalSize = length
+    }
+
+    var tables: MaterialTables {
+        var result = MaterialTables()
+        withUnsafeMutableBytes(of: &result.offsets) { buffer in
+            let offsets = buffer.bindMemory(to: UInt32.self)
+            for (i, offset) in self.offsets.enumerated() {
+                offsets[i] = UInt32(offset)
+            }
+        }
+        return result
+    }
+
+    /// Bit mask of `MaterialKind`s with non-empty tables, see `kernel_function_constant_material_kinds`.
+    var kinds: UInt32 {
+        var result: UInt32 = 0
+        for (kind, offset) in offsets.enumerated() {
+            let end = kind + 1 < offsets.count ? offsets[kind + 1] : totalSize
+            if end > offset {
+                result |= 1 << kind
+            }
+        }
+        return result
+    }
+
+    /// Byte range of the material referenced by `handle`, which must have the given stride.
+    func range(of handle: MaterialHandle, stride: Int) -> Range<Int> {
+        let kind = Int(material_handle_kind(handle).rawValue)
+        var tables = tables
+        let start = Int(material_offset(&tables, handle, UInt32(stride)))
+        precondition(start + stride <= tableEnd(kind), "Material handle is out of bounds of its table")
+        return start..<start + stride
+    }
+
+    /// Tables are ordered by kind, the last one ends at the end of the buffer.
+    private func tableEnd(_ kind: Int) -> Int {
+        kind + 1 < offsets.count ? offsets[kind + 1] : totalSize
+    }
+
+    /// Whether the tables are aligned, ordered and lie within the buffer, for buffers read from files.
+    var isValid: Bool {
+        guard let first = offsets.first, first >= MemoryLayout<MaterialTables>.stride else { return false }
+        return offsets.indices.allSatisfy { offsets[$0] % Int(MATERIAL_TABLE_ALIGNMENT) == 0 && offsets[$0] <= tableEnd($0) }
     }
 
-    mutating func accept(_ material: some Material) {
-        totalSize += material.size
+    /// Whether `handle` references a material of a known kind within its table, for handles read from files.
+    func contains(_ handle: MaterialHandle) -> Bool {
+        guard let kind = MaterialKind(rawValue: .init(handle >> 28)) else { return false }
+        let k = Int(kind.rawValue)
+        // Index has 28 bits and strides are small, so this cannot overflow
+        let end = offsets[k] + (Int(material_handle_index(handle)) + 1) * kind.stride
+        return end <= tableEnd(k)
+    }
+}
+
+extension MaterialKind {
+    /// Stride of materials in the table of the kind, same as `Material.size`.
+    var stride: Int {
+        switch self {
+        case .material_kind_lambertian_colored: MemoryLayout<__ColoredLambertianMaterial>.stride
+        case .material_kind_lambertian_textured: MemoryLayout<__TexturedLambertianMaterial>.stride
+        case .material_kind_lambertian_perlin_noise: MemoryLayout<__PerlinNoiseLambertianMaterial>.stride
+        case .material_kind_metal_colored: MemoryLayout<__ColoredMetalMaterial>.stride
+        case .material_kind_metal_textured: MemoryLayout<__TexturedMetalMaterial>.stride
+        case .material_kind_metal_perlin_noise: MemoryLayout<__PerlinNoiseMetalMaterial>.stride
+        case .material_kind_dielectric: MemoryLayout<__DielectricMaterial>.stride
+        case .material_kind_emissive_colored: MemoryLayout<__ColoredEmissiveMaterial>.stride
+        case .material_kind_isotropic_colored: MemoryLayout<__ColoredIsotropicMaterial>.stride
+        }
     }
 }
 
 public struct MaterialEncoder {
-    private var availableSize: Int
-    private var pointer: UnsafeMutableRawPointer
-    private var offset: Int
+    private let pointer: UnsafeMutableRawPointer
+    let layout: MaterialLayout
+    /// Number of encoded materials of each kind.
+    private var counts = [Int](repeating: 0, count: Int(MATERIAL_TABLE_COUNT))
+    /// Offset of the material being encoded.
+    private var offset = 0
     let textureLoader: TextureLoader
+    /// Offsets of texture resource IDs in the encoded materials, these need to be patched when loading `SceneArchive`.
+    private(set) var textureReferences: [(offset: Int, texture: ImageTexture)] = []
 
-    init(availableSize: Int, pointer: UnsafeMutableRawPointer, textureLoader: TextureLoader) {
-        self.availableSize = availableSize
+    /// Writes `MaterialTables` for `layout` at the start of the buffer.
+    init(layout: MaterialLayout, pointer: UnsafeMutableRawPointer, textureLoader: TextureLoader) {
         self.pointer = pointer
-        self.offset = 0
+        self.layout = layout
         self.textureLoader = textureLoader
+        pointer.storeBytes(of: layout.tables, as: MaterialTables.self)
     }
 
-    mutating func encode(_ material: some Material) -> Int {
-        let result = offset
-        let size = material.size
-        precondition(size <= availableSize)
-        let oldPointer = pointer
-        material.encode(to: &self)
-        precondition(pointer == oldPointer + size)
-        availableSize -= size
-        offset += size
-        return result
+    /// Encoder for replacing materials in a buffer encoded earlier.
+    init(encoded pointer: UnsafeMutableRawPointer, length: Int, textureLoader: TextureLoader) {
+        self.pointer = pointer
+        self.layout = MaterialLayout(buffer: pointer, length: length)
+        self.textureLoader = textureLoader
     }
 
-    mutating func write<T>(_ value: T) {
-        pointer.assumingMemoryBound(to: T.self).pointee = value
-        pointer += MemoryLayout<T>.stride
+    /// Appends `material` to the table of its kind.
+    mutating func encode<M: Material>(_ material: M) -> MaterialHandle {
+        let kind = Int(M.kind.rawValue)
+        let handle = make_material_handle(M.kind, UInt32(counts[kind]))
+        counts[kind] += 1
+        store(material, at: handle)
+        return handle
+    }
+
+    /// Overwrites the material referenced by `handle` in place, the new material must be of the same kind.
+    mutating func replace<M: Material>(at handle: MaterialHandle, with material: M) {
+        precondition(material_handle_kind(handle) == M.kind, "Material kind cannot change in place")
+        let range = layout.range(of: handle, stride: material.size)
+        textureReferences.removeAll { range.contains($0.offset) }
+        store(material, at: handle)
+    }
+
+    private mutating func store<M: Material>(_ material: M, at handle: MaterialHandle) {
+        offset = layout.range(of: handle, stride: material.size).lowerBound
+        let impl = material.asImpl(&self)
+        (pointer + offset).assumingMemoryBound(to: M.Impl.self).pointee = impl
+    }
+
+    /// Loads the texture of the material being encoded.
+    /// `fieldOffset` is the offset of the texture within the material struct.
+    mutating func loadTexture(_ texture: ImageTexture, fieldOffset: Int) -> __ImageTexture {
+        let metalTexture = textureLoader.load(texture)
+        textureReferences.append((offset: offset + fieldOffset, texture: texture))
+        return __ImageTexture(texture_ptr: metalTexture.gpuResourceID)
     }
 }
 
 public struct ColoredLambertian: Material {
+    public static var kind: MaterialKind { .material_kind_lambertian_colored }
+
     public var albedo: vector_float3
 
     public init(albedo: vector_float3) {
@@ -69,11 +191,13 @@ public struct ColoredLambertian: Material {
     }
 
     public func asImpl(_ encoder: inout MaterialEncoder) -> __ColoredLambertianMaterial {
-        __ColoredLambertianMaterial(kind: .material_kind_lambertian_colored, albedo: albedo)
+        __ColoredLambertianMaterial(albedo: albedo)
     }
 }
 
 public struct TexturedLambertian: Material {
+    public static var kind: MaterialKind { .material_kind_lambertian_textured }
+
     public var albedo: ImageTexture
 
     public init(albedo: ImageTexture) {
@@ -81,13 +205,14 @@ public struct TexturedLambertian: Material {
     }
 
     public func asImpl(_ encoder: inout MaterialEncoder) -> __TexturedLambertianMaterial {
-        let metalTexture = encoder.textureLoader.load(albedo)
-        let texture = __ImageTexture(texture_ptr: metalTexture.gpuResourceID)
-        return __TexturedLambertianMaterial(kind: .material_kind_lambertian_textured, albedo: texture)
+        let texture = encoder.loadTexture(albedo, fieldOffset: MemoryLayout<__TexturedLambertianMaterial>.offset(of: \.albedo)!)
+        return __TexturedLambertianMaterial(albedo: texture)
     }
 }
 
 public struct PerlinNoiseLambertian: Material {
+    public static var kind: MaterialKind { .material_kind_lambertian_perlin_noise }
+
     public var albedo: PerlinNoiseTexture
 
     public init(albedo: PerlinNoiseTexture) {
@@ -95,11 +220,13 @@ public struct PerlinNoiseLambertian: Material {
     }
 
     public func asImpl(_ encoder: inout MaterialEncoder) -> __PerlinNoiseLambertianMaterial {
-        return __PerlinNoiseLambertianMaterial(kind: .material_kind_lambertian_perlin_noise, albedo: albedo)
+        return __PerlinNoiseLambertianMaterial(albedo: albedo)
     }
 }
 
 public struct ColoredMetal: Material {
+    public static var kind: MaterialKind { .material_kind_metal_colored }
+
     public var albedo: vector_float3
     public var fuzz: Float
 
@@ -110,11 +237,13 @@ public struct ColoredMetal: Material {
     }
 
     public func asImpl(_ encoder: inout MaterialEncoder) -> __ColoredMetalMaterial {
-        __ColoredMetalMaterial(kind: .material_kind_metal_colored, albedo: albedo, fuzz: fuzz)
+        __ColoredMetalMaterial(albedo: albedo, fuzz: fuzz)
     }
 }
 
 public struct TexturedMetal: Material {
+    public static var kind: MaterialKind { .material_kind_metal_textured }
+
     public var albedo: ImageTexture
     public var fuzz: Float
 
@@ -125,13 +254,14 @@ public struct TexturedMetal: Material {
     }
 
     public func asImpl(_ encoder: inout MaterialEncoder) -> __TexturedMetalMaterial {
-        let metalTexture = encoder.textureLoader.load(albedo)
-        let texture = __ImageTexture(texture_ptr: metalTexture.gpuResourceID)
-        return __TexturedMetalMaterial(kind: .material_kind_metal_textured, albedo: texture, fuzz: fuzz)
+        let texture = encoder.loadTexture(albedo, fieldOffset: MemoryLayout<__TexturedMetalMaterial>.offset(of: \.albedo)!)
+        return __TexturedMetalMaterial(albedo: texture, fuzz: fuzz)
     }
 }
 
 public struct PerlinNoiseMetal: Material {
+    public static var kind: MaterialKind { .material_kind_metal_perlin_noise }
+
     public var albedo: PerlinNoiseTexture
     public var fuzz: Float
 
@@ -142,11 +272,13 @@ public struct PerlinNoiseMetal: Material {
     }
 
     public func asImpl(_ encoder: inout MaterialEncoder) -> __PerlinNoiseMetalMaterial {
-        return __PerlinNoiseMetalMaterial(kind: .material_kind_metal_perlin_noise, albedo: albedo, fuzz: fuzz)
+        return __PerlinNoiseMetalMaterial(albedo: albedo, fuzz: fuzz)
     }
 }
 
 public struct Dielectric: Material {
+    public static var kind: MaterialKind { .material_kind_dielectric }
+
     public var refractionIndex: Float
 
     public init(refractionIndex: Float) {
@@ -155,22 +287,26 @@ public struct Dielectric: Material {
     }
 
     public func asImpl(_ encoder: inout MaterialEncoder) -> __DielectricMaterial {
-        __DielectricMaterial(kind: .material_kind_dielectric, refraction_index: refractionIndex)
+        __DielectricMaterial(refraction_index: refractionIndex)
     }
 }
 
 public struct ColoredEmissive: Material {
+    public static var kind: MaterialKind { .material_kind_emissive_colored }
+
     public var albedo: vector_float3
 
     public func asImpl(_ encoder: inout MaterialEncoder) -> __ColoredEmissiveMaterial {
-        __ColoredEmissiveMaterial(kind: .material_kind_emissive_colored, albedo: albedo)
+        __ColoredEmissiveMaterial(albedo: albedo)
     }
 }
 
 public struct ColoredIsotropic: Material {
+    public static var kind: MaterialKind { .material_kind_isotropic_colored }
+
     public var albedo: vector_float3
 
     public func asImpl(_ encoder: inout MaterialEncoder) -> __ColoredIsotropicMaterial {
-        __ColoredIsotropicMaterial(kind: .material_kind_isotropic_colored, albedo: albedo)
+        __ColoredIsotropicMaterial(albedo: albedo)
     }
 }
@@ -25,6 +25,57 @@ enum MaterialKind {
     material_kind_isotropic_colored,
 } __attribute__((enum_extensibility(closed)));
 
+/// Kind of the material in the high 4 bits, and index into the table of that kind in the low 28 bits.
+typedef uint32_t MaterialHandle;
+
+static inline MaterialHandle make_material_handle(enum MaterialKind kind, uint32_t index) {
+    return ((uint32_t)kind << 28) | index;
+}
+
+static inline enum MaterialKind material_handle_kind(MaterialHandle handle) {
+    return (enum MaterialKind)(handle >> 28);
+}
+
+static inline uint32_t material_handle_index(MaterialHandle handle) {
+    return handle & 0x0fffffff;
+}
+
+/// Start of the materials buffer. Materials of each kind are stored in a dense table of their struct,
+/// so materials of the same kind are read from contiguous memory, and can be replaced in place.
+struct MaterialTables {
+    enum {
+        /// Indexed by `MaterialKind`, table 0 is always empty.
+        MATERIAL_TABLE_COUNT = 16,
+        /// Tables start at cache line boundaries.
+        MATERIAL_TABLE_ALIGNMENT = 64,
+    };
+    /// Offset of each table from the start of the buffer.
+    uint32_t offsets[MATERIAL_TABLE_COUNT];
+};
+
+#ifndef __METAL__
+/// Lays out tables of `counts[kind]` materials of `strides[kind]` bytes after `MaterialTables`, returns size of the buffer.
+static inline uint32_t material_tables_layout(uint32_t const *counts, uint32_t const *strides, struct MaterialTables *tables) {
+    // Enumerators are scoped to the struct in C++
+#ifdef __cplusplus
+    uint32_t const alignment = MaterialTables::MATERIAL_TABLE_ALIGNMENT;
+#else
+    uint32_t const alignment = MATERIAL_TABLE_ALIGNMENT;
+#endif
+    uint32_t offset = (sizeof(struct MaterialTables) + alignment - 1) / alignment * alignment;
+    for (uint32_t kind = 0; kind < sizeof(tables->offsets) / sizeof(tables->offsets[0]); kind++) {
+        tables->offsets[kind] = offset;
+        offset = (offset + counts[kind] * strides[kind] + alignment - 1) / alignment * alignment;
+    }
+    return offset;
+}
+
+/// Offset of the material referenced by `handle` from the start of the buffer, same as `material_at()` in MaterialsImpl.h.
+static inline uint32_t material_offset(struct MaterialTables const *tables, MaterialHandle handle, uint32_t stride) {
+    return tables->offsets[material_handle_kind(handle)] + material_handle_index(handle) * stride;
+}
+#endif
+
 typedef vector_float3 SolidColor;
 
 struct ImageTexture {
@@ -45,50 +96,41 @@ struct PerlinNoiseTexture {
 };
 
 struct ColoredLambertianMaterial {
-    enum MaterialKind kind;
     SolidColor albedo;
 } __attribute__((swift_private));
 
 struct TexturedLambertianMaterial {
-    enum MaterialKind kind;
     struct ImageTexture albedo;
 } __attribute__((swift_private));
 
 struct PerlinNoiseLambertianMaterial {
-    enum MaterialKind kind;
     struct PerlinNoiseTexture albedo;
 } __attribute__((swift_private));
 
 struct ColoredMetalMaterial {
-    enum MaterialKind kind;
     SolidColor albedo;
     float fuzz;
 } __attribute__((swift_private));
 
 struct TexturedMetalMaterial {
-    enum MaterialKind kind;
     struct ImageTexture albedo;
     float fuzz;
 } __attribute__((swift_private));
 
 struct PerlinNoiseMetalMaterial {
-    enum MaterialKind kind;
     struct PerlinNoiseTexture albedo;
     float fuzz;
 } __attribute__((swift_private));
 
 struct DielectricMaterial {
-    enum MaterialKind kind;
     float refraction_index;
 } __attribute__((swift_private));
 
 struct ColoredEmissiveMaterial {
-    enum MaterialKind kind;
     SolidColor albedo;
 } __attribute__((swift_private));
 
 struct ColoredIsotropicMaterial {
-    enum MaterialKind kind;
     SolidColor albedo;
 } __attribute__((swift_private));
 
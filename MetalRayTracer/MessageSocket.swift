@@ -0,0 +1,140 @@
+//
+//  MessageSocket.swift
+//  MetalRayTracer
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+
+import Foundation
+
+struct SocketError: Error, CustomStringConvertible {
+    var operation: String
+    var code: Int32
+
+    init(_ operation: String, code: Int32 = errno) {
+        self.operation = operation
+        self.code = code
+    }
+
+    var description: String {
+        "\(operation): \(String(cString: strerror(code)))"
+    }
+}
+
+/// Blocking loopback TCP connection, which exchanges length-prefixed messages.
+final class MessageSocket: @unchecked Sendable {
+    let fd: Int32
+
+    init(fd: Int32) {
+        self.fd = fd
+        var on: Int32 = 1
+        // Writing into a connection closed by a dead peer should fail instead of killing the process
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, socklen_t(MemoryLayout<Int32>.size))
+    }
+
+    convenience init(connectingTo port: UInt16) throws {
+        let fd = socket(AF_INET, SOCK_STREAM, 0)
+        guard fd >= 0 else { throw SocketError("socket") }
+        var address = Self.loopbackAddress(port: port)
+        let result = withUnsafePointer(to: &address) {
+            $0.withMemoryRebound(to: sockaddr.self, capacity: 1) {
+                connect(fd, $0, socklen_t(MemoryLayout<sockaddr_in>.size))
+            }
+        }
+        guard result == 0 else {
+            let error = SocketError("connect")
+            close(fd)
+            throw error
+        }
+        self.init(fd: fd)
+    }
+
+    deinit {
+        close(fd)
+    }
+
+    func send(_ message: Data) throws {
+        var length = UInt64(message.count).littleEndian
+        try withUnsafeBytes(of: &length) { try write($0) }
+        try message.withUnsafeBytes { try write($0) }
+    }
+
+    func receive() throws -> Data {
+        var length: UInt64 = 0
+        try withUnsafeMutableBytes(of: &length) { try read($0) }
+        var message = Data(count: Int(UInt64(littleEndian: length)))
+        try message.withUnsafeMutableBytes { try read($0) }
+        return message
+    }
+
+    private func write(_ buffer: UnsafeRawBufferPointer) throws {
+        var offset = 0
+        while offset < buffer.count {
+            let n = Darwin.write(fd, buffer.baseAddress! + offset, buffer.count - offset)
+            if n < 0 && errno == EINTR { continue }
+            guard n > 0 else { throw SocketError("write") }
+            offset += n
+        }
+    }
+
+    private func read(_ buffer: UnsafeMutableRawBufferPointer) throws {
+        var offset = 0
+        while offset < buffer.count {
+            let n = Darwin.read(fd, buffer.baseAddress! + offset, buffer.count - offset)
+            if n < 0 && errno == EINTR { continue }
+            guard n > 0 else { throw SocketError("read", code: n == 0 ? ECONNRESET : errno) }
+            offset += n
+        }
+    }
+
+    static func loopbackAddress(port: UInt16) -> sockaddr_in {
+        var address = sockaddr_in()
+        address.sin_len = UInt8(MemoryLayout<sockaddr_in>.size)
+        address.sin_family = sa_family_t(AF_INET)
+        address.sin_port = port.bigEndian
+        address.sin_addr.s_addr = UInt32(0x7f00_0001).bigEndian // 127.0.0.1
+        return address
+    }
+}
+
+/// Listening loopback socket.
+final class MessageListener: @unchecked Sendable {
+    let fd: Int32
+    let port: UInt16
+
+    /// Port 0 picks any free port.
+    init(port: UInt16) throws {
+        let fd = socket(AF_INET, SOCK_STREAM, 0)
+        guard fd >= 0 else { throw SocketError("socket") }
+        var on: Int32 = 1
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, socklen_t(MemoryLayout<Int32>.size))
+        var address = MessageSocket.loopbackAddress(port: port)
+        var length = socklen_t(MemoryLayout<sockaddr_in>.size)
+        let result = withUnsafeMutablePointer(to: &address) {
+            $0.withMemoryRebound(to: sockaddr.self, capacity: 1) {
+                bind(fd, $0, length) == 0 && listen(fd, 16) == 0 && getsockname(fd, $0, &length) == 0
+            }
+        }
+        guard result else {
+            let error = SocketError("bind")
+            close(fd)
+            throw error
+        }
+        self.fd = fd
+        self.port = UInt16(bigEndian: address.sin_port)
+    }
+
+    deinit {
+        close(fd)
+    }
+
+    /// Returns nil if no connection arrived within the timeout.
+    func accept(timeout: Duration) -> MessageSocket? {
+        var descriptor = pollfd(fd: fd, events: Int16(POLLIN), revents: 0)
+        let milliseconds = Int32(timeout.components.seconds * 1000 + timeout.components.attoseconds / 1_000_000_000_000_000)
+        guard poll(&descriptor, 1, milliseconds) > 0 else { return nil }
+        let connection = Darwin.accept(fd, nil, nil)
+        guard connection >= 0 else { return nil }
+        return MessageSocket(fd: connection)
+    }
+}
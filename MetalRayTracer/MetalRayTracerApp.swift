@@ -9,9 +9,42 @@ import SwiftUI
 
 @main
 struct MetalRayTracerApp: App {
+    init() {
+        if let options = SceneBenchmark.Options(arguments: CommandLine.arguments) {
+            SceneBenchmark(options: options).run()
+            Tracer.shared?.write()
+            exit(0)
+        }
+        if CheckpointOptions.runMerge(arguments: CommandLine.arguments) {
+            exit(0)
+        }
+        if let options = DistributedRender.Options(arguments: CommandLine.arguments) {
+            DistributedRender.run(options: options)
+            Tracer.shared?.write()
+            exit(0)
+        }
+        if let tracer = Tracer.shared {
+            NotificationCenter.default.addObserver(forName: NSApplication.willTerminateNotification, object: nil, queue: nil) { _ in
+                tracer.write()
+            }
+        }
+    }
+
     var body: some SwiftUI.Scene {
         WindowGroup {
-            ContentView(scene: .quads)
+            ContentView(scene: Self.initialScene)
+        }
+    }
+
+    /// Scene from `--scene-archive <path>`, if given.
+    private static var initialScene: Scene {
+        let arguments = CommandLine.arguments
+        if let i = arguments.firstIndex(of: "--scene-archive"), i + 1 < arguments.endIndex,
+           let scene = Scene(archive: SceneBenchmark.Options.url(for: arguments[i + 1])) {
+            return scene
         }
+        var scene = Scene.quads
+        scene.name = "quads"
+        return scene
     }
 }
@@ -0,0 +1,132 @@
+//
+//  Moving.swift
+//  RayTracing
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+
+import Metal
+
+struct __MovingImpl<Base: RenderableImpl>: RenderableImpl {
+    var base: Base
+    var motion: Motion
+
+    static var intersectionFunctionName: String {
+        getIntersectionFunctionName(operation: "moving", operands: (Base.self))
+    }
+
+    static var materialHandleOffsets: [Int] {
+        Base.materialHandleOffsets.map { $0 + MemoryLayout<Self>.offset(of: \.base)! }
+    }
+
+    static var hasMotion: Bool { true }
+}
+
+/// `base` moving rigidly over the shutter interval, for motion blur.
+/// `base` is given in its own coordinates, e.g. a sphere centered at the origin,
+/// and is moved into the world by `keyframes`, uniformly spaced from shutter open to shutter close.
+struct Moving<Base: Renderable>: Renderable {
+    var base: Base
+    var keyframes: [Transform]
+
+    init(base: Base, keyframes: [Transform]) {
+        precondition((2...Int(MOTION_MAX_KEYFRAMES)).contains(keyframes.count), "Motion needs 2 to \(MOTION_MAX_KEYFRAMES) keyframes")
+        self.base = base
+        self.keyframes = keyframes
+    }
+
+    init(base: Base, from: Transform, to: Transform) {
+        self.init(base: base, keyframes: [from, to])
+    }
+
+    /// Same interpolation as `motion_transform()` in RenderableImpl.h.
+    func transform(at time: Float) -> Transform {
+        let x = simd_clamp(time, 0, 1) * Float(keyframes.count - 1)
+        let i = min(Int(x), keyframes.count - 2)
+        let f = x - Float(i)
+        let a = keyframes[i].rotation.normalized.vector
+        var b = keyframes[i + 1].rotation.normalized.vector
+        if simd_dot(a, b) < 0 {
+            b = -b
+        }
+        return Transform(
+            rotation: simd_quatf(vector: simd_mix(a, b, simd_float4(repeating: f))).normalized,
+            translation: simd_mix(keyframes[i].translation, keyframes[i + 1].translation, vector_float3(repeating: f))
+        )
+    }
+
+    var boundingBox: MTLAxisAlignedBoundingBox {
+        boundingBox(during: 0...1)
+    }
+
+    /// Union of boxes at sampled times, padded by the largest distance a point of `base` travels between two samples,
+    /// so that the box is conservative for any time in `interval`.
+    func boundingBox(during interval: ClosedRange<Float>) -> MTLAxisAlignedBoundingBox {
+        let box = base.boundingBox
+        let corners = Self.corners(of: box)
+        // Distance of the farthest point of `base` from its origin, which moves it along arcs when rotating
+        let radius = corners.map(simd_length).max()!
+        // Samples per keyframe segment, the motion is smooth between keyframes
+        let samplesPerSegment = 8
+        let steps = max(Int(((interval.upperBound - interval.lowerBound) * Float(keyframes.count - 1) * Float(samplesPerSegment)).rounded(.up)), 1)
+
+        var result: MTLAxisAlignedBoundingBox = .empty
+        var padding: Float = 0
+        var previous: Transform?
+        for k in 0...steps {
+            let time = interval.lowerBound + (interval.upperBound - interval.lowerBound) * Float(k) / Float(steps)
+            let transform = transform(at: time)
+            for p in corners {
+                result.add(transform.rotation.act(p) + transform.translation)
+            }
+            if let previous {
+                var delta = (transform.rotation * previous.rotation.inverse).vector
+                if delta.w < 0 {
+                    delta = -delta
+                }
+                let angle = 2 * atan2(simd_length(simd_make_float3(delta)), delta.w)
+                padding = max(padding, simd_length(transform.translation - previous.translation) + radius * angle)
+            }
+            previous = transform
+        }
+        // Rotations are quantized in `Motion`, see `compactRotation`
+        padding += radius * 1e-3
+        return MTLAxisAlignedBoundingBox(min: result.min.asUnpacked - padding, max: result.max.asUnpacked + padding)
+    }
+
+    private static func corners(of box: MTLAxisAlignedBoundingBox) -> [vector_float3] {
+        let lo = box.min.asUnpacked
+        let hi = box.max.asUnpacked
+        return (0..<8).map { i in
+            vector_float3(i & 1 != 0 ? hi.x : lo.x, i & 2 != 0 ? hi.y : lo.y, i & 4 != 0 ? hi.z : lo.z)
+        }
+    }
+
+    func visitMaterials(_ reserver: inout MaterialReserver) {
+        base.visitMaterials(&reserver)
+    }
+
+    func asImpl(_ encoder: inout MaterialEncoder) -> __MovingImpl<Base.Impl> {
+        let baseImpl = base.asImpl(&encoder)
+        return __MovingImpl(base: baseImpl, motion: Motion(keyframes: keyframes))
+    }
+}
+
+extension Motion {
+    init(keyframes: [Transform]) {
+        self.init()
+        keyframe_count = UInt32(keyframes.count)
+        withUnsafeMutableBytes(of: &translation) { buffer in
+            let translations = buffer.bindMemory(to: vector_float3.self)
+            for (i, keyframe) in keyframes.enumerated() {
+                translations[i] = keyframe.translation
+            }
+        }
+        withUnsafeMutableBytes(of: &rotation) { buffer in
+            let rotations = buffer.bindMemory(to: vector_short4.self)
+            for (i, keyframe) in keyframes.enumerated() {
+                rotations[i] = keyframe.compactRotation
+            }
+        }
+    }
+}
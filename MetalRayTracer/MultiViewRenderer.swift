@@ -0,0 +1,78 @@
+//
+//  MultiViewRenderer.swift
+//  MetalRayTracer
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+
+import Metal
+
+/// Renders several cameras of one scene in a batch, e.g. a turntable or a stereo pair.
+/// The scene, acceleration structure, textures and pipeline are built once and shared by all views,
+/// and so is the caustic photon map, traced once per pass before any view gathers it.
+/// Every pass dispatches all views into one concurrent compute encoder, so the GPU schedules their threadgroups
+/// from a single queue, while the acceleration structure and materials stay hot in caches.
+/// Each view has its own output texture, accumulation buffers and ray counter.
+final class MultiViewRenderer {
+    struct View {
+        var camera: CameraConfig
+        let engine: RenderEngine
+        let outputTexture: MTLTexture
+    }
+
+    let views: [View]
+
+    init(scene: Scene, cameras: [CameraConfig], width: Int, height: Int, device: MTLDevice, commandQueue: MTLCommandQueue, motionSegments: Int = SceneBuffers.defaultMotionSegments, specialize: Bool = true,
+         photonsPerPass: Int = PhotonMapper.defaultPhotonsPerPass, guidingIterations: Int = PathGuiding.defaultTrainingIterations, guidingBaselinePasses: Int = 0) {
+        precondition(!cameras.isEmpty)
+        let first = RenderEngine(scene: scene, device: device, commandQueue: commandQueue, motionSegments: motionSegments, specialize: specialize,
+                                 photonsPerPass: photonsPerPass, guidingIterations: guidingIterations, guidingBaselinePasses: guidingBaselinePasses)
+        views = cameras.enumerated().map { i, camera in
+            let engine = i == 0 ? first : RenderEngine(sharing: first)
+            return View(camera: camera, engine: engine, outputTexture: engine.makeOutputTexture(width: width, height: height))
+        }
+    }
+
+    /// Cameras orbiting around the look-at point of `camera` at equal steps of yaw, starting with `camera` itself.
+    static func turntable(around camera: CameraConfig, count: Int) -> [CameraConfig] {
+        (0..<count).map { i in
+            var result = camera
+            result.relativePosition.yaw += 360 * Float(i) / Float(count)
+            return result
+        }
+    }
+
+    /// Encodes one progressive pass of every view.
+    /// View 0 uses the seed of `renderConfig`, others get seeds derived from it, so that their noise is not correlated.
+    /// View 0 also traces the photon map of the pass, its last barrier orders it before the camera kernels of all views.
+    func encodePass(commandBuffer: MTLCommandBuffer, renderConfig: RenderConfig) {
+        Tracer.interval("Encode multi-view pass") {
+            let encoder = commandBuffer.makeComputeCommandEncoder(dispatchType: .concurrent)!
+            for (i, view) in views.enumerated() {
+                var config = renderConfig
+                config.impl.rng_seed ^= UInt64(i) &* 0x9E37_79B9_7F4A_7C15
+                view.engine.encodePass(encoder: encoder, outputTexture: view.outputTexture, camera: view.camera, renderConfig: config, tracePhotons: i == 0)
+            }
+            encoder.endEncoding()
+            // Views share the guiding field, see `RenderEngine.init(sharing:)`
+            views[0].engine.pathGuiding?.passEncoded(commandBuffer: commandBuffer)
+        }
+        Tracer.gpuInterval("Multi-view pass", commandBuffer: commandBuffer, detail: "pass \(renderConfig.impl.pass_counter), \(views.count) views")
+    }
+
+    /// Rays traced by each view since the last reset, must be called after passes have completed.
+    var rayCounts: [UInt32] {
+        views.map { $0.engine.rayCount }
+    }
+
+    func resetRayCounters() {
+        for view in views {
+            view.engine.resetRayCounter()
+        }
+    }
+
+    /// Kernel counters of the last pass of each view, only collected if `ENABLE_STATISTICS` is set.
+    func collectStatistics() -> [RenderStatisticsTotals] {
+        views.map { $0.engine.collectStatistics() }
+    }
+}
@@ -0,0 +1,304 @@
+//
+//  PathGuiding.swift
+//  MetalRayTracer
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+
+import Foundation
+import Metal
+
+/// Online path guiding with an SD-tree (Müller et al., "Practical Path Guiding for Efficient Light-Transport Simulation"),
+/// see `GuidingConfig`. Training runs in iterations of 1, 2, 4... passes. Paths record incident radiance into the
+/// training buffers with atomics, and once the last pass of an iteration completes, the CPU refines the trees from what
+/// was learned, which then guide the following passes. Passes encoded while the CPU rebuilds keep sampling the old trees
+/// without training. Shared by all views of a scene, they train the same trees.
+/// Optional baseline passes before training sample materials only, and measure the variance guiding is compared to.
+final class PathGuiding {
+    static let defaultTrainingIterations = 10
+    /// Baseline passes of benchmarks, the first of them has no accumulation to compare with.
+    static let defaultBaselinePasses = 16
+    /// Spatial leaves split once they record more bounces than this, times square root of the passes of the iteration.
+    static let spatialThreshold: Float = 12000
+    /// Directional nodes split while they hold more than this fraction of energy of their tree.
+    static let directionalThreshold: Float = 0.01
+    static let maxSpatialDepth = 24
+    static let maxDirectionalDepth = 10
+    static let bsdfFraction: Float = 0.5
+    /// Passes that can be in flight before their `GuidingPassStatistics` slot is reused.
+    private static let statisticsSlots = 64
+
+    struct Iteration: Encodable {
+        var passes: Int
+        var spatialLeaves: Int
+        var directionalNodes: Int
+        var rebuildSeconds: Double
+    }
+
+    struct Pass: Encodable {
+        /// Rebuilt trees the pass sampled from, 0 if it sampled the initial uniform trees, nil for baseline passes.
+        var generation: Int?
+        /// Mean variance of a sample of pixels of the pass, see `GuidingPassStatistics`.
+        var variance: Double
+        /// `Report.baselineVariance` divided by `variance`, nil without baseline passes.
+        var varianceReduction: Double?
+    }
+
+    struct Report: Encodable {
+        var iterations: [Iteration]
+        /// Mean variance of baseline passes, nil without them.
+        var baselineVariance: Double?
+        var passes: [Pass]
+    }
+
+    private struct Trees {
+        var spatial: [GuidingSpatialNode]
+        var directional: [GuidingDirectionalNode]
+
+        static var initial: Trees {
+            Trees(spatial: [GuidingSpatialNode(axis: 3, child: 0)], directional: [GuidingDirectionalNode(child: 0, energy: 0)])
+        }
+
+        var spatialLeaves: Int {
+            spatial.reduce(0) { $0 + ($1.axis > 2 ? 1 : 0) }
+        }
+    }
+
+    private let device: MTLDevice
+    private let trainingIterations: Int
+    private var config: GuidingConfig
+    private var trees: Trees = .initial
+    private var spatialNodes: MTLBuffer
+    private var directionalNodes: MTLBuffer
+    private var trainingEnergy: MTLBuffer
+    private var trainingCounts: MTLBuffer
+    private let statistics: MTLBuffer
+    private var iteration = 0
+    private var passesInIteration = 0
+    private var generation = 0
+    private var baselinePassesLeft: Int
+
+    /// Guards results of command buffer completion handlers.
+    private let lock = NSLock()
+    private var rebuilt: Trees?
+    private var iterations: [Iteration] = []
+    private var passes: [(generation: Int?, variance: Double)] = []
+
+    init(bounds: MTLAxisAlignedBoundingBox, trainingIterations: Int, baselinePasses: Int = 0, device: MTLDevice) {
+        self.device = device
+        self.trainingIterations = trainingIterations
+        baselinePassesLeft = baselinePasses
+        config = GuidingConfig()
+        // Padding keeps surfaces at the bounds away from the last cells
+        let padding = length(bounds.max.asUnpacked - bounds.min.asUnpacked) * 0.01 + 1e-3
+        config.bounds_min = bounds.min.asUnpacked - padding
+        config.bounds_max = bounds.max.asUnpacked + padding
+        config.bsdf_fraction = Self.bsdfFraction
+        statistics = device.makeBuffer(length: MemoryLayout<GuidingPassStatistics>.stride * Self.statisticsSlots, options: .storageModeShared)!
+        memset(statistics.contents(), 0, statistics.length)
+        (spatialNodes, directionalNodes, trainingEnergy, trainingCounts) = Self.makeBuffers(trees: trees, device: device)
+        config.spatial_node_count = UInt32(trees.spatial.count)
+        config.training = trainingIterations > 0 ? 1 : 0
+    }
+
+    private static func makeBuffers(trees: Trees, device: MTLDevice) -> (MTLBuffer, MTLBuffer, MTLBuffer, MTLBuffer) {
+        func makeBuffer<T>(_ array: [T]) -> MTLBuffer {
+            array.withUnsafeBytes { device.makeBuffer(bytes: $0.baseAddress!, length: $0.count, options: .storageModeShared)! }
+        }
+        return (
+            makeBuffer(trees.spatial),
+            makeBuffer(trees.directional),
+            makeBuffer([Float](repeating: 0, count: trees.directional.count)),
+            makeBuffer([UInt32](repeating: 0, count: trees.spatial.count))
+        )
+    }
+
+    /// Binds the trees for the camera kernel, installing ones rebuilt since the last pass.
+    func encode(encoder: MTLComputeCommandEncoder) {
+        lock.lock()
+        let rebuilt = self.rebuilt
+        self.rebuilt = nil
+        lock.unlock()
+        if let rebuilt {
+            trees = rebuilt
+            (spatialNodes, directionalNodes, trainingEnergy, trainingCounts) = Self.makeBuffers(trees: trees, device: device)
+            config.spatial_node_count = UInt32(trees.spatial.count)
+            generation += 1
+            iteration += 1
+            passesInIteration = 0
+            config.training = iteration < trainingIterations ? 1 : 0
+        }
+
+        var config = config
+        if baselinePassesLeft > 0 {
+            config.bsdf_fraction = 1
+            config.training = 0
+        }
+        encoder.setBytes(&config, length: MemoryLayout<GuidingConfig>.stride, index: Int(kernel_buffers.guiding_config.rawValue))
+        encoder.setBuffer(spatialNodes, offset: 0, index: Int(kernel_buffers.guiding_spatial_nodes.rawValue))
+        encoder.setBuffer(directionalNodes, offset: 0, index: Int(kernel_buffers.guiding_directional_nodes.rawValue))
+        encoder.setBuffer(trainingEnergy, offset: 0, index: Int(kernel_buffers.guiding_training_energy.rawValue))
+        encoder.setBuffer(trainingCounts, offset: 0, index: Int(kernel_buffers.guiding_training_counts.rawValue))
+        encoder.setBuffer(statistics, offset: 0, index: Int(kernel_buffers.guiding_statistics.rawValue))
+    }
+
+    /// Binds a disabled field, for the camera kernel of engines without guiding.
+    static func encodeDisabled(encoder: MTLComputeCommandEncoder, placeholder: MTLBuffer) {
+        var config = GuidingConfig()
+        encoder.setBytes(&config, length: MemoryLayout<GuidingConfig>.stride, index: Int(kernel_buffers.guiding_config.rawValue))
+        for index in [kernel_buffers.guiding_spatial_nodes, .guiding_directional_nodes, .guiding_training_energy, .guiding_training_counts, .guiding_statistics] {
+            encoder.setBuffer(placeholder, offset: 0, index: Int(index.rawValue))
+        }
+    }
+
+    /// Must be called once per pass, after all views of the pass are encoded into `commandBuffer`, before it is committed.
+    /// Collects variance of the pass, and ends the training iteration after its last pass.
+    func passEncoded(commandBuffer: MTLCommandBuffer) {
+        let slot = Int(config.statistics_slot)
+        let generation: Int? = baselinePassesLeft > 0 ? nil : generation
+        let statistics = statistics
+        commandBuffer.addCompletedHandler { [weak self] _ in
+            let pointer = statistics.contents().assumingMemoryBound(to: GuidingPassStatistics.self) + slot
+            let result = pointer.pointee
+            pointer.pointee = GuidingPassStatistics()
+            // Pass 1 has no accumulation to compare with
+            guard let self, result.pixels > 0 else { return }
+            self.lock.lock()
+            self.passes.append((generation, Double(result.squared_error / result.pixels)))
+            self.lock.unlock()
+        }
+        config.statistics_slot = UInt32((slot + 1) % Self.statisticsSlots)
+
+        if baselinePassesLeft > 0 {
+            baselinePassesLeft -= 1
+            return
+        }
+        guard config.training != 0 else { return }
+        passesInIteration += 1
+        guard passesInIteration == 1 << iteration else { return }
+        // Later passes don't train, until the rebuilt trees are installed
+        config.training = 0
+        let trees = trees
+        let trainingEnergy = trainingEnergy
+        let trainingCounts = trainingCounts
+        let iteration = iteration
+        let passes = passesInIteration
+        commandBuffer.addCompletedHandler { [weak self] _ in
+            DispatchQueue.global(qos: .userInitiated).async {
+                let start = Date.now
+                let result = Tracer.interval("Guiding rebuild", detail: "iteration \(iteration)") {
+                    Self.rebuild(
+                        trees,
+                        energy: UnsafeBufferPointer(start: trainingEnergy.contents().assumingMemoryBound(to: Float.self), count: trees.directional.count),
+                        counts: UnsafeBufferPointer(start: trainingCounts.contents().assumingMemoryBound(to: UInt32.self), count: trees.spatial.count),
+                        iteration: iteration
+                    )
+                }
+                let summary = Iteration(passes: passes, spatialLeaves: result.spatialLeaves, directionalNodes: result.directional.count, rebuildSeconds: Date.now.timeIntervalSince(start))
+                guard let self else { return }
+                self.lock.lock()
+                self.rebuilt = result
+                self.iterations.append(summary)
+                self.lock.unlock()
+            }
+        }
+    }
+
+    /// Training iterations and variance of passes so far, must be called after passes have completed.
+    var report: Report {
+        lock.lock()
+        defer { lock.unlock() }
+        let unguided = passes.filter { $0.generation == nil }.map(\.variance)
+        let baseline = unguided.isEmpty ? nil : unguided.reduce(0, +) / Double(unguided.count)
+        return Report(
+            iterations: iterations,
+            baselineVariance: baseline,
+            passes: passes.map { pass in
+                Pass(generation: pass.generation, variance: pass.variance, varianceReduction: baseline.flatMap { pass.variance > 0 ? $0 / pass.variance : nil })
+            }
+        )
+    }
+
+    /// Spatial leaves that recorded many bounces are split in half, copying their directional trees.
+    /// Directional trees are rebuilt from learned energy: nodes with enough of it are subdivided, others are merged.
+    /// Trees that learned nothing keep their previous distribution.
+    private static func rebuild(_ trees: Trees, energy: UnsafeBufferPointer<Float>, counts: UnsafeBufferPointer<UInt32>, iteration: Int) -> Trees {
+        // Children are always after their parents, so energy is summed up from leaves in reverse order
+        var learned = [Float](repeating: 0, count: trees.directional.count)
+        for i in trees.directional.indices.reversed() {
+            let child = Int(trees.directional[i].child)
+            learned[i] = child == 0 ? energy[i] : learned[child..<child + 4].reduce(0, +)
+        }
+
+        var result = Trees(spatial: [], directional: [])
+        let spatialPlaceholder = GuidingSpatialNode()
+        let directionalPlaceholder = GuidingDirectionalNode()
+        let threshold = spatialThreshold * Float(1 << iteration).squareRoot()
+
+        func buildDirectional(_ index: Int, old: Int?, energy: Float, total: Float, depth: Int) {
+            guard depth < maxDirectionalDepth, energy > total * directionalThreshold else {
+                result.directional[index] = GuidingDirectionalNode(child: 0, energy: energy)
+                return
+            }
+            let child = result.directional.count
+            result.directional.append(contentsOf: repeatElement(directionalPlaceholder, count: 4))
+            result.directional[index] = GuidingDirectionalNode(child: UInt32(child), energy: energy)
+            let oldChild = old.map { Int(trees.directional[$0].child) } ?? 0
+            for i in 0..<4 {
+                if oldChild != 0 {
+                    buildDirectional(child + i, old: oldChild + i, energy: learned[oldChild + i], total: total, depth: depth + 1)
+                } else {
+                    buildDirectional(child + i, old: nil, energy: energy / 4, total: total, depth: depth + 1)
+                }
+            }
+        }
+
+        func copyDirectional(_ index: Int, old: Int) {
+            let node = trees.directional[old]
+            guard node.child != 0 else {
+                result.directional[index] = node
+                return
+            }
+            let child = result.directional.count
+            result.directional.append(contentsOf: repeatElement(directionalPlaceholder, count: 4))
+            result.directional[index] = GuidingDirectionalNode(child: UInt32(child), energy: node.energy)
+            for i in 0..<4 {
+                copyDirectional(child + i, old: Int(node.child) + i)
+            }
+        }
+
+        func buildSpatial(_ index: Int, old: Int, count: Float, depth: Int) {
+            let node = trees.spatial[old]
+            let child = result.spatial.count
+            if node.axis <= 2 {
+                result.spatial.append(contentsOf: [spatialPlaceholder, spatialPlaceholder])
+                result.spatial[index] = GuidingSpatialNode(axis: node.axis, child: UInt32(child))
+                for i in 0..<2 {
+                    let oldChild = Int(node.child) + i
+                    buildSpatial(child + i, old: oldChild, count: Float(counts[oldChild]), depth: depth + 1)
+                }
+            } else if count > threshold && depth < maxSpatialDepth {
+                // Axes alternate with depth, both halves start from the distribution of the whole leaf
+                result.spatial.append(contentsOf: [spatialPlaceholder, spatialPlaceholder])
+                result.spatial[index] = GuidingSpatialNode(axis: UInt32(depth % 3), child: UInt32(child))
+                for i in 0..<2 {
+                    buildSpatial(child + i, old: old, count: count / 2, depth: depth + 1)
+                }
+            } else {
+                let oldRoot = Int(node.child)
+                let root = result.directional.count
+                result.directional.append(directionalPlaceholder)
+                if learned[oldRoot] > 0 {
+                    buildDirectional(root, old: oldRoot, energy: learned[oldRoot], total: learned[oldRoot], depth: 0)
+                } else {
+                    copyDirectional(root, old: oldRoot)
+                }
+                result.spatial[index] = GuidingSpatialNode(axis: 3, child: UInt32(root))
+            }
+        }
+
+        result.spatial.append(spatialPlaceholder)
+        buildSpatial(0, old: 0, count: Float(counts[0]), depth: 0)
+        return result
+    }
+}
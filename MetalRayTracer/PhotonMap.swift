@@ -0,0 +1,177 @@
+//
+//  PhotonMap.swift
+//  MetalRayTracer
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+
+import Metal
+
+/// Caustic photon pass that runs before every pass of the camera kernel, see `PhotonMapConfig`.
+/// Photons are traced, counted per hash grid cell, and sorted by cell, so that photons of a cell are contiguous.
+/// Camera paths gather them in `ray_tracing_kernel`, which adds caustics to the samples, and shrinks gather radii per pixel.
+/// Shared by all views of a scene, the map is traced once per pass and gathered by every view.
+final class PhotonMapper {
+    static let defaultPhotonsPerPass = 1 << 18
+
+    let config: PhotonMapConfig
+    private let emitters: MTLBuffer
+    private let tracingPipeline: MTLComputePipelineState
+    private let intersectionFunctionsTable: any MTLIntersectionFunctionTable
+    private let clearPipeline: MTLComputePipelineState
+    private let prefixSumPipeline: MTLComputePipelineState
+    private let sortPipeline: MTLComputePipelineState
+    private let photons: MTLBuffer
+    private let sortedPhotons: MTLBuffer
+    private let photonCounter: MTLBuffer
+    private let cellCounts: MTLBuffer
+    private let cellStarts: MTLBuffer
+
+    /// Returns nil if the scene cannot have caustics: it has no dielectrics, or nothing emits photons.
+    /// Scene archives are not supported, because emitters and dielectrics are found among Swift objects.
+    init?(scene: Scene, photonsPerPass: Int, library: MTLLibrary, constants: MTLFunctionConstantValues, intersectionFunctions: [Int: MTLFunction], device: MTLDevice) {
+        guard photonsPerPass > 0, scene.archive == nil, let (config, emitters) = Self.makeConfig(scene: scene, photonsPerPass: photonsPerPass) else {
+            return nil
+        }
+        self.config = config
+        self.emitters = device.makeBuffer(bytes: emitters, length: max(MemoryLayout<PhotonEmitter>.stride * emitters.count, 1), options: .storageModeShared)!
+
+        let tracing = try! library.makeFunction(name: "photon_tracing_kernel", constantValues: constants)
+        (tracingPipeline, intersectionFunctionsTable) = RenderEngine.makeRayTracingPipeline(function: tracing, intersectionFunctions: intersectionFunctions, device: device)
+        func makePipeline(_ name: String) -> MTLComputePipelineState {
+            try! device.makeComputePipelineState(function: library.makeFunction(name: name)!)
+        }
+        clearPipeline = makePipeline("photon_clear_kernel")
+        prefixSumPipeline = makePipeline("photon_prefix_sum_kernel")
+        sortPipeline = makePipeline("photon_sort_kernel")
+
+        let photonBytes = MemoryLayout<Photon>.stride * Int(config.max_stored_photons)
+        let cellBytes = MemoryLayout<UInt32>.stride * Int(config.cell_count)
+        photons = device.makeBuffer(length: photonBytes, options: .storageModePrivate)!
+        sortedPhotons = device.makeBuffer(length: photonBytes, options: .storageModePrivate)!
+        photonCounter = device.makeBuffer(length: MemoryLayout<UInt32>.stride, options: .storageModePrivate)!
+        cellCounts = device.makeBuffer(length: cellBytes, options: .storageModePrivate)!
+        cellStarts = device.makeBuffer(length: cellBytes, options: .storageModePrivate)!
+    }
+
+    /// Encodes the photon pass, and binds its results for the camera kernel dispatched next into the same encoder.
+    /// Scene resources, camera and render config must already be bound.
+    func encode(encoder: MTLComputeCommandEncoder) {
+        bind(encoder: encoder)
+
+        // Barriers are no-ops in serial encoders, but order the steps in concurrent ones, see `MultiViewRenderer`
+        dispatch(encoder, clearPipeline, count: Int(config.cell_count))
+        encoder.memoryBarrier(scope: .buffers)
+        encoder.setIntersectionFunctionTable(intersectionFunctionsTable, bufferIndex: Int(kernel_buffers.function_table.rawValue))
+        dispatch(encoder, tracingPipeline, count: Int(config.photon_count))
+        encoder.memoryBarrier(scope: .buffers)
+        encoder.setComputePipelineState(prefixSumPipeline)
+        let threads = min(prefixSumPipeline.maxTotalThreadsPerThreadgroup, 1024)
+        encoder.dispatchThreadgroups(MTLSize(width: 1, height: 1, depth: 1), threadsPerThreadgroup: MTLSize(width: threads, height: 1, depth: 1))
+        encoder.memoryBarrier(scope: .buffers)
+        dispatch(encoder, sortPipeline, count: Int(config.max_stored_photons))
+        encoder.memoryBarrier(scope: .buffers)
+    }
+
+    /// Binds the photon map encoded earlier into the same encoder, for camera kernels of other views of the scene.
+    func bind(encoder: MTLComputeCommandEncoder) {
+        var config = config
+        encoder.setBytes(&config, length: MemoryLayout<PhotonMapConfig>.stride, index: Int(kernel_buffers.photon_config.rawValue))
+        encoder.setBuffer(emitters, offset: 0, index: Int(kernel_buffers.photon_emitters.rawValue))
+        encoder.setBuffer(photons, offset: 0, index: Int(kernel_buffers.photons.rawValue))
+        encoder.setBuffer(sortedPhotons, offset: 0, index: Int(kernel_buffers.sorted_photons.rawValue))
+        encoder.setBuffer(photonCounter, offset: 0, index: Int(kernel_buffers.photon_counter.rawValue))
+        encoder.setBuffer(cellCounts, offset: 0, index: Int(kernel_buffers.photon_cell_counts.rawValue))
+        encoder.setBuffer(cellStarts, offset: 0, index: Int(kernel_buffers.photon_cell_starts.rawValue))
+    }
+
+    private func dispatch(_ encoder: MTLComputeCommandEncoder, _ pipeline: MTLComputePipelineState, count: Int) {
+        encoder.setComputePipelineState(pipeline)
+        encoder.dispatchThreads(MTLSize(width: count, height: 1, depth: 1), threadsPerThreadgroup: MTLSize(width: pipeline.threadExecutionWidth, height: 1, depth: 1))
+    }
+
+    /// Binds an empty photon map, for the camera kernel of scenes without one.
+    static func encodeDisabled(encoder: MTLComputeCommandEncoder, placeholder: MTLBuffer) {
+        var config = PhotonMapConfig()
+        encoder.setBytes(&config, length: MemoryLayout<PhotonMapConfig>.stride, index: Int(kernel_buffers.photon_config.rawValue))
+        encoder.setBuffer(placeholder, offset: 0, index: Int(kernel_buffers.sorted_photons.rawValue))
+        encoder.setBuffer(placeholder, offset: 0, index: Int(kernel_buffers.photon_cell_counts.rawValue))
+        encoder.setBuffer(placeholder, offset: 0, index: Int(kernel_buffers.photon_cell_starts.rawValue))
+    }
+
+    /// Dielectric objects cast caustics. Photons are emitted by emissive quads, and by the background aimed at the casters.
+    /// Emissive quads only emit photons if there are no other emissive objects, otherwise camera paths
+    /// could not tell which light is covered by photons, and all emissive caustics are left to them.
+    static func makeConfig(scene: Scene, photonsPerPass: Int) -> (PhotonMapConfig, [PhotonEmitter])? {
+        var casterBox: MTLAxisAlignedBoundingBox = .empty
+        var sceneBox: MTLAxisAlignedBoundingBox = .empty
+        var hasCasters = false
+        var emissiveCount = 0
+        var emitters: [PhotonEmitter] = []
+        var fluxes: [Float] = []
+        for object in scene.objects {
+            var reserver = MaterialReserver()
+            object.visitMaterials(&reserver)
+            let box = object.boundingBox
+            sceneBox.unite(with: box)
+            if reserver.counts[Int(MaterialKind.material_kind_dielectric.rawValue)] > 0 {
+                casterBox.unite(with: box)
+                hasCasters = true
+            }
+            emissiveCount += reserver.counts[Int(MaterialKind.material_kind_emissive_colored.rawValue)]
+            if let quad = object as? Quad, let material = quad.material as? ColoredEmissive {
+                emitters.append(PhotonEmitter(origin: quad.origin, u: quad.u, v: quad.v, radiance: material.albedo, cdf: 0))
+                fluxes.append(2 * .pi * luminance(material.albedo) * length(cross(quad.u, quad.v)))
+            }
+        }
+        guard hasCasters else { return nil }
+        if emitters.count != emissiveCount {
+            emitters = []
+            fluxes = []
+        }
+
+        let casterCenter = (casterBox.min.asUnpacked + casterBox.max.asUnpacked) / 2
+        let casterRadius = length(casterBox.max.asUnpacked - casterBox.min.asUnpacked) / 2
+        let sceneCenter = (sceneBox.min.asUnpacked + sceneBox.max.asUnpacked) / 2
+        let sceneRadius = length(sceneBox.max.asUnpacked - sceneBox.min.asUnpacked) / 2
+
+        // Average luminance of the background, times the area of the disk facing the casters, times the sphere of directions
+        var backgroundFlux: Float = 0
+        if scene.camera.impl.background == .background_lighting_sky {
+            // `background_color()` is linear in the elevation, so its average is the luminance at the horizon
+            backgroundFlux = 0.68
+        } else if scene.camera.impl.background == .background_lighting_environment {
+            backgroundFlux = scene.environment?.averageLuminance ?? 0
+        }
+        backgroundFlux *= .pi * casterRadius * casterRadius * 4 * .pi
+
+        let totalFlux = fluxes.reduce(0, +) + backgroundFlux
+        guard totalFlux > 0 else { return nil }
+        var cdf: Float = 0
+        for i in emitters.indices {
+            cdf += fluxes[i] / totalFlux
+            emitters[i].cdf = cdf
+        }
+        if backgroundFlux == 0, !emitters.isEmpty {
+            emitters[emitters.count - 1].cdf = 1
+        }
+
+        var config = PhotonMapConfig()
+        config.photon_count = UInt32(photonsPerPass)
+        config.max_stored_photons = UInt32(photonsPerPass)
+        config.emitter_count = UInt32(emitters.count)
+        config.background_emits = backgroundFlux > 0 ? 1 : 0
+        config.caster_center = casterCenter
+        config.caster_radius = casterRadius
+        config.background_distance = length(sceneCenter - casterCenter) + sceneRadius
+        config.max_radius = 0.02 * casterRadius
+        config.initial_radius_scale = 4
+        config.alpha = 2.0 / 3.0
+        config.cell_count = UInt32(1) << UInt32(Int.bitWidth - (photonsPerPass - 1).leadingZeroBitCount)
+        return (config, emitters)
+    }
+
+    private static func luminance(_ color: vector_float3) -> Float {
+        dot(color, vector_float3(0.2126, 0.7152, 0.0722))
+    }
+}
@@ -7,6 +7,7 @@
 
 extension __Sphere: RenderableImpl {
     static var intersectionFunctionName: String { "sphereIntersectionFunction" }
+    static var materialHandleOffsets: [Int] { [MemoryLayout<Self>.offset(of: \.material)!] }
 }
 
 struct Sphere: Renderable {
@@ -37,13 +38,20 @@ struct Sphere: Renderable {
     }
 
     func asImpl(_ encoder: inout MaterialEncoder) -> __Sphere {
-        let materialOffset = encoder.encode(material)
-        return __Sphere(transform: transform.asImpl, radius: radius, material_offset: materialOffset)
+        return __Sphere(
+            center: transform.translation,
+            rotation: transform.compactRotation,
+            radius: radius,
+            material: encoder.encode(material)
+        )
     }
 }
 
 extension __Cylinder: RenderableImpl {
     static var intersectionFunctionName: String { "cylinderIntersectionFunction" }
+    static var materialHandleOffsets: [Int] {
+        [\Self.bottom_material, \Self.top_material, \Self.side_material].map { MemoryLayout<Self>.offset(of: $0)! }
+    }
 }
 
 struct Cylinder: Renderable {
@@ -131,22 +139,27 @@ struct Cylinder: Renderable {
     }
 
     func asImpl(_ encoder: inout MaterialEncoder) -> __Cylinder {
-        let bottomOffset = encoder.encode(self.bottom)
-        let topOffset = encoder.encode(self.top)
-        let sideOffset = encoder.encode(self.side)
+        let bottomMaterial = encoder.encode(self.bottom)
+        let topMaterial = encoder.encode(self.top)
+        let sideMaterial = encoder.encode(self.side)
         return __Cylinder(
-            transform: transform.asImpl,
+            translation: transform.translation,
+            rotation: transform.compactRotation,
             radius: radius,
             height: height,
-            bottom_material_offset: bottomOffset,
-            top_material_offset: topOffset,
-            side_material_offset: sideOffset
+            bottom_material: bottomMaterial,
+            top_material: topMaterial,
+            side_material: sideMaterial
         )
     }
 }
 
 extension __Cuboid: RenderableImpl {
     static var intersectionFunctionName: String { "cuboidIntersectionFunction" }
+    static var materialHandleOffsets: [Int] {
+        let start = MemoryLayout<Self>.offset(of: \.material)!
+        return (0..<6).map { start + $0 * MemoryLayout<MaterialHandle>.stride }
+    }
 }
 
 struct Cuboid: Renderable {
@@ -186,9 +199,10 @@ struct Cuboid: Renderable {
     func asImpl(_ encoder: inout MaterialEncoder) -> __Cuboid {
         let mat = encoder.encode(material)
         return __Cuboid(
-            transform: transform.asImpl,
+            translation: transform.translation,
             size: size,
-            material_offset: (mat, mat, mat, mat, mat, mat)
+            rotation: transform.compactRotation,
+            material: (mat, mat, mat, mat, mat, mat)
         )
     }
 }
@@ -197,6 +211,7 @@ extension __Quad: RenderableImpl {
     static var intersectionFunctionName: String {
         "quadIntersectionFunction"
     }
+    static var materialHandleOffsets: [Int] { [MemoryLayout<Self>.offset(of: \.material)!] }
 }
 
 struct Quad: Renderable {
@@ -264,12 +279,10 @@ struct Quad: Renderable {
     }
 
     func asImpl(_ encoder: inout MaterialEncoder) -> __Quad {
-        let materialOffset = encoder.encode(material)
+        let materialHandle = encoder.encode(material)
         let n = cross(u, v)
-        let lenSq = length_squared(n)
-        let w = n / lenSq
-        let normal = n / lenSq.squareRoot()
-        let d = dot(origin, normal)
-        return __Quad(origin: origin, u: u, v: v, w: w, normal: normal, d: d, material_offset: materialOffset)
+        let w = n / length_squared(n)
+        let d = dot(origin, w)
+        return __Quad(origin: origin, u: u, v: v, w: w, d: d, material: materialHandle)
     }
 }
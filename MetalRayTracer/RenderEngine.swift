@@ -0,0 +1,414 @@
+//
+//  RenderEngine.swift
+//  MetalRayTracer
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+
+import Metal
+
+/// GPU state needed to render a scene progressively: acceleration structure, pipeline and accumulated moments.
+/// Shared by the interactive `Renderer` and the headless `SceneBenchmark`.
+class RenderEngine {
+    let device: MTLDevice
+    let commandQueue: MTLCommandQueue
+    let sceneBuffers: SceneBuffers
+    let pipeline: MTLComputePipelineState
+    let intersectionFunctionsTable: any MTLIntersectionFunctionTable
+    /// Environment map and its `EnvironmentAliasEntry` per texel, black if the scene has none.
+    let environmentTexture: MTLTexture
+    let environmentAliasTable: MTLBuffer
+    /// Wall time of scene ingestion and pipeline compilation on the CPU.
+    let setupTimings: StageTimings
+    /// Number of rays traced by the kernel, incremented by all passes until reset.
+    let rayCounter: MTLBuffer
+    /// Caustic photons traced before every pass, nil if the scene has no caustics or they are disabled.
+    let photonMapper: PhotonMapper?
+    /// Learns where light comes from and guides diffuse bounces, nil if the scene has no diffuse materials or it is disabled.
+    let pathGuiding: PathGuiding?
+    /// Bound in place of photon and guiding buffers when they are disabled.
+    private let placeholder: MTLBuffer
+    /// `PixelMoments` and `PixelFeatures` per pixel, rows from top to bottom.
+    private var moments: MTLBuffer?
+    private var features: MTLBuffer?
+    /// `PixelPhotonStats` per pixel, gather radii of caustic photons. Not reprojected, restarts on camera changes.
+    private var photonStats: MTLBuffer?
+    /// Buffers of the previous camera, read when reprojecting. Swapped with the current ones on camera changes.
+    private var historyMoments: MTLBuffer?
+    private var historyFeatures: MTLBuffer?
+    private var pixelBuffersSize: (width: Int, height: Int) = (0, 0)
+    /// Samples per pixel averaged into `features` and `costTexture`, see `RenderConfig.feature_samples`.
+    private var featureSamples = 0
+    /// Average cost per sample: intersection tests, enumerator steps and bounces in RGB channels.
+    /// Only written by passes with a heatmap output mode, or all passes if `measuresCost` is set.
+    private(set) var costTexture: MTLTexture?
+    var measuresCost = false
+    /// Variant of `pipeline` that measures cost, see `kernel_function_constant_cost`.
+    private let costPipeline: CostPipeline
+    /// One `RenderStatistics` per SIMD-group of the last pass, only used if `ENABLE_STATISTICS` is set.
+    private var statisticsSlots: MTLBuffer?
+    private var statisticsSlotCount = 0
+
+    /// With `specialize` the kernel is compiled only for material kinds and lighting present in the scene,
+    /// see `kernel_function_constants`. With `streamTextures` rendering starts with placeholder textures,
+    /// see `SceneBuffers.init()`. `photonsPerPass` of 0 disables caustic photons, see `PhotonMapper`.
+    /// `guidingIterations` of 0 disables path guiding, see `PathGuiding`, which renders `guidingBaselinePasses` unguided first.
+    init(scene: Scene, device: MTLDevice, commandQueue: MTLCommandQueue, motionSegments: Int = SceneBuffers.defaultMotionSegments, specialize: Bool = true, streamTextures: Bool = false,
+         photonsPerPass: Int = PhotonMapper.defaultPhotonsPerPass, guidingIterations: Int = PathGuiding.defaultTrainingIterations, guidingBaselinePasses: Int = 0) {
+        self.device = device
+        self.commandQueue = commandQueue
+
+        sceneBuffers = SceneBuffers(scene: scene, device: device, commandQueue: commandQueue, motionSegments: motionSegments, streamTextures: streamTextures)
+        var timings = sceneBuffers.timings
+
+        let environment = scene.environment ?? .empty
+        let aliasTable = timings.measure("Environment alias table", category: "cpu") {
+            environment.makeAliasTable()
+        }
+        environmentTexture = environment.makeTexture(device: device)
+        environmentAliasTable = device.makeBuffer(bytes: aliasTable, length: MemoryLayout<EnvironmentAliasEntry>.stride * aliasTable.count, options: .storageModeShared)!
+
+        let lib = device.makeDefaultLibrary()!
+        let constants = MTLFunctionConstantValues()
+        var materialKinds = specialize ? sceneBuffers.materialKinds : ~0
+        var hasEnvironment = !specialize || scene.environment != nil
+        constants.setConstantValue(&materialKinds, type: .uint, index: Int(kernel_function_constant_material_kinds.rawValue))
+        constants.setConstantValue(&hasEnvironment, type: .bool, index: Int(kernel_function_constant_environment.rawValue))
+        var measureCost = false
+        constants.setConstantValue(&measureCost, type: .bool, index: Int(kernel_function_constant_cost.rawValue))
+
+        // Load functions from Metal library, archives only name functions from `SceneArchive.primitiveTypes`
+        let functionNames = sceneBuffers.intersectionFunctions
+        let functions = functionNames.mapValues { name in
+            try! lib.makeFunction(name: name, constantValues: constants)
+        }
+
+        // Photon pipelines are specialized for the scene too, the camera kernel only needs to know whether there are photons
+        let photonMapper = timings.measure("Photon map", category: "cpu") {
+            PhotonMapper(scene: scene, photonsPerPass: photonsPerPass, library: lib, constants: constants, intersectionFunctions: functions, device: device)
+        }
+        var hasPhotons = !specialize || photonMapper != nil
+        constants.setConstantValue(&hasPhotons, type: .bool, index: Int(kernel_function_constant_photons.rawValue))
+
+        // Only bounces of materials with `diffuse_pdf()` are guided
+        let diffuseKinds: [MaterialKind] = [.material_kind_lambertian_colored, .material_kind_lambertian_textured, .material_kind_lambertian_perlin_noise, .material_kind_isotropic_colored]
+        let hasDiffuse = diffuseKinds.contains { sceneBuffers.materialKinds & (1 << $0.rawValue) != 0 }
+        let pathGuiding = guidingIterations > 0 && hasDiffuse && sceneBuffers.bounds.isFinite
+            ? PathGuiding(bounds: sceneBuffers.bounds, trainingIterations: guidingIterations, baselinePasses: guidingBaselinePasses, device: device)
+            : nil
+        var hasGuiding = !specialize || pathGuiding != nil
+        constants.setConstantValue(&hasGuiding, type: .bool, index: Int(kernel_function_constant_guiding.rawValue))
+        let kernel = try! lib.makeFunction(name: "ray_tracing_kernel", constantValues: constants)
+
+        (pipeline, intersectionFunctionsTable) = timings.measure("Pipeline", category: "cpu") {
+            Self.makeRayTracingPipeline(function: kernel, intersectionFunctions: functions, device: device)
+        }
+        let costConstants = constants.copy() as! MTLFunctionConstantValues
+        measureCost = true
+        costConstants.setConstantValue(&measureCost, type: .bool, index: Int(kernel_function_constant_cost.rawValue))
+        costPipeline = CostPipeline {
+            let kernel = try! lib.makeFunction(name: "ray_tracing_kernel", constantValues: costConstants)
+            let functions = functionNames.mapValues { name in
+                try! lib.makeFunction(name: name, constantValues: costConstants)
+            }
+            return Self.makeRayTracingPipeline(function: kernel, intersectionFunctions: functions, device: device)
+        }
+        setupTimings = timings
+        self.photonMapper = photonMapper
+        self.pathGuiding = pathGuiding
+        placeholder = device.makeBuffer(length: MemoryLayout<Photon>.stride, options: .storageModePrivate)!
+
+        rayCounter = device.makeBuffer(length: MemoryLayout<UInt32>.stride, options: .storageModeShared)!
+        resetRayCounter()
+    }
+
+    /// Compute pipeline of a kernel that traces rays, with its table of intersection functions linked into it.
+    static func makeRayTracingPipeline(function: MTLFunction, intersectionFunctions functions: [Int: MTLFunction], device: MTLDevice) -> (MTLComputePipelineState, any MTLIntersectionFunctionTable) {
+        let functionsTableSize = functions.keys.max().map { $0 + 1 } ?? 0
+
+        // Attach functions to ray tracing compute pipeline descriptor
+        let linkedFunctions = MTLLinkedFunctions()
+        linkedFunctions.functions = Array(functions.values)
+
+        let pipelineDescriptor = MTLComputePipelineDescriptor()
+        pipelineDescriptor.computeFunction = function
+        pipelineDescriptor.linkedFunctions = linkedFunctions
+
+        let pipeline = try! device.makeComputePipelineState(descriptor: pipelineDescriptor, options: [], reflection: nil)
+
+        // Allocate intersection function table
+        let descriptor = MTLIntersectionFunctionTableDescriptor()
+        descriptor.functionCount = functionsTableSize
+
+        let functionTable = pipeline.makeIntersectionFunctionTable(descriptor: descriptor)!
+        for i in 0..<functionsTableSize {
+            guard let f = functions[i] else { continue }
+            // Get a handle to the linked intersection function in the pipeline state
+            let functionHandle = pipeline.functionHandle(function: f)
+
+            // Insert the function handle into the table
+            functionTable.setFunction(functionHandle, index: i)
+        }
+        return (pipeline, functionTable)
+    }
+
+    /// Another view of the same scene: shares scene buffers, pipeline and environment with `engine`,
+    /// but accumulates into its own pixel buffers and counters. Both engines gather the same photon map and train the same guiding field.
+    init(sharing engine: RenderEngine) {
+        device = engine.device
+        commandQueue = engine.commandQueue
+        sceneBuffers = engine.sceneBuffers
+        pipeline = engine.pipeline
+        intersectionFunctionsTable = engine.intersectionFunctionsTable
+        costPipeline = engine.costPipeline
+        environmentTexture = engine.environmentTexture
+        environmentAliasTable = engine.environmentAliasTable
+        setupTimings = engine.setupTimings
+        photonMapper = engine.photonMapper
+        pathGuiding = engine.pathGuiding
+        placeholder = engine.placeholder
+        rayCounter = device.makeBuffer(length: MemoryLayout<UInt32>.stride, options: .storageModeShared)!
+        resetRayCounter()
+    }
+
+    var rayCount: UInt32 {
+        rayCounter.contents().load(as: UInt32.self)
+    }
+
+    func resetRayCounter() {
+        rayCounter.contents().storeBytes(of: 0, as: UInt32.self)
+    }
+
+    /// Encodes one progressive pass into `outputTexture`.
+    /// Pass counter 1 starts accumulation from scratch, or from the accumulation of `historyCamera` reprojected into `camera`,
+    /// if it is given, and `renderConfig` allows history samples.
+    func encodePass(commandBuffer: MTLCommandBuffer, outputTexture: MTLTexture, camera: CameraConfig, renderConfig: RenderConfig, historyCamera: CameraConfig? = nil) {
+        Tracer.interval("Encode pass") {
+            doEncodePass(commandBuffer: commandBuffer, outputTexture: outputTexture, camera: camera, renderConfig: renderConfig, historyCamera: historyCamera)
+            pathGuiding?.passEncoded(commandBuffer: commandBuffer)
+        }
+        Tracer.gpuInterval("Pass", commandBuffer: commandBuffer, detail: "pass \(renderConfig.impl.pass_counter)")
+    }
+
+    private func doEncodePass(commandBuffer: MTLCommandBuffer, outputTexture: MTLTexture, camera: CameraConfig, renderConfig: RenderConfig, historyCamera: CameraConfig?) {
+        let renderEncoder = commandBuffer.makeComputeCommandEncoder()!
+        encodePass(encoder: renderEncoder, outputTexture: outputTexture, camera: camera, renderConfig: renderConfig, historyCamera: historyCamera)
+        renderEncoder.endEncoding()
+    }
+
+    /// Same as `encodePass(commandBuffer:...)`, but dispatches into an existing encoder,
+    /// so that passes of several views can run concurrently. The caller ends the pass of `pathGuiding`.
+    /// Without `tracePhotons` the pass gathers the photon map traced earlier in the encoder by another view.
+    func encodePass(encoder renderEncoder: MTLComputeCommandEncoder, outputTexture: MTLTexture, camera: CameraConfig, renderConfig: RenderConfig, historyCamera: CameraConfig? = nil, tracePhotons: Bool = true) {
+        var renderConfig = renderConfig
+        var historyCamera = historyCamera
+        let hasHistory = moments != nil && pixelBuffersSize == (outputTexture.width, outputTexture.height)
+        if renderConfig.impl.pass_counter == 1, renderConfig.impl.max_history_samples > 0, historyCamera != nil, hasHistory {
+            swap(&moments, &historyMoments)
+            swap(&features, &historyFeatures)
+        } else {
+            renderConfig.impl.max_history_samples = 0
+            historyCamera = nil
+        }
+        if renderConfig.impl.pass_counter == 1 {
+            featureSamples = 0
+        }
+
+        renderEncoder.setTexture(outputTexture, index: Int(kernel_buffers.output_texture.rawValue))
+        renderEncoder.setBuffer(getMomentsBuffer(width: outputTexture.width, height: outputTexture.height), offset: 0, index: Int(kernel_buffers.moments.rawValue))
+        renderEncoder.setBuffer(getFeaturesBuffer(width: outputTexture.width, height: outputTexture.height), offset: 0, index: Int(kernel_buffers.features.rawValue))
+        renderEncoder.setBuffer(historyMoments, offset: 0, index: Int(kernel_buffers.history_moments.rawValue))
+        renderEncoder.setBuffer(historyFeatures, offset: 0, index: Int(kernel_buffers.history_features.rawValue))
+        var camera = camera
+        renderEncoder.setBytes(&camera, length: MemoryLayout<CameraConfig>.stride, index: Int(kernel_buffers.camera_config.rawValue))
+        // Not read without history, but must be bound
+        var history = historyCamera ?? camera
+        renderEncoder.setBytes(&history, length: MemoryLayout<CameraConfig>.stride, index: Int(kernel_buffers.history_camera_config.rawValue))
+        // After binding pixel buffers, which start features over when reallocated
+        renderConfig.impl.feature_samples = UInt32(featureSamples)
+        featureSamples += Int(renderConfig.impl.samples_per_pixel)
+        renderEncoder.setBytes(&renderConfig, length: MemoryLayout<RenderConfig>.stride, index: Int(kernel_buffers.render_config.rawValue))
+        renderEncoder.setAccelerationStructure(sceneBuffers.accelerationStructure, bufferIndex: Int(kernel_buffers.acceleration_structure.rawValue))
+        renderEncoder.setBuffer(sceneBuffers.materialsBuffer, offset: 0, index: Int(kernel_buffers.materials.rawValue))
+        renderEncoder.setTexture(environmentTexture, index: Int(kernel_buffers.environment_texture.rawValue))
+        renderEncoder.setBuffer(environmentAliasTable, offset: 0, index: Int(kernel_buffers.environment_alias_table.rawValue))
+        renderEncoder.setBuffer(rayCounter, offset: 0, index: Int(kernel_buffers.ray_counter.rawValue))
+        renderEncoder.setBuffer(photonStats, offset: 0, index: Int(kernel_buffers.photon_stats.rawValue))
+
+        for texture in sceneBuffers.textureLoader.textures.values {
+            renderEncoder.useResource(texture, usage: .read)
+        }
+
+        // Photons are traced with the same seed, scene and camera, and bind the map they build for the camera kernel
+        if let photonMapper, tracePhotons {
+            photonMapper.encode(encoder: renderEncoder)
+        } else if let photonMapper {
+            photonMapper.bind(encoder: renderEncoder)
+        } else {
+            PhotonMapper.encodeDisabled(encoder: renderEncoder, placeholder: placeholder)
+        }
+        if let pathGuiding {
+            pathGuiding.encode(encoder: renderEncoder)
+        } else {
+            PathGuiding.encodeDisabled(encoder: renderEncoder, placeholder: placeholder)
+        }
+        // Color passes don't count intersection tests, and don't bind the cost texture
+        let measureCost = measuresCost || renderConfig.impl.output_mode != .output_mode_color
+        let (pipeline, intersectionFunctionsTable) = measureCost ? costPipeline.value : (self.pipeline, self.intersectionFunctionsTable)
+        if measureCost {
+            renderEncoder.setTexture(getCostTexture(width: outputTexture.width, height: outputTexture.height), index: Int(kernel_buffers.cost_texture.rawValue))
+        }
+        renderEncoder.setComputePipelineState(pipeline)
+        renderEncoder.setIntersectionFunctionTable(intersectionFunctionsTable, bufferIndex: Int(kernel_buffers.function_table.rawValue))
+
+        let threadGroupWidth = pipeline.threadExecutionWidth
+        let threadGroupHeight = pipeline.maxTotalThreadsPerThreadgroup / threadGroupWidth
+        let threadGroupSize = MTLSize(width: threadGroupWidth, height: threadGroupHeight, depth: 1)
+
+        let gridSize = MTLSize(width: outputTexture.width, height: outputTexture.height, depth: 1)
+
+        if ENABLE_STATISTICS != 0 {
+            let threadGroups = ((gridSize.width + threadGroupWidth - 1) / threadGroupWidth) * ((gridSize.height + threadGroupHeight - 1) / threadGroupHeight)
+            let simdGroupsPerThreadGroup = (threadGroupWidth * threadGroupHeight + pipeline.threadExecutionWidth - 1) / pipeline.threadExecutionWidth
+            renderEncoder.setBuffer(getStatisticsBuffer(slotCount: threadGroups * simdGroupsPerThreadGroup), offset: 0, index: Int(kernel_buffers.statistics.rawValue))
+        }
+
+        renderEncoder.dispatchThreads(gridSize, threadsPerThreadgroup: threadGroupSize)
+    }
+
+    /// Sums counters of the last pass, must be called after it has completed.
+    func collectStatistics() -> RenderStatisticsTotals {
+        guard let statisticsSlots else { return RenderStatisticsTotals() }
+        let result = RenderStatisticsTotals(summing: statisticsSlots.contents(), count: statisticsSlotCount)
+        // Partial threadgroups at the edges don't write all their slots
+        memset(statisticsSlots.contents(), 0, statisticsSlots.length)
+        return result
+    }
+
+    private func getStatisticsBuffer(slotCount: Int) -> MTLBuffer {
+        if let statisticsSlots, statisticsSlotCount == slotCount {
+            return statisticsSlots
+        }
+        let buffer = device.makeBuffer(length: MemoryLayout<RenderStatistics>.stride * slotCount, options: .storageModeShared)!
+        memset(buffer.contents(), 0, buffer.length)
+        statisticsSlots = buffer
+        statisticsSlotCount = slotCount
+        return buffer
+    }
+
+    func getMomentsBuffer(width: Int, height: Int) -> MTLBuffer {
+        preparePixelBuffers(width: width, height: height)
+        return moments!
+    }
+
+    func getFeaturesBuffer(width: Int, height: Int) -> MTLBuffer {
+        preparePixelBuffers(width: width, height: height)
+        return features!
+    }
+
+    private func preparePixelBuffers(width: Int, height: Int) {
+        if moments != nil, pixelBuffersSize == (width, height) {
+            return
+        }
+        moments = device.makeBuffer(length: MemoryLayout<PixelMoments>.stride * width * height, options: .storageModeShared)!
+        features = device.makeBuffer(length: MemoryLayout<PixelFeatures>.stride * width * height, options: .storageModeShared)!
+        historyMoments = device.makeBuffer(length: MemoryLayout<PixelMoments>.stride * width * height, options: .storageModeShared)!
+        historyFeatures = device.makeBuffer(length: MemoryLayout<PixelFeatures>.stride * width * height, options: .storageModeShared)!
+        photonStats = device.makeBuffer(length: MemoryLayout<PixelPhotonStats>.stride * width * height, options: .storageModeShared)!
+        memset(photonStats!.contents(), 0, photonStats!.length)
+        pixelBuffersSize = (width, height)
+        featureSamples = 0
+    }
+
+    /// Copies moments after the passes already encoded into `commandBuffer`, so that they can be read once it completes,
+    /// while the following passes keep rendering.
+    func encodeMomentsSnapshot(commandBuffer: MTLCommandBuffer) -> MTLBuffer? {
+        moments.map { encodeSnapshot(of: $0, commandBuffer: commandBuffer) }
+    }
+
+    /// Same as `encodeMomentsSnapshot`, for first-hit features.
+    func encodeFeaturesSnapshot(commandBuffer: MTLCommandBuffer) -> MTLBuffer? {
+        features.map { encodeSnapshot(of: $0, commandBuffer: commandBuffer) }
+    }
+
+    private func encodeSnapshot(of buffer: MTLBuffer, commandBuffer: MTLCommandBuffer) -> MTLBuffer {
+        let snapshot = device.makeBuffer(length: buffer.length, options: .storageModeShared)!
+        let blitEncoder = commandBuffer.makeBlitCommandEncoder()!
+        blitEncoder.copy(from: buffer, sourceOffset: 0, to: snapshot, destinationOffset: 0, size: buffer.length)
+        blitEncoder.endEncoding()
+        return snapshot
+    }
+
+    /// Moments and features of the last pass, must be called after it has completed.
+    func readPixelBuffers() -> (moments: [PixelMoments], features: [PixelFeatures]) {
+        guard let moments, let features else { return ([], []) }
+        return (Self.read(moments), Self.read(features))
+    }
+
+    static func read<T>(_ buffer: MTLBuffer) -> [T] {
+        Array(UnsafeBufferPointer(start: buffer.contents().assumingMemoryBound(to: T.self), count: buffer.length / MemoryLayout<T>.stride))
+    }
+
+    /// Replaces accumulated moments, e.g. when resuming from a checkpoint.
+    /// The next pass must have pass counter greater than 1 to continue accumulation.
+    func loadMoments(_ pixels: [PixelMoments], width: Int, height: Int) {
+        precondition(pixels.count == width * height)
+        let buffer = getMomentsBuffer(width: width, height: height)
+        pixels.withUnsafeBytes { bytes in
+            buffer.contents().copyMemory(from: bytes.baseAddress!, byteCount: bytes.count)
+        }
+        // Caustics are in the moments, but gather radii and features are not stored in checkpoints, and start over
+        memset(photonStats!.contents(), 0, photonStats!.length)
+        featureSamples = 0
+    }
+
+    func getCostTexture(width: Int, height: Int) -> MTLTexture {
+        if let costTexture, costTexture.width == width, costTexture.height == height {
+            return costTexture
+        }
+        let descriptor = MTLTextureDescriptor.texture2DDescriptor(pixelFormat: .rgba32Float, width: width, height: height, mipmapped: false)
+        descriptor.usage = [.shaderRead, .shaderWrite]
+        let texture = device.makeTexture(descriptor: descriptor)!
+        self.costTexture = texture
+        return texture
+    }
+
+    /// Float texture for headless rendering, that can be read back with `readPixels`.
+    func makeOutputTexture(width: Int, height: Int) -> MTLTexture {
+        let descriptor = MTLTextureDescriptor.texture2DDescriptor(pixelFormat: .rgba32Float, width: width, height: height, mipmapped: false)
+        descriptor.usage = [.shaderRead, .shaderWrite]
+        descriptor.storageMode = .managed
+        return device.makeTexture(descriptor: descriptor)!
+    }
+
+    /// Waits for all submitted work, and copies a `.rgba32Float` texture to the CPU.
+    func readPixels(_ texture: MTLTexture) -> FloatImage {
+        let commandBuffer = commandQueue.makeCommandBuffer()!
+        let blitEncoder = commandBuffer.makeBlitCommandEncoder()!
+        blitEncoder.synchronize(resource: texture)
+        blitEncoder.endEncoding()
+        commandBuffer.commit()
+        commandBuffer.waitUntilCompleted()
+
+        var rgba = [SIMD4<Float>](repeating: .zero, count: texture.width * texture.height)
+        rgba.withUnsafeMutableBytes { buffer in
+            texture.getBytes(
+                buffer.baseAddress!,
+                bytesPerRow: texture.width * MemoryLayout<SIMD4<Float>>.stride,
+                from: MTLRegionMake2D(0, 0, texture.width, texture.height),
+                mipmapLevel: 0
+            )
+        }
+        return FloatImage(width: texture.width, height: texture.height, pixels: rgba.map { SIMD3($0.x, $0.y, $0.z) })
+    }
+}
+
+/// Pipeline compiled on first use, shared by engines of all views of a scene.
+private final class CostPipeline {
+    private let make: () -> (MTLComputePipelineState, any MTLIntersectionFunctionTable)
+    private(set) lazy var value = make()
+
+    init(make: @escaping () -> (MTLComputePipelineState, any MTLIntersectionFunctionTable)) {
+        self.make = make
+    }
+}
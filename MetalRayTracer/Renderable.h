@@ -9,28 +9,45 @@
 #define RENDERABLE_H
 
 #include <simd/simd.h>
+#include "Materials.h"
 
+/// Rigid transform, unpacked from the compact rotation of a primitive before hit testing.
 struct Transform {
     matrix_float3x3 rotation;
     vector_float3 translation;
 } __attribute__((swift_private));
 
+// Primitives are kept compact, because intersection functions read them for every candidate hit:
+// rotation is a unit quaternion in signed normalized 16-bit components (xyz - vector part, w - real part),
+// and materials are referenced by 32-bit `MaterialHandle`s.
+
+#ifndef __METAL_VERSION__
+/// Quaternion `q` (xyz - vector part, w - real part) as stored in primitives, see `unpack_rotation()` in RenderableImpl.h.
+static inline vector_short4 compact_rotation(vector_float4 q) {
+    float scale = 32767 / sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+    return (vector_short4){ (short)roundf(q.x * scale), (short)roundf(q.y * scale), (short)roundf(q.z * scale), (short)roundf(q.w * scale) };
+}
+#endif
+
 struct Sphere {
-    struct Transform transform;
+    vector_float3 center;
+    vector_short4 rotation;
     float radius;
-    size_t material_offset;
+    MaterialHandle material;
 #ifdef __cplusplus
     class HitEnumerator;
 #endif
 } __attribute__((swift_private));
 
 struct Cylinder {
-    struct Transform transform;
+    /// Center of the bottom cap.
+    vector_float3 translation;
+    vector_short4 rotation;
     float radius;
     float height;
-    size_t bottom_material_offset;
-    size_t top_material_offset;
-    size_t side_material_offset;
+    MaterialHandle bottom_material;
+    MaterialHandle top_material;
+    MaterialHandle side_material;
 #ifdef __cplusplus
     class HitEnumerator; 
 #endif
@@ -43,9 +60,10 @@ struct Cuboid {
         back, front
     };
 
-    struct Transform transform;
+    vector_float3 translation;
     vector_float3 size;
-    size_t material_offset[6];
+    vector_short4 rotation;
+    MaterialHandle material[6];
 #ifdef __cplusplus
     class HitEnumerator;
 #endif
@@ -53,13 +71,45 @@ struct Cuboid {
 
 struct Quad {
     vector_float3 origin;
-    vector_float3 u, v, w;
-    vector_float3 normal;
+    vector_float3 u, v;
+    /// Normal divided by the area, gives barycentric coordinates.
+    vector_float3 w;
+    /// Plane equation is dot(p, w) == d.
     float d;
-    size_t material_offset;
+    MaterialHandle material;
 #ifdef __cplusplus
     class HitEnumerator;
 #endif
 } __attribute__((swift_private));
 
+/// Rigid motion over the shutter interval, given by transforms at uniformly spaced times
+/// from 0 (shutter open) to 1 (shutter closed).
+struct Motion {
+    enum {
+        MOTION_MAX_KEYFRAMES = 4,
+    };
+    vector_float3 translation[MOTION_MAX_KEYFRAMES];
+    vector_short4 rotation[MOTION_MAX_KEYFRAMES];
+    /// At least 2.
+    uint32_t keyframe_count;
+};
+
+/// Density of a heterogeneous volume on a dense voxel grid over an axis-aligned box in world space,
+/// interpolated trilinearly between voxel centers.
+/// Majorants bound the interpolated density inside blocks of voxels, for delta tracking and skipping of empty space.
+struct DensityGrid {
+    enum {
+        DENSITY_GRID_RESOLUTION = 32,
+        DENSITY_GRID_MAJORANT_RESOLUTION = 8,
+    };
+    vector_float3 bounds_min;
+    vector_float3 bounds_max;
+    /// Density of voxel value 255.
+    float density_scale;
+    /// Indexed by z, y, x.
+    float majorants[DENSITY_GRID_MAJORANT_RESOLUTION][DENSITY_GRID_MAJORANT_RESOLUTION][DENSITY_GRID_MAJORANT_RESOLUTION];
+    /// Indexed by z, y, x.
+    uint8_t voxels[DENSITY_GRID_RESOLUTION][DENSITY_GRID_RESOLUTION][DENSITY_GRID_RESOLUTION];
+};
+
 #endif // RENDERABLE_H
@@ -64,13 +64,16 @@ struct Transform {
         return Transform(rotation: rInv, translation: -rInv.act(translation))
     }
 
-    var asImpl: __Transform {
-        return __Transform(rotation: simd_float3x3(rotation), translation: translation)
+    /// Rotation as stored in primitives, see `compact_rotation()` in Renderable.h.
+    var compactRotation: vector_short4 {
+        compact_rotation(rotation.vector)
     }
 }
 
 protocol Renderable {
     var boundingBox: MTLAxisAlignedBoundingBox { get }
+    /// Bounds of the object at times within `interval` of the shutter, for acceleration structures with motion.
+    func boundingBox(during interval: ClosedRange<Float>) -> MTLAxisAlignedBoundingBox
 
     func visitMaterials(_ reserver: inout MaterialReserver)
 
@@ -80,14 +83,25 @@ protocol Renderable {
 
 extension Renderable {
     var implType: RenderableImpl.Type { Impl.self }
+
+    func boundingBox(during interval: ClosedRange<Float>) -> MTLAxisAlignedBoundingBox {
+        boundingBox
+    }
 }
 
 protocol RenderableImpl {
     static var intersectionFunctionName: String { get }
+    /// Intersection function reads time of the ray.
+    static var hasMotion: Bool { get }
+    /// Byte offsets of all `MaterialHandle`s in the struct, for validating `SceneArchive` files.
+    static var materialHandleOffsets: [Int] { get }
 }
 
 extension RenderableImpl {
     static var size: Int { MemoryLayout<Self>.stride }
+    /// Size without trailing padding, as `MTLAccelerationStructureBoundingBoxGeometryDescriptor.primitiveDataElementSize`.
+    static var unpaddedSize: Int { MemoryLayout<Self>.size }
+    static var hasMotion: Bool { false }
 }
 
 extension vector_float3 {
@@ -152,6 +166,13 @@ extension MTLAxisAlignedBoundingBox {
         self.min = simd.max(min.asUnpacked, box.min.asUnpacked).asPacked
         self.max = simd.min(max.asUnpacked, box.max.asUnpacked).asPacked
     }
+
+    /// False for `.empty`, `.unlimited`, and boxes of infinite objects.
+    var isFinite: Bool {
+        let lo = min.asUnpacked
+        let hi = max.asUnpacked
+        return all(lo .<= hi) && [lo.x, lo.y, lo.z, hi.x, hi.y, hi.z].allSatisfy(\.isFinite)
+    }
 }
 
 func getIntersectionFunctionName<each T: RenderableImpl>(operation: String, operands: (repeat (each T).Type)) -> String {
@@ -164,6 +185,30 @@ func getIntersectionFunctionName<each T: RenderableImpl>(operation: String, oper
     return result
 }
 
+/// Composites read time of the ray if any of their operands does.
+func getHasMotion<each T: RenderableImpl>(operands: (repeat (each T).Type)) -> Bool {
+    var result = false
+    for hasMotion in repeat (each operands).hasMotion {
+        result = result || hasMotion
+    }
+    return result
+}
+
+/// Offsets of material handles in `operands` stored one after another from `offset`, as in a struct or a tuple.
+func getMaterialHandleOffsets<each T: RenderableImpl>(at offset: Int, operands: (repeat (each T).Type)) -> [Int] {
+    var result: [Int] = []
+    var offset = offset
+    func append<U: RenderableImpl>(_ type: U.Type) {
+        offset = (offset + MemoryLayout<U>.alignment - 1) / MemoryLayout<U>.alignment * MemoryLayout<U>.alignment
+        result += U.materialHandleOffsets.map { $0 + offset }
+        offset += MemoryLayout<U>.size
+    }
+    for type in repeat each operands {
+        append(type)
+    }
+    return result
+}
+
 extension String {
     func removingSuffix(_ suffix: String) -> Substring {
         let range = self.range(of: suffix)!
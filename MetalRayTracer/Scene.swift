@@ -9,10 +9,42 @@ import Metal
 struct Scene {
     var camera: CameraConfig
     var objects: [any Renderable]
+    /// If set, render data is loaded from the `SceneArchive` file, and `objects` is empty.
+    var archive: URL?
+    /// Identifies the scene in checkpoints.
+    var name = ""
+    /// Lights the scene when `camera.background` is `background_lighting_environment`, not stored in archives.
+    var environment: EnvironmentMap?
 
-    public init(camera: CameraConfig, objects: [any Renderable]) {
+    public init(camera: CameraConfig, objects: [any Renderable], environment: EnvironmentMap? = nil) {
         self.camera = camera
         self.objects = objects
+        self.environment = environment
+    }
+
+    /// Returns nil if the file is not a valid `SceneArchive`.
+    init?(archive url: URL) {
+        guard let archive = SceneArchive(url: url) else { return nil }
+        self.camera = archive.camera
+        self.objects = []
+        self.archive = url
+        self.name = url.deletingPathExtension().lastPathComponent
+    }
+
+    /// Presets rendered by `SceneBenchmark`.
+    static var presets: [(name: String, scene: Scene)] {
+        [
+            ("simpleBalls", .simpleBalls),
+            ("singleCylinder", .singleCylinder),
+            ("simpleCylinders", .simpleCylinders),
+            ("texturedCylinders", .texturedCylinders),
+            ("pencilInGlass", .pencilInGlass),
+            ("compositionDemo", .compositionDemo),
+            ("quads", .quads),
+            ("smoke", .smoke),
+            ("motionBlur", .motionBlur),
+            ("sunlitBalls", .sunlitBalls),
+        ]
     }
 
     static var simpleBalls: Scene {
@@ -217,7 +249,8 @@ struct Scene {
         let upper = ColoredLambertian(albedo: vector_float3(1.0, 0.5, 0.0))
         let lower = ColoredLambertian(albedo: vector_float3(0.2, 0.8, 0.8))
 
-        var rng = SystemRandomNumberGenerator()
+        // Fixed seed, so that benchmark references stay valid
+        var rng = SplitMix64(seed: 42)
 
         return Scene(
             camera: CameraConfig(
@@ -255,4 +288,91 @@ struct Scene {
             ]
         )
     }
+
+    static var smoke: Scene {
+        let ground = ColoredLambertian(albedo: vector_float3(0.5, 0.5, 0.5))
+        let light = ColoredEmissive(albedo: vector_float3(7, 7, 7))
+
+        // Fixed seed, so that benchmark references stay valid
+        var rng = SplitMix64(seed: 42)
+        let noise = PerlinNoiseTexture.generate(from: .zero, to: .one, frequency: 0.7, turbulence: 5, using: &rng)
+
+        return Scene(
+            camera: CameraConfig(
+                verticalFOV: 40,
+                lookFrom: vector_float3(0, 2, 12),
+                lookAt: vector_float3(0, 1.5, 0)
+            ),
+            objects: [
+                Sphere(center: vector_float3(0, -1000, 0), radius: 1000, material: ground),
+                Quad(origin: vector_float3(-2, 6, -2), u: vector_float3(4, 0, 0), v: vector_float3(0, 0, 4), material: light),
+                HeterogeneousVolume(
+                    base: Cuboid(
+                        transform: .translation(-3, 0, -3),
+                        size: vector_float3(6, 4, 6),
+                        material: ColoredIsotropic(albedo: vector_float3(0.8, 0.8, 0.8))
+                    ),
+                    maxDensity: 2,
+                    density: DensityGrid.smoke(noise)
+                )
+            ]
+        )
+    }
+
+    /// Bouncing balls and a spinning box during the shutter interval, next to static balls.
+    static var motionBlur: Scene {
+        let ground = ColoredLambertian(albedo: vector_float3(0.5, 0.5, 0.5))
+        var objects: [any Renderable] = [
+            Sphere(center: vector_float3(0, -1000, 0), radius: 1000, material: ground),
+        ]
+        for i in 0..<5 {
+            let x = Float(i - 2) * 1.2
+            let material = ColoredLambertian(albedo: vector_float3(0.2 + 0.15 * Float(i), 0.3, 0.8 - 0.15 * Float(i)))
+            if i % 2 == 0 {
+                objects.append(Sphere(center: vector_float3(x, 0.5, 0), radius: 0.5, material: material))
+            } else {
+                // Up and back down, slowing at the top
+                let heights: [Float] = [0.5, 1.3, 1.3, 0.5]
+                objects.append(Moving(
+                    base: Sphere(center: .zero, radius: 0.5, material: material),
+                    keyframes: heights.map { .translation(x, $0, 0) }
+                ))
+            }
+        }
+        objects.append(Moving(
+            base: Cuboid(transform: .translation(-0.4, -0.4, -0.4), size: vector_float3(0.8, 0.8, 0.8), material: ColoredMetal(albedo: vector_float3(0.8, 0.6, 0.2), fuzz: 0.2)),
+            keyframes: [0, 20, 40].map { .translation(0, 0.4, 1.5) * .rotation(degrees: $0, axis: .y) }
+        ))
+        return Scene(
+            camera: CameraConfig(
+                verticalFOV: 40,
+                lookFrom: vector_float3(0, 2, 8),
+                lookAt: vector_float3(0, 0.7, 0)
+            ),
+            objects: objects
+        )
+    }
+
+    /// Balls lit by a small sun in the environment map, which bouncing rays rarely hit without sampling the environment.
+    static var sunlitBalls: Scene {
+        let ground = ColoredLambertian(albedo: vector_float3(0.6, 0.6, 0.6))
+        let center = ColoredLambertian(albedo: vector_float3(0.1, 0.2, 0.5))
+        let left   = Dielectric(refractionIndex: 1.50)
+        let right  = ColoredMetal(albedo: vector_float3(0.8, 0.6, 0.2), fuzz: 0.3)
+        return Scene(
+            camera: CameraConfig(
+                verticalFOV: 40,
+                lookFrom: vector_float3(0, 1.5, 6),
+                lookAt: vector_float3(0, 0.5, 0),
+                background: .background_lighting_environment
+            ),
+            objects: [
+                Sphere(center: vector_float3(-1.1, 0.5, 0), radius: 0.5, material: left),
+                Sphere(center: vector_float3(0, 0.5, 0), radius: 0.5, material: center),
+                Sphere(center: vector_float3(1.1, 0.5, 0), radius: 0.5, material: right),
+                Sphere(center: vector_float3(0, -1000, 0), radius: 1000, material: ground),
+            ],
+            environment: .sunAndSky()
+        )
+    }
 }
@@ -0,0 +1,53 @@
+//
+//  SceneArchive.h
+//  RayTracing
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+#ifndef SCENE_ARCHIVE_H
+#define SCENE_ARCHIVE_H
+
+#include "Config.h"
+
+/// Layout of the binary scene file, see SceneArchive.swift.
+/// All offsets are relative to the start of the file.
+/// Sections with render data are aligned to `SceneArchiveHeader.alignment`,
+/// and contain exactly the bytes that are bound to the kernel.
+
+struct SceneArchiveString {
+    uint64_t offset;
+    uint64_t length;
+};
+
+/// Texture resource ID in the materials section, which is not valid across processes.
+struct SceneArchiveTexture {
+    uint64_t material_offset;
+    struct SceneArchiveString name;
+};
+
+/// Primitives of the same type, handled by the same intersection function.
+struct SceneArchiveGroup {
+    struct SceneArchiveString intersection_function;
+    uint64_t function_table_index;
+    uint64_t primitive_count;
+    uint64_t primitive_stride;
+    uint64_t primitive_size;
+    /// `MTLAxisAlignedBoundingBox` per primitive.
+    uint64_t bounding_boxes_offset;
+    uint64_t primitives_offset;
+};
+
+struct SceneArchiveHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t alignment;
+    struct CameraConfig camera;
+    uint64_t materials_offset;
+    uint64_t materials_size;
+    uint64_t texture_count;
+    uint64_t textures_offset;
+    uint64_t group_count;
+    uint64_t groups_offset;
+};
+
+#endif // SCENE_ARCHIVE_H
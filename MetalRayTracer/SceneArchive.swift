@@ -0,0 +1,282 @@
+//
+//  SceneArchive.swift
+//  MetalRayTracer
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+//  Binary scene file, laid out as in SceneArchive.h. Materials, bounding boxes and primitives are stored
+//  exactly as the kernel consumes them, so loading maps the file and wraps its sections into buffers,
+//  without decoding or copying. Only texture resource IDs are patched, since they are valid in a single process.
+//
+//  Acceleration structure is still built on the GPU: Metal has no API to serialize it.
+//
+
+import Foundation
+import Metal
+
+// Immutable after loading, except for patching texture references before the buffers are used
+final class SceneArchive: @unchecked Sendable {
+    static let magic: UInt32 = 0x4353_5452 // "RTSC"
+    static let version: UInt32 = 3
+    static let fileExtension = "rtscene"
+    /// Largest page size on macOS, so that files are mapped without copying both on arm64 and x86_64.
+    static let alignment = 16384
+
+    private let base: UnsafeMutableRawPointer
+    private let length: Int
+    let header: SceneArchiveHeader
+
+    /// Returns nil if the file cannot be mapped, or is not a valid archive.
+    init?(url: URL) {
+        let fd = open(url.path, O_RDONLY)
+        guard fd >= 0 else { return nil }
+        defer { close(fd) }
+        var info = stat()
+        guard fstat(fd, &info) == 0, Int(info.st_size) >= MemoryLayout<SceneArchiveHeader>.size else { return nil }
+        let length = Int(info.st_size)
+        // Private writable mapping: patching texture references copies only the touched pages
+        guard let base = mmap(nil, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0), base != MAP_FAILED else { return nil }
+        self.base = base
+        self.length = length
+        self.header = base.load(as: SceneArchiveHeader.self)
+        guard isValid() else { return nil }
+    }
+
+    deinit {
+        munmap(base, length)
+    }
+
+    var camera: CameraConfig {
+        var camera = CameraConfig()
+        camera.impl = header.camera
+        return camera
+    }
+
+    var textures: UnsafeBufferPointer<SceneArchiveTexture> {
+        table(at: header.textures_offset, count: header.texture_count)
+    }
+
+    var groups: UnsafeBufferPointer<SceneArchiveGroup> {
+        table(at: header.groups_offset, count: header.group_count)
+    }
+
+    func string(_ string: SceneArchiveString) -> String {
+        String(decoding: UnsafeRawBufferPointer(start: base + Int(string.offset), count: Int(string.length)), as: UTF8.self)
+    }
+
+    /// Replaces texture references in the materials section by resource IDs of the textures in `textureLoader`,
+    /// which are placeholders until the textures are decoded.
+    /// Returns offsets of the references within the materials section, same as `MaterialEncoder.textureReferences`.
+    func patchTextures(textureLoader: TextureLoader) -> [(offset: Int, texture: ImageTexture)] {
+        textures.map { reference in
+            let texture = ImageTexture(name: string(reference.name))
+            let p = base + Int(header.materials_offset + reference.material_offset)
+            p.storeBytes(of: textureLoader.load(texture).gpuResourceID, as: MTLResourceID.self)
+            return (offset: Int(reference.material_offset), texture: texture)
+        }
+    }
+
+    /// Wraps a section into a buffer. The buffer keeps the mapping alive.
+    /// Falls back to copying if the page size is larger than alignment of the file.
+    func makeBuffer(device: MTLDevice, offset: UInt64, length: UInt64) -> MTLBuffer {
+        let pointer = base + Int(offset)
+        let alignment = Int(header.alignment)
+        guard alignment % Int(getpagesize()) == 0 else {
+            return device.makeBuffer(bytes: pointer, length: max(Int(length), 1), options: .storageModeShared)!
+        }
+        return device.makeBuffer(
+            bytesNoCopy: pointer,
+            length: Self.sectionLength(Int(length), alignment: alignment),
+            options: .storageModeShared,
+            deallocator: { _, _ in withExtendedLifetime(self) {} }
+        )!
+    }
+
+    private func table<T>(at offset: UInt64, count: UInt64) -> UnsafeBufferPointer<T> {
+        UnsafeBufferPointer(start: (base + Int(offset)).assumingMemoryBound(to: T.self), count: Int(count))
+    }
+
+    /// Primitive types of the intersection functions in Shaders.metal, by function name.
+    /// Groups of an archive may only use these, with the same layout of primitives.
+    static let primitiveTypes: [String: any RenderableImpl.Type] = {
+        typealias Union3 = __UnionImpl<__Cylinder, __Cylinder, __Cylinder>
+        typealias Intersection2 = __IntersectionImpl<__Cuboid, __Sphere>
+        let types: [any RenderableImpl.Type] = [
+            __Sphere.self, __Cylinder.self, __Cuboid.self, __Quad.self,
+            __SubtractImpl<__Cylinder, __Cylinder>.self, __SubtractImpl<__Cuboid, __Cylinder>.self,
+            Intersection2.self, Union3.self, __SubtractImpl<__Cuboid, Union3>.self,
+            __SubtractImpl<Intersection2, __Cylinder>.self, __SubtractImpl<Intersection2, Union3>.self,
+            __ConstantDensityVolumeImpl<__Cuboid>.self, __HeterogeneousVolumeImpl<__Cuboid>.self,
+            __MovingImpl<__Sphere>.self, __MovingImpl<__Cuboid>.self,
+        ]
+        return Dictionary(uniqueKeysWithValues: types.map { ($0.intersectionFunctionName, $0) })
+    }()
+
+    /// Checks that everything that is read from the file lies within it, without trapping on hostile values:
+    /// sections, tables and strings, intersection functions and layouts of primitives, and material handles in them.
+    private func isValid() -> Bool {
+        guard header.magic == Self.magic, header.version == Self.version,
+              let alignment = Int(exactly: header.alignment), alignment > 0,
+              let materialsSize = Int(exactly: header.materials_size), materialsSize >= MemoryLayout<MaterialTables>.stride
+        else { return false }
+        func product(_ count: UInt64, _ stride: Int) -> Int? {
+            guard let count = Int(exactly: count) else { return nil }
+            let (result, overflow) = count.multipliedReportingOverflow(by: stride)
+            return overflow ? nil : result
+        }
+        func contains(_ offset: UInt64, _ size: Int?) -> Bool {
+            guard let size else { return false }
+            return offset <= UInt64(length) && UInt64(size) <= UInt64(length) - offset
+        }
+        func containsSection(_ offset: UInt64, _ size: Int?) -> Bool {
+            guard let size, offset % UInt64(alignment) == 0 else { return false }
+            // Rounds up to whole pages without overflowing
+            let pages = max(size / alignment + (size % alignment == 0 ? 0 : 1), 1)
+            return contains(offset, product(UInt64(pages), alignment))
+        }
+        guard containsSection(header.materials_offset, materialsSize),
+              contains(header.textures_offset, product(header.texture_count, MemoryLayout<SceneArchiveTexture>.stride)),
+              contains(header.groups_offset, product(header.group_count, MemoryLayout<SceneArchiveGroup>.stride))
+        else { return false }
+
+        let materials = MaterialLayout(buffer: base + Int(header.materials_offset), length: materialsSize)
+        guard materials.isValid else { return false }
+        for texture in textures {
+            // Patching must not overwrite `MaterialTables`
+            let (end, overflow) = texture.material_offset.addingReportingOverflow(UInt64(MemoryLayout<MTLResourceID>.size))
+            guard !overflow, texture.material_offset >= UInt64(materials.offsets[0]), end <= header.materials_size,
+                  contains(texture.name.offset, Int(exactly: texture.name.length))
+            else { return false }
+        }
+
+        var functionTableIndices = Set<UInt64>()
+        for group in groups {
+            guard contains(group.intersection_function.offset, Int(exactly: group.intersection_function.length)),
+                  let type = Self.primitiveTypes[string(group.intersection_function)],
+                  group.function_table_index < header.group_count, functionTableIndices.insert(group.function_table_index).inserted,
+                  let stride = Int(exactly: group.primitive_stride), stride == type.size,
+                  let count = Int(exactly: group.primitive_count),
+                  group.primitive_size == UInt64(type.unpaddedSize),
+                  containsSection(group.bounding_boxes_offset, product(group.primitive_count, MemoryLayout<MTLAxisAlignedBoundingBox>.stride)),
+                  containsSection(group.primitives_offset, product(group.primitive_count, stride))
+            else { return false }
+            let primitives = base + Int(group.primitives_offset)
+            for i in 0..<count {
+                for offset in type.materialHandleOffsets {
+                    guard materials.contains(primitives.loadUnaligned(fromByteOffset: i * stride + offset, as: MaterialHandle.self)) else { return false }
+                }
+            }
+        }
+        return true
+    }
+
+    /// Sections are padded to alignment, and take at least one page, because Metal does not allow empty buffers.
+    private static func sectionLength(_ size: Int, alignment: Int) -> Int {
+        max((size + alignment - 1) / alignment, 1) * alignment
+    }
+
+    /// Encodes the scene in the same way as `SceneBuffers`, and writes the result.
+    static func write(_ scene: Scene, device: MTLDevice, to url: URL) throws {
+        var timings = StageTimings()
+        let encoded = EncodedScene(objects: scene.objects, device: device, timings: &timings)
+        var writer = Writer()
+        writer.append(SceneArchiveHeader())
+
+        var header = SceneArchiveHeader()
+        header.magic = magic
+        header.version = version
+        header.alignment = UInt64(alignment)
+        header.camera = scene.camera.impl
+
+        var materials = Data(bytes: encoded.materialsBuffer.contents(), count: encoded.materialsBuffer.length)
+        for reference in encoded.textureReferences {
+            // Resource IDs are meaningless in another process
+            let range = reference.offset..<reference.offset + MemoryLayout<MTLResourceID>.size
+            materials.replaceSubrange(range, with: Data(count: range.count))
+        }
+        header.materials_offset = materials.withUnsafeBytes { writer.appendSection($0) }
+        header.materials_size = UInt64(materials.count)
+
+        var groups: [SceneArchiveGroup] = []
+        for group in encoded.groups {
+            var record = SceneArchiveGroup()
+            record.function_table_index = UInt64(group.index)
+            record.primitive_count = UInt64(group.count)
+            record.primitive_stride = UInt64(group.primitiveStride)
+            record.primitive_size = UInt64(group.primitiveSize)
+            record.bounding_boxes_offset = writer.appendSection(length: MemoryLayout<MTLAxisAlignedBoundingBox>.stride * group.count, group.copyBoundingBoxes(to:))
+            record.primitives_offset = writer.appendSection(length: group.primitiveStride * group.count, group.copyPrimitives(to:))
+            groups.append(record)
+        }
+
+        // Tables and strings are small, and are read on the CPU only
+        var textures: [SceneArchiveTexture] = []
+        for reference in encoded.textureReferences {
+            textures.append(SceneArchiveTexture(material_offset: UInt64(reference.offset), name: writer.append(reference.texture.name)))
+        }
+        for (i, group) in encoded.groups.enumerated() {
+            groups[i].intersection_function = writer.append(group.intersectionFunctionName)
+        }
+        header.texture_count = UInt64(textures.count)
+        header.textures_offset = writer.append(textures)
+        header.group_count = UInt64(groups.count)
+        header.groups_offset = writer.append(groups)
+
+        writer.replace(at: 0, with: header)
+        try writer.data.write(to: url, options: .atomic)
+    }
+
+    private struct Writer {
+        var data = Data()
+
+        @discardableResult
+        mutating func append<T>(_ value: T) -> UInt64 {
+            withUnsafeBytes(of: value) { appendBytes($0) }
+        }
+
+        mutating func append<T>(_ values: [T]) -> UInt64 {
+            align(MemoryLayout<T>.alignment)
+            return values.withUnsafeBytes { appendBytes($0) }
+        }
+
+        mutating func append(_ string: String) -> SceneArchiveString {
+            let bytes = Array(string.utf8)
+            return SceneArchiveString(offset: bytes.withUnsafeBytes { appendBytes($0) }, length: UInt64(bytes.count))
+        }
+
+        mutating func appendSection(_ bytes: UnsafeRawBufferPointer) -> UInt64 {
+            appendSection(length: bytes.count) { pointer in
+                if let source = bytes.baseAddress {
+                    pointer.copyMemory(from: source, byteCount: bytes.count)
+                }
+            }
+        }
+
+        /// Appends a page-aligned section of `length` bytes, filled by `body`.
+        mutating func appendSection(length: Int, _ body: (UnsafeMutableRawPointer) -> Void) -> UInt64 {
+            align(SceneArchive.alignment)
+            let offset = data.count
+            data.count += SceneArchive.sectionLength(length, alignment: SceneArchive.alignment)
+            data.withUnsafeMutableBytes { buffer in
+                body(buffer.baseAddress! + offset)
+            }
+            return UInt64(offset)
+        }
+
+        mutating func replace<T>(at offset: Int, with value: T) {
+            withUnsafeBytes(of: value) { bytes in
+                data.replaceSubrange(offset..<offset + bytes.count, with: bytes)
+            }
+        }
+
+        private mutating func appendBytes(_ bytes: UnsafeRawBufferPointer) -> UInt64 {
+            let offset = data.count
+            data.append(contentsOf: bytes)
+            return UInt64(offset)
+        }
+
+        private mutating func align(_ alignment: Int) {
+            data.count = (data.count + alignment - 1) / alignment * alignment
+        }
+    }
+}
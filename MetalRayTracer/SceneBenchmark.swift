@@ -0,0 +1,602 @@
+//
+//  SceneBenchmark.swift
+//  MetalRayTracer
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+//  Headless end-to-end benchmark. Renders every preset from `Scene.presets` at fixed resolutions,
+//  and prints one JSON object per scene and resolution with throughput and error versus time.
+//
+//  MetalRayTracer --benchmark [--scene <name>]... [--resolution <width>x<height>]... [--checkpoints <seconds>,...]
+//                             [--references <dir>] [--label <text>] [--output <path>] [--statistics <path>] [--heatmap <dir>]
+//                             [--motion-segments <count>] [--no-environment-sampling] [--no-specialization]
+//                             [--views <count>] [--photons <count>] [--guiding-iterations <count>]
+//  MetalRayTracer --benchmark --make-references <dir> [--passes <count>] [--scene <name>]... [--resolution <width>x<height>]...
+//  MetalRayTracer --benchmark --write-scene-archives <dir> [--scene <name>]...
+//
+//  With ENABLE_STATISTICS set in Statistics.h, --statistics writes kernel counters of every pass as JSON lines.
+//  --heatmap writes average cost per sample of the whole run: raw data as PFM, and a false-color PNG per metric.
+//  --denoise also reports error of the image filtered by `Denoiser` at each checkpoint, and its run time.
+//  --scene-archive <path> benchmarks a scene loaded from a `SceneArchive` file, named after the file,
+//  instead of the presets, unless they are also selected by --scene.
+//  --write-scene-archives writes presets as `SceneArchive` files.
+//  --motion-segments sets shutter segments with separate bounding boxes of moving objects,
+//  0 bounds them by the union over the whole shutter interval, like scene archives do.
+//  --no-environment-sampling lights scenes with an environment map by bouncing rays only,
+//  references always sample the environment.
+//  --views renders a turntable of that many cameras around the scene camera with `MultiViewRenderer`,
+//  and reports total throughput of the batch and rays per view, without comparing against references.
+//  The scene camera is then rendered alone for the same time, as the single-view baseline of the batch.
+//  --no-specialization compiles the kernel for all material kinds and lighting, instead of those present in the scene.
+//  --photons sets caustic photons traced per pass, 0 leaves caustics to path tracing. References never use photons.
+//  --guiding-iterations sets training iterations of `PathGuiding`, 0 disables it. Guided scenes start with
+//  `PathGuiding.defaultBaselinePasses` passes that sample materials only, and results report variance of every pass
+//  relative to them. References are not guided.
+//
+//  The app is sandboxed, relative paths are resolved against its Documents directory.
+//
+
+import Foundation
+import ImageIO
+import Metal
+
+struct SceneBenchmark {
+    struct Resolution: Encodable {
+        var width: Int
+        var height: Int
+    }
+
+    struct Options {
+        var scenes: [String] = []
+        var resolutions: [Resolution] = []
+        var checkpoints: [Double] = [0.25, 0.5, 1, 2, 4, 8]
+        var references: URL?
+        var makeReferences = false
+        var referencePasses = 4096
+        var label = ""
+        var output: URL?
+        var statistics: URL?
+        var heatmap: URL?
+        var denoise = false
+        var sceneArchives: [URL] = []
+        var writeSceneArchives: URL?
+        var motionSegments = SceneBuffers.defaultMotionSegments
+        var sampleEnvironment = true
+        var specialize = true
+        var views = 1
+        var photonsPerPass = PhotonMapper.defaultPhotonsPerPass
+        var guidingIterations = PathGuiding.defaultTrainingIterations
+
+        /// Returns nil if the app was not launched with `--benchmark`.
+        init?(arguments: [String]) {
+            guard arguments.contains("--benchmark") else { return nil }
+            var i = arguments.startIndex + 1
+            func value() -> String? {
+                guard i + 1 < arguments.endIndex else { return nil }
+                i += 1
+                return arguments[i]
+            }
+            while i < arguments.endIndex {
+                switch arguments[i] {
+                case "--benchmark":
+                    break
+                case "--scene":
+                    if let name = value() {
+                        scenes.append(name)
+                    }
+                case "--resolution":
+                    if let parts = value()?.split(separator: "x").compactMap({ Int($0) }), parts.count == 2 {
+                        resolutions.append(Resolution(width: parts[0], height: parts[1]))
+                    }
+                case "--checkpoints":
+                    checkpoints = value()?.split(separator: ",").compactMap { Double($0) }.sorted() ?? checkpoints
+                case "--references":
+                    references = value().map(Self.url(for:))
+                case "--make-references":
+                    makeReferences = true
+                    references = value().map(Self.url(for:))
+                case "--passes":
+                    referencePasses = value().flatMap { Int($0) } ?? referencePasses
+                case "--label":
+                    label = value() ?? label
+                case "--output":
+                    output = value().map(Self.url(for:))
+                case "--statistics":
+                    statistics = value().map(Self.url(for:))
+                case "--heatmap":
+                    heatmap = value().map(Self.url(for:))
+                case "--denoise":
+                    denoise = true
+                case "--scene-archive":
+                    if let path = value() {
+                        sceneArchives.append(Self.url(for: path))
+                    }
+                case "--write-scene-archives":
+                    writeSceneArchives = value().map(Self.url(for:))
+                case "--motion-segments":
+                    motionSegments = value().flatMap { Int($0) }.map { max($0, 0) } ?? motionSegments
+                case "--no-environment-sampling":
+                    sampleEnvironment = false
+                case "--no-specialization":
+                    specialize = false
+                case "--views":
+                    views = value().flatMap { Int($0) }.map { max($0, 1) } ?? views
+                case "--photons":
+                    photonsPerPass = value().flatMap { Int($0) }.map { max($0, 0) } ?? photonsPerPass
+                case "--guiding-iterations":
+                    guidingIterations = value().flatMap { Int($0) }.map { max($0, 0) } ?? guidingIterations
+                default:
+                    // Xcode passes its own options, like -NSDocumentRevisionsDebugMode
+                    break
+                }
+                i += 1
+            }
+            if resolutions.isEmpty {
+                resolutions = [Resolution(width: 320, height: 180), Resolution(width: 640, height: 360)]
+            }
+        }
+
+        static func url(for path: String) -> URL {
+            let documents = FileManager.default.urls(for: .documentDirectory, in: .userDomainMask)[0]
+            return URL(fileURLWithPath: path, relativeTo: documents)
+        }
+    }
+
+    struct Checkpoint: Encodable {
+        var seconds: Double
+        var passes: Int
+        /// Root mean square error of the displayed color against the reference, nil if there is no reference.
+        var rmse: Double?
+        /// Same for the denoised image, nil unless `--denoise` is set.
+        var rmseDenoised: Double?
+        var denoiseSeconds: Double?
+    }
+
+    struct Result: Encodable {
+        var scene: String
+        var width: Int
+        var height: Int
+        var label: String
+        var setupSeconds: Double
+        /// CPU stages of `setupSeconds`, the rest is waiting for the acceleration structure build on the GPU.
+        var setupStages: StageTimings
+        var primitiveBytes: Int
+        var motionSegments: Int
+        var sampleEnvironment: Bool
+        var specialized: Bool
+        /// Caustic photons per pass, 0 if the scene has no photon map.
+        var photonsPerPass: Int
+        /// Nil if the scene is not guided.
+        var guiding: PathGuiding.Report?
+        var passes: Int
+        var wallSeconds: Double
+        var gpuSeconds: Double
+        var samplesPerSecond: Double
+        var raysPerSecond: Double
+        var checkpoints: [Checkpoint]
+    }
+
+    struct MultiViewResult: Encodable {
+        var scene: String
+        var width: Int
+        var height: Int
+        var label: String
+        var views: Int
+        var setupSeconds: Double
+        var setupStages: StageTimings
+        var passes: Int
+        var wallSeconds: Double
+        var gpuSeconds: Double
+        /// Samples and rays of all views together.
+        var samplesPerSecond: Double
+        var raysPerSecond: Double
+        var raysPerView: [UInt64]
+        /// Scene camera rendered alone by the same renderer for the same time, and the gain of the batch over it in samples per second.
+        var singleViewSamplesPerSecond: Double
+        var singleViewRaysPerSecond: Double
+        var speedup: Double
+        var guiding: PathGuiding.Report?
+    }
+
+    var options: Options
+    let device: MTLDevice
+    let commandQueue: MTLCommandQueue
+
+    init(options: Options) {
+        self.options = options
+        self.device = MTLCreateSystemDefaultDevice()!
+        self.commandQueue = device.makeCommandQueue()!
+    }
+
+    func run() {
+        if let directory = options.writeSceneArchives {
+            writeSceneArchives(to: directory)
+            return
+        }
+        var output = JSONLinesWriter(url: options.output)
+        var statistics = options.statistics.map { JSONLinesWriter(url: $0) }
+        for (name, scene) in selectedScenes() {
+            for resolution in options.resolutions {
+                if options.makeReferences {
+                    makeReference(name: name, scene: scene, resolution: resolution)
+                } else if options.views > 1 {
+                    output.write(measureViews(name: name, scene: scene, resolution: resolution, statistics: &statistics))
+                } else {
+                    output.write(measure(name: name, scene: scene, resolution: resolution, statistics: &statistics))
+                }
+            }
+        }
+    }
+
+    private func selectedScenes() -> [(name: String, scene: Scene)] {
+        var result = Scene.presets.filter { preset in
+            options.scenes.contains(preset.name) || (options.scenes.isEmpty && options.sceneArchives.isEmpty)
+        }
+        for url in options.sceneArchives {
+            guard let scene = Scene(archive: url) else {
+                FileHandle.standardError.write(Data("Invalid scene archive \(url.path)\n".utf8))
+                continue
+            }
+            result.append((url.deletingPathExtension().lastPathComponent, scene))
+        }
+        return result
+    }
+
+    private func writeSceneArchives(to directory: URL) {
+        try? FileManager.default.createDirectory(at: directory, withIntermediateDirectories: true)
+        for (name, scene) in Scene.presets where options.scenes.isEmpty || options.scenes.contains(name) {
+            let url = directory.appendingPathComponent(name).appendingPathExtension(SceneArchive.fileExtension)
+            do {
+                try SceneArchive.write(scene, device: device, to: url)
+                FileHandle.standardError.write(Data("Wrote \(url.path)\n".utf8))
+            } catch {
+                FileHandle.standardError.write(Data("Failed to write \(url.path): \(error)\n".utf8))
+            }
+        }
+    }
+
+    /// Renders passes until the last checkpoint, and compares the image against the reference at each checkpoint.
+    /// Reading back the image is not included into measured time.
+    func measure(name: String, scene: Scene, resolution: Resolution, statistics: inout JSONLinesWriter?) -> Result {
+        let setupStart = Date.now
+        let engine = RenderEngine(scene: scene, device: device, commandQueue: commandQueue, motionSegments: options.motionSegments, specialize: options.specialize, photonsPerPass: options.photonsPerPass, guidingIterations: options.guidingIterations,
+                                guidingBaselinePasses: PathGuiding.defaultBaselinePasses)
+        engine.measuresCost = options.heatmap != nil
+        waitUntilIdle()
+        let setupSeconds = Date.now.timeIntervalSince(setupStart)
+
+        let outputTexture = engine.makeOutputTexture(width: resolution.width, height: resolution.height)
+        let reference = options.references.flatMap { FloatImage(pfm: referenceURL(in: $0, name: name, resolution: resolution)) }
+
+        var pendingCheckpoints = options.checkpoints[...]
+        var checkpoints: [Checkpoint] = []
+        var passes = 0
+        var wallSeconds: Double = 0
+        var gpuSeconds: Double = 0
+        var rays: UInt64 = 0
+        engine.resetRayCounter()
+        while let next = pendingCheckpoints.first {
+            let start = Date.now
+            passes += 1
+            let commandBuffer = commandQueue.makeCommandBuffer()!
+            let renderConfig = RenderConfig(samplesPerPixel: 1, maxDepth: 10, passCounter: passes, rngSeed: RenderConfig.seed(pass: passes, stream: 0), sampleEnvironment: options.sampleEnvironment)
+            engine.encodePass(commandBuffer: commandBuffer, outputTexture: outputTexture, camera: scene.camera, renderConfig: renderConfig)
+            commandBuffer.commit()
+            commandBuffer.waitUntilCompleted()
+            wallSeconds += Date.now.timeIntervalSince(start)
+            gpuSeconds += commandBuffer.gpuEndTime - commandBuffer.gpuStartTime
+            rays += UInt64(engine.rayCount)
+            engine.resetRayCounter()
+            if ENABLE_STATISTICS != 0 {
+                statistics?.write(StatisticsReport(scene: name, pass: passes, statistics: engine.collectStatistics()))
+            }
+
+            guard wallSeconds >= next else { continue }
+            let rmse = reference.flatMap { engine.readPixels(outputTexture).rmse(to: $0) }
+            var rmseDenoised: Double?
+            var denoiseSeconds: Double?
+            if options.denoise {
+                let (moments, features) = engine.readPixelBuffers()
+                let start = Date.now
+                let denoised = Denoiser().denoise(moments: moments, features: features, width: resolution.width, height: resolution.height)
+                denoiseSeconds = Date.now.timeIntervalSince(start)
+                rmseDenoised = reference.flatMap { denoised.rmse(to: $0) }
+            }
+            while let next = pendingCheckpoints.first, wallSeconds >= next {
+                pendingCheckpoints.removeFirst()
+                checkpoints.append(Checkpoint(seconds: wallSeconds, passes: passes, rmse: rmse, rmseDenoised: rmseDenoised, denoiseSeconds: denoiseSeconds))
+            }
+        }
+
+        if let directory = options.heatmap, let costTexture = engine.costTexture {
+            writeHeatmap(engine.readPixels(costTexture), to: directory, name: "\(name)-\(resolution.width)x\(resolution.height)")
+        }
+
+        let samples = Double(passes * resolution.width * resolution.height)
+        return Result(
+            scene: name,
+            width: resolution.width,
+            height: resolution.height,
+            label: options.label,
+            setupSeconds: setupSeconds,
+            setupStages: engine.setupTimings,
+            primitiveBytes: engine.sceneBuffers.primitiveBytes,
+            motionSegments: options.motionSegments,
+            sampleEnvironment: options.sampleEnvironment,
+            specialized: options.specialize,
+            photonsPerPass: Int(engine.photonMapper?.config.photon_count ?? 0),
+            guiding: engine.pathGuiding?.report,
+            passes: passes,
+            wallSeconds: wallSeconds,
+            gpuSeconds: gpuSeconds,
+            samplesPerSecond: samples / wallSeconds,
+            raysPerSecond: Double(rays) / wallSeconds,
+            checkpoints: checkpoints
+        )
+    }
+
+    /// Renders passes of all views until the last checkpoint,
+    /// then the scene camera alone for the same time, as the baseline of the batch.
+    func measureViews(name: String, scene: Scene, resolution: Resolution, statistics: inout JSONLinesWriter?) -> MultiViewResult {
+        let setupStart = Date.now
+        let renderer = makeMultiViewRenderer(scene: scene, cameras: MultiViewRenderer.turntable(around: scene.camera, count: options.views), resolution: resolution)
+        waitUntilIdle()
+        let setupSeconds = Date.now.timeIntervalSince(setupStart)
+
+        let duration = options.checkpoints.last ?? 0
+        let batch = renderViews(renderer, name: name, duration: duration, statistics: &statistics)
+        var noStatistics: JSONLinesWriter?
+        let baseline = renderViews(makeMultiViewRenderer(scene: scene, cameras: [scene.camera], resolution: resolution), name: name, duration: duration, statistics: &noStatistics)
+
+        let pixels = Double(resolution.width * resolution.height)
+        let samplesPerSecond = Double(batch.passes * renderer.views.count) * pixels / batch.wallSeconds
+        let baselineSamplesPerSecond = Double(baseline.passes) * pixels / baseline.wallSeconds
+        return MultiViewResult(
+            scene: name,
+            width: resolution.width,
+            height: resolution.height,
+            label: options.label,
+            views: renderer.views.count,
+            setupSeconds: setupSeconds,
+            setupStages: renderer.views[0].engine.setupTimings,
+            passes: batch.passes,
+            wallSeconds: batch.wallSeconds,
+            gpuSeconds: batch.gpuSeconds,
+            samplesPerSecond: samplesPerSecond,
+            raysPerSecond: Double(batch.rays.reduce(0, +)) / batch.wallSeconds,
+            raysPerView: batch.rays,
+            singleViewSamplesPerSecond: baselineSamplesPerSecond,
+            singleViewRaysPerSecond: Double(baseline.rays[0]) / baseline.wallSeconds,
+            speedup: samplesPerSecond / baselineSamplesPerSecond,
+            guiding: renderer.views[0].engine.pathGuiding?.report
+        )
+    }
+
+    private func makeMultiViewRenderer(scene: Scene, cameras: [CameraConfig], resolution: Resolution) -> MultiViewRenderer {
+        MultiViewRenderer(
+            scene: scene,
+            cameras: cameras,
+            width: resolution.width,
+            height: resolution.height,
+            device: device,
+            commandQueue: commandQueue,
+            motionSegments: options.motionSegments,
+            specialize: options.specialize,
+            photonsPerPass: options.photonsPerPass,
+            guidingIterations: options.guidingIterations,
+            guidingBaselinePasses: PathGuiding.defaultBaselinePasses
+        )
+    }
+
+    /// Renders passes of all views of `renderer` for `duration` seconds of wall time.
+    private func renderViews(_ renderer: MultiViewRenderer, name: String, duration: Double, statistics: inout JSONLinesWriter?) -> (passes: Int, wallSeconds: Double, gpuSeconds: Double, rays: [UInt64]) {
+        var passes = 0
+        var wallSeconds: Double = 0
+        var gpuSeconds: Double = 0
+        var rays = [UInt64](repeating: 0, count: renderer.views.count)
+        renderer.resetRayCounters()
+        while wallSeconds < duration {
+            let start = Date.now
+            passes += 1
+            let commandBuffer = commandQueue.makeCommandBuffer()!
+            let renderConfig = RenderConfig(samplesPerPixel: 1, maxDepth: 10, passCounter: passes, rngSeed: RenderConfig.seed(pass: passes, stream: 0), sampleEnvironment: options.sampleEnvironment)
+            renderer.encodePass(commandBuffer: commandBuffer, renderConfig: renderConfig)
+            commandBuffer.commit()
+            commandBuffer.waitUntilCompleted()
+            wallSeconds += Date.now.timeIntervalSince(start)
+            gpuSeconds += commandBuffer.gpuEndTime - commandBuffer.gpuStartTime
+            for (i, count) in renderer.rayCounts.enumerated() {
+                rays[i] += UInt64(count)
+            }
+            renderer.resetRayCounters()
+            if ENABLE_STATISTICS != 0 {
+                for (i, viewStatistics) in renderer.collectStatistics().enumerated() {
+                    statistics?.write(StatisticsReport(scene: "\(name)/view\(i)", pass: passes, statistics: viewStatistics))
+                }
+            }
+        }
+        return (passes, wallSeconds, gpuSeconds, rays)
+    }
+
+    /// Renders a high sample count reference with the same estimator as `measure()`.
+    /// Every pass starts accumulation from scratch, passes are averaged on the CPU,
+    /// so the result is not limited by precision of float accumulation.
+    func makeReference(name: String, scene: Scene, resolution: Resolution) {
+        guard let directory = options.references else { return }
+        // Passes are averaged on the CPU, so progressive caustic photons would not converge
+        let engine = RenderEngine(scene: scene, device: device, commandQueue: commandQueue, motionSegments: options.motionSegments, photonsPerPass: 0, guidingIterations: 0)
+        let outputTexture = engine.makeOutputTexture(width: resolution.width, height: resolution.height)
+        var sum = [SIMD3<Double>](repeating: .zero, count: resolution.width * resolution.height)
+        for pass in 1...options.referencePasses {
+            let commandBuffer = commandQueue.makeCommandBuffer()!
+            let renderConfig = RenderConfig(samplesPerPixel: 1, maxDepth: 10, passCounter: 1, rngSeed: RenderConfig.seed(pass: pass, stream: 1))
+            engine.encodePass(commandBuffer: commandBuffer, outputTexture: outputTexture, camera: scene.camera, renderConfig: renderConfig)
+            commandBuffer.commit()
+            // Kernel outputs square root of the linear color
+            let image = engine.readPixels(outputTexture)
+            for i in sum.indices {
+                let c = SIMD3<Double>(image.pixels[i])
+                sum[i] += c * c
+            }
+        }
+        let n = Double(options.referencePasses)
+        let mean = FloatImage(width: resolution.width, height: resolution.height, pixels: sum.map { SIMD3<Float>(($0 / n).squareRoot()) })
+        try? FileManager.default.createDirectory(at: directory, withIntermediateDirectories: true)
+        let url = referenceURL(in: directory, name: name, resolution: resolution)
+        mean.writePFM(to: url)
+        FileHandle.standardError.write(Data("Wrote \(url.path)\n".utf8))
+    }
+
+    /// Writes raw cost data, and false-color images using the same scale as the interactive heatmap modes.
+    private func writeHeatmap(_ cost: FloatImage, to directory: URL, name: String) {
+        try? FileManager.default.createDirectory(at: directory, withIntermediateDirectories: true)
+        cost.writePFM(to: directory.appendingPathComponent("\(name)-cost.pfm"))
+        let metrics: [(OutputMode, String)] = [
+            (.output_mode_intersection_tests, "intersection-tests"),
+            (.output_mode_enumerator_steps, "enumerator-steps"),
+            (.output_mode_bounces, "bounces"),
+        ]
+        for (channel, (mode, metric)) in metrics.enumerated() {
+            let scale = mode.defaultHeatmapMax(maxDepth: 10)
+            let image = FloatImage(width: cost.width, height: cost.height, pixels: cost.pixels.map { heatmapColor($0[channel] / scale) })
+            image.writePNG(to: directory.appendingPathComponent("\(name)-\(metric).png"))
+        }
+    }
+
+    private func referenceURL(in directory: URL, name: String, resolution: Resolution) -> URL {
+        directory.appendingPathComponent("\(name)-\(resolution.width)x\(resolution.height).pfm")
+    }
+
+    private func waitUntilIdle() {
+        let commandBuffer = commandQueue.makeCommandBuffer()!
+        commandBuffer.commit()
+        commandBuffer.waitUntilCompleted()
+    }
+}
+
+/// RGB image, rows are stored from top to bottom.
+struct FloatImage {
+    var width: Int
+    var height: Int
+    var pixels: [SIMD3<Float>]
+
+    init(width: Int, height: Int, pixels: [SIMD3<Float>]) {
+        self.width = width
+        self.height = height
+        self.pixels = pixels
+    }
+
+    /// Reads a little-endian RGB Portable Float Map.
+    init?(pfm url: URL) {
+        guard let data = try? Data(contentsOf: url) else { return nil }
+        var lines: [String] = []
+        var offset = data.startIndex
+        while lines.count < 3, let newline = data[offset...].firstIndex(of: UInt8(ascii: "\n")) {
+            lines.append(String(decoding: data[offset..<newline], as: UTF8.self))
+            offset = newline + 1
+        }
+        let size = lines.count == 3 ? lines[1].split(separator: " ").compactMap { Int($0) } : []
+        guard lines.count == 3, lines[0] == "PF", size.count == 2, Double(lines[2]).map({ $0 < 0 }) == true else { return nil }
+        let (width, height) = (size[0], size[1])
+        guard data.count - offset == width * height * 3 * MemoryLayout<Float>.size else { return nil }
+
+        var pixels = [SIMD3<Float>](repeating: .zero, count: width * height)
+        data[offset...].withUnsafeBytes { buffer in
+            for y in 0..<height {
+                for x in 0..<width {
+                    let p = ((height - 1 - y) * width + x) * 3 * MemoryLayout<Float>.size
+                    pixels[y * width + x] = SIMD3(
+                        buffer.loadUnaligned(fromByteOffset: p, as: Float.self),
+                        buffer.loadUnaligned(fromByteOffset: p + 4, as: Float.self),
+                        buffer.loadUnaligned(fromByteOffset: p + 8, as: Float.self)
+                    )
+                }
+            }
+        }
+        self.init(width: width, height: height, pixels: pixels)
+    }
+
+    func writePFM(to url: URL) {
+        var data = Data("PF\n\(width) \(height)\n-1.0\n".utf8)
+        for y in (0..<height).reversed() {
+            for x in 0..<width {
+                let p = pixels[y * width + x]
+                withUnsafeBytes(of: (p.x, p.y, p.z)) { data.append(contentsOf: $0) }
+            }
+        }
+        try? data.write(to: url)
+    }
+
+    /// Writes 8-bit PNG, values are clamped to [0, 1] without any tone mapping.
+    func writePNG(to url: URL) {
+        var bytes: [UInt8] = []
+        bytes.reserveCapacity(pixels.count * 4)
+        for p in pixels {
+            let c = (simd_clamp(p, .zero, .one) * 255).rounded()
+            bytes += [UInt8(c.x), UInt8(c.y), UInt8(c.z), 255]
+        }
+        guard
+            let provider = CGDataProvider(data: Data(bytes) as CFData),
+            let image = CGImage(
+                width: width,
+                height: height,
+                bitsPerComponent: 8,
+                bitsPerPixel: 32,
+                bytesPerRow: width * 4,
+                space: CGColorSpace(name: CGColorSpace.sRGB)!,
+                bitmapInfo: CGBitmapInfo(rawValue: CGImageAlphaInfo.noneSkipLast.rawValue),
+                provider: provider,
+                decode: nil,
+                shouldInterpolate: false,
+                intent: .defaultIntent
+            ),
+            let destination = CGImageDestinationCreateWithURL(url as CFURL, "public.png" as CFString, 1, nil)
+        else { return }
+        CGImageDestinationAddImage(destination, image, nil)
+        CGImageDestinationFinalize(destination)
+    }
+
+    func rmse(to other: FloatImage) -> Double? {
+        guard width == other.width, height == other.height else { return nil }
+        var sum: Double = 0
+        for (a, b) in zip(pixels, other.pixels) {
+            let d = SIMD3<Double>(a - b)
+            sum += (d * d).sum()
+        }
+        return (sum / Double(pixels.count * 3)).squareRoot()
+    }
+}
+
+/// Same as heatmap_color() in Shaders.metal.
+func heatmapColor(_ value: Float) -> SIMD3<Float> {
+    let stops: [SIMD3<Float>] = [[0, 0, 0], [0, 0, 1], [0, 1, 1], [0, 1, 0], [1, 1, 0], [1, 0, 0], [1, 1, 1]]
+    let x = min(max(value, 0), 1) * 6
+    let i = min(Int(x), 5)
+    let f = x - Float(i)
+    return stops[i] * (1 - f) + stops[i + 1] * f
+}
+
+/// Writes one JSON object per line, to stdout if no file is given.
+struct JSONLinesWriter {
+    private var handle: FileHandle
+    private let encoder = JSONEncoder()
+
+    init(url: URL?) {
+        handle = .standardOutput
+        encoder.keyEncodingStrategy = .convertToSnakeCase
+        if let url {
+            if !FileManager.default.fileExists(atPath: url.path) {
+                FileManager.default.createFile(atPath: url.path, contents: nil)
+            }
+            if let file = try? FileHandle(forWritingTo: url) {
+                file.seekToEndOfFile()
+                handle = file
+            }
+        }
+    }
+
+    mutating func write(_ value: some Encodable) {
+        guard let data = try? encoder.encode(value) else { return }
+        handle.write(data + Data("\n".utf8))
+    }
+}
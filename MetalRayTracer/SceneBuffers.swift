@@ -11,43 +11,164 @@ struct SceneBuffers {
     let intersectionFunctions: [Int: String]
     let materialsBuffer: any MTLBuffer
     let textureLoader: TextureLoader
+    /// Offsets of texture resource IDs in `materialsBuffer`, patched by `installTextures()`, and updated by `replaceMaterial()`.
+    private(set) var textureReferences: [(offset: Int, texture: ImageTexture)]
+    /// Size of primitive data read by intersection functions, without bounding boxes and materials.
+    let primitiveBytes: Int
+    /// Union of finite bounding boxes of primitives, over the whole shutter interval.
+    let bounds: MTLAxisAlignedBoundingBox
 
-    init(scene: Scene, device: MTLDevice, commandQueue: MTLCommandQueue) {
-        var reserver = MaterialReserver()
-        for obj in scene.objects {
-            obj.visitMaterials(&reserver)
+    /// Bit mask of `MaterialKind`s used by the scene.
+    var materialKinds: UInt32 {
+        MaterialLayout(buffer: materialsBuffer.contents(), length: materialsBuffer.length).kinds
+    }
+
+    /// Moving objects get bounding boxes per segment of the shutter interval, so that rays only test objects
+    /// near their position at the time of the ray. With 0 segments they are bounded by the union over the whole interval.
+    static let defaultMotionSegments = 4
+
+    /// Wall time of setup stages on the CPU. The acceleration structure is built on the GPU after `init` returns.
+    private(set) var timings = StageTimings()
+
+    /// With `streamTextures` materials reference placeholders, and rendering can start before textures are decoded.
+    /// The caller decodes `pendingTextures` in the background, and calls `installTextures()` once they are ready.
+    /// Otherwise textures are decoded concurrently before returning.
+    init(scene: Scene, device: MTLDevice, commandQueue: MTLCommandQueue, motionSegments: Int = defaultMotionSegments, streamTextures: Bool = false) {
+        if let url = scene.archive, let archive = SceneArchive(url: url) {
+            self.init(archive: archive, device: device, commandQueue: commandQueue)
+        } else {
+            var timings = StageTimings()
+            let encoded = EncodedScene(objects: scene.objects, device: device, motionSegments: motionSegments, timings: &timings)
+            self.init(encoded: encoded, device: device, commandQueue: commandQueue)
+            self.timings.merge(timings)
         }
-        textureLoader = TextureLoader(device: device)
-        materialsBuffer = device.makeBuffer(length: reserver.totalSize)!
-        var encoder = MaterialEncoder(availableSize: reserver.totalSize, pointer: materialsBuffer.contents(), textureLoader: textureLoader)
+        if !streamTextures {
+            let textureLoader = textureLoader
+            let pending = pendingTextures
+            let decoded = timings.measure("Texture decode") {
+                textureLoader.decode(pending)
+            }
+            installTextures(decoded)
+        }
+    }
 
-        var grouper = RenderableGrouper()
-        for obj in scene.objects {
-            grouper.add(obj, encoder: &encoder)
+    private init(encoded: EncodedScene, device: MTLDevice, commandQueue: MTLCommandQueue) {
+        textureLoader = encoded.textureLoader
+        materialsBuffer = encoded.materialsBuffer
+        textureReferences = encoded.textureReferences
+        primitiveBytes = encoded.groups.reduce(0) { $0 + $1.primitiveStride * $1.count }
+        bounds = encoded.groups.reduce(into: .empty) { bounds, group in
+            if group.bounds.isFinite {
+                bounds.unite(with: group.bounds)
+            }
         }
 
-        var geometryDescriptors: [MTLAccelerationStructureGeometryDescriptor] = []
         var intersectionFunctions: [Int: String] = [:]
-        for group in grouper.groups.values {
-            // Create one or more bounding box geometry descriptors:
-            let geometryDescriptor = group.makeGeometryDescriptor(device: device)
-            geometryDescriptors.append(geometryDescriptor)
-
+        for group in encoded.groups {
             assert(intersectionFunctions[group.index] == nil)
             intersectionFunctions[group.index] = group.intersectionFunctionName
         }
         self.intersectionFunctions = intersectionFunctions
 
+        // Groups copy their primitives and bounding boxes into separate buffers, so they are uploaded in parallel
+        var geometryDescriptors = [MTLAccelerationStructureGeometryDescriptor?](repeating: nil, count: encoded.groups.count)
+        timings.measure("Geometry descriptors") {
+            geometryDescriptors.withUnsafeMutableBufferPointer { descriptors in
+                DispatchQueue.concurrentPerform(iterations: encoded.groups.count) { i in
+                    descriptors[i] = encoded.groups[i].makeGeometryDescriptor(device: device, keyframeCount: encoded.motionKeyframeCount)
+                }
+            }
+        }
+        accelerationStructure = timings.measure("Acceleration structure encode") {
+            Self.buildAccelerationStructure(geometryDescriptors: geometryDescriptors.map { $0! }, motionKeyframeCount: encoded.motionKeyframeCount,
+                                            device: device, commandQueue: commandQueue)
+        }
+    }
+
+    /// Render data is used in place, only texture references in the materials are patched.
+    private init(archive: SceneArchive, device: MTLDevice, commandQueue: MTLCommandQueue) {
+        textureLoader = TextureLoader(device: device)
+        textureReferences = archive.patchTextures(textureLoader: textureLoader)
+        let header = archive.header
+        materialsBuffer = archive.makeBuffer(device: device, offset: header.materials_offset, length: header.materials_size)
+        primitiveBytes = archive.groups.reduce(0) { $0 + Int($1.primitive_stride * $1.primitive_count) }
+
+        var geometryDescriptors: [MTLAccelerationStructureGeometryDescriptor] = []
+        var intersectionFunctions: [Int: String] = [:]
+        var bounds: MTLAxisAlignedBoundingBox = .empty
+        timings.measure("Geometry descriptors") {
+            for group in archive.groups {
+                let count = Int(group.primitive_count)
+                let stride = Int(group.primitive_stride)
+                let boundingBoxBuffer = archive.makeBuffer(device: device, offset: group.bounding_boxes_offset, length: UInt64(MemoryLayout<MTLAxisAlignedBoundingBox>.stride * count))
+                for box in UnsafeBufferPointer(start: boundingBoxBuffer.contents().assumingMemoryBound(to: MTLAxisAlignedBoundingBox.self), count: count) where box.isFinite {
+                    bounds.unite(with: box)
+                }
+                geometryDescriptors.append(MTLAccelerationStructureBoundingBoxGeometryDescriptor(
+                    boundingBoxBuffer: boundingBoxBuffer,
+                    primitiveDataBuffer: archive.makeBuffer(device: device, offset: group.primitives_offset, length: UInt64(stride * count)),
+                    count: count,
+                    stride: stride,
+                    size: Int(group.primitive_size),
+                    intersectionFunctionTableOffset: Int(group.function_table_index)
+                ))
+                intersectionFunctions[Int(group.function_table_index)] = archive.string(group.intersection_function)
+            }
+        }
+        self.intersectionFunctions = intersectionFunctions
+        self.bounds = bounds
+        accelerationStructure = timings.measure("Acceleration structure encode") {
+            Self.buildAccelerationStructure(geometryDescriptors: geometryDescriptors, device: device, commandQueue: commandQueue)
+        }
+    }
+
+    /// Textures that materials reference, but that still render as placeholders.
+    var pendingTextures: Set<ImageTexture> {
+        textureLoader.pending
+    }
+
+    /// Replaces placeholders by textures from `TextureLoader.decode()` in the materials.
+    /// Same as `replaceMaterial`, this must not overlap with passes in flight.
+    func installTextures(_ decoded: [ImageTexture: MTLTexture]) {
+        textureLoader.install(decoded)
+        for reference in textureReferences {
+            guard let texture = decoded[reference.texture] else { continue }
+            (materialsBuffer.contents() + reference.offset).storeBytes(of: texture.gpuResourceID, as: MTLResourceID.self)
+        }
+    }
+
+    /// Replaces the material referenced by `handle` in place, without re-encoding other materials or primitives.
+    /// The new material must be of the same kind. Passes encoded afterwards see the change,
+    /// so this must not overlap with passes in flight.
+    /// Textures new to the scene render as placeholders, and join `pendingTextures`, same as with streamed textures.
+    mutating func replaceMaterial(at handle: MaterialHandle, with material: some Material) {
+        var encoder = MaterialEncoder(encoded: materialsBuffer.contents(), length: materialsBuffer.length, textureLoader: textureLoader)
+        encoder.replace(at: handle, with: material)
+        let range = encoder.layout.range(of: handle, stride: material.size)
+        textureReferences.removeAll { range.contains($0.offset) }
+        textureReferences += encoder.textureReferences
+    }
+
+    private static func buildAccelerationStructure(geometryDescriptors: [MTLAccelerationStructureGeometryDescriptor], motionKeyframeCount: Int = 1,
+                                                   device: MTLDevice, commandQueue: MTLCommandQueue) -> any MTLAccelerationStructure {
         // Create a primitive acceleration structure descriptor
         let accelerationStructureDescriptor = MTLPrimitiveAccelerationStructureDescriptor()
         accelerationStructureDescriptor.geometryDescriptors = geometryDescriptors
+        if motionKeyframeCount > 1 {
+            // Keyframes are uniformly spaced over the shutter interval, same as time of the rays
+            accelerationStructureDescriptor.motionKeyframeCount = motionKeyframeCount
+            accelerationStructureDescriptor.motionStartTime = 0
+            accelerationStructureDescriptor.motionEndTime = 1
+            accelerationStructureDescriptor.motionStartBorderMode = .clamp
+            accelerationStructureDescriptor.motionEndBorderMode = .clamp
+        }
 
         // Query for the sizes needed to store and build the acceleration structure.
         let accelSizes = device.accelerationStructureSizes(descriptor: accelerationStructureDescriptor)
 
         // Allocate an acceleration structure large enough for this descriptor. This method
         // doesn't actually build the acceleration structure, but rather allocates memory.
-        accelerationStructure = device.makeAccelerationStructure(size: accelSizes.accelerationStructureSize)!
+        let accelerationStructure = device.makeAccelerationStructure(size: accelSizes.accelerationStructureSize)!
 
         // Allocate scratch space Metal uses to build the acceleration structure.
         // Use MTLResourceStorageModePrivate for the best performance because the sample
@@ -68,19 +189,69 @@ struct SceneBuffers {
         )
 
         commandEncoder.endEncoding()
+        Tracer.gpuInterval("Acceleration structure build", commandBuffer: commandBuffer)
         commandBuffer.commit()
+        return accelerationStructure
+    }
+}
+
+/// Materials and primitives encoded from Swift objects, before they are uploaded as geometry.
+struct EncodedScene {
+    let textureLoader: TextureLoader
+    let materialsBuffer: any MTLBuffer
+    let textureReferences: [(offset: Int, texture: ImageTexture)]
+    let groups: [AnyRenderableGroup]
+    /// Bounding boxes per primitive in the acceleration structure, 1 if it is built without motion.
+    let motionKeyframeCount: Int
+
+    /// Textures are not decoded, materials reference placeholders from `textureLoader`.
+    init(objects: [any Renderable], device: MTLDevice, motionSegments: Int = 0, timings: inout StageTimings) {
+        var reserver = MaterialReserver()
+        timings.measure("MaterialReserver") {
+            for obj in objects {
+                obj.visitMaterials(&reserver)
+            }
+        }
+        textureLoader = TextureLoader(device: device)
+        let layout = reserver.layout
+        materialsBuffer = device.makeBuffer(length: layout.totalSize)!
+        var encoder = MaterialEncoder(layout: layout, pointer: materialsBuffer.contents(), textureLoader: textureLoader)
+
+        // Encodes materials as objects are added
+        var grouper = RenderableGrouper(motionSegments: motionSegments)
+        timings.measure("RenderableGrouper + MaterialEncoder") {
+            for obj in objects {
+                grouper.add(obj, encoder: &encoder)
+            }
+        }
+        textureReferences = encoder.textureReferences
+        groups = grouper.groups.values.sorted { $0.index < $1.index }
+        motionKeyframeCount = groups.contains { $0.hasMotion } ? motionSegments + 1 : 1
     }
 }
 
 protocol AnyRenderableGroup: AnyObject {
     var index: Int { get }
     var intersectionFunctionName: String { get }
-    func makeGeometryDescriptor(device: MTLDevice) -> MTLAccelerationStructureBoundingBoxGeometryDescriptor
+    var count: Int { get }
+    var primitiveStride: Int { get }
+    var primitiveSize: Int { get }
+    var hasMotion: Bool { get }
+    /// Union of finite bounding boxes of the group.
+    var bounds: MTLAxisAlignedBoundingBox { get }
+    /// Writes `count` bounding boxes, covering the whole shutter interval.
+    func copyBoundingBoxes(to pointer: UnsafeMutableRawPointer)
+    /// Writes `count` primitives with `primitiveStride`.
+    func copyPrimitives(to pointer: UnsafeMutableRawPointer)
+    /// Motion geometry if `keyframeCount` is greater than 1. Groups without motion repeat the same boxes in every keyframe.
+    func makeGeometryDescriptor(device: MTLDevice, keyframeCount: Int) -> MTLAccelerationStructureGeometryDescriptor
 }
 
 class RenderableGroup<Impl: RenderableImpl>: AnyRenderableGroup {
     var index: Int
     var objects: [(Impl, MTLAxisAlignedBoundingBox)] = []
+    /// Bounding boxes of `objects` per keyframe of the acceleration structure, empty for groups without motion.
+    var keyframeBoxes: [[MTLAxisAlignedBoundingBox]] = []
 
     init(index: Int) {
         self.index = index
@@ -88,34 +259,102 @@ class RenderableGroup<Impl: RenderableImpl>: AnyRenderableGroup {
 
     var intersectionFunctionName: String { Impl.intersectionFunctionName }
 
-    func makeGeometryDescriptor(device: MTLDevice) -> MTLAccelerationStructureBoundingBoxGeometryDescriptor {
-        let boundingBoxBuffer = device.makeBuffer(length: MemoryLayout<MTLAxisAlignedBoundingBox>.stride * objects.count)!
-        let renderablesBuffer = device.makeBuffer(length: MemoryLayout<Impl>.stride * objects.count)!
-        var pBox = boundingBoxBuffer.contents().assumingMemoryBound(to: MTLAxisAlignedBoundingBox.self)
-        var pSphere = renderablesBuffer.contents().assumingMemoryBound(to: Impl.self)
-        for (obj, box) in objects {
-            pSphere.pointee = obj
-            pSphere += 1
+    var count: Int { objects.count }
+    var primitiveStride: Int { MemoryLayout<Impl>.stride }
+    var primitiveSize: Int { MemoryLayout<Impl>.size }
+    var hasMotion: Bool { Impl.hasMotion }
+
+    var bounds: MTLAxisAlignedBoundingBox {
+        objects.reduce(into: .empty) { bounds, object in
+            if object.1.isFinite {
+                bounds.unite(with: object.1)
+            }
+        }
+    }
+
+    func copyBoundingBoxes(to pointer: UnsafeMutableRawPointer) {
+        var pBox = pointer.assumingMemoryBound(to: MTLAxisAlignedBoundingBox.self)
+        for (_, box) in objects {
             pBox.pointee = box
             pBox += 1
         }
-        let geometryDescriptor = MTLAccelerationStructureBoundingBoxGeometryDescriptor()
-        geometryDescriptor.boundingBoxBuffer = boundingBoxBuffer
-        geometryDescriptor.boundingBoxCount = objects.count
-        geometryDescriptor.primitiveDataBuffer = renderablesBuffer
-        geometryDescriptor.primitiveDataStride = MemoryLayout<Impl>.stride
-        geometryDescriptor.primitiveDataElementSize = MemoryLayout<Impl>.size
-        geometryDescriptor.intersectionFunctionTableOffset = index
-        return geometryDescriptor
+    }
+
+    func copyPrimitives(to pointer: UnsafeMutableRawPointer) {
+        var pObject = pointer.assumingMemoryBound(to: Impl.self)
+        for (obj, _) in objects {
+            pObject.pointee = obj
+            pObject += 1
+        }
+    }
+
+    func makeGeometryDescriptor(device: MTLDevice, keyframeCount: Int) -> MTLAccelerationStructureGeometryDescriptor {
+        let boundingBoxBuffer = device.makeBuffer(length: MemoryLayout<MTLAxisAlignedBoundingBox>.stride * objects.count)!
+        let renderablesBuffer = device.makeBuffer(length: MemoryLayout<Impl>.stride * objects.count)!
+        copyBoundingBoxes(to: boundingBoxBuffer.contents())
+        copyPrimitives(to: renderablesBuffer.contents())
+        guard keyframeCount > 1 else {
+            return MTLAccelerationStructureBoundingBoxGeometryDescriptor(
+                boundingBoxBuffer: boundingBoxBuffer,
+                primitiveDataBuffer: renderablesBuffer,
+                count: objects.count,
+                stride: MemoryLayout<Impl>.stride,
+                size: MemoryLayout<Impl>.size,
+                intersectionFunctionTableOffset: index
+            )
+        }
+
+        precondition(keyframeBoxes.isEmpty || keyframeBoxes.count == keyframeCount)
+        let descriptor = MTLAccelerationStructureMotionBoundingBoxGeometryDescriptor()
+        descriptor.boundingBoxBuffers = (0..<keyframeCount).map { k in
+            let keyframe = MTLMotionKeyframeData()
+            if keyframeBoxes.isEmpty {
+                keyframe.buffer = boundingBoxBuffer
+            } else {
+                keyframe.buffer = keyframeBoxes[k].withUnsafeBytes { device.makeBuffer(bytes: $0.baseAddress!, length: $0.count)! }
+            }
+            return keyframe
+        }
+        descriptor.boundingBoxCount = objects.count
+        descriptor.primitiveDataBuffer = renderablesBuffer
+        descriptor.primitiveDataStride = MemoryLayout<Impl>.stride
+        descriptor.primitiveDataElementSize = MemoryLayout<Impl>.size
+        descriptor.intersectionFunctionTableOffset = index
+        return descriptor
+    }
+}
+
+extension MTLAccelerationStructureBoundingBoxGeometryDescriptor {
+    convenience init(boundingBoxBuffer: MTLBuffer, primitiveDataBuffer: MTLBuffer, count: Int, stride: Int, size: Int, intersectionFunctionTableOffset: Int) {
+        self.init()
+        self.boundingBoxBuffer = boundingBoxBuffer
+        self.boundingBoxCount = count
+        self.primitiveDataBuffer = primitiveDataBuffer
+        self.primitiveDataStride = stride
+        self.primitiveDataElementSize = size
+        self.intersectionFunctionTableOffset = intersectionFunctionTableOffset
     }
 }
 
 struct RenderableGrouper {
     var groups: [ObjectIdentifier: AnyRenderableGroup] = [:]
+    /// Number of shutter segments for keyframe bounding boxes of moving objects, 0 for static bounds only.
+    var motionSegments = 0
 
     mutating func add<R: Renderable>(_ renderable: R, encoder: inout MaterialEncoder) {
         let g = group(for: R.Impl.self)
         g.objects.append((renderable.asImpl(&encoder), renderable.boundingBox))
+        guard R.Impl.hasMotion && motionSegments > 0 else { return }
+        if g.keyframeBoxes.isEmpty {
+            g.keyframeBoxes = Array(repeating: [], count: motionSegments + 1)
+        }
+        // Metal interpolates boxes linearly between keyframes,
+        // so the box at a keyframe covers both adjacent segments
+        let n = Float(motionSegments)
+        for k in 0...motionSegments {
+            let interval = Float(max(k - 1, 0)) / n...Float(min(k + 1, motionSegments)) / n
+            g.keyframeBoxes[k].append(renderable.boundingBox(during: interval))
+        }
     }
 
     private mutating func group<Impl: RenderableImpl>(for type: Impl.Type) -> RenderableGroup<Impl> {
@@ -0,0 +1,64 @@
+//
+//  Statistics.h
+//  RayTracing
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+/// Compile-time switch for hot path counters. When 0, counters are not compiled into the kernel at all.
+#define ENABLE_STATISTICS 0
+
+enum {
+    statistics_path_length_buckets = 16,
+    statistics_material_kinds = 16,
+};
+
+enum StatisticsRayKind {
+    statistics_ray_camera,
+    statistics_ray_bounce,
+    statistics_ray_shadow,
+    statistics_ray_kind_count
+};
+
+/// One entry per intersection function in Shaders.metal.
+enum StatisticsIntersectionFunction {
+    statistics_function_sphere,
+    statistics_function_cylinder,
+    statistics_function_cuboid,
+    statistics_function_quad,
+    statistics_function_subtract_cylinder_cylinder,
+    statistics_function_subtract_cuboid_cylinder,
+    statistics_function_intersection2_cuboid_sphere,
+    statistics_function_union3_cylinder_cylinder_cylinder,
+    statistics_function_subtract_cuboid_union3_cylinder_cylinder_cylinder,
+    statistics_function_subtract_intersection2_cuboid_sphere__cylinder,
+    statistics_function_subtract_intersection2_cuboid_sphere__union3_cylinder_cylinder_cylinder,
+    statistics_function_cdv_cuboid,
+    statistics_function_hdv_cuboid,
+    statistics_function_moving_sphere,
+    statistics_function_moving_cuboid,
+    statistics_function_count
+};
+
+/// Counters updated by intersection functions, travel in the ray payload.
+struct IntersectionStatistics {
+    unsigned int calls[statistics_function_count];
+    unsigned int accepted_hits;
+    unsigned int rejected_hits;
+};
+
+/// Counters of a single thread, or a sum of them.
+/// Contains only `unsigned int` fields, so that it can be reduced as an array.
+struct RenderStatistics {
+    unsigned int rays[statistics_ray_kind_count];
+    struct IntersectionStatistics intersections;
+    /// Number of bounces before the path was terminated, last bucket includes longer paths.
+    unsigned int path_length[statistics_path_length_buckets];
+    unsigned int paths_killed_by_max_depth;
+    /// Indexed by MaterialKind.
+    unsigned int material_shading[statistics_material_kinds];
+};
+
+#endif // STATISTICS_H
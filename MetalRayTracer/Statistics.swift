@@ -0,0 +1,101 @@
+//
+//  Statistics.swift
+//  MetalRayTracer
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+
+/// Per-pass counters collected by the kernel when `ENABLE_STATISTICS` is set in Statistics.h.
+struct StatisticsReport: Encodable {
+    var scene: String
+    var pass: Int
+    var rays: [String: UInt64]
+    var intersectionCalls: [String: UInt64]
+    var acceptedHits: UInt64
+    var rejectedHits: UInt64
+    var pathLength: [UInt64]
+    var pathsKilledByMaxDepth: UInt64
+    var materialShading: [String: UInt64]
+
+    // Same order as in StatisticsRayKind
+    static let rayKinds = ["camera", "bounce", "shadow"]
+
+    // Same order as in StatisticsIntersectionFunction
+    static let intersectionFunctions = [
+        "sphere",
+        "cylinder",
+        "cuboid",
+        "quad",
+        "subtract_cylinder_cylinder",
+        "subtract_cuboid_cylinder",
+        "intersection2_cuboid_sphere",
+        "union3_cylinder_cylinder_cylinder",
+        "subtract_cuboid_union3_cylinder_cylinder_cylinder",
+        "subtract_intersection2_cuboid_sphere__cylinder",
+        "subtract_intersection2_cuboid_sphere__union3_cylinder_cylinder_cylinder",
+        "cdv_cuboid",
+        "hdv_cuboid",
+        "moving_sphere",
+        "moving_cuboid",
+    ]
+
+    // Indexed by MaterialKind
+    static let materialKinds = [
+        "",
+        "lambertian_colored",
+        "lambertian_textured",
+        "lambertian_perlin_noise",
+        "metal_colored",
+        "metal_textured",
+        "metal_perlin_noise",
+        "dielectric",
+        "emissive_colored",
+        "isotropic_colored",
+    ]
+
+    init(scene: String, pass: Int, statistics s: RenderStatisticsTotals) {
+        self.scene = scene
+        self.pass = pass
+        self.rays = Self.named(Self.rayKinds, s.counters(\.rays))
+        self.intersectionCalls = Self.named(Self.intersectionFunctions, s.counters(\.intersections.calls))
+        self.acceptedHits = s.counters(\.intersections.accepted_hits)[0]
+        self.rejectedHits = s.counters(\.intersections.rejected_hits)[0]
+        self.pathLength = s.counters(\.path_length)
+        self.pathsKilledByMaxDepth = s.counters(\.paths_killed_by_max_depth)[0]
+        self.materialShading = Self.named(Self.materialKinds, s.counters(\.material_shading))
+    }
+
+    /// Skips zero counters, to keep the output short.
+    private static func named(_ names: [String], _ counters: [UInt64]) -> [String: UInt64] {
+        var result: [String: UInt64] = [:]
+        for (i, value) in counters.enumerated() where value != 0 {
+            result[i < names.count ? names[i] : "\(i)"] = value
+        }
+        return result
+    }
+}
+
+/// Element-wise sum of `RenderStatistics` of many SIMD-groups. Counters are summed in 64 bits,
+/// because totals of a large pass overflow the 32-bit counters of the kernel.
+struct RenderStatisticsTotals {
+    private static let fieldCount = MemoryLayout<RenderStatistics>.size / MemoryLayout<UInt32>.size
+    /// Fields of `RenderStatistics` in memory order, treating it as an array of `UInt32`.
+    private var fields = [UInt64](repeating: 0, count: fieldCount)
+
+    init() {}
+
+    init(summing pointer: UnsafeRawPointer, count: Int) {
+        let slots = pointer.bindMemory(to: UInt32.self, capacity: count * Self.fieldCount)
+        for slot in 0..<count {
+            for field in 0..<Self.fieldCount {
+                fields[field] += UInt64(slots[slot * Self.fieldCount + field])
+            }
+        }
+    }
+
+    /// Totals of a counter or a C array of them.
+    func counters<T>(_ keyPath: KeyPath<RenderStatistics, T>) -> [UInt64] {
+        let start = MemoryLayout<RenderStatistics>.offset(of: keyPath)! / MemoryLayout<UInt32>.size
+        return Array(fields[start..<start + MemoryLayout<T>.size / MemoryLayout<UInt32>.size])
+    }
+}
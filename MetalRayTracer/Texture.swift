@@ -8,48 +8,82 @@
 import Metal
 import MetalKit
 
+/// Textures are not decoded when materials are encoded: they get a placeholder, and are queued in `pending`.
+/// `decode()` loads them concurrently, and `SceneBuffers.installTextures()` patches them into the materials,
+/// so that rendering can start before images are decoded.
 class TextureLoader {
     private(set) var textures: [ImageTexture: MTLTexture] = [:]
-    private var placeholderTexture: MTLTexture?
+    /// Textures that are referenced by materials, but are not decoded yet.
+    private(set) var pending: Set<ImageTexture> = []
     private let mtkLoader: MTKTextureLoader
+    /// Shown instead of textures that failed to load.
+    private let missingPlaceholder: MTLTexture
+    /// Shown while textures are being decoded.
+    private let pendingPlaceholder: MTLTexture
 
     init(device: MTLDevice) {
         mtkLoader = MTKTextureLoader(device: device)
+        missingPlaceholder = Self.makePlaceholder(device: device, color: 0xff_ff_00_ff)
+        pendingPlaceholder = Self.makePlaceholder(device: device, color: 0xff_80_80_80)
     }
 
     func load(_ texture: ImageTexture) -> MTLTexture {
         if let existing = textures[texture] {
             return existing
         }
-        let new = doLoad(texture)
-        textures[texture] = new
-        return new
+        pending.insert(texture)
+        textures[texture] = pendingPlaceholder
+        return pendingPlaceholder
     }
 
-    func doLoad(_ texture: ImageTexture) -> MTLTexture {
+    /// Decodes images concurrently. Does not change the loader, so it can run on a background queue,
+    /// while passes render with placeholders.
+    func decode(_ textures: some Collection<ImageTexture>) -> [ImageTexture: MTLTexture] {
+        let textures = Array(textures)
+        var decoded = [MTLTexture?](repeating: nil, count: textures.count)
+        decoded.withUnsafeMutableBufferPointer { decoded in
+            DispatchQueue.concurrentPerform(iterations: textures.count) { i in
+                decoded[i] = Tracer.interval("Texture load", category: "scene", detail: textures[i].name) {
+                    doLoad(textures[i])
+                }
+            }
+        }
+        return Dictionary(uniqueKeysWithValues: zip(textures, decoded.map { $0! }))
+    }
+
+    /// Replaces placeholders of decoded textures, see `SceneBuffers.installTextures()`.
+    func install(_ decoded: [ImageTexture: MTLTexture]) {
+        for (texture, metalTexture) in decoded {
+            textures[texture] = metalTexture
+            pending.remove(texture)
+        }
+    }
+
+    private func doLoad(_ texture: ImageTexture) -> MTLTexture {
         guard let url = Bundle.main.url(forResource: texture.name, withExtension: nil) else {
-            return getPlaceholder()
+            return missingPlaceholder
         }
 
         do {
+            // Mipmaps are sampled by the footprint of the ray cone, see `get_color()` in MaterialsImpl.h
             return try mtkLoader.newTexture(URL: url, options: [
-                .origin: MTKTextureLoader.Origin.bottomLeft
+                .origin: MTKTextureLoader.Origin.bottomLeft,
+                .allocateMipmaps: true,
+                .generateMipmaps: true,
             ])
         } catch {
-            return getPlaceholder()
+            return missingPlaceholder
         }
     }
 
-    func getPlaceholder() -> MTLTexture {
-        if let placeholderTexture { return placeholderTexture }
+    private static func makePlaceholder(device: MTLDevice, color: UInt32) -> MTLTexture {
         let descriptor = MTLTextureDescriptor.texture2DDescriptor(pixelFormat: .bgra8Unorm, width: 1, height: 1, mipmapped: false)
-        let texture = mtkLoader.device.makeTexture(descriptor: descriptor)!
+        let texture = device.makeTexture(descriptor: descriptor)!
         let region = MTLRegion(origin: MTLOrigin(x: 0, y: 0, z: 0), size: MTLSize(width: 1, height: 1, depth: 1))
-        var magenta: UInt32 = 0xff_ff_00_ff
-        withUnsafeBytes(of: &magenta) { buffer in
+        var color = color
+        withUnsafeBytes(of: &color) { buffer in
             texture.replace(region: region, mipmapLevel: 0, withBytes: buffer.baseAddress!, bytesPerRow: 4)
         }
-        self.placeholderTexture = texture
         return texture
     }
 }
@@ -88,6 +122,48 @@ extension PerlinNoiseTexture {
         }
         return result
     }
+
+    /// Interpolation factor between `colors` at the points, computed on the CPU the same way as `get_color()` in MaterialsImpl.h.
+    func turbulence(at points: [vector_float3]) -> [Float] {
+        withUnsafeBytes(of: vectors) { vectors in
+            withUnsafeBytes(of: permutations) { permutations in
+                let vectors = vectors.bindMemory(to: vector_float3.self)
+                let permutations = permutations.bindMemory(to: UInt8.self)
+                func hash(_ x: Int, _ y: Int, _ z: Int) -> Int {
+                    Int(permutations[512 + (Int(permutations[256 + (Int(permutations[x]) + y) & 255]) + z) & 255])
+                }
+                func noise(_ p: vector_float3) -> Float {
+                    let i0 = SIMD3(Int(floor(p.x)) & 255, Int(floor(p.y)) & 255, Int(floor(p.z)) & 255)
+                    let i1 = (i0 &+ 1) & 255
+                    let f = p - p.rounded(.down)
+                    let s = f * f * f * (f * (6 * f - 15) + 10)
+                    func corner(_ dx: Int, _ dy: Int, _ dz: Int) -> Float {
+                        let g = vectors[hash(dx == 0 ? i0.x : i1.x, dy == 0 ? i0.y : i1.y, dz == 0 ? i0.z : i1.z)]
+                        return simd_dot(g, f - vector_float3(Float(dx), Float(dy), Float(dz)))
+                    }
+                    let a = simd_mix(corner(0, 0, 0), corner(1, 0, 0), s.x)
+                    let b = simd_mix(corner(0, 1, 0), corner(1, 1, 0), s.x)
+                    let c = simd_mix(corner(0, 0, 1), corner(1, 0, 1), s.x)
+                    let d = simd_mix(corner(0, 1, 1), corner(1, 1, 1), s.x)
+                    return simd_mix(simd_mix(a, b, s.y), simd_mix(c, d, s.y), s.z)
+                }
+                return points.map { point in
+                    if turbulence == 0 {
+                        return 1 + noise(point * frequency)
+                    }
+                    var t: Float = 0
+                    var f = frequency
+                    var weight: Float = 1
+                    for _ in 0..<turbulence {
+                        t += noise(point * f) * weight
+                        weight *= 0.5
+                        f *= 2
+                    }
+                    return abs(t)
+                }
+            }
+        }
+    }
 }
 
 extension RandomNumberGenerator {
@@ -103,3 +179,20 @@ extension RandomNumberGenerator {
         }
     }
 }
+
+/// Deterministic generator for procedural content that must not change between launches.
+struct SplitMix64: RandomNumberGenerator {
+    private var state: UInt64
+
+    init(seed: UInt64) {
+        state = seed
+    }
+
+    mutating func next() -> UInt64 {
+        state &+= 0x9e3779b97f4a7c15
+        var z = state
+        z = (z ^ (z >> 30)) &* 0xbf58476d1ce4e5b9
+        z = (z ^ (z >> 27)) &* 0x94d049bb133111eb
+        return z ^ (z >> 31)
+    }
+}
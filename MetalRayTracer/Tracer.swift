@@ -0,0 +1,212 @@
+//
+//  Tracer.swift
+//  MetalRayTracer
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+
+import Foundation
+import Metal
+
+/// Timeline of scene building and rendering, written in Chrome trace format (chrome://tracing, ui.perfetto.dev).
+/// Enabled by launching with `--trace <path>`, the file is written when the app exits.
+///
+/// Every thread records into its own lock-free ring buffer, see `ThreadBuffer`.
+/// `write()` drains them, and can be called while other threads, including Metal completion handlers, keep recording.
+final class Tracer: @unchecked Sendable {
+    static let shared: Tracer? = {
+        let arguments = CommandLine.arguments
+        guard let i = arguments.firstIndex(of: "--trace"), i + 1 < arguments.endIndex else { return nil }
+        return Tracer(url: SceneBenchmark.Options.url(for: arguments[i + 1]))
+    }()
+
+    /// Track for GPU work, which does not belong to any CPU thread.
+    static let gpuTrack: UInt64 = 0
+
+    struct Event {
+        var name: StaticString
+        var category: StaticString
+        var start: UInt64
+        var duration: UInt64
+        var detail: String?
+        var track: UInt64?
+    }
+
+    /// Single-producer single-consumer ring of fixed capacity. Only the owning thread appends, and only `write()` drains.
+    /// Events in [tail, head) are published, and the producer does not touch their slots until the consumer advances tail.
+    /// When full, new events are dropped and counted, because overwriting the oldest ones would race with the consumer.
+    final class ThreadBuffer {
+        let threadID: UInt64
+        let threadName: String
+        private let capacity: UInt64
+        private let slots: UnsafeMutablePointer<Event>
+        /// Head, tail and number of dropped events, accessed only through `Atomics.h`.
+        private let counters: UnsafeMutablePointer<UInt64>
+        /// Events drained by previous calls to `write()`, accessed only by the consumer.
+        var drained: [Event] = []
+
+        init(threadID: UInt64, threadName: String, capacity: Int) {
+            self.threadID = threadID
+            self.threadName = threadName
+            self.capacity = UInt64(capacity)
+            slots = .allocate(capacity: capacity)
+            counters = .allocate(capacity: 3)
+            counters.initialize(repeating: 0, count: 3)
+        }
+
+        deinit {
+            let tail = atomic_load_acquire_u64(counters + 1)
+            for i in tail..<atomic_load_acquire_u64(counters) {
+                (slots + Int(i % capacity)).deinitialize(count: 1)
+            }
+            slots.deallocate()
+            counters.deallocate()
+        }
+
+        var dropped: UInt64 {
+            atomic_load_acquire_u64(counters + 2)
+        }
+
+        /// Called only by the owning thread.
+        func append(_ event: Event) {
+            let head = atomic_load_acquire_u64(counters)
+            guard head - atomic_load_acquire_u64(counters + 1) < capacity else {
+                atomic_increment_relaxed_u64(counters + 2)
+                return
+            }
+            (slots + Int(head % capacity)).initialize(to: event)
+            atomic_store_release_u64(counters, head + 1)
+        }
+
+        /// Moves published events into `drained`, called only by the consumer.
+        func drain() {
+            let head = atomic_load_acquire_u64(counters)
+            let tail = atomic_load_acquire_u64(counters + 1)
+            for i in tail..<head {
+                drained.append((slots + Int(i % capacity)).move())
+            }
+            atomic_store_release_u64(counters + 1, head)
+        }
+    }
+
+    let url: URL
+    private var key = pthread_key_t()
+    private var buffers: [ThreadBuffer] = []
+    private let buffersLock = NSLock()
+    /// Serializes consumers of the buffers.
+    private let writeLock = NSLock()
+
+    init(url: URL) {
+        self.url = url
+        pthread_key_create(&key, nil)
+    }
+
+    /// Nanoseconds, same time base as `MTLCommandBuffer.gpuStartTime`.
+    static func now() -> UInt64 {
+        clock_gettime_nsec_np(CLOCK_UPTIME_RAW)
+    }
+
+    /// Runs `body`, recording it as an event on the current thread if tracing is enabled.
+    static func interval<T>(_ name: StaticString, category: StaticString = "cpu", detail: @autoclosure () -> String? = nil, _ body: () throws -> T) rethrows -> T {
+        guard let tracer = shared else { return try body() }
+        let start = now()
+        let result = try body()
+        tracer.record(Event(name: name, category: category, start: start, duration: now() - start, detail: detail()))
+        return result
+    }
+
+    /// Records execution of the command buffer on the GPU track once it completes.
+    static func gpuInterval(_ name: StaticString, commandBuffer: MTLCommandBuffer, detail: @autoclosure () -> String? = nil) {
+        guard let tracer = shared else { return }
+        let detail = detail()
+        commandBuffer.addCompletedHandler { commandBuffer in
+            let start = UInt64(commandBuffer.gpuStartTime * 1e9)
+            let end = UInt64(commandBuffer.gpuEndTime * 1e9)
+            guard end > start else { return }
+            tracer.record(Event(name: name, category: "gpu", start: start, duration: end - start, detail: detail, track: gpuTrack))
+        }
+    }
+
+    func record(_ event: Event) {
+        currentBuffer().append(event)
+    }
+
+    private func currentBuffer() -> ThreadBuffer {
+        if let existing = pthread_getspecific(key) {
+            return Unmanaged<ThreadBuffer>.fromOpaque(existing).takeUnretainedValue()
+        }
+        var threadID: UInt64 = 0
+        pthread_threadid_np(nil, &threadID)
+        let name = Thread.isMainThread ? "Main" : (Thread.current.name.flatMap { $0.isEmpty ? nil : $0 } ?? "Thread \(threadID)")
+        let buffer = ThreadBuffer(threadID: threadID, threadName: name, capacity: 1 << 16)
+        buffersLock.withLock {
+            buffers.append(buffer)
+        }
+        // Retained by `buffers`
+        pthread_setspecific(key, Unmanaged.passUnretained(buffer).toOpaque())
+        return buffer
+    }
+
+    private struct TraceEvent: Encodable {
+        var name: String
+        var cat: String?
+        var ph: String
+        var ts: Double?
+        var dur: Double?
+        var pid: Int
+        var tid: UInt64
+        var args: [String: String]?
+    }
+
+    func write() {
+        writeLock.lock()
+        defer { writeLock.unlock() }
+        let buffers = buffersLock.withLock { self.buffers }
+        for buffer in buffers {
+            buffer.drain()
+        }
+        var events: [TraceEvent] = [
+            TraceEvent(name: "thread_name", ph: "M", pid: 1, tid: Self.gpuTrack, args: ["name": "GPU"])
+        ]
+        let origin = buffers.flatMap { $0.drained.map(\.start) }.min() ?? 0
+        for buffer in buffers {
+            let dropped = buffer.dropped
+            let name = dropped > 0 ? "\(buffer.threadName) (\(dropped) events dropped)" : buffer.threadName
+            events.append(TraceEvent(name: "thread_name", ph: "M", pid: 1, tid: buffer.threadID, args: ["name": name]))
+            for e in buffer.drained {
+                events.append(TraceEvent(
+                    name: e.name.description,
+                    cat: e.category.description,
+                    ph: "X",
+                    ts: Double(e.start - origin) / 1000,
+                    dur: Double(e.duration) / 1000,
+                    pid: 1,
+                    tid: e.track ?? buffer.threadID,
+                    args: e.detail.map { ["detail": $0] }
+                ))
+            }
+        }
+        guard let data = try? JSONEncoder().encode(["traceEvents": events]) else { return }
+        try? data.write(to: url)
+    }
+}
+
+/// Wall time of setup stages in seconds, reported by the benchmark regardless of `--trace`.
+struct StageTimings: Encodable {
+    private(set) var seconds: [String: Double] = [:]
+
+    /// Runs `body` as a `Tracer` interval, and adds its duration to the stage.
+    mutating func measure<T>(_ name: StaticString, category: StaticString = "scene", _ body: () throws -> T) rethrows -> T {
+        let start = Tracer.now()
+        defer { seconds[name.description, default: 0] += Double(Tracer.now() - start) / 1e9 }
+        return try Tracer.interval(name, category: category, body)
+    }
+
+    mutating func merge(_ other: StageTimings) {
+        seconds.merge(other.seconds, uniquingKeysWith: +)
+    }
+
+    func encode(to encoder: any Encoder) throws {
+        try seconds.encode(to: encoder)
+    }
+}
@@ -8,3 +8,7 @@
 #include "Config.h"
 #include "Materials.h"
 #include "Renderable.h"
+#include "Statistics.h"
+#include "SceneArchive.h"
+#include "Atomics.h"
+#include "AliasTable.h"
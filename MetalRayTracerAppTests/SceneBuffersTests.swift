@@ -0,0 +1,94 @@
+//
+//  SceneBuffersTests.swift
+//  MetalRayTracerAppTests
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+import XCTest
+import Metal
+@testable import MetalRayTracer
+
+/// Hosted by the app, unlike `MetalRayTracerTests`, so that it can encode scenes with the app's Swift types.
+class SceneBuffersTests: XCTestCase {
+    let earth = ImageTexture(name: "earthmap.jpg")
+    let barrel = ImageTexture(name: "barrel-side.jpg")
+
+    func makeBuffers() throws -> SceneBuffers {
+        let device = try XCTUnwrap(MTLCreateSystemDefaultDevice())
+        let commandQueue = try XCTUnwrap(device.makeCommandQueue())
+        let scene = Scene(camera: CameraConfig(), objects: [
+            Sphere(center: vector_float3(0, 0, 0), radius: 1, material: ColoredLambertian(albedo: vector_float3(0.1, 0.2, 0.3))),
+            Sphere(center: vector_float3(3, 0, 0), radius: 1, material: ColoredLambertian(albedo: vector_float3(0.4, 0.5, 0.6))),
+            Sphere(center: vector_float3(6, 0, 0), radius: 1, material: TexturedLambertian(albedo: earth)),
+            Sphere(center: vector_float3(9, 0, 0), radius: 1, material: TexturedMetal(albedo: earth, fuzz: 0.5)),
+        ])
+        return SceneBuffers(scene: scene, device: device, commandQueue: commandQueue, streamTextures: true)
+    }
+
+    func bytes(_ buffers: SceneBuffers) -> [UInt8] {
+        Array(UnsafeRawBufferPointer(start: buffers.materialsBuffer.contents(), count: buffers.materialsBuffer.length))
+    }
+
+    func materialRange<M: Material>(_ buffers: SceneBuffers, _ handle: MaterialHandle, _ type: M.Type) -> Range<Int> {
+        MaterialLayout(buffer: buffers.materialsBuffer.contents(), length: buffers.materialsBuffer.length)
+            .range(of: handle, stride: MemoryLayout<M.Impl>.stride)
+    }
+
+    func load<T>(_ buffers: SceneBuffers, at offset: Int, as type: T.Type) -> T {
+        (buffers.materialsBuffer.contents() + offset).load(as: T.self)
+    }
+
+    /// Only the bytes of the replaced material change, including the tables at the start of the buffer.
+    func assertUnchanged(_ before: [UInt8], _ after: [UInt8], outside range: Range<Int>, file: StaticString = #filePath, line: UInt = #line) {
+        XCTAssertEqual(before.count, after.count, file: file, line: line)
+        XCTAssertEqual(before[..<range.lowerBound], after[..<range.lowerBound], file: file, line: line)
+        XCTAssertEqual(before[range.upperBound...], after[range.upperBound...], file: file, line: line)
+    }
+
+    func testReplaceInPlace() throws {
+        var buffers = try makeBuffers()
+        let before = bytes(buffers)
+        let references = buffers.textureReferences
+
+        let handle = make_material_handle(.material_kind_lambertian_colored, 1)
+        buffers.replaceMaterial(at: handle, with: ColoredLambertian(albedo: vector_float3(0.7, 0.8, 0.9)))
+        let range = materialRange(buffers, handle, ColoredLambertian.self)
+        XCTAssertEqual(load(buffers, at: range.lowerBound, as: __ColoredLambertianMaterial.self).albedo, vector_float3(0.7, 0.8, 0.9))
+        assertUnchanged(before, bytes(buffers), outside: range)
+        // Neighbour in the same table
+        let other = materialRange(buffers, make_material_handle(.material_kind_lambertian_colored, 0), ColoredLambertian.self)
+        XCTAssertEqual(load(buffers, at: other.lowerBound, as: __ColoredLambertianMaterial.self).albedo, vector_float3(0.1, 0.2, 0.3))
+
+        XCTAssertEqual(buffers.textureReferences.map { $0.offset }, references.map { $0.offset })
+        XCTAssertEqual(buffers.textureReferences.map { $0.texture }, references.map { $0.texture })
+    }
+
+    func testReplaceTexture() throws {
+        var buffers = try makeBuffers()
+        XCTAssertEqual(buffers.pendingTextures, [earth])
+        let before = bytes(buffers)
+
+        let handle = make_material_handle(.material_kind_lambertian_textured, 0)
+        let range = materialRange(buffers, handle, TexturedLambertian.self)
+        let metal = materialRange(buffers, make_material_handle(.material_kind_metal_textured, 0), TexturedMetal.self)
+        buffers.replaceMaterial(at: handle, with: TexturedLambertian(albedo: barrel))
+        assertUnchanged(before, bytes(buffers), outside: range)
+
+        // Reference of the replaced material points to the new texture, the other material keeps its own
+        let replaced = buffers.textureReferences.filter { range.contains($0.offset) }
+        XCTAssertEqual(replaced.map { $0.offset }, [range.lowerBound + MemoryLayout<__TexturedLambertianMaterial>.offset(of: \.albedo)!])
+        XCTAssertEqual(replaced.map { $0.texture }, [barrel])
+        XCTAssertEqual(buffers.textureReferences.filter { metal.contains($0.offset) }.map { $0.texture }, [earth])
+        XCTAssertEqual(buffers.textureReferences.count, 2)
+        XCTAssertEqual(buffers.pendingTextures, [earth, barrel])
+
+        // Installing patches the new reference, same as references encoded with the scene
+        let decoded = buffers.textureLoader.decode(buffers.pendingTextures)
+        buffers.installTextures(decoded)
+        XCTAssertEqual(buffers.pendingTextures, [])
+        for reference in buffers.textureReferences {
+            let id = load(buffers, at: reference.offset, as: MTLResourceID.self)
+            XCTAssertEqual(id._impl, decoded[reference.texture]!.gpuResourceID._impl)
+        }
+    }
+}
@@ -0,0 +1,238 @@
+//
+//  Fixtures.h
+//  MetalRayTracerBenchmarks
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+
+#ifndef FIXTURES_H
+#define FIXTURES_H
+
+#include <cstring>
+#include <vector>
+#include "../MetalRayTracer/Impl/RenderableImpl.h"
+#include "../MetalRayTracer/Impl/MaterialsImpl.h"
+
+// MARK: - Ray sets
+
+enum ray_kind {
+    ray_kind_hit,
+    ray_kind_grazing,
+    ray_kind_miss,
+};
+
+/// Deterministic ray set aimed at a bounding sphere of the object under test.
+/// Rays are interleaved: aimed inside the sphere, tangent to its silhouette, and clearly outside of it.
+/// Only the first kind is guaranteed to mostly hit, actual hit ratio is reported by the benchmark.
+inline std::vector<Ray3D> make_rays(float3 center, float radius, size_t count, uint64_t seed) {
+    RNG rng(seed, 0x5eed);
+    std::vector<Ray3D> result;
+    result.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        float3 origin = center + normalize(rng.random_unit_vector_3d()) * (radius * 4);
+        float3 view = normalize(center - origin);
+        float3 offset;
+        switch ((ray_kind)(i % 3)) {
+            case ray_kind_hit: {
+                offset = normalize(rng.random_unit_vector_3d()) * (radius * 0.5f * rng.random_f());
+                break;
+            }
+            case ray_kind_grazing:
+            case ray_kind_miss: {
+                float3 side = rng.random_unit_vector_3d();
+                side = side - dot(side, view) * view;
+                float lenSq = length_squared(side);
+                side = lenSq > min_vector_length_squared ? side / sqrt(lenSq) : cross(view, (float3){0, 1, 0});
+                float scale = (i % 3) == ray_kind_grazing ? 0.98f + 0.04f * rng.random_f() : 1.5f + 1.5f * rng.random_f();
+                offset = side * (radius * scale);
+                break;
+            }
+        }
+        result.push_back(Ray3D(origin, normalize(center + offset - origin)));
+    }
+    return result;
+}
+
+// MARK: - Objects
+
+inline vector_short4 identity_rotation() {
+    return (vector_short4){0, 0, 0, 32767};
+}
+
+/// Rotation around one of the coordinate axes, packed like `Transform.compactRotation` in Renderable.swift.
+inline vector_short4 make_rotation(float degrees, int axis) {
+    float a = degrees * M_PI_F / 360;
+    short s = (short)round(sin(a) * 32767), c = (short)round(cos(a) * 32767);
+    switch (axis) {
+        case 0: return (vector_short4){s, 0, 0, c};
+        case 1: return (vector_short4){0, s, 0, c};
+        default: return (vector_short4){0, 0, s, c};
+    }
+}
+
+inline Sphere make_sphere(float3 center, float radius) {
+    Sphere result = { center, identity_rotation(), radius, 0 };
+    return result;
+}
+
+inline Cylinder make_cylinder(vector_short4 rotation, float3 translation, float radius, float height) {
+    Cylinder result = { translation, rotation, radius, height, 0, 0, 0 };
+    return result;
+}
+
+inline Cuboid make_cuboid(vector_short4 rotation, float3 translation, float3 size) {
+    Cuboid result = { translation, size, rotation, { 0, 0, 0, 0, 0, 0 } };
+    return result;
+}
+
+inline Quad make_quad(float3 origin, float3 u, float3 v) {
+    // Mirrors Quad.asImpl() in Primitives.swift
+    float3 n = cross(u, v);
+    float3 w = n / length_squared(n);
+    Quad result = { origin, u, v, w, dot(origin, w), 0 };
+    return result;
+}
+
+// Parts of Scene.compositionDemo, all of them fit into a sphere of radius 2 around the origin.
+inline Cuboid demo_box() { return make_cuboid(identity_rotation(), (float3){-1, -1, -1}, (float3){2, 2, 2}); }
+inline Sphere demo_sphere() { return make_sphere((float3){0, 0, 0}, 1.3); }
+inline Cylinder demo_cylinder(int axis) {
+    if (axis == 1) {
+        return make_cylinder(identity_rotation(), (float3){0, -2, 0}, 0.55, 4);
+    }
+    // Rotate first, then move the base so that the cylinder is centered at the origin.
+    vector_short4 rotation = make_rotation(90, axis == 0 ? 2 : 0);
+    return make_cylinder(rotation, unpack_rotation(rotation) * (float3){0, -2, 0}, 0.55, 4);
+}
+inline Union<Cylinder, Cylinder, Cylinder> demo_cross() {
+    return Union<Cylinder, Cylinder, Cylinder>(demo_cylinder(0), demo_cylinder(1), demo_cylinder(2));
+}
+
+/// Motion from `from` to `to` with a half turn around the Y axis, in `keyframe_count` uniform steps.
+inline Motion make_motion(float3 from, float3 to, uint32_t keyframe_count) {
+    Motion result = {};
+    result.keyframe_count = keyframe_count;
+    for (uint32_t i = 0; i < keyframe_count; i++) {
+        float f = float(i) / (keyframe_count - 1);
+        result.translation[i] = from + (to - from) * f;
+        result.rotation[i] = make_rotation(180 * f, 1);
+    }
+    return result;
+}
+
+/// Same rays at random times over the shutter interval.
+inline std::vector<Ray3D> with_random_times(std::vector<Ray3D> rays, uint64_t seed) {
+    RNG rng(seed, 0x71e);
+    for (Ray3D & ray : rays) {
+        ray.time = rng.random_f();
+    }
+    return rays;
+}
+
+// MARK: - Materials
+
+inline PerlinNoiseTexture make_perlin_texture(uint64_t seed) {
+    RNG rng(seed, 0x9e71);
+    PerlinNoiseTexture result;
+    result.colors[0] = (float3){0, 0, 0};
+    result.colors[1] = (float3){1, 1, 1};
+    result.frequency = 4;
+    result.turbulence = 5;
+    for (int i = 0; i < PerlinNoiseTexture::TABLE_SIZE; i++) {
+        result.vectors[i] = rng.random_unit_vector_3d();
+    }
+    for (int k = 0; k < 3; k++) {
+        for (int i = 0; i < PerlinNoiseTexture::TABLE_SIZE; i++) {
+            result.permutations[k][i] = (uint8_t)i;
+        }
+        // Fisher-Yates, same as PerlinNoiseTexture.generate() in Texture.swift
+        for (int i = PerlinNoiseTexture::TABLE_SIZE - 1; i > 0; i--) {
+            int j = (int)(rng.random_u32() % (uint32_t)(i + 1));
+            uint8_t tmp = result.permutations[k][i];
+            result.permutations[k][i] = result.permutations[k][j];
+            result.permutations[k][j] = tmp;
+        }
+    }
+    return result;
+}
+
+/// Materials buffer with a single material in the table of `kind`, laid out as by `MaterialEncoder`.
+template<class Material>
+std::vector<uchar> make_material_tables(MaterialKind kind, Material const & material) {
+    MaterialTables tables = {};
+    uint32_t offset = (sizeof(MaterialTables) + MaterialTables::MATERIAL_TABLE_ALIGNMENT - 1) / MaterialTables::MATERIAL_TABLE_ALIGNMENT * MaterialTables::MATERIAL_TABLE_ALIGNMENT;
+    tables.offsets[kind] = offset;
+    std::vector<uchar> result(offset + sizeof(Material));
+    memcpy(result.data(), &tables, sizeof(tables));
+    memcpy(result.data() + offset, &material, sizeof(material));
+    return result;
+}
+
+// MARK: - Volumes
+
+/// Smoke-like density from turbulence of `noise` over the box, with empty space around the denser parts.
+/// Majorants are computed the same way as `DensityGrid.init` in HeterogeneousVolume.swift.
+inline DensityGrid make_density_grid(PerlinNoiseTexture const & noise, float3 bounds_min, float3 bounds_max, float max_density) {
+    enum { N = DensityGrid::DENSITY_GRID_RESOLUTION, M = DensityGrid::DENSITY_GRID_MAJORANT_RESOLUTION, B = N / M };
+    DensityGrid result;
+    result.bounds_min = bounds_min;
+    result.bounds_max = bounds_max;
+    result.density_scale = max_density;
+    for (int z = 0; z < N; z++) {
+        for (int y = 0; y < N; y++) {
+            for (int x = 0; x < N; x++) {
+                float3 p = (float3){x + 0.5f, y + 0.5f, z + 0.5f} / float(N);
+                float value = perlin_color(noise, bounds_min + p * (bounds_max - bounds_min), 0).x - 0.5f;
+                result.voxels[z][y][x] = (uint8_t)(min(max(value * 2, 0.0f), 1.0f) * 255);
+            }
+        }
+    }
+    for (int z = 0; z < M; z++) {
+        for (int y = 0; y < M; y++) {
+            for (int x = 0; x < M; x++) {
+                // Interpolation inside the block also reads the neighbouring voxels
+                uint8_t value = 0;
+                for (int k = max(z * B - 1, 0); k <= min(z * B + B, N - 1); k++) {
+                    for (int j = max(y * B - 1, 0); j <= min(y * B + B, N - 1); j++) {
+                        for (int i = max(x * B - 1, 0); i <= min(x * B + B, N - 1); i++) {
+                            value = std::max(value, result.voxels[k][j][i]);
+                        }
+                    }
+                }
+                result.majorants[z][y][x] = value * (max_density / 255);
+            }
+        }
+    }
+    return result;
+}
+
+/// Surface hits to shade: random points on a unit sphere, hit from outside or inside.
+struct ShadingSample {
+    Ray3D ray;
+    HitInfo hit;
+};
+
+inline std::vector<ShadingSample> make_shading_samples(size_t count, uint64_t seed) {
+    RNG rng(seed, 0x5ade);
+    std::vector<ShadingSample> result;
+    result.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        float3 n = normalize(rng.random_unit_vector_3d());
+        float3 origin = n * (1 + 3 * rng.random_f()) + rng.random_unit_vector_3d() * 0.5f;
+        if (i % 4 == 3) {
+            // Leaving a dielectric or a volume
+            origin = (float3){0, 0, 0};
+        }
+        float3 direction = normalize(n - origin);
+        HitInfo hit;
+        hit.point = n;
+        hit.set_normal(n, direction);
+        hit.material = 0;
+        hit.texture_coordinates = (float2){rng.random_f(), rng.random_f()};
+        hit.texture_scale = 1;
+        result.push_back({ Ray3D(origin, direction), hit });
+    }
+    return result;
+}
+
+#endif // FIXTURES_H
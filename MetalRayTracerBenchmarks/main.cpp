@@ -0,0 +1,238 @@
+//
+//  main.cpp
+//  MetalRayTracerBenchmarks
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+//  Microbenchmarks for the hit-testing and shading code shared with Shaders.metal.
+//  Prints one JSON object per benchmark per line, so that results of different commits can be diffed or plotted.
+//
+//  Usage: MetalRayTracerBenchmarks [--filter <substring>] [--rays <count>] [--min-time <seconds>] [--label <text>] [--output <path>]
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include "Fixtures.h"
+
+struct Options {
+    std::string filter;
+    std::string label;
+    std::string output;
+    size_t ray_count = 30000;
+    double min_time = 0.25;
+    int repetitions = 5;
+};
+
+/// Result of a single timed run. Counters are accumulated so that the compiler cannot drop the work.
+struct RunResult {
+    uint64_t items = 0;
+    uint64_t hits = 0;
+    uint64_t steps = 0;
+    double checksum = 0;
+};
+
+struct Benchmark {
+    std::string name;
+    std::function<RunResult()> run;
+};
+
+// MARK: - Kernels
+
+template<class T>
+RunResult trace_rays(T const & object, std::vector<Ray3D> const & rays) {
+    RunResult result;
+    RNG rng(42, 54);
+    for (Ray3D const & ray : rays) {
+        auto e = get_hit_enumerator(object, ray, &rng);
+        // Same query as intersection() in Shaders.metal does for a primary ray.
+        HitInfo hit;
+        float distance;
+        uint steps = 0;
+        if (find_first_hit(e, ray.direction, 0.0001, INFINITY, hit, distance, steps)) {
+            result.hits++;
+            result.checksum += distance + hit.normal.x + hit.texture_coordinates.y;
+        }
+        result.steps += steps;
+    }
+    result.items = rays.size();
+    return result;
+}
+
+RunResult shade(std::vector<uchar> const & materials, MaterialHandle material, float footprint, std::vector<ShadingSample> const & samples) {
+    RunResult result;
+    RNG rng(42, 54);
+    for (ShadingSample const & sample : samples) {
+        material_result r = { (float3){0, 0, 0}, (float3){0, 0, 0}, sample.ray };
+        RayCone cone = { footprint, 0 };
+        if (scatter(materials.data(), material, sample.ray, sample.hit, cone, &rng, r)) {
+            result.hits++;
+            result.checksum += r.scattered.direction.x + r.attenuation.y;
+        }
+        result.checksum += r.emitted.z;
+    }
+    result.items = samples.size();
+    return result;
+}
+
+template<class T>
+Benchmark hit_benchmark(std::string name, T object, float3 center, float radius, Options const & options) {
+    auto rays = std::make_shared<std::vector<Ray3D>>(make_rays(center, radius, options.ray_count, 2025));
+    return { "hit/" + name, [object, rays]() { return trace_rays(object, *rays); } };
+}
+
+template<class Material>
+Benchmark scatter_benchmark(std::string name, MaterialKind kind, Material material, Options const & options, float footprint = 0) {
+    auto samples = std::make_shared<std::vector<ShadingSample>>(make_shading_samples(options.ray_count, 2025));
+    auto materials = std::make_shared<std::vector<uchar>>(make_material_tables(kind, material));
+    MaterialHandle handle = make_material_handle(kind, 0);
+    return { "scatter/" + name, [materials, handle, footprint, samples]() { return shade(*materials, handle, footprint, *samples); } };
+}
+
+std::vector<Benchmark> make_benchmarks(Options const & options) {
+    std::vector<Benchmark> result;
+
+    // Primitives
+    result.push_back(hit_benchmark("sphere", demo_sphere(), (float3){0, 0, 0}, 1.3, options));
+    result.push_back(hit_benchmark("cylinder", make_cylinder(make_rotation(30, 0), (float3){0, -1, 0}, 0.5, 2), (float3){0, 0, 0}, 1.2, options));
+    result.push_back(hit_benchmark("cuboid", make_cuboid(make_rotation(30, 1), (float3){-0.5, -0.5, -0.5}, (float3){1, 1, 1}), (float3){0, 0, 0}, 0.9, options));
+    result.push_back(hit_benchmark("quad", make_quad((float3){-1, -1, 0}, (float3){2, 0, 0}, (float3){0, 2, 0}), (float3){0, 0, 0}, 1.5, options));
+
+    // Compositions, same instantiations as the intersection functions in Shaders.metal
+    Cylinder glass = make_cylinder(identity_rotation(), (float3){0, 0, 0}, 4, 12);
+    Cylinder glass_hole = make_cylinder(identity_rotation(), (float3){0, 1, 0}, 3.5, 12);
+    result.push_back(hit_benchmark("subtract_cylinder_cylinder", Subtract<Cylinder, Cylinder>(glass, glass_hole), (float3){0, 6, 0}, 7.3, options));
+    result.push_back(hit_benchmark("subtract_cuboid_cylinder", Subtract<Cuboid, Cylinder>(demo_box(), demo_cylinder(1)), (float3){0, 0, 0}, 1.8, options));
+    result.push_back(hit_benchmark("intersection2_cuboid_sphere", Intersection<Cuboid, Sphere>(demo_box(), demo_sphere()), (float3){0, 0, 0}, 1.5, options));
+    result.push_back(hit_benchmark("union3_cylinder_cylinder_cylinder", demo_cross(), (float3){0, 0, 0}, 2.1, options));
+    result.push_back(hit_benchmark("subtract_cuboid_union3_cylinder_cylinder_cylinder", Subtract<Cuboid, Union<Cylinder, Cylinder, Cylinder>>(demo_box(), demo_cross()), (float3){0, 0, 0}, 1.8, options));
+    result.push_back(hit_benchmark("subtract_intersection2_cuboid_sphere__cylinder", Subtract<Intersection<Cuboid, Sphere>, Cylinder>(Intersection<Cuboid, Sphere>(demo_box(), demo_sphere()), demo_cylinder(1)), (float3){0, 0, 0}, 1.5, options));
+    result.push_back(hit_benchmark("subtract_intersection2_cuboid_sphere__union3_cylinder_cylinder_cylinder", Subtract<Intersection<Cuboid, Sphere>, Union<Cylinder, Cylinder, Cylinder>>(Intersection<Cuboid, Sphere>(demo_box(), demo_sphere()), demo_cross()), (float3){0, 0, 0}, 1.5, options));
+
+    // Volumes
+    result.push_back(hit_benchmark("cdv_cuboid", ConstantDensityVolume<Cuboid>(make_cuboid(identity_rotation(), (float3){-3, -3, 0}, (float3){6, 3, 5}), 0.5), (float3){0, -1.5, 2.5}, 4.2, options));
+    {
+        // Grid is large, so the object is shared instead of being copied into the closure
+        auto smoke = std::make_shared<HeterogeneousVolume<Cuboid>>(
+            make_cuboid(identity_rotation(), (float3){-3, -3, 0}, (float3){6, 3, 5}),
+            make_density_grid(make_perlin_texture(2025), (float3){-3, -3, 0}, (float3){3, 0, 5}, 2)
+        );
+        auto rays = std::make_shared<std::vector<Ray3D>>(make_rays((float3){0, -1.5, 2.5}, 4.2, options.ray_count, 2025));
+        result.push_back({ "hit/hdv_cuboid", [smoke, rays]() { return trace_rays(*smoke, *rays); } });
+    }
+
+    // Motion, objects move across the bounding sphere of the rays
+    {
+        auto rays = std::make_shared<std::vector<Ray3D>>(with_random_times(make_rays((float3){0, 0, 0}, 2, options.ray_count, 2025), 2025));
+        Moving<Sphere> sphere(make_sphere((float3){0, 0, 0}, 0.5), make_motion((float3){-1, 0, 0}, (float3){1, 0, 0}, 3));
+        result.push_back({ "hit/moving_sphere", [sphere, rays]() { return trace_rays(sphere, *rays); } });
+        Moving<Cuboid> cuboid(make_cuboid(identity_rotation(), (float3){-0.5, -0.5, -0.5}, (float3){1, 1, 1}), make_motion((float3){-1, 0, 0}, (float3){1, 0, 0}, 3));
+        result.push_back({ "hit/moving_cuboid", [cuboid, rays]() { return trace_rays(cuboid, *rays); } });
+    }
+
+    // Materials. Textured variants are skipped: image textures can only be sampled on the GPU.
+    PerlinNoiseTexture noise = make_perlin_texture(2025);
+    result.push_back(scatter_benchmark("lambertian_colored", material_kind_lambertian_colored, ColoredLambertianMaterial { (float3){0.1, 0.2, 0.5} }, options));
+    result.push_back(scatter_benchmark("lambertian_perlin_noise", material_kind_lambertian_perlin_noise, PerlinNoiseLambertianMaterial { noise }, options));
+    // Distant hit, or a lookup after a diffuse bounce: only the coarsest octaves are evaluated
+    result.push_back(scatter_benchmark("lambertian_perlin_noise_wide_cone", material_kind_lambertian_perlin_noise, PerlinNoiseLambertianMaterial { noise }, options, 0.05));
+    result.push_back(scatter_benchmark("metal_colored", material_kind_metal_colored, ColoredMetalMaterial { (float3){0.8, 0.6, 0.2}, 0.3 }, options));
+    result.push_back(scatter_benchmark("metal_perlin_noise", material_kind_metal_perlin_noise, PerlinNoiseMetalMaterial { noise, 0.3 }, options));
+    result.push_back(scatter_benchmark("dielectric", material_kind_dielectric, DielectricMaterial { 1.5 }, options));
+    result.push_back(scatter_benchmark("emissive_colored", material_kind_emissive_colored, ColoredEmissiveMaterial { (float3){4, 4, 4} }, options));
+    result.push_back(scatter_benchmark("isotropic_colored", material_kind_isotropic_colored, ColoredIsotropicMaterial { (float3){1, 1, 0} }, options));
+
+    return result;
+}
+
+// MARK: - Driver
+
+static double now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// Runs the benchmark until `min_time` elapses, `repetitions` times, and reports the fastest repetition.
+static void measure(Benchmark const & benchmark, Options const & options, FILE * out) {
+    RunResult warmup = benchmark.run();
+
+    double best_rate = 0;
+    double best_seconds = 0;
+    uint64_t best_items = 0;
+    double checksum = warmup.checksum;
+    for (int i = 0; i < options.repetitions; i++) {
+        uint64_t items = 0;
+        double start = now();
+        double elapsed = 0;
+        do {
+            RunResult r = benchmark.run();
+            items += r.items;
+            checksum += r.checksum;
+            elapsed = now() - start;
+        } while (elapsed < options.min_time);
+        double rate = items / elapsed;
+        if (rate > best_rate) {
+            best_rate = rate;
+            best_seconds = elapsed;
+            best_items = items;
+        }
+    }
+
+    double hit_ratio = warmup.items ? (double)warmup.hits / warmup.items : 0;
+    double steps_per_item = warmup.items ? (double)warmup.steps / warmup.items : 0;
+    fprintf(out,
+            "{\"benchmark\": \"%s\", \"label\": \"%s\", \"items\": %llu, \"seconds\": %.6f, \"items_per_second\": %.1f, "
+            "\"hit_ratio\": %.4f, \"steps_per_item\": %.4f, \"checksum\": %.6g}\n",
+            benchmark.name.c_str(), options.label.c_str(), (unsigned long long)best_items, best_seconds, best_rate,
+            hit_ratio, steps_per_item, checksum);
+    fflush(out);
+}
+
+static void usage(char const * argv0) {
+    fprintf(stderr, "Usage: %s [--filter <substring>] [--rays <count>] [--min-time <seconds>] [--label <text>] [--output <path>]\n", argv0);
+}
+
+int main(int argc, char const * argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--filter") && has_value) {
+            options.filter = argv[++i];
+        } else if (!strcmp(argv[i], "--rays") && has_value) {
+            options.ray_count = strtoull(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--min-time") && has_value) {
+            options.min_time = strtod(argv[++i], nullptr);
+        } else if (!strcmp(argv[i], "--label") && has_value) {
+            options.label = argv[++i];
+        } else if (!strcmp(argv[i], "--output") && has_value) {
+            options.output = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    FILE * out = stdout;
+    if (!options.output.empty()) {
+        out = fopen(options.output.c_str(), "a");
+        if (!out) {
+            perror(options.output.c_str());
+            return 1;
+        }
+    }
+
+    for (Benchmark const & benchmark : make_benchmarks(options)) {
+        if (benchmark.name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        measure(benchmark, options, out);
+    }
+
+    if (out != stdout) {
+        fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,66 @@
+//
+//  AliasTableTests.swift
+//  RayTracing
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+import XCTest
+
+class AliasTableTests: XCTestCase {
+    func makeTable(_ weights: [Double]) -> [EnvironmentAliasEntry] {
+        var weights = weights
+        var entries = [EnvironmentAliasEntry](repeating: EnvironmentAliasEntry(), count: weights.count)
+        var stack = [UInt32](repeating: 0, count: weights.count)
+        build_alias_table(&weights, UInt32(weights.count), &entries, &stack)
+        return entries
+    }
+
+    /// Probability of every index to be picked as in `Environment::sample()`, in the limit of many samples.
+    func frequencies(_ entries: [EnvironmentAliasEntry]) -> [Double] {
+        var result = [Double](repeating: 0, count: entries.count)
+        for (i, entry) in entries.enumerated() {
+            result[i] += Double(entry.probability)
+            result[Int(entry.alias)] += 1 - Double(entry.probability)
+        }
+        return result.map { $0 / Double(entries.count) }
+    }
+
+    func testFrequenciesMatchPdf() {
+        // Few bright texels among many dim and black ones, like the sun in `EnvironmentMap.sunAndSky()`
+        let weights = (0..<4096).map { i in
+            i % 509 == 0 ? 1000 : Double(i % 3) * sin(Double(i))
+        }.map { max($0, 0) }
+        let total = weights.reduce(0, +)
+        let entries = makeTable(weights)
+        for (i, frequency) in frequencies(entries).enumerated() {
+            XCTAssertEqual(Double(entries[i].pdf), weights[i] / total, accuracy: 1e-7)
+            XCTAssertEqual(frequency, Double(entries[i].pdf), accuracy: 1e-7)
+            XCTAssert((0...1).contains(entries[i].probability))
+        }
+    }
+
+    func testSampledFrequencies() {
+        let weights: [Double] = [1, 0, 3, 0.5, 0.5, 5]
+        let entries = makeTable(weights)
+        var counts = [Int](repeating: 0, count: weights.count)
+        var rng = SystemRandomNumberGenerator()
+        let samples = 1_000_000
+        for _ in 0..<samples {
+            // Same as `Environment::sample()`
+            let i = min(Int(Float.random(in: 0..<1, using: &rng) * Float(entries.count)), entries.count - 1)
+            counts[Float.random(in: 0..<1, using: &rng) >= entries[i].probability ? Int(entries[i].alias) : i] += 1
+        }
+        for i in weights.indices {
+            XCTAssertEqual(Double(counts[i]) / Double(samples), Double(entries[i].pdf), accuracy: 0.003)
+        }
+        XCTAssertEqual(counts[1], 0)
+    }
+
+    func testUniform() {
+        let entries = makeTable([2, 2, 2, 2])
+        for entry in entries {
+            XCTAssertEqual(entry.probability, 1)
+            XCTAssertEqual(entry.pdf, 0.25)
+        }
+    }
+}
@@ -10,12 +10,10 @@ class ConstantDensityVolumeTests: XCTestCase {
     func testNoTransform() {
         let sut = CuboidFog(
             __Cuboid(
-                transform: __Transform(
-                    rotation: matrix_identity_float3x3,
-                    translation: .zero
-                ),
+                translation: .zero,
                 size: float3(2, 3, 4),
-                material_offset: (5, 7, 9, 11, 13, 15)
+                rotation: simd_quatf.identity.compact,
+                material: (5, 7, 9, 11, 13, 15)
             ),
             0.5
         )
@@ -27,14 +25,14 @@ class ConstantDensityVolumeTests: XCTestCase {
             XCTAssertEqual(e.t(), 2.800508, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(1.0197418, 1.5, 1.0197418))
             XCTAssertAlmostEqualVectors(e.normal(), float3(0.70710677, 0.0, 0.70710677))
-            XCTAssertEqual(e.material_offset(), 7)
+            XCTAssertEqual(e.material(), 7)
             XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.5, 0.5))
             e.move()
             XCTAssert(e.hasNext())
             XCTAssertEqual(e.t(), 4.242641, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(0, 1.5, 0))
             XCTAssertAlmostEqualVectors(e.normal(), float3(0, 0, -1))
-            XCTAssertEqual(e.material_offset(), 13)
+            XCTAssertEqual(e.material(), 13)
             XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(1.0, 0.5))
             e.move()
             XCTAssertFalse(e.hasNext())
@@ -9,12 +9,10 @@ import XCTest
 class CuboidTests: XCTestCase {
     func testNoTransform() {
         let sut = __Cuboid(
-            transform: __Transform(
-                rotation: matrix_identity_float3x3,
-                translation: .zero
-            ),
+            translation: .zero,
             size: float3(2, 3, 4),
-            material_offset: (5, 7, 9, 11, 13, 15)
+            rotation: simd_quatf.identity.compact,
+            material: (5, 7, 9, 11, 13, 15)
         )
 
         do {
@@ -23,14 +21,14 @@ class CuboidTests: XCTestCase {
             XCTAssertEqual(e.t(), 1, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(0, 1.2, 2.8))
             XCTAssertAlmostEqualVectors(e.normal(), float3(-1, 0, 0))
-            XCTAssertEqual(e.material_offset(), 5)
+            XCTAssertEqual(e.material(), 5)
             XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.3, 0.4))
             e.move()
             XCTAssert(e.hasNext())
             XCTAssertEqual(e.t(), 3, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(2, 1.2, 2.8))
             XCTAssertAlmostEqualVectors(e.normal(), float3(+1, 0, 0))
-            XCTAssertEqual(e.material_offset(), 7)
+            XCTAssertEqual(e.material(), 7)
             XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.7, 0.4))
             e.move()
             XCTAssertFalse(e.hasNext())
@@ -42,14 +40,14 @@ class CuboidTests: XCTestCase {
             XCTAssertEqual(e.t(), 1, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(1.2, 2.7, 0))
             XCTAssertAlmostEqualVectors(e.normal(), float3(0, 0, -1))
-            XCTAssertEqual(e.material_offset(), 13)
+            XCTAssertEqual(e.material(), 13)
             XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.4, 0.9))
             e.move()
             XCTAssert(e.hasNext())
             XCTAssertEqual(e.t(), 5, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(1.2, 2.7, 4))
             XCTAssertAlmostEqualVectors(e.normal(), float3(0, 0, +1))
-            XCTAssertEqual(e.material_offset(), 15)
+            XCTAssertEqual(e.material(), 15)
             XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.6, 0.9))
             e.move()
             XCTAssertFalse(e.hasNext())
@@ -61,14 +59,14 @@ class CuboidTests: XCTestCase {
             XCTAssertEqual(e.t(), 1, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(1.4, 0, 1.6))
             XCTAssertAlmostEqualVectors(e.normal(), float3(0, -1, 0))
-            XCTAssertEqual(e.material_offset(), 9)
+            XCTAssertEqual(e.material(), 9)
             XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.7, 0.6))
             e.move()
             XCTAssert(e.hasNext())
             XCTAssertEqual(e.t(), 4, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(1.4, 3, 1.6))
             XCTAssertAlmostEqualVectors(e.normal(), float3(0, +1, 0))
-            XCTAssertEqual(e.material_offset(), 11)
+            XCTAssertEqual(e.material(), 11)
             XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.7, 0.4))
             e.move()
             XCTAssertFalse(e.hasNext())
@@ -106,29 +104,27 @@ class CuboidTests: XCTestCase {
         let q2 = simd_quatf(angle: Float(Double.pi / 4), axis: float3(0, 0, 1))
 
         let sut = __Cuboid(
-            transform: __Transform(
-                rotation: simd_matrix3x3(q2 * q1),
-                translation: float3(1, 2, 3)
-            ),
+            translation: float3(1, 2, 3),
             size: float3(2, 3, 4),
-            material_offset: (5, 7, 9, 11, 13, 15)
+            rotation: (q2 * q1).compact,
+            material: (5, 7, 9, 11, 13, 15)
         )
 
         do {
             var e = __Cuboid.HitEnumerator(sut, Ray3D(float3(1.4, -1, 1.6), float3(0, 1, 0)))
             XCTAssert(e.hasNext())
-            XCTAssertEqual(e.t(), 3.7430952, accuracy: .defaultTestAccuracy)
-            XCTAssertAlmostEqualVectors(e.point(), float3(1.4, 2.7430952, 1.6))
-            XCTAssertAlmostEqualVectors(e.normal(), float3(-0.61237234, -0.61237246, -0.5))
-            XCTAssertEqual(e.material_offset(), 13)
-            XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.19170964, 0.08086828))
+            XCTAssertEqual(e.t(), 3.7430952, accuracy: .compactRotationAccuracy)
+            XCTAssertAlmostEqualVectors(e.point(), float3(1.4, 2.7430952, 1.6), accuracy: .compactRotationAccuracy)
+            XCTAssertAlmostEqualVectors(e.normal(), float3(-0.61237234, -0.61237246, -0.5), accuracy: .compactRotationAccuracy)
+            XCTAssertEqual(e.material(), 13)
+            XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.19170964, 0.08086828), accuracy: .compactRotationAccuracy)
             e.move()
             XCTAssert(e.hasNext())
-            XCTAssertEqual(e.t(), 4.827569, accuracy: .defaultTestAccuracy)
-            XCTAssertAlmostEqualVectors(e.point(), float3(1.4, 3.827569, 1.6))
-            XCTAssertAlmostEqualVectors(e.normal(), float3(0.35355335, 0.3535534, -0.8660254))
-            XCTAssertEqual(e.material_offset(), 7)
-            XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.16602547, 0.3364812))
+            XCTAssertEqual(e.t(), 4.827569, accuracy: .compactRotationAccuracy)
+            XCTAssertAlmostEqualVectors(e.point(), float3(1.4, 3.827569, 1.6), accuracy: .compactRotationAccuracy)
+            XCTAssertAlmostEqualVectors(e.normal(), float3(0.35355335, 0.3535534, -0.8660254), accuracy: .compactRotationAccuracy)
+            XCTAssertEqual(e.material(), 7)
+            XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.16602547, 0.3364812), accuracy: .compactRotationAccuracy)
             e.move()
             XCTAssertFalse(e.hasNext())
         }
@@ -10,15 +10,13 @@ import XCTest
 class CylinderTests: XCTestCase {
     func testNoTransform() {
         let sut = __Cylinder(
-            transform: __Transform(
-                rotation: matrix_identity_float3x3,
-                translation: .zero
-            ),
+            translation: .zero,
+            rotation: simd_quatf.identity.compact,
             radius: 0.5,
             height: 2,
-            bottom_material_offset: 5,
-            top_material_offset: 7,
-            side_material_offset: 9
+            bottom_material: 5,
+            top_material: 7,
+            side_material: 9
         )
 
         do {
@@ -28,7 +26,7 @@ class CylinderTests: XCTestCase {
             XCTAssertEqual(e.t(), 5.0, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(0, 0, 0))
             XCTAssertAlmostEqualVectors(e.normal(), float3(0, -1, 0))
-            XCTAssertEqual(e.material_offset(), 5)
+            XCTAssertEqual(e.material(), 5)
             XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.5, 0.5))
             e.move()
             XCTAssert(e.hasNext())
@@ -36,7 +34,7 @@ class CylinderTests: XCTestCase {
             XCTAssertEqual(e.t(), 7.0, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(0, 2, 0))
             XCTAssertAlmostEqualVectors(e.normal(), float3(0, 1, 0))
-            XCTAssertEqual(e.material_offset(), 7)
+            XCTAssertEqual(e.material(), 7)
             XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.5, 0.5))
             e.move()
             XCTAssertFalse(e.hasNext())
@@ -49,7 +47,7 @@ class CylinderTests: XCTestCase {
             XCTAssertEqual(e.t(), 5.0, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(0.25, 0, 0.25))
             XCTAssertAlmostEqualVectors(e.normal(), float3(0, -1, 0))
-            XCTAssertEqual(e.material_offset(), 5)
+            XCTAssertEqual(e.material(), 5)
             XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.25, 0.75))
             e.move()
             XCTAssert(e.hasNext())
@@ -57,7 +55,7 @@ class CylinderTests: XCTestCase {
             XCTAssertEqual(e.t(), 7.0, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(0.25, 2, 0.25))
             XCTAssertAlmostEqualVectors(e.normal(), float3(0, 1, 0))
-            XCTAssertEqual(e.material_offset(), 7)
+            XCTAssertEqual(e.material(), 7)
             XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.75, 0.75))
             e.move()
             XCTAssertFalse(e.hasNext())
@@ -70,7 +68,7 @@ class CylinderTests: XCTestCase {
             XCTAssertEqual(e.t(), 5.0, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(-0.25, 0, -0.25))
             XCTAssertAlmostEqualVectors(e.normal(), float3(0, -1, 0))
-            XCTAssertEqual(e.material_offset(), 5)
+            XCTAssertEqual(e.material(), 5)
             XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.75, 0.25))
             e.move()
             XCTAssert(e.hasNext())
@@ -78,7 +76,7 @@ class CylinderTests: XCTestCase {
             XCTAssertEqual(e.t(), 7.0, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(-0.25, 2, -0.25))
             XCTAssertAlmostEqualVectors(e.normal(), float3(0, 1, 0))
-            XCTAssertEqual(e.material_offset(), 7)
+            XCTAssertEqual(e.material(), 7)
             XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.25, 0.25))
             e.move()
             XCTAssertFalse(e.hasNext())
@@ -96,7 +94,7 @@ class CylinderTests: XCTestCase {
             XCTAssertEqual(e.t(), 4.5, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(-0.5, 1, 0))
             XCTAssertAlmostEqualVectors(e.normal(), float3(-1, 0, 0))
-            XCTAssertEqual(e.material_offset(), 9)
+            XCTAssertEqual(e.material(), 9)
             XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.5, 0.5))
             e.move()
             XCTAssert(e.hasNext())
@@ -104,7 +102,7 @@ class CylinderTests: XCTestCase {
             XCTAssertEqual(e.t(), 5.5, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(+0.5, 1, 0))
             XCTAssertAlmostEqualVectors(e.normal(), float3(+1, 0, 0))
-            XCTAssertEqual(e.material_offset(), 9)
+            XCTAssertEqual(e.material(), 9)
             XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(1.0, 0.5))
             e.move()
             XCTAssertFalse(e.hasNext())
@@ -117,7 +115,7 @@ class CylinderTests: XCTestCase {
             XCTAssertEqual(e.t(), 4.5, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(0, 0.5, +0.5))
             XCTAssertAlmostEqualVectors(e.normal(), float3(0, 0, +1))
-            XCTAssertEqual(e.material_offset(), 9)
+            XCTAssertEqual(e.material(), 9)
             XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.75, 0.25))
             e.move()
             XCTAssert(e.hasNext())
@@ -125,7 +123,7 @@ class CylinderTests: XCTestCase {
             XCTAssertEqual(e.t(), 5.5, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(0, 0.5, -0.5))
             XCTAssertAlmostEqualVectors(e.normal(), float3(0, 0, -1))
-            XCTAssertEqual(e.material_offset(), 9)
+            XCTAssertEqual(e.material(), 9)
             XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.25, 0.25))
             e.move()
             XCTAssertFalse(e.hasNext())
@@ -146,42 +144,40 @@ class CylinderTests: XCTestCase {
         let angle = Float(Double.pi / 3)
         let q = simd_quatf(angle: angle, axis: float3(0, 0, 1))
         let sut = __Cylinder(
-            transform: __Transform(
-                rotation: simd_matrix3x3(q),
-                translation: .zero
-            ),
+            translation: .zero,
+            rotation: q.compact,
             radius: 0.5,
             height: 2,
-            bottom_material_offset: 5,
-            top_material_offset: 7,
-            side_material_offset: 9
+            bottom_material: 5,
+            top_material: 7,
+            side_material: 9
         )
 
         do {
             var e = __Cylinder.HitEnumerator(sut, Ray3D(float3(0, -5, 0), float3(0, 1, 0)))
             XCTAssert(e.hasNext())
             XCTAssertEqual(e.isExit(), false)
-            XCTAssertEqual(e.t(), 5.0, accuracy: .defaultTestAccuracy)
-            XCTAssertAlmostEqualVectors(e.point(), float3(0, 0, 0))
-            XCTAssertAlmostEqualVectors(e.normal(), float3(0.866025, -0.5, 0))
+            XCTAssertEqual(e.t(), 5.0, accuracy: .compactRotationAccuracy)
+            XCTAssertAlmostEqualVectors(e.point(), float3(0, 0, 0), accuracy: .compactRotationAccuracy)
+            XCTAssertAlmostEqualVectors(e.normal(), float3(0.866025, -0.5, 0), accuracy: .compactRotationAccuracy)
             do {
-                let n = sut.transform.rotation * float3(0, -1, 0)
-                XCTAssertAlmostEqualVectors(e.normal(), n)
+                let n = q.act(float3(0, -1, 0))
+                XCTAssertAlmostEqualVectors(e.normal(), n, accuracy: .compactRotationAccuracy)
             }
-            XCTAssertEqual(e.material_offset(), 5)
-            XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.5, 0.5))
+            XCTAssertEqual(e.material(), 5)
+            XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.5, 0.5), accuracy: .compactRotationAccuracy)
             e.move()
             XCTAssert(e.hasNext())
             XCTAssertEqual(e.isExit(), true)
-            XCTAssertEqual(e.t(), 5.57735, accuracy: .defaultTestAccuracy)
-            XCTAssertAlmostEqualVectors(e.point(), float3(0, 0.57735, 0))
-            XCTAssertAlmostEqualVectors(e.normal(), float3(0.5, 0.866025, 0))
+            XCTAssertEqual(e.t(), 5.57735, accuracy: .compactRotationAccuracy)
+            XCTAssertAlmostEqualVectors(e.point(), float3(0, 0.57735, 0), accuracy: .compactRotationAccuracy)
+            XCTAssertAlmostEqualVectors(e.normal(), float3(0.5, 0.866025, 0), accuracy: .compactRotationAccuracy)
             do {
-                let n = sut.transform.rotation * float3(1, 0, 0)
-                XCTAssertAlmostEqualVectors(e.normal(), n)
+                let n = q.act(float3(1, 0, 0))
+                XCTAssertAlmostEqualVectors(e.normal(), n, accuracy: .compactRotationAccuracy)
             }
-            XCTAssertEqual(e.material_offset(), 9)
-            XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(1.0, 0.14433756))
+            XCTAssertEqual(e.material(), 9)
+            XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(1.0, 0.14433756), accuracy: .compactRotationAccuracy)
             e.move()
             XCTAssertFalse(e.hasNext())
         }
@@ -0,0 +1,60 @@
+//
+//  HeterogeneousVolumeTests.swift
+//  RayTracing
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+import XCTest
+
+class HeterogeneousVolumeTests: XCTestCase {
+    let cuboid = __Cuboid(
+        translation: .zero,
+        size: float3(2, 2, 2),
+        rotation: simd_quatf.identity.compact,
+        material: (5, 7, 9, 11, 13, 15)
+    )
+
+    /// Fraction of rays passing through `sut` along x without collisions, with fixed random numbers.
+    func transmittance(_ sut: CuboidSmoke, count: Int) -> Float {
+        // LCG is good enough for sampling, and keeps the test reproducible
+        var state: UInt64 = 0x2545F4914F6CDD1D
+        let values: [Float] = (0..<(1 << 20)).map { _ in
+            state = state &* 6364136223846793005 &+ 1442695040888963407
+            return Float(state >> 40) / Float(1 << 24)
+        }
+        var rng = RNG(.init(values))
+        var passed = 0
+        for _ in 0..<count {
+            let e = CuboidSmoke.HitEnumerator(sut, Ray3D(float3(-1, 0.5, 1.5), float3(1, 0, 0)), &rng)
+            if e.hasNext() {
+                XCTAssertFalse(e.isExit())
+                XCTAssertGreaterThanOrEqual(e.t(), 1)
+                XCTAssertLessThanOrEqual(e.t(), 3)
+            } else {
+                passed += 1
+            }
+        }
+        return Float(passed) / Float(count)
+    }
+
+    func testUniformDensity() {
+        // Same as `ConstantDensityVolume`: exp(-density * length)
+        let sut = CuboidSmoke(cuboid, 0.5, 255, 255)
+        XCTAssertEqual(transmittance(sut, count: 20000), exp(-1), accuracy: 0.01)
+    }
+
+    func testGradientDensity() {
+        // Voxels are 8 * x, interpolated between voxel centers and clamped outside of them,
+        // so the integral over the 32 voxels is 8 * (31 * 31 / 2 + 31 / 2) = 8 * 496 of 255, times the voxel size
+        let sut = CuboidSmoke(cuboid, 1, 0, 248)
+        let depth: Float = 8 * 496 / 255 * (2.0 / 32)
+        XCTAssertEqual(transmittance(sut, count: 20000), exp(-depth), accuracy: 0.01)
+    }
+
+    func testEmptyGrid() {
+        let sut = CuboidSmoke(cuboid, 1, 0, 0)
+        var rng = RNG([0.5])
+        let e = CuboidSmoke.HitEnumerator(sut, Ray3D(float3(-1, 0.5, 1.5), float3(1, 0, 0)), &rng)
+        XCTAssertFalse(e.hasNext())
+    }
+}
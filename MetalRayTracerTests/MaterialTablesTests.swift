@@ -0,0 +1,67 @@
+//
+//  MaterialTablesTests.swift
+//  RayTracing
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+import XCTest
+
+class MaterialTablesTests: XCTestCase {
+    static let kinds: [MaterialKind] = [
+        .material_kind_lambertian_colored,
+        .material_kind_lambertian_textured,
+        .material_kind_lambertian_perlin_noise,
+        .material_kind_metal_colored,
+        .material_kind_metal_textured,
+        .material_kind_metal_perlin_noise,
+        .material_kind_dielectric,
+        .material_kind_emissive_colored,
+        .material_kind_isotropic_colored,
+    ]
+
+    /// Material of every kind is a float3, as `SolidColor`.
+    let stride = MemoryLayout<float3>.stride
+
+    func makeLayout(counts: [Int: Int]) -> (MaterialTables, Int) {
+        var tables = MaterialTables()
+        let tableCount = MemoryLayout.size(ofValue: tables.offsets) / MemoryLayout<UInt32>.size
+        var countArray = [UInt32](repeating: 0, count: tableCount)
+        var strideArray = [UInt32](repeating: 0, count: tableCount)
+        for (kind, count) in counts {
+            countArray[kind] = UInt32(count)
+            strideArray[kind] = UInt32(stride)
+        }
+        let size = material_tables_layout(countArray, strideArray, &tables)
+        return (tables, Int(size))
+    }
+
+    func offsets(_ tables: MaterialTables) -> [Int] {
+        withUnsafeBytes(of: tables.offsets) { Array($0.bindMemory(to: UInt32.self)).map(Int.init) }
+    }
+
+    func testLayout() {
+        let counts = [1: 3, 4: 1, 7: 5, 9: 2]
+        let (tables, size) = makeLayout(counts: counts)
+        let offsets = offsets(tables)
+        XCTAssertGreaterThanOrEqual(offsets[0], MemoryLayout<MaterialTables>.size)
+        for (kind, offset) in offsets.enumerated() {
+            XCTAssertEqual(offset % 64, 0)
+            let end = offset + (counts[kind] ?? 0) * stride
+            let next = kind + 1 < offsets.count ? offsets[kind + 1] : size
+            XCTAssertLessThanOrEqual(end, next)
+            if counts[kind] == nil {
+                XCTAssertEqual(offset, next)
+            }
+        }
+    }
+
+    func testHandleRoundTrip() {
+        for kind in Self.kinds {
+            for index: UInt32 in [0, 1, 12345, 0x0fff_ffff] {
+                let handle = make_material_handle(kind, index)
+                XCTAssertEqual(material_handle_kind(handle), kind)
+                XCTAssertEqual(material_handle_index(handle), index)
+            }
+        }
+    }
+}
@@ -3,8 +3,10 @@
 //
 
 #include <vector>
+#include <memory>
 #define USE_TEST_RNG 1
 #import "../MetalRayTracer/Impl/RenderableImpl.h"
+#import "../MetalRayTracer/AliasTable.h"
 
 class CylinderDiff {
     Subtract<Cylinder, Cylinder> _impl;
@@ -28,7 +30,7 @@ public:
     float t() const { return _impl.t(); }
     float3 point() const { return _impl.point(); }
     float3 normal() const { return _impl.normal(); }
-    size_t material_offset() const { return _impl.material_offset(); }
+    MaterialHandle material() const { return _impl.material(); }
     float2 texture_coordinates() const { return _impl.texture_coordinates(); }
 };
 
@@ -54,7 +56,7 @@ public:
     float t() const { return _impl.t(); }
     float3 point() const { return _impl.point(); }
     float3 normal() const { return _impl.normal(); }
-    size_t material_offset() const { return _impl.material_offset(); }
+    MaterialHandle material() const { return _impl.material(); }
     float2 texture_coordinates() const { return _impl.texture_coordinates(); }
 };
 
@@ -81,7 +83,70 @@ public:
     float t() const { return _impl.t(); }
     float3 point() const { return _impl.point(); }
     float3 normal() const { return _impl.normal(); }
-    size_t material_offset() const { return _impl.material_offset(); }
+    MaterialHandle material() const { return _impl.material(); }
     float2 texture_coordinates() const { return _impl.texture_coordinates(); }
 };
 
+
+/// Grid is kept on the heap, because enumerators of `HeterogeneousVolume` point into it, and Swift copies the wrappers.
+class CuboidSmoke {
+    std::shared_ptr<HeterogeneousVolume<Cuboid>> _impl;
+public:
+    /// Grid covers the cuboid, voxel values change linearly along x from `low` to `high`, and 255 is `density`.
+    CuboidSmoke(Cuboid impl, float density, uint8_t low, uint8_t high) {
+        enum {
+            N = DensityGrid::DENSITY_GRID_RESOLUTION,
+            M = DensityGrid::DENSITY_GRID_MAJORANT_RESOLUTION,
+            B = N / M,
+        };
+        auto grid = std::make_unique<DensityGrid>();
+        grid->bounds_min = impl.translation;
+        grid->bounds_max = impl.translation + impl.size;
+        grid->density_scale = density;
+        for (int z = 0; z < N; z++) {
+            for (int y = 0; y < N; y++) {
+                for (int x = 0; x < N; x++) {
+                    grid->voxels[z][y][x] = uint8_t(round(low + (high - low) * float(x) / (N - 1)));
+                }
+            }
+        }
+        // Same as `DensityGrid.updateMajorants()` in the app
+        for (int z = 0; z < M; z++) {
+            for (int y = 0; y < M; y++) {
+                for (int x = 0; x < M; x++) {
+                    uint8_t value = 0;
+                    for (int k = std::max(z * B - 1, 0); k <= std::min(z * B + B, N - 1); k++) {
+                        for (int j = std::max(y * B - 1, 0); j <= std::min(y * B + B, N - 1); j++) {
+                            for (int i = std::max(x * B - 1, 0); i <= std::min(x * B + B, N - 1); i++) {
+                                value = std::max(value, grid->voxels[k][j][i]);
+                            }
+                        }
+                    }
+                    grid->majorants[z][y][x] = value * (density / 255);
+                }
+            }
+        }
+        _impl = std::make_shared<HeterogeneousVolume<Cuboid>>(impl, *grid);
+    }
+
+    class HitEnumerator;
+};
+
+class CuboidSmoke::HitEnumerator {
+    std::shared_ptr<HeterogeneousVolume<Cuboid>> _object;
+    HeterogeneousVolume<Cuboid>::HitEnumerator _impl;
+public:
+    HitEnumerator(CuboidSmoke object, Ray3D ray, thread RNG* rng): _object(object._impl), _impl(*_object, ray, rng) {};
+
+    bool hasNext() const { return _impl.hasNext(); }
+    void move() {
+        _impl.move();
+    }
+
+    bool isExit() const { return _impl.isExit(); }
+    float t() const { return _impl.t(); }
+    float3 point() const { return _impl.point(); }
+    float3 normal() const { return _impl.normal(); }
+    MaterialHandle material() const { return _impl.material(); }
+    float2 texture_coordinates() const { return _impl.texture_coordinates(); }
+};
@@ -14,12 +14,10 @@ func XCTAssertIsValidTextureCoord(_ x: Float, file: StaticString = #filePath, li
 class SphereTests: XCTestCase {
     func testNoTransform() {
         let sut = __Sphere(
-            transform: __Transform(
-                rotation: matrix_identity_float3x3,
-                translation: .zero
-            ),
+            center: .zero,
+            rotation: simd_quatf.identity.compact,
             radius: 0.5,
-            material_offset: 42
+            material: 42
         )
 
         do {
@@ -28,7 +26,7 @@ class SphereTests: XCTestCase {
             XCTAssertEqual(e.t(), 4.5, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(0, -0.5, 0))
             XCTAssertAlmostEqualVectors(e.normal(), float3(0, -1, 0))
-            XCTAssertEqual(e.material_offset(), 42)
+            XCTAssertEqual(e.material(), 42)
             XCTAssertIsValidTextureCoord(e.texture_coordinates().x)
             XCTAssertEqual(e.texture_coordinates().y, 0, accuracy: .defaultTestAccuracy)
             e.move()
@@ -36,7 +34,7 @@ class SphereTests: XCTestCase {
             XCTAssertEqual(e.t(), 5.5, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(0, +0.5, 0))
             XCTAssertAlmostEqualVectors(e.normal(), float3(0, +1, 0))
-            XCTAssertEqual(e.material_offset(), 42)
+            XCTAssertEqual(e.material(), 42)
             XCTAssertIsValidTextureCoord(e.texture_coordinates().x)
             XCTAssertEqual(e.texture_coordinates().y, 1, accuracy: .defaultTestAccuracy)
             e.move()
@@ -54,14 +52,14 @@ class SphereTests: XCTestCase {
             XCTAssertEqual(e.t(), 1.5, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(0.5, 0, 0))
             XCTAssertAlmostEqualVectors(e.normal(), float3(1, 0, 0))
-            XCTAssertEqual(e.material_offset(), 42)
+            XCTAssertEqual(e.material(), 42)
             XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(1.0, 0.5))
             e.move()
             XCTAssert(e.hasNext())
             XCTAssertEqual(e.t(), 2.5, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(-0.5, 0, 0))
             XCTAssertAlmostEqualVectors(e.normal(), float3(-1, 0, 0))
-            XCTAssertEqual(e.material_offset(), 42)
+            XCTAssertEqual(e.material(), 42)
             XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.5, 0.5))
             e.move()
             XCTAssertFalse(e.hasNext())
@@ -74,14 +72,14 @@ class SphereTests: XCTestCase {
             XCTAssertEqual(e.t(), sqrt(3) - 0.5, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(-sqrt_1_3, +sqrt_1_3, -sqrt_1_3) / 2)
             XCTAssertAlmostEqualVectors(e.normal(), float3(-sqrt_1_3, +sqrt_1_3, -sqrt_1_3))
-            XCTAssertEqual(e.material_offset(), 42)
+            XCTAssertEqual(e.material(), 42)
             XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.375, 0.6959132760153036))
             e.move()
             XCTAssert(e.hasNext())
             XCTAssertEqual(e.t(), sqrt(3) + 0.5, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(+sqrt_1_3, -sqrt_1_3, +sqrt_1_3) / 2)
             XCTAssertAlmostEqualVectors(e.normal(), float3(+sqrt_1_3, -sqrt_1_3, +sqrt_1_3))
-            XCTAssertEqual(e.material_offset(), 42)
+            XCTAssertEqual(e.material(), 42)
             XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.875, 0.3040867239846964))
             e.move()
             XCTAssertFalse(e.hasNext())
@@ -92,12 +90,10 @@ class SphereTests: XCTestCase {
         let q1 = simd_quatf(angle: Float(Double.pi / 3), axis: float3(0, 1, 0))
         let q2 = simd_quatf(angle: Float(Double.pi / 4), axis: float3(0, 0, 1))
         let sut = __Sphere(
-            transform: __Transform(
-                rotation: simd_matrix3x3(q2 * q1),
-                translation: float3(1, 2, 3)
-            ),
+            center: float3(1, 2, 3),
+            rotation: (q2 * q1).compact,
             radius: 0.5,
-            material_offset: 42
+            material: 42
         )
 
         do {
@@ -106,15 +102,15 @@ class SphereTests: XCTestCase {
             XCTAssertEqual(e.t(), 5.6, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(1, 2.3, 2.6))
             XCTAssertAlmostEqualVectors(e.normal(), float3(0, 0.6, -0.8))
-            XCTAssertEqual(e.material_offset(), 42)
-            XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.005726772, 0.6394671))
+            XCTAssertEqual(e.material(), 42)
+            XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.005726772, 0.6394671), accuracy: .compactRotationAccuracy)
             e.move()
             XCTAssert(e.hasNext())
             XCTAssertEqual(e.t(), 6.4, accuracy: .defaultTestAccuracy)
             XCTAssertAlmostEqualVectors(e.point(), float3(1, 2.3, 3.4))
             XCTAssertAlmostEqualVectors(e.normal(), float3(0, 0.6, +0.8))
-            XCTAssertEqual(e.material_offset(), 42)
-            XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.66093993, 0.6394671))
+            XCTAssertEqual(e.material(), 42)
+            XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.66093993, 0.6394671), accuracy: .compactRotationAccuracy)
             e.move()
             XCTAssertFalse(e.hasNext())
         }
@@ -9,26 +9,22 @@ import XCTest
 class SubtractTests: XCTestCase {
     let sut = CylinderDiff(
         __Cylinder(
-            transform: __Transform(
-                rotation: matrix_identity_float3x3,
-                translation: .zero
-            ),
+            translation: .zero,
+            rotation: simd_quatf.identity.compact,
             radius: 2,
             height: 4,
-            bottom_material_offset: 5,
-            top_material_offset: 7,
-            side_material_offset: 9
+            bottom_material: 5,
+            top_material: 7,
+            side_material: 9
         ),
         __Cylinder(
-            transform: __Transform(
-                rotation: matrix_identity_float3x3,
-                translation: float3(0, 1, 0)
-            ),
+            translation: float3(0, 1, 0),
+            rotation: simd_quatf.identity.compact,
             radius: 1,
             height: 6,
-            bottom_material_offset: 11,
-            top_material_offset: 13,
-            side_material_offset: 15
+            bottom_material: 11,
+            top_material: 13,
+            side_material: 15
         )
     )
 
@@ -39,7 +35,7 @@ class SubtractTests: XCTestCase {
         XCTAssertEqual(e.t(), 1, accuracy: .defaultTestAccuracy)
         XCTAssertAlmostEqualVectors(e.point(), float3(0, 0, 0))
         XCTAssertAlmostEqualVectors(e.normal(), float3(0, -1, 0))
-        XCTAssertEqual(e.material_offset(), 5)
+        XCTAssertEqual(e.material(), 5)
         XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.5, 0.5))
         e.move()
         XCTAssert(e.hasNext())
@@ -47,7 +43,7 @@ class SubtractTests: XCTestCase {
         XCTAssertEqual(e.t(), 2.0, accuracy: .defaultTestAccuracy)
         XCTAssertAlmostEqualVectors(e.point(), float3(0, 1, 0))
         XCTAssertAlmostEqualVectors(e.normal(), float3(0, 1, 0))
-        XCTAssertEqual(e.material_offset(), 11)
+        XCTAssertEqual(e.material(), 11)
         XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.5, 0.5))
         e.move()
         XCTAssertFalse(e.hasNext())
@@ -60,7 +56,7 @@ class SubtractTests: XCTestCase {
         XCTAssertEqual(e.t(), 9, accuracy: .defaultTestAccuracy)
         XCTAssertAlmostEqualVectors(e.point(), float3(0, 1, 0))
         XCTAssertAlmostEqualVectors(e.normal(), float3(0, 1, 0))
-        XCTAssertEqual(e.material_offset(), 11)
+        XCTAssertEqual(e.material(), 11)
         XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.5, 0.5))
         e.move()
         XCTAssert(e.hasNext())
@@ -68,7 +64,7 @@ class SubtractTests: XCTestCase {
         XCTAssertEqual(e.t(), 10, accuracy: .defaultTestAccuracy)
         XCTAssertAlmostEqualVectors(e.point(), float3(0, 0, 0))
         XCTAssertAlmostEqualVectors(e.normal(), float3(0, -1, 0))
-        XCTAssertEqual(e.material_offset(), 5)
+        XCTAssertEqual(e.material(), 5)
         XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.5, 0.5))
         e.move()
         XCTAssertFalse(e.hasNext())
@@ -81,7 +77,7 @@ class SubtractTests: XCTestCase {
         XCTAssertEqual(e.t(), 3, accuracy: .defaultTestAccuracy)
         XCTAssertAlmostEqualVectors(e.point(), float3(0, 2, -2))
         XCTAssertAlmostEqualVectors(e.normal(), float3(0, 0, -1))
-        XCTAssertEqual(e.material_offset(), 9)
+        XCTAssertEqual(e.material(), 9)
         XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.25, 0.5))
         e.move()
         XCTAssert(e.hasNext())
@@ -89,7 +85,7 @@ class SubtractTests: XCTestCase {
         XCTAssertEqual(e.t(), 4, accuracy: .defaultTestAccuracy)
         XCTAssertAlmostEqualVectors(e.point(), float3(0, 2, -1))
         XCTAssertAlmostEqualVectors(e.normal(), float3(0, 0, +1))
-        XCTAssertEqual(e.material_offset(), 15)
+        XCTAssertEqual(e.material(), 15)
         XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.25, 1/6.0))
         e.move()
         XCTAssert(e.hasNext())
@@ -97,7 +93,7 @@ class SubtractTests: XCTestCase {
         XCTAssertEqual(e.t(), 6, accuracy: .defaultTestAccuracy)
         XCTAssertAlmostEqualVectors(e.point(), float3(0, 2, +1))
         XCTAssertAlmostEqualVectors(e.normal(), float3(0, 0, -1))
-        XCTAssertEqual(e.material_offset(), 15)
+        XCTAssertEqual(e.material(), 15)
         XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.75, 1/6.0))
         e.move()
         XCTAssert(e.hasNext())
@@ -105,7 +101,7 @@ class SubtractTests: XCTestCase {
         XCTAssertEqual(e.t(), 7, accuracy: .defaultTestAccuracy)
         XCTAssertAlmostEqualVectors(e.point(), float3(0, 2, +2))
         XCTAssertAlmostEqualVectors(e.normal(), float3(0, 0, +1))
-        XCTAssertEqual(e.material_offset(), 9)
+        XCTAssertEqual(e.material(), 9)
         XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.75, 0.5))
         e.move()
         XCTAssertFalse(e.hasNext())
@@ -118,7 +114,7 @@ class SubtractTests: XCTestCase {
         XCTAssertEqual(e.t(), 3.6771245, accuracy: .defaultTestAccuracy)
         XCTAssertAlmostEqualVectors(e.point(), float3(1.5, 2, 1.3228755))
         XCTAssertAlmostEqualVectors(e.normal(), float3(0.75, 0, 0.6614377))
-        XCTAssertEqual(e.material_offset(), 9)
+        XCTAssertEqual(e.material(), 9)
         XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.88497335, 0.5))
         e.move()
         XCTAssert(e.hasNext())
@@ -126,7 +122,7 @@ class SubtractTests: XCTestCase {
         XCTAssertEqual(e.t(), 6.3228755, accuracy: .defaultTestAccuracy)
         XCTAssertAlmostEqualVectors(e.point(), float3(1.5, 2, -1.3228755))
         XCTAssertAlmostEqualVectors(e.normal(), float3(0.75, 0, -0.6614377))
-        XCTAssertEqual(e.material_offset(), 9)
+        XCTAssertEqual(e.material(), 9)
         XCTAssertAlmostEqualVectors(e.texture_coordinates(), float2(0.11502672, 0.5))
         e.move()
         XCTAssertFalse(e.hasNext())
@@ -139,31 +135,25 @@ class SubtractTests: XCTestCase {
 
     func testCombo() {
         let box = __Cuboid(
-            transform: __Transform(
-                rotation: matrix_identity_float3x3,
-                translation: float3(-1, -1, -1)
-            ),
+            translation: float3(-1, -1, -1),
             size: float3(2, 2, 2),
-            material_offset: (11, 12, 13, 14, 15, 16)
+            rotation: simd_quatf.identity.compact,
+            material: (11, 12, 13, 14, 15, 16)
         )
         let sphere = __Sphere(
-            transform: __Transform(
-                rotation: matrix_identity_float3x3,
-                translation: .zero
-            ),
+            center: .zero,
+            rotation: simd_quatf.identity.compact,
             radius: 1.2,
-            material_offset: 21
+            material: 21
         )
         let cyl = __Cylinder(
-            transform: __Transform(
-                rotation: matrix_identity_float3x3,
-                translation: float3(0, -2, 0)
-            ),
+            translation: float3(0, -2, 0),
+            rotation: simd_quatf.identity.compact,
             radius: 0.5,
             height: 4,
-            bottom_material_offset: 31,
-            top_material_offset: 32,
-            side_material_offset: 33
+            bottom_material: 31,
+            top_material: 32,
+            side_material: 33
         )
         print(MemoryLayout<Combo>.size)
         print(MemoryLayout<Combo>.stride)
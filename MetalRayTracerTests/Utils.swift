@@ -10,6 +10,22 @@ extension BinaryFloatingPoint {
     static var defaultTestAccuracy: Self {
         Self(1) / Self(1 << (7 * Self.significandBitCount / 8))
     }
+
+    /// Rotations of primitives are stored in 16-bit components, which is about 1e-4 radians.
+    static var compactRotationAccuracy: Self {
+        2e-4
+    }
+}
+
+extension simd_quatf {
+    static var identity: Self {
+        .init(ix: 0, iy: 0, iz: 0, r: 1)
+    }
+
+    /// Rotation as stored in primitives, same as `Transform.compactRotation` in the app.
+    var compact: vector_short4 {
+        compact_rotation(vector)
+    }
 }
 
 protocol _Dist: SIMD {
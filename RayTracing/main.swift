@@ -14,14 +14,7 @@ func makeWorld1() throws -> some Hittable {
     let ground = Lambertian(albedo: ColorF(x: 0.5, y: 0.5, z: 0.5))
     w.append(Sphere(center: Point3D(x: 0, y: -1000, z: 0), radius: 1000, material: ground))
 
-    do {
-        let material1 = Dielectric(refractionIndex: 1.5)
-        let s1 = Sphere(center: Point3D(x: 0, y: 1, z: -9.915), radius: 10.0, material: material1)
-        let s2 = Sphere(center: Point3D(x: 0, y: 1, z: +9.915), radius: 10.0, material: material1)
-        let lens = Composition(operation: .intersection, items: [s1, s2])
-        let tr = Transformed(transform: .translation(x: -0.5, y: 0, z: 0) * .rotation(degrees: -45, axis: .y), base: lens)
-        w.append(tr)
-    }
+    w.append(makeLens())
 
     do {
         let image = try Image.load(url: getURL("textures/earthmap.jpg"))
@@ -87,7 +80,44 @@ func makeWorld1() throws -> some Hittable {
         w.append(quad)
     }
 
-    return BoundingVolumeNode(items: w)
+    return CompiledScene(objects: w)
+}
+
+func makeLens() -> Transformed<Composition> {
+    let material1 = Dielectric(refractionIndex: 1.5)
+    let s1 = Sphere(center: Point3D(x: 0, y: 1, z: -9.915), radius: 10.0, material: material1)
+    let s2 = Sphere(center: Point3D(x: 0, y: 1, z: +9.915), radius: 10.0, material: material1)
+    let lens = Composition(operation: .intersection, items: [s1, s2])
+    return Transformed(transform: .translation(x: -0.5, y: 0, z: 0) * .rotation(degrees: -45, axis: .y), base: lens)
+}
+
+/// Throughput of CSG hit testing on the lens of `makeWorld1()`, for rays from random points around it towards random points inside its box.
+/// `hits(ray:time:)` additionally returns ranges in an array, like CSG did before using `HitRangeArena`.
+func benchmarkLens(rays count: Int) {
+    let lens = makeLens()
+    let box = lens.boundingBox
+    var rng = WyRand(seed: 42)
+    func randomPoint(in box: AABB, scale: Double) -> Point3D {
+        let offset = Vector3D(x: .random(in: -0.5...0.5, using: &rng), y: .random(in: -0.5...0.5, using: &rng), z: .random(in: -0.5...0.5, using: &rng))
+        return box.center + scale * (offset * box.size)
+    }
+    let rays = (0..<count).map { _ in
+        Ray3D(origin: randomPoint(in: box, scale: 4), target: randomPoint(in: box, scale: 1), normalized: true)
+    }
+
+    var hits = 0
+    var t = Date()
+    for ray in rays where lens.hit(ray: ray, time: 0, range: 0.001..<Double.infinity) != nil {
+        hits += 1
+    }
+    print("lens hit: \(Double(count) / Date().timeIntervalSince(t) / 1e6) Mrays/s, \(hits) hits")
+
+    var ranges = 0
+    t = Date()
+    for ray in rays {
+        ranges += lens.hits(ray: ray, time: 0).count
+    }
+    print("lens hits: \(Double(count) / Date().timeIntervalSince(t) / 1e6) Mrays/s, \(ranges) ranges")
 }
 
 func makeCamera1() -> Camera {
@@ -111,7 +141,7 @@ func makeWorld2() throws -> some Hittable {
     let marbleTex = Marble(noise: PerlinNoise(using: &rng), scale: 1.0)
     w.append(Sphere(center: Point3D(x: 0, y: -1000, z: 0), radius: 1000, material: Lambertian(texture: noiseTex)))
     w.append(Sphere(center: Point3D(x: 0, y: 2, z: 0), radius: 2, material: Lambertian(texture: marbleTex)))
-    return BoundingVolumeNode(items: w)
+    return CompiledScene(objects: w)
 }
 
 func makeCamera2() -> Camera {
@@ -124,13 +154,97 @@ func makeCamera2() -> Camera {
     )
 }
 
+/// Ground and `count` small spheres scattered around the origin, to measure scaling with the number of objects.
+func makeManySpheres(count: Int) -> [any Hittable] {
+    var w: [any Hittable] = []
+    var rng = WyRand(seed: 42)
+    w.append(Sphere(center: Point3D(x: 0, y: -1000, z: 0), radius: 1000, material: Lambertian(albedo: ColorF(x: 0.5, y: 0.5, z: 0.5))))
+    let side = Double(count).squareRoot() * 0.5
+    for _ in 0..<count {
+        let center = Point3D(x: .random(in: -side...side, using: &rng), y: 0.2, z: .random(in: -side...side, using: &rng))
+        let albedo = ColorF(x: .random(in: 0...1, using: &rng), y: .random(in: 0...1, using: &rng), z: .random(in: 0...1, using: &rng))
+        w.append(Sphere(center: center, radius: 0.2, material: Lambertian(albedo: albedo)))
+    }
+    return w
+}
+
+func makeManySpheresWorld(count: Int) -> CompiledScene {
+    let objects = makeManySpheres(count: count)
+    let t = Date()
+    let world = CompiledScene(objects: objects)
+    print("Compiled \(count) spheres in \(Date().timeIntervalSince(t))s")
+    return world
+}
+
+/// Throughput of closest-hit queries on `makeManySpheres(count:)` with `BoundingVolumeNode` and `CompiledScene`,
+/// for rays from above the field towards random points on it.
+func benchmarkBVH(objects count: Int, rays rayCount: Int) {
+    let objects = makeManySpheres(count: count)
+    var rng = WyRand(seed: 7)
+    let side = Double(count).squareRoot() * 0.5
+    let rays = (0..<rayCount).map { _ in
+        let origin = Point3D(x: .random(in: -side...side, using: &rng), y: 5, z: .random(in: -side...side, using: &rng))
+        let target = Point3D(x: .random(in: -side...side, using: &rng), y: 0, z: .random(in: -side...side, using: &rng))
+        return Ray3D(origin: origin, target: target, normalized: true)
+    }
+
+    func measure(_ name: String, _ world: some Hittable, buildTime: TimeInterval) {
+        var hits = 0
+        let t = Date()
+        for ray in rays where world.hit(ray: ray, time: 0, range: 0.001..<Double.infinity) != nil {
+            hits += 1
+        }
+        print("\(name): built in \(buildTime)s, \(Double(rayCount) / Date().timeIntervalSince(t) / 1e6) Mrays/s, \(hits) hits")
+    }
+
+    var t = Date()
+    let tree = BoundingVolumeNode(items: objects)
+    measure("BoundingVolumeNode", tree, buildTime: Date().timeIntervalSince(t))
+    t = Date()
+    let compiled = CompiledScene(objects: objects)
+    measure("CompiledScene", compiled, buildTime: Date().timeIntervalSince(t))
+}
+
 private func getURL(_ path: String) -> URL {
     URL(fileURLWithPath: #filePath).deletingLastPathComponent().appending(path: path)
 }
 
+/// Renders coarse-to-fine passes, reporting how soon each of them is available.
+func renderProgressive(world: some Hittable, camera: Camera, passes: Int) async throws {
+    let renderer = ProgressiveRenderer(camera: camera, world: world, config: .init(samplesPerPixel: 4, maxDepth: 50))
+    let t = Date()
+    var image: Image?
+    for _ in 0..<passes {
+        image = await renderer.renderPass()
+        print("Pass \(renderer.passCounter) at \(Date().timeIntervalSince(t))s")
+    }
+    try image?.writePPM(to: getURL("results/progressive.ppm"))
+}
+
 func main() async throws {
+    if CommandLine.arguments.contains("--csg-benchmark") {
+        benchmarkLens(rays: 1_000_000)
+        return
+    }
+    if let i = CommandLine.arguments.firstIndex(of: "--bvh-benchmark") {
+        let count = i + 1 < CommandLine.arguments.count ? Int(CommandLine.arguments[i + 1]) : nil
+        benchmarkBVH(objects: count ?? 100_000, rays: 1_000_000)
+        return
+    }
+    if let i = CommandLine.arguments.firstIndex(of: "--spheres"), i + 1 < CommandLine.arguments.count, let count = Int(CommandLine.arguments[i + 1]) {
+        let world = makeManySpheresWorld(count: count)
+        let t = Date()
+        let image = await makeCamera1().render(world: world, config: .init(samplesPerPixel: 10, maxDepth: 10))
+        print("Done in \(Date().timeIntervalSince(t))s")
+        try image.writePPM(to: getURL("results/spheres.ppm"))
+        return
+    }
     let world = try makeWorld1()
     let camera = makeCamera1()
+    if CommandLine.arguments.contains("--progressive") {
+        try await renderProgressive(world: world, camera: camera, passes: 8)
+        return
+    }
     let t = Date()
     let image = await camera.render(world: world, config: .init(samplesPerPixel: 100, maxDepth: 50))
     let duration = Date().timeIntervalSince(t)
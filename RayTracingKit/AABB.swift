@@ -48,6 +48,9 @@ public struct AABB {
         add(box._max)
     }
 
+    var minPoint: Point3D { _min }
+    var maxPoint: Point3D { _max }
+
     public var center: Point3D {
         return (_min + _max) / 2
     }
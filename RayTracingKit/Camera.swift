@@ -18,8 +18,8 @@ public struct Camera {
         }
     }
 
-    private var imageWidth: Int
-    private var imageHeight: Int
+    private(set) var imageWidth: Int
+    private(set) var imageHeight: Int
     private var cameraCenter: Point3D
     private var viewportCenter: Point3D
     private var viewportU: Vector3D
@@ -59,6 +59,11 @@ public struct Camera {
         }
     }
 
+    /// Renders `objects` compiled into a `CompiledScene`.
+    public func render(objects: [any Hittable], config: RenderConfig = .init()) async -> Image {
+        await render(world: CompiledScene(objects: objects), config: config)
+    }
+
     public func render(world: some Hittable, config: RenderConfig = .init()) async -> Image {
         var image = Image(width: imageWidth, height: imageHeight)
         await withTaskGroup(of: (Int, Image).self) { group in
@@ -83,17 +88,23 @@ public struct Camera {
         var rng = WyRand(seed: seed)
         var image = Image(width: imageWidth, height: 1)
         for j in 0..<imageWidth {
-            var color: ColorF = .zero
-            for _ in 0..<config.samplesPerPixel {
-                let ray = getRay(i, j, using: &rng)
-                let time = Double.random(in: 0...1, using: &rng)
-                color = color + rayColor(ray, time: time, world: world, depth: config.maxDepth, using: &rng)
-            }
+            let color = sample(i, j, count: config.samplesPerPixel, world: world, maxDepth: config.maxDepth, using: &rng)
             image[0, j] = (color / Double(config.samplesPerPixel)).linearToGamma() .asU8
         }
         return image
     }
 
+    /// Sum of `count` random samples of the pixel.
+    func sample(_ i: Int, _ j: Int, count: Int, world: some Hittable, maxDepth: Int, using rng: inout some RandomNumberGenerator) -> ColorF {
+        var color: ColorF = .zero
+        for _ in 0..<count {
+            let ray = getRay(i, j, using: &rng)
+            let time = Double.random(in: 0...1, using: &rng)
+            color = color + rayColor(ray, time: time, world: world, depth: maxDepth, using: &rng)
+        }
+        return color
+    }
+
     private func getRay(_ i: Int, _ j: Int, using rng: inout some RandomNumberGenerator) -> Ray3D {
         let origin = getRayOrigin(using: &rng)
         let offsetX = Double.random(in: 0..<1, using: &rng)
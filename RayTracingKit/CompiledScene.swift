@@ -0,0 +1,328 @@
+//
+//  CompiledScene.swift
+//  RayTracing
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+
+/// Scene prepared for rendering: primitives in arrays per concrete type with materials referenced by index,
+/// and a bounding volume hierarchy flattened into an array of nodes with Float bounds.
+/// Bounds are rounded outwards from Double, and slab tests run in Double, so the tree never culls a hit of the primitives.
+///
+/// Traversal touches neither existentials nor reference counts until the closest hit is known,
+/// only then the hit is described by a `HitRecord`. Objects without a compiled form, like `Composition` or `Transformed`,
+/// are kept as `any Hittable` and tested through the protocol.
+public struct CompiledScene: Hittable {
+    struct SphereRecord {
+        var center: Point3D
+        var radius: Double
+        var material: Int32
+    }
+
+    struct QuadRecord {
+        var origin: Point3D
+        var u: Vector3D
+        var v: Vector3D
+        var w: Vector3D
+        var normal: Vector3D
+        var d: Double
+        var material: Int32
+    }
+
+    enum Kind: UInt32 {
+        case sphere
+        case quad
+        case other
+    }
+
+    /// Kind in the top 2 bits, index into the array of that kind in the rest.
+    struct PrimitiveRef {
+        var raw: UInt32
+
+        init(kind: Kind, index: Int) {
+            precondition(index < 1 << 30)
+            raw = kind.rawValue << 30 | UInt32(index)
+        }
+
+        var kind: Kind { Kind(rawValue: raw >> 30)! }
+        var index: Int { Int(raw & (1 << 30 - 1)) }
+    }
+
+    struct Node {
+        var boundsMin: SIMD3<Float>
+        var boundsMax: SIMD3<Float>
+        /// Inner nodes: index of the second child, the first one directly follows the node.
+        /// Leaves: index of the first primitive in `primitives`.
+        var offset: Int32
+        /// Number of primitives of a leaf, 0 for inner nodes.
+        var count: Int32
+    }
+
+    static let maxLeafSize = 4
+    /// Median splits keep the tree balanced, so this is enough for any scene that fits into `PrimitiveRef`.
+    static let maxStackDepth = 64
+
+    private(set) var spheres: [SphereRecord] = []
+    private(set) var quads: [QuadRecord] = []
+    private(set) var others: [any Hittable] = []
+    private(set) var materials: [any Material] = []
+    private(set) var nodes: [Node] = []
+    /// Primitives of the leaves, ordered by the tree.
+    private(set) var primitives: [PrimitiveRef] = []
+    public private(set) var boundingBox = AABB()
+
+    public init(objects: [any Hittable]) {
+        var items: [BuildItem] = []
+        items.reserveCapacity(objects.count)
+        for object in objects {
+            let ref: PrimitiveRef
+            switch object {
+            case let sphere as Sphere:
+                ref = PrimitiveRef(kind: .sphere, index: spheres.count)
+                spheres.append(SphereRecord(center: sphere.center, radius: sphere.radius, material: addMaterial(sphere.material)))
+            case let quad as Quad:
+                ref = PrimitiveRef(kind: .quad, index: quads.count)
+                quads.append(QuadRecord(
+                    origin: quad.origin, u: quad.u, v: quad.v, w: quad.w,
+                    normal: quad.plane.normal, d: quad.plane.d,
+                    material: addMaterial(quad.material)
+                ))
+            default:
+                ref = PrimitiveRef(kind: .other, index: others.count)
+                others.append(object)
+            }
+            let box = object.boundingBox
+            boundingBox.add(box)
+            items.append(BuildItem(ref: ref, box: box))
+        }
+        nodes.reserveCapacity(2 * items.count / Self.maxLeafSize + 1)
+        primitives.reserveCapacity(items.count)
+        if !items.isEmpty {
+            Self.build(&items, items.indices, nodes: &nodes, primitives: &primitives)
+        }
+    }
+
+    private mutating func addMaterial(_ material: any Material) -> Int32 {
+        materials.append(material)
+        return Int32(materials.count - 1)
+    }
+
+    public var center: Point3D {
+        boundingBox.center
+    }
+
+    // MARK: - Build
+
+    private struct BuildItem {
+        var ref: PrimitiveRef
+        var boundsMin: SIMD3<Float>
+        var boundsMax: SIMD3<Float>
+        var center: SIMD3<Float>
+
+        init(ref: PrimitiveRef, box: AABB) {
+            self.ref = ref
+            boundsMin = SIMD3(CompiledScene.lowerBound(box.minPoint.x), CompiledScene.lowerBound(box.minPoint.y), CompiledScene.lowerBound(box.minPoint.z))
+            boundsMax = SIMD3(CompiledScene.upperBound(box.maxPoint.x), CompiledScene.upperBound(box.maxPoint.y), CompiledScene.upperBound(box.maxPoint.z))
+            center = (boundsMin + boundsMax) / 2
+        }
+    }
+
+    /// Nearest Float not greater than `x`.
+    static func lowerBound(_ x: Double) -> Float {
+        let f = Float(x)
+        return Double(f) <= x ? f : f.nextDown
+    }
+
+    /// Nearest Float not less than `x`.
+    static func upperBound(_ x: Double) -> Float {
+        let f = Float(x)
+        return Double(f) >= x ? f : f.nextUp
+    }
+
+    /// Splits at the median of centers along the longest axis of their bounds, like `BoundingVolumeNode`.
+    /// Children are stored depth-first, so the first child directly follows its parent.
+    private static func build(_ items: inout [BuildItem], _ range: Range<Int>, nodes: inout [Node], primitives: inout [PrimitiveRef]) {
+        var boundsMin = SIMD3<Float>(repeating: .infinity)
+        var boundsMax = SIMD3<Float>(repeating: -.infinity)
+        var centersMin = boundsMin
+        var centersMax = boundsMax
+        for i in range {
+            boundsMin = pointwiseMin(boundsMin, items[i].boundsMin)
+            boundsMax = pointwiseMax(boundsMax, items[i].boundsMax)
+            centersMin = pointwiseMin(centersMin, items[i].center)
+            centersMax = pointwiseMax(centersMax, items[i].center)
+        }
+        let index = nodes.count
+        nodes.append(Node(boundsMin: boundsMin, boundsMax: boundsMax, offset: 0, count: 0))
+        if range.count <= maxLeafSize {
+            nodes[index].offset = Int32(primitives.count)
+            nodes[index].count = Int32(range.count)
+            for i in range {
+                primitives.append(items[i].ref)
+            }
+            return
+        }
+
+        let size = centersMax - centersMin
+        let axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2)
+        items[range].sort { $0.center[axis] < $1.center[axis] }
+        let mid = (range.lowerBound + range.upperBound + 1) / 2
+        build(&items, range.lowerBound..<mid, nodes: &nodes, primitives: &primitives)
+        nodes[index].offset = Int32(nodes.count)
+        build(&items, mid..<range.upperBound, nodes: &nodes, primitives: &primitives)
+    }
+
+    // MARK: - Traversal
+
+    private struct StackEntry {
+        var node: Int32
+        var entry: Double
+    }
+
+    public func hit(ray: Ray3D, time: Double, range: Range<Double>) -> HitRecord? {
+        guard !nodes.isEmpty else { return nil }
+        let origin = SIMD3<Double>(ray.origin.x, ray.origin.y, ray.origin.z)
+        let inverseDirection = 1 / SIMD3<Double>(ray.direction.x, ray.direction.y, ray.direction.z)
+        let lower = range.lowerBound
+
+        var closest = range.upperBound
+        var closestRef: PrimitiveRef?
+        var otherHit: HitRecord?
+        nodes.withUnsafeBufferPointer { nodes in
+            withUnsafeTemporaryAllocation(of: StackEntry.self, capacity: Self.maxStackDepth) { stack in
+                var stackSize = 0
+                var next: Int32? = Self.entry(nodes[0], origin: origin, inverseDirection: inverseDirection, lower: lower, limit: closest) != nil ? 0 : nil
+
+                func pop() -> Int32? {
+                    while stackSize > 0 {
+                        stackSize -= 1
+                        // Skip nodes behind the hit found after they were pushed
+                        if stack[stackSize].entry <= closest {
+                            return stack[stackSize].node
+                        }
+                    }
+                    return nil
+                }
+
+                while let index = next {
+                    let node = nodes[Int(index)]
+                    if node.count > 0 {
+                        for k in Int(node.offset)..<Int(node.offset + node.count) {
+                            let ref = primitives[k]
+                            let candidates = range.lowerBound..<closest
+                            switch ref.kind {
+                            case .sphere:
+                                if let t = Self.hit(spheres[ref.index], ray: ray, range: candidates) {
+                                    closest = t
+                                    closestRef = ref
+                                }
+                            case .quad:
+                                if let t = Self.hit(quads[ref.index], ray: ray, range: candidates) {
+                                    closest = t
+                                    closestRef = ref
+                                }
+                            case .other:
+                                if let hit = others[ref.index].hit(ray: ray, time: time, range: candidates) {
+                                    closest = hit.t
+                                    closestRef = ref
+                                    otherHit = hit
+                                }
+                            }
+                        }
+                        next = pop()
+                        continue
+                    }
+
+                    // Visit the nearer child first, the farther one may be culled by its hits
+                    let limit = closest
+                    let first = index + 1
+                    let second = node.offset
+                    let firstEntry = Self.entry(nodes[Int(first)], origin: origin, inverseDirection: inverseDirection, lower: lower, limit: limit)
+                    let secondEntry = Self.entry(nodes[Int(second)], origin: origin, inverseDirection: inverseDirection, lower: lower, limit: limit)
+                    switch (firstEntry, secondEntry) {
+                    case let (a?, b?):
+                        precondition(stackSize < Self.maxStackDepth)
+                        if a <= b {
+                            stack[stackSize] = StackEntry(node: second, entry: b)
+                            next = first
+                        } else {
+                            stack[stackSize] = StackEntry(node: first, entry: a)
+                            next = second
+                        }
+                        stackSize += 1
+                    case (_?, nil):
+                        next = first
+                    case (nil, _?):
+                        next = second
+                    case (nil, nil):
+                        next = pop()
+                    }
+                }
+            }
+        }
+
+        guard let ref = closestRef else { return nil }
+        switch ref.kind {
+        case .sphere:
+            let sphere = spheres[ref.index]
+            let point = ray[closest]
+            let normal = (point - sphere.center) / sphere.radius
+            return HitRecord(t: closest, point: point, normal: normal, rayDirection: ray.direction,
+                             material: materials[Int(sphere.material)], textureCoordinates: Sphere.textureCoordinates(normal: normal))
+        case .quad:
+            let quad = quads[ref.index]
+            let point = ray[closest]
+            let p = point - quad.origin
+            let textureCoordinates = Point2D(u: quad.w • (p ⨯ quad.v), v: quad.w • (quad.u ⨯ p))
+            return HitRecord(t: closest, point: point, normal: quad.normal, rayDirection: ray.direction,
+                             material: materials[Int(quad.material)], textureCoordinates: textureCoordinates)
+        case .other:
+            return otherHit
+        }
+    }
+
+    /// Relative error of slab distances: rounding of the subtraction, of the inverse direction, and of the product.
+    private static let slabTolerance = 1 + 4 * Double.ulpOfOne
+
+    /// Distance where the ray enters the box of `node`, or nil if it misses the box within [`lower`, `limit`].
+    @inline(__always)
+    private static func entry(_ node: Node, origin: SIMD3<Double>, inverseDirection: SIMD3<Double>, lower: Double, limit: Double) -> Double? {
+        let t1 = (SIMD3<Double>(node.boundsMin) - origin) * inverseDirection
+        let t2 = (SIMD3<Double>(node.boundsMax) - origin) * inverseDirection
+        // 0 * ∞ is NaN for a ray parallel to an axis, starting on a plane of the box.
+        // It runs along the face, so the slab of that axis does not limit it
+        let parallel = (t1 .!= t1) .| (t2 .!= t2)
+        let near = pointwiseMin(t1, t2).replacing(with: -.infinity, where: parallel)
+        let far = pointwiseMax(t1, t2).replacing(with: .infinity, where: parallel)
+        let tEntry = max(near.max(), lower)
+        let tExit = min(far.min() * slabTolerance, limit)
+        return tEntry <= tExit ? tEntry : nil
+    }
+
+    /// Same as `Sphere.hit(ray:time:range:)`, without describing the hit.
+    @inline(__always)
+    private static func hit(_ sphere: SphereRecord, ray: Ray3D, range: Range<Double>) -> Double? {
+        let oc = ray.origin - sphere.center
+        let a = ray.direction • ray.direction
+        let b_2 = ray.direction • oc
+        let c = oc • oc - sphere.radius * sphere.radius
+        let D_4 = b_2 * b_2 - a * c
+        if D_4 < 0 { return nil }
+        let root = D_4.squareRoot()
+        let t1 = (-b_2 - root) / a
+        if range.contains(t1) { return t1 }
+        let t2 = (-b_2 + root) / a
+        return range.contains(t2) ? t2 : nil
+    }
+
+    /// Same as `Quad.hit(ray:time:range:)`, without describing the hit.
+    @inline(__always)
+    private static func hit(_ quad: QuadRecord, ray: Ray3D, range: Range<Double>) -> Double? {
+        let t = -(quad.d + quad.normal • ray.origin) / (quad.normal • ray.direction)
+        guard t.isFinite && range.contains(t) else { return nil }
+        let p = ray[t] - quad.origin
+        let α = quad.w • (p ⨯ quad.v)
+        let β = quad.w • (quad.u ⨯ p)
+        return (0...1).contains(α) && (0...1).contains(β) ? t : nil
+    }
+}
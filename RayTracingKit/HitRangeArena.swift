@@ -0,0 +1,64 @@
+//
+//  HitRangeArena.swift
+//  RayTracing
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+
+/// Stack of hit ranges in memory provided by the caller, so that volumes compute hits without heap allocations.
+/// Volumes push their ranges on top, compositions merge ranges of their items and move the result down in place.
+public struct HitRangeArena {
+    private let storage: UnsafeMutablePointer<HitRange>
+    public let capacity: Int
+    public private(set) var count = 0
+
+    private init(_ buffer: UnsafeMutableBufferPointer<HitRange>) {
+        storage = buffer.baseAddress!
+        capacity = buffer.count
+    }
+
+    /// Calls `body` with an arena in temporary memory, which is on the stack for small capacities.
+    public static func withArena<R>(capacity: Int, _ body: (inout HitRangeArena) -> R) -> R {
+        withUnsafeTemporaryAllocation(of: HitRange.self, capacity: max(capacity, 1)) { buffer in
+            var arena = HitRangeArena(buffer)
+            defer { arena.removeLast(arena.count) }
+            return body(&arena)
+        }
+    }
+
+    public subscript(index: Int) -> HitRange {
+        get {
+            precondition(index < count)
+            return storage[index]
+        }
+        set {
+            precondition(index < count)
+            storage[index] = newValue
+        }
+    }
+
+    /// Entry and exit hits of ranges in `ranges`, in the same order as `[HitRange].hit(at:)`.
+    func hit(in ranges: Range<Int>, at index: Int) -> HitRecord {
+        let r = storage[ranges.lowerBound + index / 2]
+        return index % 2 == 0 ? r.entry : r.exit
+    }
+
+    public mutating func append(_ range: HitRange) {
+        precondition(count < capacity, "Capacity of the arena is less than hitRangeCapacity of the volume")
+        (storage + count).initialize(to: range)
+        count += 1
+    }
+
+    public mutating func removeLast(_ k: Int) {
+        (storage + count - k).deinitialize(count: k)
+        count -= k
+    }
+
+    /// Replaces everything from `destination` with ranges from `source`, which must be on top of the arena.
+    mutating func moveDown(_ source: Range<Int>, to destination: Int) {
+        precondition(source.upperBound == count && destination + source.count <= source.lowerBound)
+        (storage + destination).deinitialize(count: source.lowerBound - destination)
+        (storage + destination).moveInitialize(from: storage + source.lowerBound, count: source.count)
+        count = destination + source.count
+    }
+}
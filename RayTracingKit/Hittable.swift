@@ -101,6 +101,12 @@ public protocol Hittable {
 
 public protocol HittableVolume: Hittable {
     func hits(ray: Ray3D, time: Double) -> [HitRange]
+    /// Pushes the same ranges as `hits(ray:time:)` on top of `arena`, without allocating memory.
+    func hits(ray: Ray3D, time: Double, into arena: inout HitRangeArena)
+    /// Maximum number of ranges pushed by `hits(ray:time:into:)`.
+    var maxHitRanges: Int { get }
+    /// Maximum number of ranges in the arena at once during `hits(ray:time:into:)`, including the result.
+    var hitRangeCapacity: Int { get }
 }
 
 public protocol HittableConvexVolume: HittableVolume {
@@ -108,17 +114,27 @@ public protocol HittableConvexVolume: HittableVolume {
 }
 
 extension HittableVolume {
+    public func hits(ray: Ray3D, time: Double) -> [HitRange] {
+        HitRangeArena.withArena(capacity: hitRangeCapacity) { arena in
+            hits(ray: ray, time: time, into: &arena)
+            return (0..<arena.count).map { arena[$0] }
+        }
+    }
+
     public func hit(ray: Ray3D, time: Double, range: Range<Double>) -> HitRecord? {
-        let ranges = self.hits(ray: ray, time: time)
-        for r in ranges {
-            if range.contains(r.entry.t) {
-                return r.entry
-            }
-            if range.contains(r.exit.t) {
-                return r.exit
+        HitRangeArena.withArena(capacity: hitRangeCapacity) { arena in
+            hits(ray: ray, time: time, into: &arena)
+            for i in 0..<arena.count {
+                let r = arena[i]
+                if range.contains(r.entry.t) {
+                    return r.entry
+                }
+                if range.contains(r.exit.t) {
+                    return r.exit
+                }
             }
+            return nil
         }
-        return nil
     }
 }
 
@@ -130,6 +146,15 @@ extension HittableConvexVolume {
         return []
     }
 
+    public func hits(ray: Ray3D, time: Double, into arena: inout HitRangeArena) {
+        if let range = self.hit(ray: ray, time: time) {
+            arena.append(range)
+        }
+    }
+
+    public var maxHitRanges: Int { 1 }
+    public var hitRangeCapacity: Int { 1 }
+
     public func hit(ray: Ray3D, time: Double, range: Range<Double>) -> HitRecord? {
         if let r = self.hit(ray: ray, time: time) {
             if range.contains(r.entry.t) {
@@ -143,7 +168,7 @@ extension HittableConvexVolume {
     }
 }
 
-public struct Sphere: HittableVolume {
+public struct Sphere: HittableConvexVolume {
     public var center: Point3D
     public var radius: Double
     public var material: any Material
@@ -159,7 +184,7 @@ public struct Sphere: HittableVolume {
         return AABB(center - r, center + r)
     }
 
-    public func hits(ray: Ray3D, time: Double) -> [HitRange] {
+    public func hit(ray: Ray3D, time: Double) -> HitRange? {
         // P = ray[t]
         // (ray.origin + ray.direction * t - C) • (ray.origin + ray.direction * t - C) = radius²
         // (ray.direction * t + (ray.origin - C)) • (ray.direction * t + (ray.origin - C)) = radius²
@@ -170,10 +195,10 @@ public struct Sphere: HittableVolume {
         let b_2 = ray.direction • oc
         let c = oc • oc - radius * radius
         let D_4 = b_2 * b_2 - a * c
-        if D_4 < 0 { return [] }
+        if D_4 < 0 { return nil }
         let hit1 = hitRecord(for: (-b_2 - D_4.squareRoot()) / a, in: ray)
         let hit2 = hitRecord(for: (-b_2 + D_4.squareRoot()) / a, in: ray)
-        return [HitRange(hit1, hit2)]
+        return HitRange(hit1, hit2)
     }
 
     private func hitRecord(for t: Double, in ray: Ray3D) -> HitRecord {
@@ -183,7 +208,7 @@ public struct Sphere: HittableVolume {
         return HitRecord(t: t, point: point, normal: normal, rayDirection: ray.direction, material: material, textureCoordinates: textureCoordinates)
     }
 
-    private static func textureCoordinates(normal: Vector3D) -> Point2D {
+    static func textureCoordinates(normal: Vector3D) -> Point2D {
         return Point2D(
             u: (atan2(-normal.z, normal.x) + .pi) / (2 * .pi),
             v: acos(-normal.y) / .pi
@@ -413,115 +438,98 @@ public struct Composition: HittableVolume {
 
     public var center: Point3D { boundingBox.center }
 
-    public func hits(ray: Ray3D, time: Double) -> [HitRange] {
-        var ranges = items[0].hits(ray: ray, time: time)
+    public var maxHitRanges: Int {
+        // Every operation yields at most one range per range boundary of its inputs
+        items.reduce(0) { $0 + $1.maxHitRanges }
+    }
+
+    public var hitRangeCapacity: Int {
+        var ranges = items[0].maxHitRanges
+        var capacity = items[0].hitRangeCapacity
         for item in items.dropFirst() {
-            let next = item.hits(ray: ray, time: time)
-            switch operation {
-            case .union:
-                ranges = Self.makeUnion(lhs: ranges, rhs: next)
-            case .intersection:
-                ranges = Self.makeIntersection(lhs: ranges, rhs: next)
-            case .subtract:
-                ranges = Self.makeDifference(lhs: ranges, rhs: next)
-            }
+            // Accumulated ranges, ranges of the item and the merged result are in the arena together
+            capacity = max(capacity, ranges + item.hitRangeCapacity, 2 * (ranges + item.maxHitRanges))
+            ranges += item.maxHitRanges
         }
-        return ranges
+        return capacity
     }
 
-    static func enumerateHits(lhs: [HitRange], rhs: [HitRange], _ block: (HitRecord, Bool) -> Void) {
-        var i = 0, j = 0
-        while true {
-            if i < 2 * lhs.count {
-                let lhsHit = lhs.hit(at: i)
-                if j < 2 * rhs.count {
-                    let rhsHit = rhs.hit(at: j)
-                    if lhsHit.t < rhsHit.t {
-                        block(lhsHit, false)
-                        i += 1
-                    } else {
-                        block(rhsHit, true)
-                        j += 1
-                    }
-                } else {
-                    block(lhsHit, false)
-                    i += 1
-                }
-            } else {
-                if j < 2 * rhs.count {
-                    let rhsHit = rhs.hit(at: j)
-                    block(rhsHit, true)
-                    j += 1
-                } else {
-                    break
-                }
+    public func hits(ray: Ray3D, time: Double, into arena: inout HitRangeArena) {
+        let start = arena.count
+        items[0].hits(ray: ray, time: time, into: &arena)
+        for item in items.dropFirst() {
+            // Nothing to intersect with or to subtract from
+            if arena.count == start && operation != .union {
+                return
             }
+            let middle = arena.count
+            item.hits(ray: ray, time: time, into: &arena)
+            let end = arena.count
+            Self.merge(operation, lhs: start..<middle, rhs: middle..<end, in: &arena)
+            arena.moveDown(end..<arena.count, to: start)
         }
     }
 
-    static func makeUnion(lhs: [HitRange], rhs: [HitRange]) -> [HitRange] {
-        var result: [HitRange] = []
+    /// Pushes the result of `operation` on ranges `lhs` and `rhs` of the arena, streaming through hits of both in order.
+    static func merge(_ operation: Operation, lhs: Range<Int>, rhs: Range<Int>, in arena: inout HitRangeArena) {
         var entry: HitRecord?
         var depth: Int = 0
-        enumerateHits(lhs: lhs, rhs: rhs) { hit, _ in
-            if hit.face == .front {
-                if entry == nil {
-                    entry = hit
-                }
-                depth += 1
+        var i = 0, j = 0
+        while i < 2 * lhs.count || j < 2 * rhs.count {
+            let hit: HitRecord
+            let isRight: Bool
+            if j == 2 * rhs.count || i < 2 * lhs.count && arena.hit(in: lhs, at: i).t < arena.hit(in: rhs, at: j).t {
+                hit = arena.hit(in: lhs, at: i)
+                isRight = false
+                i += 1
             } else {
-                depth -= 1
-                if depth == 0 {
-                    result.append(HitRange(entry!, hit))
-                    entry = nil
-                }
+                hit = arena.hit(in: rhs, at: j)
+                isRight = true
+                j += 1
             }
-        }
-        return result
-    }
 
-    static func makeIntersection(lhs: [HitRange], rhs: [HitRange]) -> [HitRange] {
-        var result: [HitRange] = []
-        var entry: HitRecord?
-        var depth: Int = 0
-        enumerateHits(lhs: lhs, rhs: rhs) { hit, _ in
-            if hit.face == .front {
-                depth += 1
-                if depth == 2 {
-                    entry = hit
+            switch operation {
+            case .union:
+                if hit.face == .front {
+                    if entry == nil {
+                        entry = hit
+                    }
+                    depth += 1
+                } else {
+                    depth -= 1
+                    if depth == 0 {
+                        arena.append(HitRange(entry!, hit))
+                        entry = nil
+                    }
                 }
-            } else {
-                if depth == 2  {
-                    result.append(HitRange(entry!, hit))
-                    entry = nil
+            case .intersection:
+                if hit.face == .front {
+                    depth += 1
+                    if depth == 2 {
+                        entry = hit
+                    }
+                } else {
+                    if depth == 2 {
+                        arena.append(HitRange(entry!, hit))
+                        entry = nil
+                    }
+                    depth -= 1
                 }
-                depth -= 1
-            }
-        }
-        return result
-    }
-
-    static func makeDifference(lhs: [HitRange], rhs: [HitRange]) -> [HitRange] {
-        var result: [HitRange] = []
-        var entry: HitRecord?
-        var depth: Int = 0
-        enumerateHits(lhs: lhs, rhs: rhs) { hit, isRight in
-            if (hit.face == .front) != isRight {
-                depth += 1
-            } else {
-                depth -= 1
-            }
-            if depth == 1 {
-                entry = isRight ? hit.inverted : hit
-            } else {
-                if let e = entry {
+            case .subtract:
+                if (hit.face == .front) != isRight {
+                    depth += 1
+                } else {
+                    depth -= 1
+                }
+                if depth == 1 {
+                    entry = isRight ? hit.inverted : hit
+                } else if let e = entry {
                     let exit = isRight ? hit.inverted : hit
-                    result.append(HitRange(e, exit))
+                    arena.append(HitRange(e, exit))
                     entry = nil
                 }
             }
         }
-        return result
     }
 }
 
@@ -540,10 +548,13 @@ public struct MotionBlur<Base: HittableVolume>: HittableVolume {
         return boundingBox.center
     }
 
-    public func hits(ray: Ray3D, time: Double) -> [HitRange] {
-        return transformed(time: time).hits(ray: ray, time: time)
+    public func hits(ray: Ray3D, time: Double, into arena: inout HitRangeArena) {
+        transformed(time: time).hits(ray: ray, time: time, into: &arena)
     }
 
+    public var maxHitRanges: Int { base.maxHitRanges }
+    public var hitRangeCapacity: Int { base.hitRangeCapacity }
+
     public func hit(ray: Ray3D, time: Double, range: Range<Double>) -> HitRecord? {
         return transformed(time: time).hit(ray: ray, time: time, range: range)
     }
@@ -575,15 +586,18 @@ public struct Transformed<Base: HittableVolume>: HittableVolume {
         return boundingBox.center
     }
 
-    public func hits(ray: Ray3D, time: Double) -> [HitRange] {
+    public func hits(ray: Ray3D, time: Double, into arena: inout HitRangeArena) {
         let offsetRay = transform.inverse.transform(ray)
-        var hits = base.hits(ray: offsetRay, time: time)
-        for i in hits.indices {
-            hits[i].apply(transform: transform)
+        let start = arena.count
+        base.hits(ray: offsetRay, time: time, into: &arena)
+        for i in start..<arena.count {
+            arena[i].apply(transform: transform)
         }
-        return hits
     }
 
+    public var maxHitRanges: Int { base.maxHitRanges }
+    public var hitRangeCapacity: Int { base.hitRangeCapacity }
+
     public func hit(ray: Ray3D, time: Double, range: Range<Double>) -> HitRecord? {
         let offsetRay = transform.inverse.transform(ray)
         guard var h = base.hit(ray: offsetRay, time: time, range: range) else { return nil }
@@ -601,6 +615,8 @@ extension Transformed: HittableConvexVolume where Base: HittableConvexVolume {
     }
 }
 
+/// Tree of existentials, every visited node costs dynamic dispatch and reference counting.
+/// Prefer `CompiledScene` for rendering, especially for large scenes.
 public class BoundingVolumeNode: Hittable {
     public private(set) var boundingBox: AABB
     private var leftChild: any Hittable
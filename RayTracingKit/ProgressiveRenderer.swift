@@ -0,0 +1,191 @@
+//
+//  ProgressiveRenderer.swift
+//  RayTracing
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+
+import Foundation
+
+/// Renders an image in passes for interactive previews, returning a displayable image after every pass.
+///
+/// The first pass samples one pixel per `coarsestBlock`×`coarsestBlock` block, and the following passes halve the block size
+/// until every pixel has a sample. Each pixel is sampled exactly once while refining, so low-resolution samples are kept:
+/// a pixel without samples yet shows the sample of its smallest sampled block.
+/// Passes after that add `config.samplesPerPixel` samples to every pixel.
+///
+/// Tiles intersecting `regionOfInterest` are scheduled first and get `regionOfInterestSampleFactor` times more samples
+/// in full-resolution passes. Other tiles follow by distance from the region, or from the image center if there is none.
+public final class ProgressiveRenderer<World: Hittable> {
+    public typealias Region = (rows: Range<Int>, columns: Range<Int>)
+
+    public let camera: Camera
+    public let world: World
+    public var config: Camera.RenderConfig
+    public var regionOfInterest: Region?
+    public var regionOfInterestSampleFactor = 4
+    /// Block size of the first pass, a power of two.
+    public let coarsestBlock: Int
+    public let tileSize = 32
+    public private(set) var passCounter = 0
+
+    private var sums: [ColorF]
+    private var counts: [Int]
+    private var rng = SystemRandomNumberGenerator()
+
+    private struct Tile {
+        var rows: Range<Int>
+        var columns: Range<Int>
+    }
+
+    private struct TileResult {
+        var tile: Tile
+        /// Rows of the tile, top to bottom.
+        var sums: [ColorF]
+        var counts: [Int]
+    }
+
+    public init(camera: Camera, world: World, config: Camera.RenderConfig = .init(samplesPerPixel: 1), coarsestBlock: Int = 8) {
+        precondition(coarsestBlock > 0 && coarsestBlock & (coarsestBlock - 1) == 0, "Block size must be a power of two")
+        self.camera = camera
+        self.world = world
+        self.config = config
+        self.coarsestBlock = coarsestBlock
+        let pixelCount = camera.imageWidth * camera.imageHeight
+        sums = Array(repeating: .zero, count: pixelCount)
+        counts = Array(repeating: 0, count: pixelCount)
+    }
+
+    /// Number of passes before every pixel has a sample.
+    public var refinementPasses: Int {
+        coarsestBlock.trailingZeroBitCount + 1
+    }
+
+    /// Sets the region of interest to a square around the cursor.
+    public func focus(row: Int, column: Int, radius: Int = 32) {
+        regionOfInterest = (
+            rows: max(row - radius, 0)..<min(row + radius, camera.imageHeight),
+            columns: max(column - radius, 0)..<min(column + radius, camera.imageWidth)
+        )
+    }
+
+    public func renderPass() async -> Image {
+        let block = passCounter < refinementPasses ? coarsestBlock >> passCounter : nil
+        passCounter += 1
+        let camera = camera
+        let world = world
+        let maxDepth = config.maxDepth
+        let coarsestBlock = coarsestBlock
+        await withTaskGroup(of: TileResult.self) { group in
+            // Tasks start roughly in the order they are added
+            for tile in orderedTiles() {
+                let seed = rng.next()
+                let samples = block != nil ? 1 : config.samplesPerPixel * (intersectsRegion(tile) ? regionOfInterestSampleFactor : 1)
+                group.addTask {
+                    Self.render(tile: tile, camera: camera, world: world, block: block, coarsestBlock: coarsestBlock,
+                                samples: samples, maxDepth: maxDepth, seed: seed)
+                }
+            }
+            for await result in group {
+                merge(result)
+            }
+        }
+        return makeImage()
+    }
+
+    private static func render(tile: Tile, camera: Camera, world: World, block: Int?, coarsestBlock: Int,
+                               samples: Int, maxDepth: Int, seed: UInt64) -> TileResult {
+        var rng = WyRand(seed: seed)
+        var result = TileResult(
+            tile: tile,
+            sums: Array(repeating: .zero, count: tile.rows.count * tile.columns.count),
+            counts: Array(repeating: 0, count: tile.rows.count * tile.columns.count)
+        )
+        var k = 0
+        for i in tile.rows {
+            for j in tile.columns {
+                defer { k += 1 }
+                if let block, !isSampled(row: i, column: j, block: block, coarsestBlock: coarsestBlock) { continue }
+                result.sums[k] = camera.sample(i, j, count: samples, world: world, maxDepth: maxDepth, using: &rng)
+                result.counts[k] = samples
+            }
+        }
+        return result
+    }
+
+    /// Whether the refinement pass with `block` samples the pixel: it is the corner of a block,
+    /// and was not sampled by a coarser pass.
+    static func isSampled(row i: Int, column j: Int, block: Int, coarsestBlock: Int) -> Bool {
+        guard i % block == 0 && j % block == 0 else { return false }
+        return block == coarsestBlock || i % (2 * block) != 0 || j % (2 * block) != 0
+    }
+
+    func sampleCount(row i: Int, column j: Int) -> Int {
+        counts[i * camera.imageWidth + j]
+    }
+
+    /// Pixel whose samples are shown at `(i, j)`: the pixel itself, or the corner of its smallest sampled block.
+    func displayedPixel(row i: Int, column j: Int) -> (row: Int, column: Int)? {
+        var (row, column) = (i, j)
+        var block = 2
+        while counts[row * camera.imageWidth + column] == 0 && block <= coarsestBlock {
+            (row, column) = (i - i % block, j - j % block)
+            block *= 2
+        }
+        return counts[row * camera.imageWidth + column] > 0 ? (row, column) : nil
+    }
+
+    private func merge(_ result: TileResult) {
+        var k = 0
+        for i in result.tile.rows {
+            for j in result.tile.columns {
+                let p = i * camera.imageWidth + j
+                sums[p] = sums[p] + result.sums[k]
+                counts[p] += result.counts[k]
+                k += 1
+            }
+        }
+    }
+
+    private func makeImage() -> Image {
+        var image = Image(width: camera.imageWidth, height: camera.imageHeight)
+        for i in 0..<camera.imageHeight {
+            for j in 0..<camera.imageWidth {
+                guard let (row, column) = displayedPixel(row: i, column: j) else { continue }
+                let p = row * camera.imageWidth + column
+                image[i, j] = (sums[p] / Double(counts[p])).linearToGamma().asU8
+            }
+        }
+        return image
+    }
+
+    private func orderedTiles() -> [Tile] {
+        var tiles: [Tile] = []
+        for i in stride(from: 0, to: camera.imageHeight, by: tileSize) {
+            for j in stride(from: 0, to: camera.imageWidth, by: tileSize) {
+                tiles.append(Tile(rows: i..<min(i + tileSize, camera.imageHeight), columns: j..<min(j + tileSize, camera.imageWidth)))
+            }
+        }
+        let focus: (row: Double, column: Double)
+        if let regionOfInterest {
+            focus = (center(regionOfInterest.rows), center(regionOfInterest.columns))
+        } else {
+            focus = (Double(camera.imageHeight) / 2, Double(camera.imageWidth) / 2)
+        }
+        func priority(_ tile: Tile) -> (Int, Double) {
+            let di = center(tile.rows) - focus.row
+            let dj = center(tile.columns) - focus.column
+            return (intersectsRegion(tile) ? 0 : 1, di * di + dj * dj)
+        }
+        return tiles.sorted { priority($0) < priority($1) }
+    }
+
+    private func intersectsRegion(_ tile: Tile) -> Bool {
+        guard let regionOfInterest else { return false }
+        return tile.rows.overlaps(regionOfInterest.rows) && tile.columns.overlaps(regionOfInterest.columns)
+    }
+
+    private func center(_ range: Range<Int>) -> Double {
+        Double(range.lowerBound + range.upperBound) / 2
+    }
+}
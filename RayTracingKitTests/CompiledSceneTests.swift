@@ -0,0 +1,76 @@
+//
+//  CompiledSceneTests.swift
+//  RayTracingKitTests
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+
+import Testing
+@testable import RayTracingKit
+
+struct CompiledSceneTests {
+    /// Small spheres, axis-aligned quads and a CSG object around `offset`.
+    /// Far offsets check that Float bounds of the tree stay conservative for Double hit tests.
+    static func makeObjects(offset: Point3D) -> [any Hittable] {
+        var rng = WyRand(seed: 3)
+        let material = Lambertian(albedo: ColorF(x: 0.5, y: 0.5, z: 0.5))
+        func point(_ scale: Double) -> Point3D {
+            offset + Vector3D(x: .random(in: -scale...scale, using: &rng), y: .random(in: -scale...scale, using: &rng), z: .random(in: -scale...scale, using: &rng))
+        }
+        var objects: [any Hittable] = []
+        for _ in 0..<500 {
+            objects.append(Sphere(center: point(10), radius: .random(in: 0.01...0.5, using: &rng), material: material))
+        }
+        for _ in 0..<100 {
+            objects.append(Quad(origin: point(10), u: Vector3D(x: 1, y: 0, z: 0), v: Vector3D(x: 0, y: 0, z: 1), material: material))
+        }
+        let lens = Composition(operation: .intersection, items: [
+            Sphere(center: offset + Vector3D(x: 0, y: 0, z: -0.9), radius: 1, material: material),
+            Sphere(center: offset + Vector3D(x: 0, y: 0, z: 0.9), radius: 1, material: material),
+        ])
+        objects.append(lens)
+        return objects
+    }
+
+    @Test(arguments: [0, 1e4, -3e5])
+    func testHitsMatchBoundingVolumeNode(offset: Double) {
+        let offset = Point3D(x: offset, y: offset / 2, z: -offset)
+        let objects = Self.makeObjects(offset: offset)
+        let compiled = CompiledScene(objects: objects)
+        let reference = BoundingVolumeNode(items: objects)
+
+        var rng = WyRand(seed: 42)
+        func point(_ scale: Double) -> Point3D {
+            offset + Vector3D(x: .random(in: -scale...scale, using: &rng), y: .random(in: -scale...scale, using: &rng), z: .random(in: -scale...scale, using: &rng))
+        }
+        var rays: [Ray3D] = []
+        for _ in 0..<5000 {
+            rays.append(Ray3D(origin: point(30), target: point(10), normalized: true))
+        }
+        // Axis-parallel rays starting on planes of the boxes, where slab distances are 0 * ∞
+        for object in objects.prefix(200) {
+            let box = object.boundingBox
+            rays.append(Ray3D(origin: Point3D(x: box.minPoint.x, y: box.center.y, z: box.center.z - 20), direction: Vector3D(x: 0, y: 0, z: 1)))
+            rays.append(Ray3D(origin: Point3D(x: box.center.x, y: box.maxPoint.y, z: box.center.z + 20), direction: Vector3D(x: 0, y: 0, z: -1)))
+            rays.append(Ray3D(origin: Point3D(x: box.center.x - 20, y: box.center.y, z: box.center.z), direction: Vector3D(x: 1, y: 0, z: 0)))
+        }
+
+        var hits = 0
+        for ray in rays {
+            let expected = reference.hit(ray: ray, time: 0, range: 0.001..<Double.infinity)
+            let actual = compiled.hit(ray: ray, time: 0, range: 0.001..<Double.infinity)
+            #expect(actual?.t == expected?.t)
+            if expected != nil {
+                hits += 1
+            }
+        }
+        #expect(hits > 1000)
+    }
+
+    @Test func testBoundsRoundOutwards() {
+        for x in [0, 1e-40, 0.1, -0.1, 1e4 + 0.3, -3e5 - 0.7, 1e39, -1e39, .infinity, -.infinity] {
+            #expect(Double(CompiledScene.lowerBound(x)) <= x)
+            #expect(Double(CompiledScene.upperBound(x)) >= x)
+        }
+    }
+}
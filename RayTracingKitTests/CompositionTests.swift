@@ -0,0 +1,155 @@
+//
+//  CompositionTests.swift
+//  RayTracingKitTests
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+
+import Testing
+@testable import RayTracingKit
+
+/// Array-based CSG, as `Composition` did before using `HitRangeArena`.
+private enum Reference {
+    static func hits(_ volume: any HittableVolume, ray: Ray3D) -> [HitRange] {
+        guard let composition = volume as? Composition else {
+            return volume.hits(ray: ray, time: 0)
+        }
+        var ranges = hits(composition.items[0], ray: ray)
+        for item in composition.items.dropFirst() {
+            let next = hits(item, ray: ray)
+            switch composition.operation {
+            case .union:
+                ranges = makeUnion(lhs: ranges, rhs: next)
+            case .intersection:
+                ranges = makeIntersection(lhs: ranges, rhs: next)
+            case .subtract:
+                ranges = makeDifference(lhs: ranges, rhs: next)
+            }
+        }
+        return ranges
+    }
+
+    static func enumerateHits(lhs: [HitRange], rhs: [HitRange], _ block: (HitRecord, Bool) -> Void) {
+        var i = 0, j = 0
+        while i < 2 * lhs.count || j < 2 * rhs.count {
+            if j == 2 * rhs.count || i < 2 * lhs.count && lhs.hit(at: i).t < rhs.hit(at: j).t {
+                block(lhs.hit(at: i), false)
+                i += 1
+            } else {
+                block(rhs.hit(at: j), true)
+                j += 1
+            }
+        }
+    }
+
+    static func makeUnion(lhs: [HitRange], rhs: [HitRange]) -> [HitRange] {
+        var result: [HitRange] = []
+        var entry: HitRecord?
+        var depth: Int = 0
+        enumerateHits(lhs: lhs, rhs: rhs) { hit, _ in
+            if hit.face == .front {
+                if entry == nil {
+                    entry = hit
+                }
+                depth += 1
+            } else {
+                depth -= 1
+                if depth == 0 {
+                    result.append(HitRange(entry!, hit))
+                    entry = nil
+                }
+            }
+        }
+        return result
+    }
+
+    static func makeIntersection(lhs: [HitRange], rhs: [HitRange]) -> [HitRange] {
+        var result: [HitRange] = []
+        var entry: HitRecord?
+        var depth: Int = 0
+        enumerateHits(lhs: lhs, rhs: rhs) { hit, _ in
+            if hit.face == .front {
+                depth += 1
+                if depth == 2 {
+                    entry = hit
+                }
+            } else {
+                if depth == 2 {
+                    result.append(HitRange(entry!, hit))
+                    entry = nil
+                }
+                depth -= 1
+            }
+        }
+        return result
+    }
+
+    static func makeDifference(lhs: [HitRange], rhs: [HitRange]) -> [HitRange] {
+        var result: [HitRange] = []
+        var entry: HitRecord?
+        var depth: Int = 0
+        enumerateHits(lhs: lhs, rhs: rhs) { hit, isRight in
+            if (hit.face == .front) != isRight {
+                depth += 1
+            } else {
+                depth -= 1
+            }
+            if depth == 1 {
+                entry = isRight ? hit.inverted : hit
+            } else if let e = entry {
+                let exit = isRight ? hit.inverted : hit
+                result.append(HitRange(e, exit))
+                entry = nil
+            }
+        }
+        return result
+    }
+}
+
+struct CompositionTests {
+    static func makeVolumes() -> [any HittableVolume] {
+        var rng = WyRand(seed: 7)
+        let material = Lambertian(albedo: ColorF(x: 0.5, y: 0.5, z: 0.5))
+        func sphere() -> Sphere {
+            let center = Point3D(x: .random(in: -1...1, using: &rng), y: .random(in: -1...1, using: &rng), z: .random(in: -1...1, using: &rng))
+            return Sphere(center: center, radius: .random(in: 0.3...1.2, using: &rng), material: material)
+        }
+        let union = Composition(operation: .union, items: [sphere(), sphere(), sphere()])
+        let intersection = Composition(operation: .intersection, items: [sphere(), sphere()])
+        return [
+            union,
+            intersection,
+            Composition(operation: .subtract, items: [sphere(), sphere(), sphere()]),
+            Composition(operation: .subtract, items: [union, intersection, sphere()]),
+            Composition(operation: .intersection, items: [union, Composition(operation: .subtract, items: [sphere(), sphere()])]),
+            Composition(operation: .union, items: [intersection, Composition(operation: .subtract, items: [union, sphere()]), sphere()]),
+        ]
+    }
+
+    @Test(arguments: makeVolumes().indices)
+    func testHitsMatchArrayMerge(index: Int) {
+        let volume = Self.makeVolumes()[index]
+        var rng = WyRand(seed: 42)
+        func randomPoint(scale: Double) -> Point3D {
+            Point3D(x: .random(in: -scale...scale, using: &rng), y: .random(in: -scale...scale, using: &rng), z: .random(in: -scale...scale, using: &rng))
+        }
+        var nonEmpty = 0
+        for _ in 0..<2000 {
+            let ray = Ray3D(origin: randomPoint(scale: 4), target: randomPoint(scale: 1), normalized: true)
+            let expected = Reference.hits(volume, ray: ray)
+            let actual = volume.hits(ray: ray, time: 0)
+            #expect(actual.count == expected.count)
+            for (a, e) in zip(actual, expected) {
+                #expect(a.entry.t == e.entry.t && a.entry.face == e.entry.face)
+                #expect(a.exit.t == e.exit.t && a.exit.face == e.exit.face)
+            }
+            // `hit(ray:time:range:)` reads the same ranges from the arena
+            let first = expected.lazy.flatMap { [$0.entry, $0.exit] }.first { $0.t >= 0.001 }
+            #expect(volume.hit(ray: ray, time: 0, range: 0.001..<Double.infinity)?.t == first?.t)
+            if !expected.isEmpty {
+                nonEmpty += 1
+            }
+        }
+        #expect(nonEmpty > 100)
+    }
+}
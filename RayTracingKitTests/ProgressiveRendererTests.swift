@@ -0,0 +1,63 @@
+//
+//  ProgressiveRendererTests.swift
+//  RayTracingKitTests
+//
+//  Created by Mykola Pokhylets on 18/10/2026.
+//
+
+import Testing
+@testable import RayTracingKit
+
+struct ProgressiveRendererTests {
+    /// Size that is not a multiple of the tile or of any block, so that partial blocks are covered.
+    static func makeRenderer(coarsestBlock: Int) -> ProgressiveRenderer<Sphere> {
+        let camera = Camera(imageWidth: 45, imageHeight: 37)
+        let sphere = Sphere(center: Point3D(x: 0, y: 0, z: -2), radius: 0.5, material: Lambertian(albedo: ColorF(x: 0.5, y: 0.5, z: 0.5)))
+        return ProgressiveRenderer(camera: camera, world: sphere, config: .init(samplesPerPixel: 1, maxDepth: 2), coarsestBlock: coarsestBlock)
+    }
+
+    @Test(arguments: [1, 2, 8, 16])
+    func testEveryPixelSampledOnceWhileRefining(coarsestBlock: Int) async {
+        let renderer = Self.makeRenderer(coarsestBlock: coarsestBlock)
+        let (width, height) = (renderer.camera.imageWidth, renderer.camera.imageHeight)
+        for pass in 0..<renderer.refinementPasses {
+            _ = await renderer.renderPass()
+            let block = coarsestBlock >> pass
+            for i in 0..<height {
+                for j in 0..<width {
+                    // Sampled by this pass or a coarser one
+                    let expected = i % block == 0 && j % block == 0 ? 1 : 0
+                    #expect(renderer.sampleCount(row: i, column: j) == expected, "pass \(pass), pixel \(i), \(j)")
+                }
+            }
+        }
+        for i in 0..<height {
+            for j in 0..<width {
+                var block = coarsestBlock
+                var passes = 0
+                while block > 0 {
+                    passes += ProgressiveRenderer<Sphere>.isSampled(row: i, column: j, block: block, coarsestBlock: coarsestBlock) ? 1 : 0
+                    block /= 2
+                }
+                #expect(passes == 1, "pixel \(i), \(j)")
+            }
+        }
+    }
+
+    @Test(arguments: [2, 8])
+    func testFinerBlocksReplaceCoarser(coarsestBlock: Int) async {
+        let renderer = Self.makeRenderer(coarsestBlock: coarsestBlock)
+        let (width, height) = (renderer.camera.imageWidth, renderer.camera.imageHeight)
+        for pass in 0..<renderer.refinementPasses {
+            _ = await renderer.renderPass()
+            let block = coarsestBlock >> pass
+            for i in 0..<height {
+                for j in 0..<width {
+                    // Corner of the block of this pass, not of a coarser one that contains it
+                    let shown = renderer.displayedPixel(row: i, column: j)
+                    #expect(shown?.row == i - i % block && shown?.column == j - j % block, "pass \(pass), pixel \(i), \(j)")
+                }
+            }
+        }
+    }
+}